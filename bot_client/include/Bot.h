@@ -0,0 +1,105 @@
+#pragma once
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "ClientNetwork.h"
+#include "ClockSync.h"
+#include "NetworkData.h"
+
+// How often a bot in the lobby re-sends its character selection
+#define BOT_LOBBY_RESEND_MS 100.0
+// Snapshots further apart than this count as a stall
+#define BOT_STALL_MS (3 * SERVER_TICK_MS)
+
+// Local time in milliseconds, only meaningful relative to other calls
+double botNowMs();
+
+// One step of a scripted bot: hold these inputs for durationSeconds
+struct BotScriptStep {
+    double durationSeconds = 1;
+    bool forward = false;
+    bool backward = false;
+    bool leftward = false;
+    bool rightward = false;
+    bool jump = false;
+    bool shoot = false;
+    bool throwEgg = false;
+    bool ability = false;
+    // degrees per second added to the yaw while this step runs
+    float turnRate = 0;
+    float pitch = 0;
+};
+
+/**
+ * Lines of "<seconds> [forward] [backward] [left] [right] [jump] [shoot] [throw] [ability] [turn=deg/s] [pitch=deg]",
+ * played in order and looped. # starts a comment
+ */
+bool loadBotScript(const std::string& path, std::vector<BotScriptStep>& steps);
+
+// How regularly snapshots are arriving
+struct SnapshotStats {
+    unsigned int snapshots = 0;
+    unsigned int missedTicks = 0;
+    unsigned int stalls = 0;
+    // running mean/variance of the time between snapshots (Welford)
+    unsigned int intervals = 0;
+    double intervalMeanMs = 0;
+    double intervalM2 = 0;
+    double intervalMinMs = 1e9;
+    double intervalMaxMs = 0;
+
+    void addInterval(double intervalMs);
+    double jitterMs() const;
+    void merge(const SnapshotStats& other);
+};
+
+/**
+ * A headless client: connects, picks a character in the lobby, then sends random or scripted
+ * input every server tick and keeps track of how the snapshots arrive
+ */
+class Bot : public ClientNetworkListener {
+public:
+    Bot(unsigned int index, const std::vector<BotScriptStep>* script);
+
+    // Call as often as possible, does everything that's due
+    void update(double nowMs);
+
+    void handleIssueIdentifier(IssueIdentifierUpdate issue_identifier_update) override;
+    void handleLobbySelectionPacket(LobbyServerToClientPacket& lobbyPacket) override;
+    void handleServerActionEvent(ServerToClientPacket& updatePacket) override;
+    void handleBulletPacket(BulletPacket& bulletPacket) override;
+    void handleGameEndPacket(GameEndPacket& gameEndPacket) override;
+    void handleClockSyncReply(ClockSyncReply& reply) override;
+
+    void printStats();
+
+    unsigned int index;
+    int client_id = -1;
+    bool inGame = false;
+    bool gameOver = false;
+    SnapshotStats stats;
+    ClockSync clockSync;
+
+private:
+    void pickRandomInput();
+    void applyScriptStep(double nowMs);
+    void sendInput(double nowMs);
+
+    std::unique_ptr<ClientNetwork> network;
+    const std::vector<BotScriptStep>* script;
+    std::mt19937 rng;
+
+    double lastLobbySendMs = -BOT_LOBBY_RESEND_MS;
+    double nextInputMs = 0;
+    double lastSnapshotMs = -1;
+    unsigned int lastServerTick = 0;
+    unsigned int inputSequence = 0;
+
+    // what the bot is "pressing" right now
+    BotScriptStep current;
+    float yaw = -90.0f;
+    double currentStepEndsMs = 0;
+    size_t scriptIndex = 0;
+};
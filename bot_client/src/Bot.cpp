@@ -0,0 +1,238 @@
+#include "Bot.h"
+
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+double botNowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool loadBotScript(const std::string& path, std::vector<BotScriptStep>& steps) {
+    std::ifstream file(path);
+    if (!file) {
+        std::printf("couldn't open bot script %s\n", path.c_str());
+        return false;
+    }
+
+    std::string text;
+    int lineNumber = 0;
+    while (std::getline(file, text)) {
+        lineNumber++;
+        text = text.substr(0, text.find('#'));
+        std::istringstream words(text);
+        std::string word;
+        if (!(words >> word)) {
+            continue;
+        }
+
+        BotScriptStep step;
+        try {
+            step.durationSeconds = std::stod(word);
+        } catch (...) {
+            std::printf("%s:%d: expected a duration in seconds, got \"%s\"\n", path.c_str(), lineNumber, word.c_str());
+            return false;
+        }
+        while (words >> word) {
+            if (word == "forward")       step.forward = true;
+            else if (word == "backward") step.backward = true;
+            else if (word == "left")     step.leftward = true;
+            else if (word == "right")    step.rightward = true;
+            else if (word == "jump")     step.jump = true;
+            else if (word == "shoot")    step.shoot = true;
+            else if (word == "throw")    step.throwEgg = true;
+            else if (word == "ability")  step.ability = true;
+            else if (word.rfind("turn=", 0) == 0)  step.turnRate = std::stof(word.substr(5));
+            else if (word.rfind("pitch=", 0) == 0) step.pitch = std::stof(word.substr(6));
+            else {
+                std::printf("%s:%d: don't understand \"%s\"\n", path.c_str(), lineNumber, word.c_str());
+                return false;
+            }
+        }
+        steps.push_back(step);
+    }
+    if (steps.empty()) {
+        std::printf("bot script %s has no steps\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void SnapshotStats::addInterval(double intervalMs) {
+    intervals++;
+    double delta = intervalMs - intervalMeanMs;
+    intervalMeanMs += delta / intervals;
+    intervalM2 += delta * (intervalMs - intervalMeanMs);
+    intervalMinMs = std::min(intervalMinMs, intervalMs);
+    intervalMaxMs = std::max(intervalMaxMs, intervalMs);
+    if (intervalMs > BOT_STALL_MS) {
+        stalls++;
+    }
+}
+
+double SnapshotStats::jitterMs() const {
+    return intervals > 1 ? std::sqrt(intervalM2 / (intervals - 1)) : 0;
+}
+
+void SnapshotStats::merge(const SnapshotStats& other) {
+    // Chan et al. parallel variance
+    unsigned int total = intervals + other.intervals;
+    if (total > 0) {
+        double delta = other.intervalMeanMs - intervalMeanMs;
+        intervalM2 += other.intervalM2 + delta * delta * intervals * other.intervals / total;
+        intervalMeanMs += delta * other.intervals / total;
+    }
+    intervals = total;
+    snapshots += other.snapshots;
+    missedTicks += other.missedTicks;
+    stalls += other.stalls;
+    intervalMinMs = std::min(intervalMinMs, other.intervalMinMs);
+    intervalMaxMs = std::max(intervalMaxMs, other.intervalMaxMs);
+}
+
+Bot::Bot(unsigned int index, const std::vector<BotScriptStep>* script)
+    : index(index), script(script), rng(index * 7919 + 1) {
+    // connect and ask the server for a client id, same as ClientGame
+    network = std::make_unique<ClientNetwork>(this);
+    network->sendInitUpdate();
+}
+
+void Bot::update(double nowMs) {
+    network->receiveUpdates();
+
+    if (clockSync.shouldSendRequest(nowMs)) {
+        ClockSyncRequest request = clockSync.makeRequest(nowMs);
+        network->sendClockSyncRequest(request);
+    }
+
+    if (client_id < 0) {
+        // still waiting for the server to tell us who we are
+        return;
+    }
+
+    if (!inGame) {
+        if (nowMs - lastLobbySendMs >= BOT_LOBBY_RESEND_MS) {
+            lastLobbySendMs = nowMs;
+            LobbyClientToServerPacket packet;
+            packet.characterUID = client_id % 4;
+            packet.browsingCharacterUID = client_id % 4;
+            network->sendLobbyClientToServer(packet);
+        }
+        return;
+    }
+
+    // one input per server tick, like the real client
+    if (nowMs >= nextInputMs) {
+        nextInputMs = std::max(nextInputMs + SERVER_TICK_MS, nowMs);
+        if (script != nullptr) {
+            applyScriptStep(nowMs);
+        } else if (nowMs >= currentStepEndsMs) {
+            pickRandomInput();
+            currentStepEndsMs = nowMs + current.durationSeconds * 1000;
+        }
+        yaw += current.turnRate * SERVER_TICK_MS / 1000.0f;
+        sendInput(nowMs);
+    }
+}
+
+void Bot::pickRandomInput() {
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    current = BotScriptStep();
+    current.durationSeconds = 0.5 + 1.5 * unit(rng);
+    current.forward = unit(rng) < 0.6f;
+    current.backward = !current.forward && unit(rng) < 0.3f;
+    current.leftward = unit(rng) < 0.25f;
+    current.rightward = !current.leftward && unit(rng) < 0.3f;
+    current.jump = unit(rng) < 0.2f;
+    current.shoot = unit(rng) < 0.3f;
+    current.throwEgg = unit(rng) < 0.05f;
+    current.ability = unit(rng) < 0.05f;
+    current.turnRate = (unit(rng) - 0.5f) * 180.0f;
+    current.pitch = (unit(rng) - 0.5f) * 40.0f;
+}
+
+void Bot::applyScriptStep(double nowMs) {
+    if (currentStepEndsMs == 0) {
+        current = (*script)[0];
+        currentStepEndsMs = nowMs + current.durationSeconds * 1000;
+    }
+    while (nowMs >= currentStepEndsMs) {
+        scriptIndex = (scriptIndex + 1) % script->size();
+        current = (*script)[scriptIndex];
+        currentStepEndsMs += current.durationSeconds * 1000;
+    }
+}
+
+void Bot::sendInput(double nowMs) {
+    ClientToServerPacket packet = {};
+    packet.requestForward = current.forward;
+    packet.requestBackward = current.backward;
+    packet.requestLeftward = current.leftward;
+    packet.requestRightward = current.rightward;
+    packet.requestJump = current.jump;
+    packet.requestThrowEgg = current.throwEgg;
+    packet.requestShoot = current.shoot;
+    packet.requestAbility = current.ability;
+    packet.yaw = yaw;
+    packet.pitch = current.pitch;
+    packet.inputSequence = ++inputSequence;
+    packet.viewTick = (float)lastServerTick;
+    if (clockSync.isSynced()) {
+        packet.targetTick = (unsigned int)std::max(0.0, std::floor(clockSync.serverTickAt(nowMs + clockSync.getRoundTripMs() / 2))) + 1;
+    }
+    network->sendClientToServerPacket(packet);
+}
+
+void Bot::handleIssueIdentifier(IssueIdentifierUpdate issue_identifier_update) {
+    client_id = issue_identifier_update.client_id;
+    std::printf("bot %u is client %d\n", index, client_id);
+    if (client_id >= (int)issue_identifier_update.maxPlayers) {
+        std::printf("bot %u: the server only has room for %u players, client %d is past the end\n", index, issue_identifier_update.maxPlayers, client_id);
+    }
+}
+
+void Bot::handleLobbySelectionPacket(LobbyServerToClientPacket&) {
+}
+
+void Bot::handleServerActionEvent(ServerToClientPacket& updatePacket) {
+    double now = botNowMs();
+    if (!inGame) {
+        inGame = true;
+        std::printf("bot %u: game started\n", index);
+    }
+    clockSync.addTickStamp(updatePacket.serverTick, updatePacket.serverTimeMs);
+
+    stats.snapshots++;
+    if (lastSnapshotMs >= 0) {
+        stats.addInterval(now - lastSnapshotMs);
+        if (updatePacket.serverTick > lastServerTick + 1) {
+            stats.missedTicks += updatePacket.serverTick - lastServerTick - 1;
+        }
+    }
+    lastSnapshotMs = now;
+    lastServerTick = updatePacket.serverTick;
+}
+
+void Bot::handleBulletPacket(BulletPacket&) {
+}
+
+void Bot::handleGameEndPacket(GameEndPacket& gameEndPacket) {
+    if (gameEndPacket.gameOver && !gameOver) {
+        gameOver = true;
+        std::printf("bot %u: game over\n", index);
+    }
+}
+
+void Bot::handleClockSyncReply(ClockSyncReply& reply) {
+    double now = botNowMs();
+    clockSync.addReply(reply, now);
+    network->telemetry.setRoundTrip(clockSync.getRoundTripMs(), clockSync.getRoundTripJitterMs());
+}
+
+void Bot::printStats() {
+    std::printf("bot %u (client %d): %u snapshots, interval %.1fms avg (%.1f-%.1f), jitter %.1fms, %u missed ticks, %u stalls, rtt %.1fms\n",
+        index, client_id, stats.snapshots, stats.intervalMeanMs, stats.intervals ? stats.intervalMinMs : 0.0, stats.intervalMaxMs,
+        stats.jitterMs(), stats.missedTicks, stats.stalls, clockSync.getRoundTripMs());
+}
@@ -0,0 +1,58 @@
+// bot_client.cpp : Headless clients for load testing the server and measuring snapshot timing.
+//
+// Usage: bot_client [number of bots] [seconds to run, 0 for forever] [bot script]
+// Bots connect to "server-ip" and "client-connect-port" from setup.json, same as the real client.
+// Without a script each bot wanders around, jumps, shoots and throws the egg at random
+
+#include "Bot.h"
+
+#include <thread>
+#include <string>
+
+#define BOT_STATS_INTERVAL_MS 5000.0
+
+static void printAllStats(std::vector<std::unique_ptr<Bot>>& bots) {
+    SnapshotStats total;
+    for (std::unique_ptr<Bot>& bot : bots) {
+        bot->printStats();
+        total.merge(bot->stats);
+    }
+    std::printf("all bots: %u snapshots, interval %.1fms avg, jitter %.1fms, worst gap %.1fms, %u missed ticks, %u stalls\n",
+        total.snapshots, total.intervalMeanMs, total.jitterMs(), total.intervalMaxMs, total.missedTicks, total.stalls);
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int numBots = argc > 1 ? std::stoi(argv[1]) : 4;
+    double runSeconds = argc > 2 ? std::stod(argv[2]) : 0;
+
+    std::vector<BotScriptStep> script;
+    if (argc > 3 && !loadBotScript(argv[3], script)) {
+        return 1;
+    }
+
+    std::printf("starting %u bots%s\n", numBots, script.empty() ? " with random input" : " with a script");
+    std::vector<std::unique_ptr<Bot>> bots;
+    for (unsigned int i = 0; i < numBots; i++) {
+        bots.push_back(std::make_unique<Bot>(i, script.empty() ? nullptr : &script));
+    }
+
+    double startMs = botNowMs();
+    double lastStatsMs = startMs;
+    while (runSeconds <= 0 || botNowMs() - startMs < runSeconds * 1000) {
+        double now = botNowMs();
+        for (std::unique_ptr<Bot>& bot : bots) {
+            bot->update(now);
+        }
+
+        if (now - lastStatsMs >= BOT_STATS_INTERVAL_MS) {
+            lastStatsMs = now;
+            printAllStats(bots);
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    printAllStats(bots);
+    return 0;
+}
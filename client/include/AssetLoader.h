@@ -0,0 +1,65 @@
+#pragma once
+
+#include <deque>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+#include "SetupParser.h"
+
+// How many threads decode assets, 0 means one per core minus the one drawing frames
+#define ASSET_LOADER_THREADS std::stoi(SetupParser::getValue("asset_loader_threads"))
+// How long each frame may spend handing finished assets to OpenGL before it gets on with drawing
+#define ASSET_UPLOAD_BUDGET_MS std::stod(SetupParser::getValue("asset_upload_budget_ms"))
+
+// Work for the thread that owns the OpenGL context (and the other main thread only objects), run once
+using AssetUpload = std::function<void()>;
+// Work for a loader thread: read and decode a file, then say what the main thread should do with the result
+using AssetDecode = std::function<AssetUpload()>;
+
+/**
+ * Decodes models, images and sounds on a pool of worker threads so the window keeps responding while
+ * they load. OpenGL calls have to happen on the main thread, so each decoded asset comes back as an
+ * upload that the main loop runs a few of every frame, within a time budget
+ */
+class AssetLoader {
+public:
+    AssetLoader();
+    ~AssetLoader();
+
+    // Queue an asset, decodes run in the order they're queued
+    void load(AssetDecode decode);
+
+    // Run finished uploads until they run out or budgetMs has passed. One upload is never split,
+    // so a big one can go over the budget by itself
+    void uploadFinished(double budgetMs);
+    // Wait for everything queued so far, uploading as it finishes
+    void finish();
+
+    // Nothing waiting to be decoded or uploaded
+    bool isDone();
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+
+    // guards everything below
+    std::mutex mutex;
+    // workers wait on this for decodes, finish() waits on it for uploads
+    std::condition_variable changed;
+    std::deque<AssetDecode> decodes;
+    std::deque<AssetUpload> uploads;
+    // queued but not uploaded yet, including the ones being decoded right now
+    unsigned int unfinished = 0;
+    bool stopping = false;
+
+    // for the log line once everything's in
+    std::chrono::steady_clock::time_point startTime;
+    unsigned int loadedCount = 0;
+};
+
+extern std::unique_ptr<AssetLoader> assetLoader;
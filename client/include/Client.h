@@ -23,6 +23,7 @@ static std::unique_ptr<sge::ParticleEmitterEntity> makeProjParticleEmitterEntity
 
 extern double lastX, lastY;
 extern bool enableInput;
+extern bool showNetworkOverlay;
 extern std::unique_ptr<ClientGame> clientGame;
 // C++ inheritance only works when referencing objects as pointers/references
 extern std::vector<std::shared_ptr<sge::ModelEntityState>> entities;
@@ -19,19 +19,21 @@
 #include <cassert>
 #include <vector>
 #include <deque>
+#include <chrono>
 #include "ClientNetwork.h"
+// to avoid circular dependency (ui/UIManager.h includes Client.h, which uses ClientGame)
+class ClientGame;
 #include "NetworkData.h"
+#include "Physics.h"
+#include "SnapshotInterpolator.h"
+#include "ClockSync.h"
 #include "sound/SoundManager.h"
 #include "ui/UIManager.h"
 #include "sge/GraphicsEntity.h"
 #include <glm/glm.hpp>
 
-#define EGG_POSITION_INDEX NUM_PLAYER_ENTITIES
 
 
-// to avoid circular dependency
-class ClientNetwork;
-
 enum PlayerAnimations {
     NO_ANIMATION = -1,
     SHOOTING = 0,
@@ -53,7 +55,27 @@ struct BulletToRender {
     int framesToRender;  // start at BULLET_FRAMES, then --, -- ...
 };
 
-class ClientGame
+// A tick of movement input we've already applied locally but the server might not have yet
+struct PendingInput {
+    unsigned int sequence;
+    physics::MovementInput input;
+};
+
+// Stop predicting if we get this far ahead of the server, something is wrong with the connection
+#define MAX_PENDING_INPUTS 64
+// How fast a misprediction is blended away, fraction of the error left after each frame
+#define PREDICTION_ERROR_DECAY 0.85f
+// If we fall more than this many ticks behind (window dragged, debugger) skip ahead instead of sending a burst of inputs
+#define MAX_INPUT_CATCHUP_TICKS 8
+// Extra time on top of half the round trip we give inputs to reach the server before their tick.
+// Grows quickly when inputs arrive late and shrinks slowly while they're on time
+#define INPUT_ARRIVAL_MARGIN_START_MS 10.0
+#define INPUT_ARRIVAL_MARGIN_MAX_MS 100.0
+#define INPUT_ARRIVAL_MARGIN_LATE_STEP_MS 4.0
+#define INPUT_ARRIVAL_MARGIN_EARLY_STEP_MS 1.0
+#define INPUT_ARRIVAL_MARGIN_CREEP_MS 0.05
+
+class ClientGame : public ClientNetworkListener
 {
 
 public:
@@ -64,14 +86,35 @@ public:
 
     void initializeParticleEmitters();
 
-    void handleServerActionEvent(ServerToClientPacket& updatePacket);
-    void handleIssueIdentifier(IssueIdentifierUpdate issue_identifier_update);
-    void handleBulletPacket(BulletPacket& bulletPacket);
-    void handleGameEndPacket(GameEndPacket& gameEndPacket);
+    // Size everything for a match with this many players (players are the first movement entities, then the egg)
+    void resizePlayers(unsigned int numPlayers);
+    // Make room for more movement entities, new ones start out where the old code put them
+    void resizeMovementEntities(unsigned int numEntities);
+    // Start keeping track of a projectile the server just told us about
+    void addProjectile(const ProjectileSnapshot& projectile);
+    unsigned int eggIndex() const { return numPlayers; }
+    // What kind of thing a movement entity is, for picking its model
+    bool isPlayer(unsigned int movementIndex) const { return movementIndex < numPlayers; }
+    bool isEgg(unsigned int movementIndex) const { return movementIndex == numPlayers; }
+
+    // Lobby state of a player, safe to call with any id
+    int characterOf(int player) const;
+    int browsingCharacterOf(int player) const;
+    int teammateOf(int player) const;
+    // Everyone who has joined has picked a character, and there are enough of them to start
+    bool allJoinedPlayersReady() const;
+    int teamScore(Teams team) const;
+
+    void handleServerActionEvent(ServerToClientPacket& updatePacket) override;
+    void handleIssueIdentifier(IssueIdentifierUpdate issue_identifier_update) override;
+    void handleBulletPacket(BulletPacket& bulletPacket) override;
+    void handleGameEndPacket(GameEndPacket& gameEndPacket) override;
+    void handleClockSyncReply(ClockSyncReply& reply) override;
+    std::vector<std::string> networkOverlayLines();
     void updateShootingEmo();
     void updateBulletQueue();
 
-    void updateAnimations(std::bitset<NUM_STATES> movementEntityStates[]);
+    void updateAnimations(const std::vector<MovementEntitySnapshot>& movementEntities);
     bool shouldRenderBombTicks();
     bool shouldPlayBombTicking();
     bool shouldPlayDanceSong();
@@ -80,12 +123,25 @@ public:
 
     void update(); // <- will need to break this into 1.receiving from network and 2.sending client input to network
 
-    void sendClientInputToServer();
+    void sendClientInputToServer(unsigned int targetTick);
+
+    // Keep our estimate of the server's clock up to date, call once per frame
+    void updateClockSync();
+
+    // Client-side prediction of our own player's movement. Also sends our input to the server, once per server tick
+    void predictLocalMovement();
+    void stepLocalInput(unsigned int targetTick);
+    void reconcileLocalPlayer(ServerToClientPacket& updatePacket);
+
+    // Smoothly place everything we don't predict between the server snapshots we've received
+    void interpolateEntities();
 
     void sendLobbySelectionToServer(int browsingCharacterUID, int selectedCharacterUID);
-    void handleLobbySelectionPacket(LobbyServerToClientPacket& lobbyPacket);
+    void handleLobbySelectionPacket(LobbyServerToClientPacket& lobbyPacket) override;
 
     int client_id = 0;  // for init only, will be overwritten when the server assign me a client_id
+    // Players in the match. Until the server tells us, it's just us
+    unsigned int numPlayers = 0;
 
     // Game movements requested from client's input
     bool requestForward = false;
@@ -112,14 +168,42 @@ public:
     float playerYaw = -90.0f; // init to -90 so that default direction is -z axis.
     float playerPitch = 0.0f;
 
+    // Same collision map the server uses, so we can run the movement code locally
+    std::shared_ptr<const CollisionMap> collisionMap;
+    // Our player as of the newest input we applied locally, and as of the one before that (for smoothing between ticks)
+    physics::PlayerMovementState predictedState;
+    glm::vec3 previousPredictedPosition;
+    bool hasPredictedState = false;
+    // Server is moving us on its own (lerping, dancing, god mode...) so just show what it says
+    bool predictionEnabled = false;
+    unsigned int inputSequence = 0;
+    std::deque<PendingInput> pendingInputs;
+    // Leftover from the last correction, added to the rendered position and decayed every frame
+    glm::vec3 predictionError = glm::vec3(0);
+    // Only used to pace inputs until the clock is synced
+    std::chrono::steady_clock::time_point lastPredictionTime;
+    double predictionAccumulatorMs = 0;
+
+    // Server's clock and tick schedule, so each input can be sent to arrive right before the tick that uses it
+    ClockSync clockSync;
+    double inputArrivalMarginMs = INPUT_ARRIVAL_MARGIN_START_MS;
+    // Server tick our next input will be for, 0 until the clock is synced
+    unsigned int nextInputTick = 0;
+
+    // History of server snapshots for every movement entity, rendered slightly in the past
+    SnapshotInterpolator interpolator;
+    // Server tick everything else was rendered at this frame, sent with our input so the server can lag compensate shots
+    double lastRenderTick = 0;
+
     // Game world data (local + received from the server)
-    glm::vec3 positions[NUM_MOVEMENT_ENTITIES];
-    float yaws[NUM_MOVEMENT_ENTITIES];
-    float pitches[NUM_MOVEMENT_ENTITIES];
-    // make sure these 3 below are using NUM_PLAYER_ENTITIES!!!
-    float cameraDistances[NUM_PLAYER_ENTITIES];
-    int healths[NUM_PLAYER_ENTITIES];
-    int scores[NUM_PLAYER_ENTITIES];
+    // one for each movement entity
+    std::vector<glm::vec3> positions;
+    std::vector<float> yaws;
+    std::vector<float> pitches;
+    // one for each player
+    std::vector<float> cameraDistances;
+    std::vector<int> healths;
+    std::vector<int> scores;
     bool gameOver = false;
     Teams winner = BLUE;
     Season currentSeason = SPRING_SEASON;
@@ -127,7 +211,8 @@ public:
     double gameDurationInSeconds = 0.0;
 
 
-    bool projActive[NUM_TOTAL_PROJECTILES];
+    // one for each projectile, same order as projIndices
+    std::vector<bool> projActive;
     std::unique_ptr<sge::DiskParticleEmitterEntity> ambientParticleEmitters[4];
     std::vector<glm::vec4> ambientStartingColors[4] = {
         std::vector<glm::vec4>({
@@ -164,8 +249,8 @@ public:
         std::vector<float>({ 1.0f })
     };
 
-    std::unique_ptr<sge::ParticleEmitterEntity> projParticleEmitters[NUM_TOTAL_PROJECTILES];
-    std::unique_ptr<sge::ParticleEmitterEntity> projExplosionEmitters[NUM_TOTAL_PROJECTILES];
+    std::vector<std::unique_ptr<sge::ParticleEmitterEntity>> projParticleEmitters;
+    std::vector<std::unique_ptr<sge::ParticleEmitterEntity>> projExplosionEmitters;
     std::vector<glm::vec4> projStartingColors[NUM_PROJ_TYPES] = {
         std::vector<glm::vec4>({
             glm::vec4(0.12f, 0.42f, 0.12f, 1.0f),
@@ -223,20 +308,24 @@ public:
     int detonationMiliSecs = 150;
     bool waitingCD = false;
 
-    int animations[NUM_MOVEMENT_ENTITIES];
+    std::vector<int> animations;
 
-    // Contains the indices between 0 and NUM_MOVEMENT_ENTITIES which correspond to players
+    // Contains the movement entity indices which correspond to players
     std::vector<unsigned int> playerIndices;
 
-    // Contains the indices between 0 and NUM_MOVEMENT_ENTITIES which correspond to projectiles
+    // Contains the movement entity indices which correspond to projectiles
     std::vector<unsigned int> projIndices;
 
     // map player's id to entity you want
     // player's character selection
-    int characterUID[NUM_PLAYER_ENTITIES] = { NO_CHARACTER,NO_CHARACTER,NO_CHARACTER,NO_CHARACTER };
+    std::vector<int> characterUID;
 
-    int browsingCharacterUID[NUM_PLAYER_ENTITIES];
+    std::vector<int> browsingCharacterUID;
 
     // teammate setup
-    int teams[NUM_PLAYER_ENTITIES] = { 0,0,0,0 };
+    std::vector<int> teams;
+    // which lobby slots have a player in them right now
+    std::vector<bool> joined;
+    // how many players are in the lobby right now
+    unsigned int numJoinedPlayers = 0;
 };
@@ -21,11 +21,22 @@
 
 #include "NetworkServices.h"
 #include "NetworkData.h"
+#include "NetTelemetry.h"
 #include "SetupParser.h"
 
-// to avoid circular dependency
-class ClientGame;
-#include "ClientGame.h"
+/**
+ * Whoever owns a ClientNetwork and reacts to what the server sends: ClientGame, or a headless bot
+ */
+class ClientNetworkListener {
+public:
+    virtual ~ClientNetworkListener() = default;
+    virtual void handleIssueIdentifier(IssueIdentifierUpdate issue_identifier_update) = 0;
+    virtual void handleLobbySelectionPacket(LobbyServerToClientPacket& lobbyPacket) = 0;
+    virtual void handleServerActionEvent(ServerToClientPacket& updatePacket) = 0;
+    virtual void handleBulletPacket(BulletPacket& bulletPacket) = 0;
+    virtual void handleGameEndPacket(GameEndPacket& gameEndPacket) = 0;
+    virtual void handleClockSyncReply(ClockSyncReply& reply) = 0;
+};
 
 // size of our buffer
 #define DEFAULT_BUFLEN 512
@@ -47,11 +58,19 @@ public:
     int iResult;
 
     char network_data[MAX_PACKET_SIZE];
+    // bytes of the last update that hadn't fully arrived yet
+    std::vector<char> pendingData;
+    // bytes the socket hasn't taken yet. Nonblocking sends can stop partway through an
+    // update, the rest has to go out before anything newer or the server reads garbage
+    std::vector<char> outgoingData;
 
     // socket for client to connect to server
     SOCKET ConnectSocket;
 
-    ClientGame *game;
+    ClientNetworkListener *game;
+
+    // traffic counters for our connection, shown on the network overlay
+    NetTelemetry telemetry;
 
     // receive updates
     void receiveUpdates();
@@ -64,11 +83,18 @@ public:
     void sendIncreaseCounterUpdate(IncreaseCounterUpdate& increase_counter_update);
     void sendReplaceCounterUpdate(ReplaceCounterUpdate& replace_counter_update);
     void sendClientToServerPacket(ClientToServerPacket& packet);
+    void sendClockSyncRequest(ClockSyncRequest& request);
     void sendInitUpdate();
 
+    // send a serialized update and count it in telemetry, queued behind anything still waiting
+    void sendToServer(char* packet_data, int packet_size);
+
+    // retry whatever the socket wouldn't take last frame, called at the start of receiveUpdates
+    void flushSends();
+
     // ctor/dtor
-    ClientNetwork(ClientGame* game);
+    ClientNetwork(ClientNetworkListener* game);
     ~ClientNetwork(void);
 
-    int receivePackets(char*);
+    int receivePackets(char* recvbuf, int bufSize);
 };
\ No newline at end of file
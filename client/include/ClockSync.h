@@ -0,0 +1,69 @@
+#pragma once
+
+#include <deque>
+#include "NetworkData.h"
+#include "GameConstants.h"
+
+// How many of the most recent sync replies we keep, the fastest one of these gives the offset
+#define CLOCK_SYNC_WINDOW 8
+// Ask quickly until the window is full, then settle down to one request a second
+#define CLOCK_SYNC_FAST_INTERVAL_MS 200.0
+#define CLOCK_SYNC_INTERVAL_MS 1000.0
+// Wait at least this long between two offset estimates before trusting the slope between them as drift
+#define CLOCK_DRIFT_MIN_SPAN_MS 10000.0
+// Real clocks are off by tens of ppm, anything bigger is just noise from a bad sample
+#define CLOCK_MAX_DRIFT 0.0005
+
+// One request/reply round trip, from the client's point of view
+struct ClockSample {
+    double localMs;     // when the reply came back
+    double roundTripMs;
+    double offsetMs;    // serverTime - localTime
+};
+
+/**
+ * Estimates the server's clock from NTP-style request/reply round trips: round trip time,
+ * offset between the two clocks, and the rate the offset drifts at. Combined with the tick
+ * stamps on snapshots this tells us which server tick will be running at any local time
+ */
+class ClockSync {
+public:
+    // True if enough time has passed that we should send another request
+    bool shouldSendRequest(double nowMs) const;
+    ClockSyncRequest makeRequest(double nowMs);
+    void addReply(const ClockSyncReply& reply, double nowMs);
+
+    // Every snapshot says when its tick started on the server's clock
+    void addTickStamp(unsigned int serverTick, double serverTimeMs);
+
+    bool isSynced() const { return !samples.empty() && hasTickStamp; }
+
+    double serverTimeMs(double localMs) const;
+    // (fractional) server tick running at the given local time, e.g. 10.5 is halfway through tick 10
+    double serverTickAt(double localMs) const;
+
+    double getRoundTripMs() const { return roundTripMs; }
+    double getRoundTripJitterMs() const { return roundTripJitterMs; }
+    double getOffsetMs() const { return offsetMs; }
+    double getDrift() const { return drift; }
+
+private:
+    std::deque<ClockSample> samples;
+    double lastRequestMs = -CLOCK_SYNC_INTERVAL_MS;
+
+    // Current best estimates
+    double roundTripMs = 0;
+    double roundTripJitterMs = 0;
+    double offsetMs = 0;
+    double offsetLocalMs = 0;  // local time offsetMs was measured at
+    double drift = 0;          // change in offset per ms of local time
+
+    // Older estimate we measure drift against
+    bool hasDriftReference = false;
+    double driftReferenceOffsetMs = 0;
+    double driftReferenceLocalMs = 0;
+
+    bool hasTickStamp = false;
+    unsigned int stampTick = 0;
+    double stampServerMs = 0;
+};
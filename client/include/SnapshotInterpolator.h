@@ -0,0 +1,65 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <glm/glm.hpp>
+#include "GameConstants.h"
+#include "NetworkData.h"
+
+// How many past snapshots we keep for each entity (~1 second of server ticks)
+#define SNAPSHOT_HISTORY_LENGTH 32
+// Bounds for how far behind the newest snapshot we render, in milliseconds
+#define MIN_INTERPOLATION_DELAY_MS SERVER_TICK_MS
+#define MAX_INTERPOLATION_DELAY_MS 250.0
+// Never guess further than this past the newest snapshot if packets are late
+#define MAX_EXTRAPOLATION_MS 100.0
+// Moving further than this in a single tick is a teleport (respawn, projectile spawn), don't smooth it
+#define SNAPSHOT_TELEPORT_DISTANCE 5.0f
+
+// State of one entity as of one server tick
+struct EntitySnapshot {
+    unsigned int serverTick;
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+};
+
+/**
+ * Keeps a short history of server snapshots for every entity and renders them slightly in the past,
+ * so remote players and projectiles move smoothly between the 33ms server ticks regardless of
+ * client frame rate or network jitter. Times are all in server ticks as estimated by ClockSync,
+ * this only keeps track of how late snapshots show up compared to that clock
+ */
+class SnapshotInterpolator {
+public:
+    explicit SnapshotInterpolator(unsigned int numEntities = 0);
+
+    void addSnapshot(unsigned int serverTick, const std::vector<MovementEntitySnapshot>& entities);
+    // When the snapshot for serverTick got here, by the server's clock
+    void addArrival(unsigned int serverTick, double arrivalServerTick);
+
+    // Server tick (fractional) we should be rendering when the server is at nowServerTick
+    double renderTick(double nowServerTick);
+
+    // Interpolated state of the entity at the given server tick. Returns false if we have nothing for it yet
+    bool sample(unsigned int entity, double tick, glm::vec3& position, float& yaw, float& pitch) const;
+
+    double getInterpolationDelayMs() const { return interpolationDelayMs; }
+    unsigned int getNewestTick() const { return newestTick; }
+
+private:
+    glm::vec3 tangentAt(const std::deque<EntitySnapshot>& history, size_t i) const;
+
+    std::vector<std::deque<EntitySnapshot>> histories;
+
+    bool hasSnapshots = false;
+    bool hasArrivals = false;
+    // How long after its tick started a snapshot usually gets to us, smoothed over many snapshots
+    double arrivalDelayMs = 0;
+    // Average of how late/early snapshots arrive compared to arrivalDelayMs
+    double arrivalJitterMs = 0;
+    double interpolationDelayMs = 2 * SERVER_TICK_MS;
+    unsigned int newestTick = 0;
+};
+
+float slerpYaw(float fromDegrees, float toDegrees, float t);
@@ -0,0 +1,49 @@
+#pragma once
+
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <unordered_map>
+
+#include "sge/GraphicsGeometry.h"
+
+/**
+ * Shitty graphics engine (SGE)
+ */
+namespace sge {
+
+    /**
+     * Bone matrices of every pose drawn this frame, back to back in one texture buffer the skinning shaders read from.
+     * Each pose is written once a frame however many passes draw it, and draws find their bones by the pose's offset
+     * into the palette instead of uploading a bone uniform array each time they change entity.
+     * A pose only takes up as many bones as its model has
+     */
+    class BonePalette {
+    public:
+        void initPalette();
+        void deletePalette();
+        // Add a pose to this frame's palette if it isn't already in it, returns where its first bone is
+        unsigned int add(const ModelPose &pose);
+        // Send the bones added since the last upload to the GPU, in one buffer write
+        void upload();
+        // Start the next frame's palette, once per frame before anything's drawn
+        void clear();
+        // Poses and bones in this frame's palette, for the debug overlay
+        unsigned int numPoses() const;
+        unsigned int numBones() const;
+    private:
+        std::vector<glm::mat4> bones;
+        std::unordered_map<const ModelPose *, unsigned int> offsets; // Where each pose added this frame starts
+        size_t uploaded = 0; // Bones already on the GPU
+        size_t capacity = 0; // Bones the buffer has room for
+        GLuint TBO; // Buffer holding the bones
+        GLuint texture; // Texture buffer the shaders read TBO through
+    };
+
+    extern BonePalette bonePalette;
+}
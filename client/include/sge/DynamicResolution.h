@@ -0,0 +1,58 @@
+#pragma once
+
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#include <chrono>
+
+#include "sge/GraphicsConstants.h"
+
+/**
+ * Shitty graphics engine (SGE)
+ */
+namespace sge {
+
+    /**
+     * Picks the render scale the 3D scene is drawn at (as a fraction of the window's resolution) to hold
+     * target_frame_time_ms from setup.json. Every RENDER_SCALE_INTERVAL frames it looks at how long the GPU and CPU
+     * spent on them: the scale goes down a step when the GPU is over budget and is what's holding the frame up, and
+     * back up a step once there's room to spare. The UI is always drawn at the window's resolution
+     */
+    class DynamicResolution {
+    public:
+        void initTimers();
+        void deleteTimers();
+        // Start timing a frame, call before drawing anything
+        void beginFrame();
+        // Stop timing the frame and adjust the scale if it's time to, call right before swapping buffers
+        void endFrame();
+        float getScale() const;
+        // Turn scaling on or off, off locks the scale at RENDER_SCALE_MAX
+        void setEnabled(bool enable);
+        bool isEnabled() const;
+        // Averages over the last RENDER_SCALE_INTERVAL frames, for the debug overlay
+        double gpuMs = 0;
+        double cpuMs = 0;
+        double budgetMs;
+    private:
+        void adjustScale();
+        float scale = RENDER_SCALE_MAX;
+        bool enabled;
+        // Timer queries are read a few frames after they're issued so we never wait on the GPU for them
+        GLuint queries[RENDER_TIMER_QUERIES];
+        bool pending[RENDER_TIMER_QUERIES] = {}; // Whether a query has been issued and not read back yet
+        unsigned int nextQuery = 0;
+        bool timing = false; // Whether this frame has a query running
+        std::chrono::steady_clock::time_point cpuStart;
+        // Totals since the last adjustment
+        unsigned int frames = 0;
+        unsigned int gpuSamples = 0;
+        double gpuTotalMs = 0;
+        double cpuTotalMs = 0;
+    };
+
+    extern DynamicResolution dynamicResolution;
+}
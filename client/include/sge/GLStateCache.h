@@ -0,0 +1,97 @@
+#pragma once
+
+#ifdef __APPLE__
+#include <OpenGL/gl3.h>
+#else
+#include <GL/glew.h>
+#endif
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+/**
+ * Shitty graphics engine (SGE)
+ */
+namespace sge {
+
+    /**
+     * How many state changes were sent to OpenGL and how many were dropped for changing nothing
+     */
+    struct GLStateStats {
+        unsigned int issued = 0;
+        unsigned int skipped = 0;
+    };
+
+    /**
+     * Remembers the OpenGL state sge has set (bound program, VAO, textures per unit, blend/depth/cull state and
+     * uniform values) and only passes calls on to OpenGL when they'd change something.
+     * Takes the same arguments as the GL function it replaces. Everything in sge sets state through here, so any
+     * code that changes the same state with plain GL calls has to invalidate() afterwards
+     */
+    class GLStateCache {
+    public:
+        void useProgram(GLuint program);
+        void bindVertexArray(GLuint array);
+        void activeTexture(GLenum unit);
+        void bindTexture(GLenum target, GLuint texture);
+
+        void enable(GLenum cap);
+        void disable(GLenum cap);
+        void enablei(GLenum cap, GLuint index);
+        void disablei(GLenum cap, GLuint index);
+        void blendFunc(GLenum sfactor, GLenum dfactor);
+        void depthFunc(GLenum func);
+        void depthMask(GLboolean flag);
+        void cullFace(GLenum mode);
+
+        // Uniforms of the program bound with useProgram
+        void uniform1i(GLint location, GLint v0);
+        void uniform1f(GLint location, GLfloat v0);
+        void uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+        void uniform2fv(GLint location, GLsizei count, const GLfloat *value);
+        void uniform3fv(GLint location, GLsizei count, const GLfloat *value);
+        void uniform4fv(GLint location, GLsizei count, const GLfloat *value);
+        void uniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value);
+        void uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value);
+
+        // Deleting a bound texture or VAO unbinds it, these keep the cache in step
+        void deleteTextures(GLsizei n, const GLuint *textures);
+        void deleteVertexArrays(GLsizei n, const GLuint *arrays);
+
+        // Forget everything, the next call of each kind always goes to OpenGL
+        void invalidate();
+
+        // Call once a frame, after swapping buffers
+        void endFrame();
+        // Counts for the frame so far and the whole of the last one
+        GLStateStats stats;
+        GLStateStats lastFrameStats;
+
+    private:
+        // Whether value differs from what the current program's uniform at location was last set to, remembers it if so
+        bool uniformChanged(GLint location, const void *value, size_t size);
+        // Count a call, returning whether it has to go to OpenGL
+        bool changed(bool isChanged);
+        void setCapability(GLenum cap, bool enabled);
+        void setCapabilityIndexed(GLenum cap, GLuint index, bool enabled);
+
+        // What state is in until it's set through the cache, for names and enums that can't be this
+        static constexpr GLuint UNKNOWN = ~0u;
+
+        GLuint program = UNKNOWN;
+        GLuint vertexArray = UNKNOWN;
+        GLenum textureUnit = UNKNOWN;
+        std::unordered_map<uint64_t, GLuint> textures; // Keyed by unit and target
+        std::unordered_map<GLenum, bool> capabilities; // glEnable/glDisable
+        std::unordered_map<uint64_t, bool> indexedCapabilities; // glEnablei/glDisablei, keyed by capability and index
+        GLenum blendSource = UNKNOWN;
+        GLenum blendDestination = UNKNOWN;
+        GLenum depthFunction = UNKNOWN;
+        int depthWrites = -1;
+        GLenum culledFace = UNKNOWN;
+        std::unordered_map<uint64_t, std::vector<unsigned char>> uniforms; // Keyed by program and location
+    };
+
+    extern GLStateCache glState;
+}
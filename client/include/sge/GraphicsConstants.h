@@ -16,7 +16,8 @@ enum TexType {
     SHININESS_TEXTURE = 5,
     SHADOWMAP_TEXTURE = 6,
     UNKNOWN_TEXTYPE = 7,
-    NUM_TEXTURES = 8
+    BONE_PALETTE_TEXTURE = 8, // Not a material texture, the unit BonePalette stays bound to
+    NUM_TEXTURES = 9
 };
 
 /**
@@ -27,20 +28,19 @@ enum VAOLayout {
     NORMAL_POS = 1,
     TEXCOORD_POS = 2,
     BONEIDX_POS = 3,
-    BONEWEIGHT_POS = 4
+    BONEWEIGHT_POS = 4,
+    INSTANCE_MODEL_POS = 5, // Per-instance model matrix, one location per column so it takes up 5 to 8
+    INSTANCE_FLAGS_POS = 9 // Per-instance outline, alternate texture, texture index and seasons flags
 };
 
 /**
- * Indices of vertex buffer, normal buffer, etc. for ModelComposite's buffer array
+ * Indices of vertex buffer and index buffer for ModelComposite's buffer array
+ * (positions, normals, texture coordinates and bone weights are interleaved in the vertex buffer, see ModelVertex)
  */
 enum BufferIndex {
     VERTEX_BUF = 0,
-    NORMAL_BUF = 1,
-    TEXCOORD_BUF = 2,
-    BONE_IDX = 3,
-    BONE_WEIGHT = 4,
-    INDEX_BUF = 5,
-    NUM_BUFFERS = 6
+    INDEX_BUF = 1,
+    NUM_BUFFERS = 2
 };
 
 /**
@@ -62,6 +62,23 @@ enum ModelIndex {
     NUM_MODELS
 };
 
+/**
+ * Passes the render queue draws, each one is queued and drawn separately
+ */
+enum RenderPass {
+    SHADOW_PASS = 0, // Depth only, from the light into the shadow map
+    MAIN_PASS = 1, // Toon shaded into the gBuffer
+    NUM_RENDER_PASSES
+};
+
+/**
+ * Uniform buffer binding points, fixed so every program that declares a block reads the same buffer
+ */
+enum UniformBlockBinding {
+    FRAME_DATA_BINDING = 0, // FrameData block, see FrameUniforms in GraphicsShaders.h
+    NUM_UNIFORM_BLOCKS
+};
+
 enum ParticleIndex {
     FIRE = 0,
     SNOW = 1,
@@ -77,7 +94,48 @@ enum ParticleIndex {
 // Maximum number of bones per model
 #define MAX_BONES 100
 
+// How far (in degrees) the light can move before the cached static shadows have to be redrawn for it. The shadows
+// only follow the light in steps this big
+#define STATIC_SHADOW_MAX_ANGLE 0.25f
+
+// Number of shadow map cascades, each covers a slice of the camera's view further away than the last one's.
+// The shaders hardcode it too (lightSpace in the FrameData block), change them together
+#define SHADOW_CASCADES 3
+// How far from the camera shadows reach
+#define SHADOW_DISTANCE 80.0f
+// How the view is split between cascades, 0 for even slices up to 1 for slices growing logarithmically with distance
+#define CASCADE_SPLIT_LAMBDA 0.75f
+// Cascades move in steps of 1 / this much of their width (rounded to whole texels, so shadows don't shimmer).
+// Each cascade's static shadows stay cached until it moves a step
+#define CASCADE_SNAP_STEPS 8
+// Light space depth the shadow maps cover either side of the light's position
+#define SHADOW_DEPTH_RANGE 40.0f
+
+// Dynamic resolution, the 3D scene is drawn at between RENDER_SCALE_MIN and RENDER_SCALE_MAX of the window's
+// resolution in each direction, changing by RENDER_SCALE_STEP at a time
+#define RENDER_SCALE_MIN 0.5f
+#define RENDER_SCALE_MAX 1.0f
+#define RENDER_SCALE_STEP 0.05f
+// Frames averaged between each change to the render scale
+#define RENDER_SCALE_INTERVAL 15
+// Fraction of the frame time budget the GPU has to stay under before the render scale goes back up
+#define RENDER_SCALE_HEADROOM 0.9f
+// GPU timer queries kept in flight, the GPU can be this many frames behind before frames stop getting timed
+#define RENDER_TIMER_QUERIES 4
+
+// G-buffer color and normal formats to choose from (gbuffer_color_format and gbuffer_normal_format in setup.json)
+#define NUM_COLOR_FORMATS 2
+#define NUM_NORMAL_FORMATS 2
+
+// Smallest resolution cycling through shadow map resolutions goes down to before going back to shadowmap-resolution
+#define SHADOWMAP_MIN_RESOLUTION 1024
+
 #define MAX_PARTICLE_INSTANCE 10000 // Maximum number of particle instances per particle type
 
+// Animated models' bounds come from posing them this many times through each animation
+#define ANIMATION_BOUNDS_SAMPLES 16
+// and growing the result by this fraction of its size on each side, for whatever happens between samples
+#define ANIMATION_BOUNDS_PADDING 0.1f
+
 // Assimp model importer flags
 #define ASSIMP_IMPORT_FLAGS aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices | aiProcess_ValidateDataStructure | aiProcess_FindInstances | aiProcess_OptimizeGraph | aiProcess_OptimizeMeshes
@@ -10,6 +10,7 @@
 #include <random>
 #include <bitset>
 #include "GraphicsGeometry.h"
+#include "RenderQueue.h"
 
 namespace sge {
 
@@ -36,6 +37,8 @@ namespace sge {
         // Draw this element to the screen
         virtual void draw() const override;
         virtual void drawShadow() const;
+        // Whether the entity's shadow never changes, so it can go in the cached static shadow map
+        virtual bool hasStaticShadow() const;
         virtual void update() override;
         virtual void updateOutline(bool outline);
         virtual void updateShadow(bool shadow);
@@ -57,6 +60,7 @@ namespace sge {
         // Add hitboxes here? idk
         bool castShadow = true; // Whether this entity should cast a shadow with the global light
         size_t modelIndex; // This entity's index in GraphicsGeometry.h's model array
+        DrawInstance drawInstance() const;
     };
 
     /**
@@ -69,6 +73,7 @@ namespace sge {
         DynamicModelEntityState(size_t modelIndex, size_t positionIndex);
         void draw() const override;
         void drawShadow() const override;
+        bool hasStaticShadow() const override;
         void update() override;
         void setAnimation(unsigned int animationId);
     protected:
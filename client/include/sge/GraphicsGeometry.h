@@ -16,20 +16,17 @@
 #include <glm/gtx/quaternion.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-#include <assimp/material.h>
-
 #include <vector>
 #include <string>
 #include <iostream>
 #include <filesystem>
 #include <unordered_map>
 #include <functional>
+#include <limits>
 
 #include "sge/GraphicsConstants.h"
 #include "sge/GraphicsShaders.h"
+#include "sge/ModelData.h"
 #include "GameConstants.h"
 
 /**
@@ -37,6 +34,45 @@
  */
 namespace sge {
 
+    /**
+     * Axis-aligned bounding box, starts out empty
+     */
+    struct BoundingBox {
+        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+        void extend(const glm::vec3 &point);
+        void extend(const BoundingBox &box);
+        bool isEmpty() const { return min.x > max.x; }
+        // Box around this one after transforming it, e.g. from model coordinates to world coordinates
+        BoundingBox transformed(const glm::mat4 &transform) const;
+    };
+
+    /**
+     * The 6 planes around everything a camera (or light) can see, pulled out of its projection * view matrix
+     */
+    class Frustum {
+    public:
+        // Contains everything until it's given a matrix
+        Frustum() = default;
+        Frustum(const glm::mat4 &projectionView);
+        // Whether any of a (world coordinate) box might be visible. Boxes near a corner can pass without being in view
+        bool intersects(const BoundingBox &box) const;
+    private:
+        glm::vec4 planes[6]; // xyz is the normal (pointing inside), w the distance
+        bool hasPlanes = false;
+    };
+
+    /**
+     * How many mesh draws frustum culling let through and skipped this frame
+     */
+    struct CullingStats {
+        unsigned int drawn = 0;
+        unsigned int culled = 0;
+        unsigned int shadowDrawn = 0;
+        unsigned int shadowCulled = 0;
+    };
+
     /**
      * Struct containing information for each mesh in ModelComposite
      */
@@ -47,16 +83,20 @@ namespace sge {
         const unsigned int BaseVertex; // Starting index in ModelComposite vertex array of current mesh
         const unsigned int BaseIndex; // Starting index in ModelComposite indices array of current mesh
         const unsigned int MaterialIndex; // Index in ModelComposite's material array - each mesh has one material
+        BoundingBox bounds; // In model coordinates, big enough for every pose of every animation
     };
 
     class Texture {
     public:
-        Texture(size_t width, size_t height, size_t channels, enum TexType type, std::vector<unsigned char> data);
+        Texture(size_t width, size_t height, size_t channels, enum TexType type, size_t gpuBytes, const std::string &source);
         const size_t width;
         const size_t height;
         const size_t channels;
         const enum TexType type;
-        std::vector<unsigned char> data;
+        // The pixels only live on the GPU once uploaded, this is how much room they take there (all mip levels)
+        const size_t gpuBytes;
+        const std::string source; // Model the texture came from, for the memory report
+
     };
 
     /**
@@ -84,19 +124,29 @@ namespace sge {
 
     typedef std::vector<glm::mat4> ModelPose; // Final transformation matrices for each bone (hierarchy and stuff accounted for)
 
+    /**
+     * Everything about one entity's draw that isn't part of its model, shared by all of the model's meshes
+     */
+    struct DrawInstance {
+        glm::mat4 model = glm::mat4(1.0f); // Filled in by ModelComposite::submit
+        const ModelPose *pose = nullptr; // nullptr to draw without animation, must live until the queue's drawn
+        bool outline = true;
+        bool alternateTextures = false;
+        int textureIdx = 0;
+        bool seasons = false;
+    };
+
     /**
      * 3D model consisting of animated and non-animated components
      * Convention: That all loaded models have their center at (x, y, z) = (0, 0, 0)
      */
     class ModelComposite {
     public:
-        ModelComposite(const std::string &filename);
+        ModelComposite(const std::string &filename, std::shared_ptr<const ModelData> data, bool retainCpuData = false);
         ~ModelComposite();
 
-        virtual void
-        render(const glm::vec3 &modelPosition, const float &modelYaw, bool shadow, bool outline) const;
-        virtual void renderPose(const glm::vec3 &modelPosition, const float &modelYaw, ModelPose pose, bool shadow,
-                                bool outline) const;
+        // Queue the meshes of this model that can be seen in pass, see RenderQueue
+        virtual void submit(RenderPass pass, const glm::vec3 &modelPosition, const float &modelYaw, DrawInstance instance) const;
 //        void render(glm::vec3 modelPosition, float modelYaw, float modelPitch, float modelRoll) const;
         ModelPose emptyModelPose();
         void animationPose(int animationId, float time, ModelPose& outputModelPose);
@@ -105,6 +155,10 @@ namespace sge {
         float timeToAnimationTick(long long milliseconds, int animationId);
         void setStillAnimation(unsigned int animationWhenStill, float animationTickWhenStill);
         bool isAnimated() const;
+        // The vertices, indices and texture pixels the model was built from, nullptr unless it was made with retainCpuData
+        const ModelData *cpuData() const { return retainedData.get(); }
+        // Print what the model keeps in main memory and on the GPU
+        void printMemoryReport(size_t &cpuTotal, size_t &gpuTotal) const;
         std::string modelFilePath;
     private:
         /**
@@ -117,24 +171,17 @@ namespace sge {
             std::vector<BoneNode> children; // Bone node children
         };
 
+        /**
+         * A bone's pose through one animation, sampled every sampleInterval ticks
+         */
         class BonePose {
         public:
             BonePose();
-            BonePose(aiNodeAnim &channel, int id);
+            BonePose(const BoneSample *samples, unsigned int numSamples, double sampleInterval, int id);
             glm::mat4 poseAtTime(double time);
             int boneId;
-            std::vector<glm::vec3> positions;
-            std::vector<double> positionTimestamps;
-
-            std::vector<glm::quat> rotations;
-            std::vector<double> rotationTimestamps;
-
-            std::vector<glm::vec3> scales;
-            std::vector<double> scaleTimestamps;
-        private:
-            glm::mat4 interpolatePosition(double time);
-            glm::mat4 interpolateRotation(double time);
-            glm::mat4 interpolateScale(double time);
+            std::vector<BoneSample> samples;
+            double sampleInterval;
         };
 
         class Animation {
@@ -146,48 +193,43 @@ namespace sge {
     protected:
         GLuint VAO = 0; // OpenGL Vertex Array Object
         GLuint buffers[NUM_BUFFERS] = {}; // OpenGL buffers for rendering model
-        std::filesystem::path parentDirectory; // Directory .obj file is located in, used for loading textures/other assets
         std::vector<Mesh> meshes; // Vector of meshes that form the model
         std::vector<Material> materials; // Vector of materials used by individual meshes
 
-        // Standard model properties
-        std::vector<glm::vec3> vertices; // Vertex positions
-        std::vector<glm::vec3> normals; // Surface normals
-        std::vector<glm::vec2> texcoords; // Texture coordinates
-        std::vector<GLuint> indices; // Vertex indices for primitive geometry
-
         // Animation properties
-        // boneIdx and boneWeights are not 2d arrays or 2d vectors because it's easier to load them into OpenGL buffers this way
-        struct {
-            std::vector<int> indices; // Bone indices for each vertex - indicating which bones influence each vertex, size: MAX_BONE_INFLUENCE * num vertices
-            std::vector<GLfloat> weights; // Amount each vertex is influenced by each bone (Should be in range [0, 1]), size MAX_BONE_INFLUENCE * num vertices
-        } boneVertexWeights;
         struct {
             // Inverse binding matrices is not in the bonenode struct because not every node has one
             std::vector<glm::mat4> offsetMatrices; // Bone offset matrices, maps from binding coordinates to bone/joint coordinates, array indexed by bone id's
             BoneNode root; // Root node in bone hierarchy
         } bones;
-        std::unordered_map<std::string, unsigned int> boneMap; // Auxiliary data structure when loading skeleton - maps Assimp bone names to integeres
         std::vector<Animation> animations;
         unsigned int animationWhenStill;
         float animationTickWhenStill;
         glm::mat4 animationGlobalInverse;
         unsigned int numBones;
         bool animated;
+        BoundingBox bounds; // Around all the meshes' bounds
+
+        // Everything else is only on the GPU once the model's uploaded, unless this holds on to it
+        std::shared_ptr<const ModelData> retainedData;
+        size_t bufferBytes = 0; // Vertex and index buffers
+        std::vector<int> textureIndices; // This model's textures in the global textures vector
 
         // Standard ModelComposite methods
-        void loadMesh(aiMesh &mesh, int meshIdx);
-        int loadTexture(aiTextureType type, const aiScene *scene, const aiMaterial &material);
-        void initBuffers();
-        void reserveGeometrySpace(const aiScene *scene);
-        void loadMaterials(const aiScene *scene);
+        int uploadTexture(const ModelData &data, const BakedTexture &texture);
+        void initBuffers(const ModelData &data);
+        void loadMaterials(const ModelData &data);
+        void computeBounds(const ModelData &data);
+        // Whether to draw the model with this transform at all, counts it in cullingStats if not
+        bool isVisible(const glm::mat4 &model, RenderPass pass) const;
+        // Whether to draw one of the model's meshes (when the model's visible), counts it in cullingStats
+        bool isMeshVisible(const Mesh &mesh, const glm::mat4 &model, RenderPass pass) const;
 
         // Animation-related methods
-        void loadBone(aiBone &bone, int meshIdx);
-        BoneNode buildBoneHierarchy(aiNode *root);
-        Animation loadAnimation(const aiAnimation &animation);
+        BoneNode buildBoneHierarchy(const ModelData &data, unsigned int &nodeIndex);
+        void loadAnimations(const ModelData &data);
 
-        void recursePose(ModelPose &out, Animation &anim, float time, glm::mat4 accumulator, BoneNode cur);
+        void recursePose(ModelPose &out, Animation &anim, float time, glm::mat4 accumulator, const BoneNode &cur);
     };
 
     /**
@@ -223,6 +265,8 @@ namespace sge {
 
     void updateCameraToFollowPlayer(glm::vec3 playerPosition, float yaw, float pitch, float distanceBehind, bool gameOver);
     void deleteTextures();
+    // Print every model's (and texture's) main memory and GPU usage
+    void printMemoryReport();
     extern glm::vec3 cameraPosition, cameraDirection, cameraUp;
     extern glm::mat4 perspectiveMat;
     extern glm::mat4 viewMat;
@@ -231,4 +275,8 @@ namespace sge {
     // Map to keep track of which textures have been loaded and their positions within textures vector
     extern std::vector<Texture> textures; // Vector of textures used by program, global vector so multiple models/meshes can use the same texture
     extern std::vector<GLuint> texID; // OpenGL texture identifiers
+    // What the camera and the shadow-casting light can see, models outside them don't get drawn to that pass
+    extern Frustum cameraFrustum;
+    extern Frustum lightFrustum;
+    extern CullingStats cullingStats; // Reset at the start of every frame
 };
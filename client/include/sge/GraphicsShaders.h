@@ -18,6 +18,7 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <cstddef> // for offsetof
 #include <map>
 #include <cmath>   // for sin() and other math functions
 #include <ctime>   // for time()
@@ -25,6 +26,7 @@
 #include "GameConstants.h"
 #include "sge/GraphicsConstants.h"
 #include "sge/FontLoader.h"
+#include "sge/GLStateCache.h"
 #include "SetupParser.h"
 
 
@@ -42,6 +44,8 @@ namespace sge {
         void useShader() const;
 
     protected:
+        void bindUniformBlocks() const;
+
         // Add geometry shader and stuff as needed later
         GLuint vertexShader;
         GLuint fragmentShader;
@@ -63,17 +67,13 @@ namespace sge {
         friend class Material;
         EntityShader() = default;
         virtual void initShaderProgram(const std::string &vertexShaderPath, const std::string &fragmentShaderPath) override;
-        void updateBoneTransforms(std::vector<glm::mat4> &transforms);
+        void updateBoneOffset(unsigned int offset) const;
         void setAnimated(bool animated) const;
-        void updatePerspectiveMat(const glm::mat4 &mat) const;
-        void updateViewMat(const glm::mat4 &mat) const;
-        void updateModelMat(const glm::mat4 &mat) const;
+        void updateCascade(int cascade) const;
     protected:
-        GLuint perspectivePos; // Uniform position of current perspective matrix within GLSL
-        GLuint viewPos; // Uniform position of current view matrix
-        GLuint modelPos; // Uniform position of current modelview matrix within GLSL
         GLuint isAnimated;
-        GLuint boneTransformPos;
+        GLint cascadePos; // Shadow cascade being drawn, only the shadow map shader has it
+        GLuint boneOffsetPos; // Where the current entity's pose starts in the bone palette
     };
 
     /**
@@ -82,34 +82,11 @@ namespace sge {
     class ToonShader : public EntityShader {
     public:
         friend class Material;
-        friend class ModelEntityState;
-        friend class DynamicModelEntityState;
         virtual void initShaderProgram(const std::string &vertexShaderPath, const std::string &fragmentShaderPath) override;
-        void updateCamPos(const glm::vec3 &pos) const;
-        void updateLightPerspectiveMat(const glm::mat4 &mat) const;
-        void updateLightViewMat(const glm::mat4 &mat) const;
-        void updateLightDir(const glm::vec4 &dir) const;
-        void updateDanceBombInfo(const glm::vec3 &pos, bool danceBomb, bool discoLights) const;
-        void updateOutline(bool outline) const;
         void updateAltState(int state);
-        void updateSeason(Season _season, float blend);
     private:
-        GLuint cameraPositionPos; // Uniform position of current camera position in world coordinates
-        GLuint lightPerspectivePos;
-        GLuint lightViewPos;
-        GLuint lightDirPos;
-
-        GLuint pointLightPositionPos;
-        GLuint danceBombPos;
-        GLuint discoLightsPos;
-
         GLuint alternating;
-        GLuint textureIdx;
         GLuint seasons;
-        GLuint curSeason;
-        GLuint seasonBlend;
-        GLuint entityAlternateTextures;
-        GLuint entitySeasons;
 
         void setMaterialUniforms();
         GLuint hasDiffuseMap; // Whether current material has a diffuse map
@@ -124,21 +101,15 @@ namespace sge {
         GLuint shinyTexturePos;
         GLuint shinyColor;
 
-        GLuint drawOutline;
-
         GLuint shadowMapTexturePos;
     };
 
     class ParticleShader : public ShaderProgram {
     public:
         virtual void initShaderProgram(const std::string &vertexShaderPath, const std::string &fragmentShaderPath, const std::string &geometryShaderPath);
-        void updatePerspectiveMat(const glm::mat4 &mat) const;
-        void updateViewMat(const glm::mat4 &mat) const;
         void updateParticleSize(const float size) const;
     private:
         GLuint geometryShader;
-        GLuint perspectivePos;
-        GLuint viewPos;
         GLuint sizePos;
     };
 
@@ -148,17 +119,16 @@ namespace sge {
     class ScreenShader : public ShaderProgram {
     public:
         virtual void initShaderProgram(const std::string &vertexShaderPath, const std::string &fragmentShaderPath) override;
+        void updateRenderScale(const glm::vec2 &scale) const;
+    private:
+        GLint renderScalePos;
     };
 
     class SkyboxShader : public ShaderProgram {
     public:
         virtual void initShaderProgram(const std::string &vertexShaderPath, const std::string &fragmentShaderPath) override;
-        void updatePerspectiveMat(const glm::mat4 &mat) const;
-        void updateViewMat(const glm::mat4 &mat) const;
         void drawSkybox();
     private:
-        GLuint perspective;
-        GLuint view;
         GLuint cubeMap;
         GLuint cubeTex;
         GLuint VAO;
@@ -166,6 +136,17 @@ namespace sge {
         GLuint EBO;
     };
 
+    /**
+     * How one of a framebuffer's textures is stored
+     */
+    struct TextureFormat {
+        const char *name; // What setup.json calls it
+        GLint internalFormat;
+        GLenum format; // Format and type of the (empty) data glTexImage2D is given, have to go with internalFormat
+        GLenum type;
+        int bytesPerPixel;
+    };
+
     /**
      * Framebuffer class for shadow maps, postprocessing, etc.
      */
@@ -180,24 +161,48 @@ namespace sge {
 
     /**
      * Shadowmap class for shadow rendering
+     * Cascaded: each cascade is a layer of the shadow map with an orthographic projection fitted around one slice of the
+     * camera's view, so the slice nearest the camera gets the most detail.
+     * Static geometry (the map) is drawn into layers of its own that are kept between frames and only redrawn when
+     * their cascade or the light moves. Every frame starts each cascade off as a copy of its static layer and only draws
+     * the things that move on top
      */
     class ShadowMap {
     public:
 
         void initShadowmap();
-        void drawToShadowmap() const;
+        bool lightMoved(const glm::vec3 &lightPos);
+        void fitCascades(const glm::mat4 &cameraPerspective, const glm::mat4 &cameraView, const glm::mat4 &lightView);
+        bool needsStaticRedraw(int cascade) const;
+        void drawToStaticShadowmap(int cascade);
+        void drawToShadowmap(int cascade) const;
         void updateShadowmap() const;
+        void setResolution(int resolution);
+        int getResolution() const;
         void deleteShadowmap();
-        FrameBuffer FBO;
+        glm::mat4 lightSpace[SHADOW_CASCADES]; // Each cascade's light projection * light viewing matrix, from fitCascades
+        glm::vec4 cascadeSplits; // How far from the camera each cascade reaches
+        unsigned int staticRedraws = 0; // Times a cascade's static shadows have been drawn, for the debug overlay
     private:
+        void allocateTextures() const;
         int shadowMapWidth;
         int shadowMapHeight;
+        GLuint depthTexture; // Array texture, one layer per cascade
+        GLuint staticDepthTexture; // Static geometry's shadows, copied into depthTexture every frame
+        GLuint cascadeFBOs[SHADOW_CASCADES];
+        GLuint staticFBOs[SHADOW_CASCADES];
+        bool staticValid[SHADOW_CASCADES] = {}; // Whether the static layer has been drawn at the current resolution
+        glm::mat4 staticLightSpace[SHADOW_CASCADES]; // What each static layer was drawn with
+        bool lightValid = false;
+        glm::vec3 shadowLightDir; // Light direction the shadows are cast from
     };
 
     /**
      * Postprocessing for handling outline rendering
      * We normally draw everything to a framebuffer, put that framebuffer in a texture
      * then render that texture on a rectangle to the screen.
+     * The framebuffer's textures are the window's size, but the scene can be drawn to just the bottom left corner of
+     * them at a lower render scale and stretched back over the whole screen
      */
     class Postprocesser {
     public:
@@ -207,12 +212,63 @@ namespace sge {
         void drawToFramebuffer() const;
 
         void drawToScreen() const;
+        void setRenderScale(float scale);
+        int getRenderWidth() const;
+        int getRenderHeight() const;
+        void cycleFormats();
+        const TextureFormat &getColorFormat() const;
+        const TextureFormat &getNormalFormat() const;
+        int bytesPerPixel() const;
     private:
+        void allocateTextures() const;
         FrameBuffer FBO;
+        int colorFormat; // Index into the color formats in GraphicsShaders.cpp
+        int normalFormat; // Index into the normal formats
+        float renderScale = RENDER_SCALE_MAX; // Fraction of the window's width and height the scene is drawn at
         GLuint VAO; // VAO for rendering quad to screen
         GLuint VBO; // VBO for rendering quad to screen
     };
 
+    /**
+     * Camera and lighting state shared by every shader for a whole frame, laid out to match the std140 FrameData
+     * block the shaders declare. Each vec3 is followed by a 4 byte scalar so it fills a 16 byte std140 slot
+     */
+    struct FrameUniforms {
+        glm::mat4 perspective; // Camera perspective projection matrix
+        glm::mat4 view; // Camera viewing matrix
+        glm::mat4 lightSpace[SHADOW_CASCADES]; // Each shadow cascade's light projection * light viewing matrix
+        glm::vec4 cascadeSplits; // How far from the camera each cascade reaches
+        glm::vec3 cameraPosition; // In world coordinates
+        float seasonBlend; // Blend factor with the next season, between 0 and 1 inclusive
+        glm::vec3 pointLightPosition; // Dance bomb's point light
+        int curSeason; // 0 = spring, 1 = summer, 2 = fall, 3 = winter
+        glm::vec3 cameraRight; // For facing billboards towards the camera
+        int danceBomb; // Whether the egg is a dance bomb
+        glm::vec3 cameraUp;
+        int discoLights; // Whether the dance bomb's disco lights are currently on
+        glm::vec4 lightDir; // Global light direction/position, w = 0 for directional lights
+    };
+    static_assert(SHADOW_CASCADES <= 4, "cascadeSplits only has room for 4 cascades");
+    static_assert(sizeof(FrameUniforms) == 224 + 64 * SHADOW_CASCADES, "FrameUniforms must match the std140 FrameData block");
+    static_assert(offsetof(FrameUniforms, cascadeSplits) == 128 + 64 * SHADOW_CASCADES &&
+                  offsetof(FrameUniforms, cameraPosition) == 144 + 64 * SHADOW_CASCADES &&
+                  offsetof(FrameUniforms, cameraUp) == 192 + 64 * SHADOW_CASCADES &&
+                  offsetof(FrameUniforms, lightDir) == 208 + 64 * SHADOW_CASCADES, "FrameUniforms must match the std140 FrameData block");
+
+    /**
+     * Uniform buffer holding FrameUniforms, bound once to FRAME_DATA_BINDING. Fill in data over the frame and
+     * upload() it before the first draw that reads it
+     */
+    class FrameUniformBuffer {
+    public:
+        void initBuffer();
+        void upload() const;
+        void deleteBuffer();
+        FrameUniforms data{};
+    private:
+        GLuint UBO;
+    };
+
     void initShaders();
 
     // Standard shading
@@ -227,6 +283,8 @@ namespace sge {
     // Shadows
     extern EntityShader shadowProgram;
     extern ShadowMap shadowprocessor;
+    // Per-frame camera and lighting uniforms
+    extern FrameUniformBuffer frameUniforms;
 
     // Extra declarations of window width/height from ShittyGraphicsEngine.cpp
     extern int windowHeight, windowWidth;
@@ -238,8 +296,6 @@ namespace sge {
     class LineShaderProgram : public ShaderProgram {
     public:
         void initShaderProgram(const std::string &vertexShaderPath, const std::string &fragmentShaderPath);
-        void updateViewMat(const glm::mat4 &mat);
-        void updatePerspectiveMat(const glm::mat4 &mat);
         void renderBulletTrail(const glm::vec3& start, const glm::vec3& end);
         // todo: some method to cleanup VAO VBOs
         void deleteLineShader();
@@ -248,8 +304,6 @@ namespace sge {
         GLuint VBO;
         GLuint EBO;
 
-        GLuint viewPos;
-        GLuint perspectivePos;
         GLuint red, green, blue;
         GLuint indices[36] = {
                 // Bottom face
@@ -351,10 +405,6 @@ namespace sge {
     class BillboardProgram : public ShaderProgram {
     public:
         void initShaderProgram(const std::string &vertexShaderPath, const std::string &fragmentShaderPath);
-        void updateViewMat(const glm::mat4 &mat);
-        void updatePerspectiveMat(const glm::mat4 &mat);
-        void updateCameraOrientation(const glm::vec3 &cameraRight, const glm::vec3 &cameraUp);
-
         void renderPlayerTag(const glm::vec3 &playerPos, GLuint textureID);
         void renderPlayerTag(const glm::vec3 &playerPos, GLuint textureID, float scale);
 
@@ -364,10 +414,6 @@ namespace sge {
 
         GLint billboardCenterPos;
         GLint billboardDimensionPos;
-        GLint CameraRightPos;
-        GLint CameraUpPos;
-        GLint viewPos;
-        GLint projectionPos;
     };
 
 
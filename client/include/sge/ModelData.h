@@ -0,0 +1,213 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "sge/GraphicsConstants.h"
+#include "MappedFile.h"
+#include "BakedAsset.h"
+
+#define BAKED_MODEL_MAGIC 0x4c444d53 // "SMDL" in a little-endian file
+// Bump whenever the layout below or how it's built changes, old files then get ignored until re-cooked
+#define BAKED_MODEL_VERSION 3
+// A baked model sits next to its source file, with the extension swapped for this one
+#define BAKED_MODEL_EXTENSION ".smdl"
+// Animations are resampled to this many poses per second, so finding a pose is an index instead of a search.
+// A multiple of the 24 and 30 fps our animations are exported at, so every keyframe lands exactly on a sample
+#define ANIMATION_SAMPLE_RATE 120
+
+/**
+ * Shitty graphics engine (SGE)
+ */
+namespace sge {
+
+    /**
+     * One vertex exactly as it sits in the vertex buffer. Models without animations leave the bone ids at -1
+     */
+    struct ModelVertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 texcoord;
+        int32_t boneIds[MAX_BONE_INFLUENCE]; // Bones influencing this vertex, -1 if unused
+        float boneWeights[MAX_BONE_INFLUENCE]; // How much each bone influences this vertex, in range [0, 1]
+    };
+    static_assert(sizeof(ModelVertex) == 64, "model vertices are uploaded to OpenGL as-is and must not have padding");
+
+    struct BakedMesh {
+        uint32_t numIndices;
+        uint32_t baseVertex;
+        uint32_t baseIndex;
+        uint32_t materialIndex;
+    };
+
+    /**
+     * Texture indices are into the model's own texture table, -1 if the material doesn't have that texture
+     */
+    struct BakedMaterial {
+        glm::vec3 diffuse;
+        glm::vec3 specular;
+        glm::vec3 shininess;
+        int32_t diffuseMap[4];
+        int32_t specularMap;
+        int32_t shinyMap;
+    };
+
+    /**
+     * How a texture's pixels are stored. The cooker compresses 3 and 4 channel textures so they stay compressed
+     * on the GPU, importing at runtime keeps them raw since compressing takes a while
+     */
+    enum BakedTextureFormat : uint32_t {
+        TEXTURE_RAW = 0, // channels bytes per pixel
+        TEXTURE_BC1 = 1, // S3TC DXT1, 8 bytes per 4x4 block, RGB only
+        TEXTURE_BC3 = 2, // S3TC DXT5, 16 bytes per 4x4 block, RGBA
+    };
+
+    /**
+     * A texture's full mip chain, starting at pixelOffset in the texture pixel section. Level 0 is full size and each
+     * level after it is half the size of the one before (rounded down, at least 1) down to 1x1. Each level is padded to 4 bytes
+     */
+    struct BakedTexture {
+        uint32_t width;
+        uint32_t height;
+        uint32_t channels; // of the source image, compressed textures always decode to RGB(A)
+        uint32_t type; // TexType
+        uint32_t pixelOffset;
+        uint32_t format; // BakedTextureFormat
+        uint32_t numLevels;
+    };
+
+    // Size of a mip level, and how many bytes it takes up
+    uint32_t textureLevelWidth(const BakedTexture &texture, uint32_t level);
+    uint32_t textureLevelHeight(const BakedTexture &texture, uint32_t level);
+    size_t textureLevelSize(const BakedTexture &texture, uint32_t level);
+    // Where a mip level starts, relative to the texture's pixelOffset. Level numLevels gives the size of the whole chain
+    size_t textureLevelOffset(const BakedTexture &texture, uint32_t level);
+    // Decode a compressed mip level into RGBA, for drivers that can't sample S3TC textures
+    std::vector<unsigned char> decompressTextureLevel(const BakedTexture &texture, uint32_t level, const unsigned char *blocks);
+
+    /**
+     * Bone hierarchy in depth-first order, a node's children come right after it (and their children)
+     */
+    struct BakedBoneNode {
+        glm::mat4 relativeTransform;
+        int32_t id; // -1 for nodes that aren't bones
+        uint32_t numChildren;
+    };
+
+    struct BakedAnimation {
+        float duration; // In ticks
+        float ticksPerSecond;
+        float ticksPerSample; // ticksPerSecond / ANIMATION_SAMPLE_RATE
+        uint32_t numSamples; // Samples per channel
+        uint32_t firstChannel;
+        uint32_t numChannels;
+    };
+
+    struct BakedChannel {
+        int32_t boneId;
+        uint32_t firstSample;
+    };
+
+    /**
+     * A bone's transform relative to its parent at one sample of an animation
+     */
+    struct BoneSample {
+        glm::vec3 position;
+        glm::quat rotation;
+        glm::vec3 scale;
+    };
+
+    /**
+     * Start of a baked model file (see model_cooker). After it come, in this order: vertices, indices, meshes,
+     * materials, textures, texture pixels (every mip level of every texture, each padded to 4 bytes), bone offset
+     * matrices, bone nodes, animations, channels and bone samples.
+     * Everything is written exactly as it sits in memory, so baked files only work on little-endian machines
+     */
+    struct BakedModelHeader {
+        uint32_t magic;
+        uint32_t version;
+        // sizeof(ModelVertex) and ANIMATION_SAMPLE_RATE the file was baked with
+        uint32_t vertexSize;
+        uint32_t animationSampleRate;
+        uint32_t animated;
+        uint32_t numVertices;
+        uint32_t numIndices;
+        uint32_t numMeshes;
+        uint32_t numMaterials;
+        uint32_t numTextures;
+        uint32_t texturePixelBytes;
+        uint32_t numBones;
+        uint32_t numBoneNodes;
+        uint32_t numAnimations;
+        uint32_t numChannels;
+        uint32_t numBoneSamples;
+        // Undoes the root node's transform for animated models
+        glm::mat4 animationGlobalInverse;
+        // bytes after the header, and their FNV-1a hash
+        uint64_t payloadSize;
+        uint64_t checksum;
+        // the model file this was imported from, when it was imported. Textures it loads from
+        // separate files aren't tracked, re-cook by hand after changing only those
+        SourceStamp source;
+    };
+    static_assert(sizeof(BakedModelHeader) == 160, "baked model header must not have padding");
+
+    /**
+     * Everything ModelComposite needs to build a model, with no OpenGL involved so the cooker can use it too.
+     * The data is always laid out like a baked file. It's either a baked file mapped straight into memory,
+     * or a buffer built the same way by running the source file through Assimp
+     */
+    class ModelData {
+    public:
+        // Use the baked model next to the source file if it's there and up to date, otherwise import the
+        // source file. nullptr if neither works
+        static std::unique_ptr<ModelData> load(const std::string &sourceFilePath);
+
+        // Run the source file through Assimp, decode its textures (making their mip chains, and compressing them if
+        // compressTextures is set) and resample its animations. nullptr if Assimp can't read it
+        static std::unique_ptr<ModelData> importModel(const std::string &sourceFilePath, bool compressTextures = false);
+        // Map a baked file into memory, nullptr if it's missing, corrupt, from a different version
+        // or older than the source file (a missing source file is fine, the baked file is all we have then)
+        static std::unique_ptr<ModelData> loadBaked(const std::string &bakedFilePath, const std::string &sourceFilePath);
+        bool writeBaked(const std::string &bakedFilePath) const;
+        static std::string bakedPathFor(const std::string &sourceFilePath);
+
+        ModelData(const ModelData&) = delete;
+        ModelData& operator=(const ModelData&) = delete;
+
+        BakedModelHeader header = {};
+        const ModelVertex *vertices = nullptr;
+        const uint32_t *indices = nullptr;
+        const BakedMesh *meshes = nullptr;
+        const BakedMaterial *materials = nullptr;
+        const BakedTexture *textures = nullptr;
+        const unsigned char *texturePixels = nullptr;
+        const glm::mat4 *offsetMatrices = nullptr; // Indexed by bone id
+        const BakedBoneNode *boneNodes = nullptr;
+        const BakedAnimation *animations = nullptr;
+        const BakedChannel *channels = nullptr;
+        const BoneSample *boneSamples = nullptr;
+
+        // Bytes of everything after the header
+        size_t memoryUsage() const { return header.payloadSize; }
+        bool isMapped() const { return mappedFile.data() != nullptr; }
+
+    private:
+        ModelData() = default;
+
+        // Check the header and point the arrays into the payload that follows it
+        bool attach(const char *data, size_t size, const std::string &name);
+
+        // whichever one holds the header and payload
+        MappedFile mappedFile;
+        std::vector<char> importedData;
+    };
+
+    // Source files of the models in the models vector, in ModelIndex order
+    std::vector<std::string> modelSourcePaths();
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+
+#include "sge/GraphicsGeometry.h"
+#include "sge/BonePalette.h"
+
+/**
+ * Shitty graphics engine (SGE)
+ */
+namespace sge {
+
+    /**
+     * One mesh of one entity's model, drawn once
+     */
+    struct DrawItem {
+        const Mesh *mesh;
+        const Material *material; // nullptr in the shadow pass, which doesn't use materials
+        GLuint VAO;
+        bool animated; // Whether the shader skins the mesh with the instance's pose
+        unsigned int instance; // Index of the entity's DrawInstance in the queue
+    };
+
+    /**
+     * One entity's DrawInstance the way the vertex shaders read it, as per-instance vertex attributes
+     */
+    struct InstanceData {
+        glm::mat4 model; // INSTANCE_MODEL_POS
+        glm::ivec4 flags; // INSTANCE_FLAGS_POS: outline, alternate textures, texture index, seasons
+    };
+
+    /**
+     * How many draws the queue made last frame and how often it actually had to change state between them
+     */
+    struct RenderQueueStats {
+        unsigned int draws = 0;
+        unsigned int instances = 0; // Meshes drawn, more than draws when instanced draws draw several at once
+        unsigned int materialChanges = 0;
+        unsigned int instanceChanges = 0; // Switching which entities' instance data (and bone offset) the next draw uses
+        unsigned int vaoChanges = 0;
+    };
+
+    /**
+     * Entities queue their draws here instead of drawing straight away. Once a pass has everything, the queue sorts
+     * its draws so ones sharing state end up next to each other and only sets what changed from the draw before,
+     * rather than setting the shader, VAO, model matrix and every material uniform and texture for every mesh.
+     * The map has lots of meshes and materials, so this saves a lot of driver calls.
+     * Every entity's model matrix and settings go in a per-frame instance buffer, and the same mesh drawn for several
+     * unskinned entities (projectiles, repeated props) is a single instanced draw
+     */
+    class RenderQueue {
+    public:
+        void initInstanceBuffer();
+        void deleteInstanceBuffer();
+        // Add an entity to a pass, its draw items refer to it by the index this returns. Its pose goes in the bone palette
+        unsigned int addInstance(RenderPass pass, const DrawInstance &instance);
+        void submit(RenderPass pass, const DrawItem &item);
+        // Sort and draw everything queued for the pass, then empty it. The pass's framebuffer should already be bound
+        void execute(RenderPass pass);
+        // Counts since the last beginFrame(), for the debug overlay
+        RenderQueueStats stats[NUM_RENDER_PASSES];
+        // Once per frame before anything's queued, resets the stats and the bone palette
+        void beginFrame();
+    private:
+        std::vector<DrawInstance> instances[NUM_RENDER_PASSES];
+        std::vector<unsigned int> boneOffsets[NUM_RENDER_PASSES]; // Each instance's pose in the bone palette
+        // Point the bound VAO's per-instance attributes at instanceData[first] onwards
+        void pointInstanceAttributes(size_t first);
+        std::vector<InstanceData> instanceData; // The pass being drawn's instances, uploaded all at once
+        GLuint instanceBuffer;
+        std::vector<DrawItem> items[NUM_RENDER_PASSES];
+    };
+
+    extern RenderQueue renderQueue;
+}
@@ -14,7 +14,9 @@
 #include "sge/GraphicsGeometry.h"
 #include "sge/GraphicsEntity.h"
 #include "sge/GraphicsConstants.h"
+#include "sge/DynamicResolution.h"
 #include "SetupParser.h"
+#include "AssetLoader.h"
 
 
 namespace sge {
@@ -74,7 +74,10 @@ namespace sge {
     // the one for all
     void renderAllTexts(int myHP, int team1score, int team2score, int currentSeason, bool inputEnabled, bool gameOver, int winner, double gameDurationInSeconds, int detonationMiliSecs, bool imBombOwner);
     void renderAllUIs(int currentSeason, int my_client_id, int client_id, int eggHolderId, bool eggIsDanceBomb, int abilityType, bool waitingCD);
-    void renderAllBillboardTags(glm::vec3* positions, int client_id, bool eggIsDanceBomb, int eggHolderId);
+    void renderAllBillboardTags(const std::vector<glm::vec3>& positions, unsigned int numPlayers, int client_id, bool eggIsDanceBomb, int eggHolderId);
+
+    // small lines of debug text in the top left corner (network stats etc)
+    void renderDebugOverlay(const std::vector<std::string>& lines);
 
 
 };
\ No newline at end of file
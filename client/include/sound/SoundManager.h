@@ -4,8 +4,10 @@
 #include <string>
 #include <memory>
 #include <iostream>
+#include <functional>
 #include "SetupParser.h"
 #include "GameConstants.h"
+#include "AssetLoader.h"
 
 namespace sound {
 	#define DANCE_SONG_NUM 4
@@ -33,6 +35,12 @@ namespace sound {
 		void stopDanceSong();
 
 	private:
+		// queue a file on the asset loader, onLoaded runs on the main thread once the sound can play
+		void loadSound(sf::SoundBuffer& buffer, sf::Sound& sound, const std::string& filepath, std::function<void()> onLoaded = nullptr);
+
+		// character theme the lobby wants playing, -1 for none. Lets a theme start once it finishes loading
+		int lobbyTheme = -1;
+
 		sf::SoundBuffer bgm_buffer;
 		sf::Sound bgm;
 		sf::SoundBuffer shooting_buffer;
@@ -5,6 +5,7 @@
 #include <memory>
 #include <chrono>
 #include <iostream>
+#include <functional>
 
 #include "imgui.h"
 #include "stb_image.h"
@@ -32,7 +33,8 @@ namespace ui {
 		~UIManager();
 		void lobby();
 
-		GLuint LoadTextureFromFile(std::string filename);
+		// decode the image on the asset loader, onLoaded gets its texture ID once it's uploaded
+		void LoadTextureFromFile(std::string filename, std::function<void(GLuint)> onLoaded);
 		void LoadLobbyImages();
 		void LoadLobbyTextFonts();
 
@@ -110,23 +112,23 @@ namespace ui {
 
 
 		// start game background image
-		GLuint startBackgroundImageTextureID;
+		GLuint startBackgroundImageTextureID = 0;
 		// start game title
-		GLuint startTitleTextureID;
+		GLuint startTitleTextureID = 0;
 		// start game button image
-		GLuint startButtonImageTextureID;
+		GLuint startButtonImageTextureID = 0;
 
 
 
 		// background image
-		GLuint lobbyBackgroundImageTextureID;
+		GLuint lobbyBackgroundImageTextureID = 0;
 		// secret - to hide which character this is
-		GLuint secretCharacterTextureID;
+		GLuint secretCharacterTextureID = 0;
 
 		// downward triangle, to indicate which character the player is controlling
-		GLuint redDownTriTextureID;
+		GLuint redDownTriTextureID = 0;
 		// green mark, to indicate that the character is ready
-		GLuint greenMarkTextureID;
+		GLuint greenMarkTextureID = 0;
 
 
 		// size of each components in the lobby
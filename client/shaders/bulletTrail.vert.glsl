@@ -2,8 +2,23 @@
 
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 perspective;
-uniform mat4 view;
+// Camera and lighting state for the whole frame, shared by every shader through one uniform buffer
+// Keep identical in every shader that declares it, it has to match sge::FrameUniforms (GraphicsShaders.h)
+layout (std140) uniform FrameData {
+    mat4 perspective;        // Camera perspective projection matrix
+    mat4 view;               // Camera viewing matrix
+    mat4 lightSpace[3];      // Light's perspective * viewing matrix for each shadow cascade (SHADOW_CASCADES of them)
+    vec4 cascadeSplits;      // How far from the camera each shadow cascade reaches
+    vec3 cameraPosition;
+    float seasonBlend;       // Amount to blend with next season
+    vec3 pointLightPosition; // Dance bomb's point light
+    int curSeason;           // Current season, value should be between 0 and 3 inclusive
+    vec3 cameraRight;
+    int danceBomb;           // 1 or 0
+    vec3 cameraUp;
+    int discoLights;         // 1 or 0
+    vec4 lightDir;
+};
 
 
 void main() {
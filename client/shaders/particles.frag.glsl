@@ -3,12 +3,12 @@
 in vec4 particleColor;
 
 layout (location = 0) out vec4 fragColor;
-layout (location = 1) out vec4 fragGNormal;
-layout (location = 2) out int fragGMask;
+layout (location = 1) out vec2 fragGNormal;
+layout (location = 2) out uint fragGMask;
 
 
 void main() {
     fragColor = particleColor;
-    fragGNormal = vec4(0, 0, 1, 1);
-    fragGMask = 0;
+    fragGNormal = vec2(0.5, 0.5); // (0, 0, 1) octahedral encoded
+    fragGMask = 0u;
 }
@@ -1,20 +1,60 @@
 #version 330 core
 
-in vec2 texCoord;
+in vec2 screenCoord;
 
 uniform sampler2D colorTexture;
-uniform sampler2D normalTexture;
-uniform isampler2D maskTexture;
+uniform sampler2D normalTexture; // Octahedral encoded normals, see decodeNormal
+uniform usampler2D maskTexture;
 uniform sampler2D depthTexture;
+uniform vec2 renderScale; // Fraction of the textures' width and height the scene was drawn to, see Postprocesser
 
 out vec4 fragColor;
 
+// Camera and lighting state for the whole frame, shared by every shader through one uniform buffer
+// Keep identical in every shader that declares it, it has to match sge::FrameUniforms (GraphicsShaders.h)
+layout (std140) uniform FrameData {
+    mat4 perspective;        // Camera perspective projection matrix
+    mat4 view;               // Camera viewing matrix
+    mat4 lightSpace[3];      // Light's perspective * viewing matrix for each shadow cascade (SHADOW_CASCADES of them)
+    vec4 cascadeSplits;      // How far from the camera each shadow cascade reaches
+    vec3 cameraPosition;
+    float seasonBlend;       // Amount to blend with next season
+    vec3 pointLightPosition; // Dance bomb's point light
+    int curSeason;           // Current season, value should be between 0 and 3 inclusive
+    vec3 cameraRight;
+    int danceBomb;           // 1 or 0
+    vec3 cameraUp;
+    int discoLights;         // 1 or 0
+    vec4 lightDir;
+};
+
+// Undo toon.frag.glsl's encodeNormal
+vec3 decodeNormal(vec2 encoded) {
+    encoded = encoded * 2.0 - 1.0;
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (n.z < 0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0 ? 1.0 : -1.0, n.y >= 0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+
+// Normal at a texture coordinate. The outline thresholds below were tuned back when normals were stored in an 8 bit
+// unsigned attachment that cut off anything below 0, so they're cut off the same way here to keep outlines the same
+vec3 normalAt(vec2 coord) {
+    return clamp(decodeNormal(texture(normalTexture, coord).xy), 0.0, 1.0);
+}
+
 void main() {
     vec2 textureSize = textureSize(colorTexture, 0).xy;
+    // Stretch the part of the textures the scene was drawn to over the screen, without filtering past its edge
+    vec2 texCoord = min(screenCoord * renderScale, renderScale - 0.5 / textureSize);
     vec3 curColor = texture(colorTexture, texCoord).rgb;
-    int curOutline = texture(maskTexture, texCoord).r;
+    uint curOutline = texture(maskTexture, texCoord).r;
     float curDepth = texture(depthTexture, texCoord).x;
-    float vDotN = texture(normalTexture, texCoord).w;
+    // Direction from the camera through this pixel, to get how much the surface faces the camera
+    vec2 ndc = screenCoord * 2.0 - 1.0;
+    vec3 viewRay = transpose(mat3(view)) * vec3(ndc.x / perspective[0][0], ndc.y / perspective[1][1], -1.0);
+    float vDotN = clamp(dot(-normalize(viewRay), decodeNormal(texture(normalTexture, texCoord).xy)), 0.0, 1.0);
 
     int size = 1;
     float depthDiff = 0;
@@ -28,11 +68,11 @@ void main() {
     float normScore = 0;
 
     // Only draw outline if all surrounding pixels allow outlines
-    if (curOutline != 0 && texture(maskTexture, tc1).r != 0 && texture(maskTexture, tc2).r != 0 &&
-        texture(maskTexture, tc3).r != 0 && texture(maskTexture, tc4).r != 0) {
-        normDiff += length(texture(normalTexture, tc1).xyz - texture(normalTexture, tc2).xyz);
+    if (curOutline != 0u && texture(maskTexture, tc1).r != 0u && texture(maskTexture, tc2).r != 0u &&
+        texture(maskTexture, tc3).r != 0u && texture(maskTexture, tc4).r != 0u) {
+        normDiff += length(normalAt(tc1) - normalAt(tc2));
         depthDiff += pow(texture(depthTexture, tc1).x - texture(depthTexture, tc2).x, 2);
-        normDiff += length(texture(normalTexture, tc3).xyz - texture(normalTexture, tc4).xyz);
+        normDiff += length(normalAt(tc3) - normalAt(tc4));
         depthDiff += pow(texture(depthTexture, tc3).x - texture(depthTexture, tc4).x, 2);
         depthDiff = sqrt(depthDiff);
         normScore = length(normDiff);
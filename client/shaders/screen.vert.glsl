@@ -3,9 +3,9 @@ layout (location = 0) in vec2 position;
 layout (location = 1) in vec2 inTexCoord;
 
 
-out vec2 texCoord;
+out vec2 screenCoord;
 
 void main() {
     gl_Position = vec4(position.x, position.y, 0, 1);
-    texCoord = inTexCoord;
+    screenCoord = inTexCoord;
 }
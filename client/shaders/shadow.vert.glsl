@@ -5,18 +5,40 @@ layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texcoord; // Unused but here for compatibility reasons (don't want to redefine VAO's for models)
 layout (location = 3) in ivec4 boneidx;
 layout (location = 4) in vec4 boneweight;
+layout (location = 5) in mat4 model; // Object's model transformation matrix, per instance (takes up locations 5 to 8)
 
 const int max_bones = 100;
 const int max_bone_influence = 4;
 
 uniform bool isAnimated;
-uniform mat4 boneTransform[max_bones]; // Up to 100 bones per model
+uniform samplerBuffer bonePalette; // Bone matrices of every pose drawn this frame, 4 texels (columns) per bone
+uniform int boneOffset; // Where the current model's pose starts in bonePalette, in bones
+uniform int cascade; // Shadow cascade being drawn
 
-// These uniforms mean different things compared to static.vert.glsl
-uniform mat4 perspective; // Light's perspective matrix
-uniform mat4 view;        // Light's viewing matrix
+// Final transformation matrix of one of the current model's bones
+mat4 boneTransform(int bone) {
+    int texel = (boneOffset + bone) * 4;
+    return mat4(texelFetch(bonePalette, texel), texelFetch(bonePalette, texel + 1),
+                texelFetch(bonePalette, texel + 2), texelFetch(bonePalette, texel + 3));
+}
 
-uniform mat4 model;       // Object's model transformation matrix
+// Camera and lighting state for the whole frame, shared by every shader through one uniform buffer
+// Keep identical in every shader that declares it, it has to match sge::FrameUniforms (GraphicsShaders.h)
+layout (std140) uniform FrameData {
+    mat4 perspective;        // Camera perspective projection matrix
+    mat4 view;               // Camera viewing matrix
+    mat4 lightSpace[3];      // Light's perspective * viewing matrix for each shadow cascade (SHADOW_CASCADES of them)
+    vec4 cascadeSplits;      // How far from the camera each shadow cascade reaches
+    vec3 cameraPosition;
+    float seasonBlend;       // Amount to blend with next season
+    vec3 pointLightPosition; // Dance bomb's point light
+    int curSeason;           // Current season, value should be between 0 and 3 inclusive
+    vec3 cameraRight;
+    int danceBomb;           // 1 or 0
+    vec3 cameraUp;
+    int discoLights;         // 1 or 0
+    vec4 lightDir;
+};
 
 // A simplified version of static.vert.glsl for shadow maps
 void main() {
@@ -32,8 +54,9 @@ void main() {
                 totalPosition = vec4(vertex, 1);
                 break;
             }
-            vec4 localPos = boneTransform[boneidx[i]] * vec4(vertex, 1);
-            accumulatorModel += boneweight[i] * boneTransform[boneidx[i]];
+            mat4 bone = boneTransform(boneidx[i]);
+            vec4 localPos = bone * vec4(vertex, 1);
+            accumulatorModel += boneweight[i] * bone;
             totalPosition += boneweight[i] * localPos;
         }
         if (boneidx[0] == -1) {
@@ -41,8 +64,8 @@ void main() {
             totalPosition = vec4(vertex, 1);
         }
 
-        gl_Position = perspective * view * model * totalPosition;
+        gl_Position = lightSpace[cascade] * model * totalPosition;
     } else {
-        gl_Position = perspective * view * model * vec4(vertex, 1);
+        gl_Position = lightSpace[cascade] * model * vec4(vertex, 1);
     }
 }
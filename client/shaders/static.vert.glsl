@@ -5,28 +5,62 @@ layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texcoord;
 layout (location = 3) in ivec4 boneidx;
 layout (location = 4) in vec4 boneweight;
+// Per instance, from the render queue's instance buffer
+layout (location = 5) in mat4 model;        // Model transformation matrix (takes up locations 5 to 8)
+layout (location = 9) in ivec4 instanceFlags; // Outline, alternate texture, texture index and seasons flags
 
 out vec4 projectedFragPosition;
 out vec3 fragPosition;
 out vec3 fragNormal;
 out vec2 fragTexcoord;
 out mat4 finalModel;
-out vec4 lightCoordPosn;
+out vec4 shadowPosition; // World position after skinning, for finding the fragment in the shadow map
+out vec4 worldPosition;
+// Instance flags passed on to the fragment shader
+flat out int drawOutline;
+flat out int entityAlternateTexture;
+flat out int textureIdx;
+flat out int entitySeasons;
 
 const int max_bones = 100;
 const int max_bone_influence = 4;
 
 uniform bool isAnimated;
-uniform mat4 boneTransform[max_bones]; // Up to 100 bones per model
+uniform samplerBuffer bonePalette; // Bone matrices of every pose drawn this frame, 4 texels (columns) per bone
+uniform int boneOffset; // Where the current model's pose starts in bonePalette, in bones
 
-uniform mat4 perspective; // Camera perspective projection matrix
-uniform mat4 view;        // Camera viewing matrix
-uniform mat4 model;       // Model transformation matrix
+// Final transformation matrix of one of the current model's bones
+mat4 boneTransform(int bone) {
+    int texel = (boneOffset + bone) * 4;
+    return mat4(texelFetch(bonePalette, texel), texelFetch(bonePalette, texel + 1),
+                texelFetch(bonePalette, texel + 2), texelFetch(bonePalette, texel + 3));
+}
 
-uniform mat4 lightView;   // Light's viewing matrix
-uniform mat4 lightPerspective; // Light's perspective matrix
+// Camera and lighting state for the whole frame, shared by every shader through one uniform buffer
+// Keep identical in every shader that declares it, it has to match sge::FrameUniforms (GraphicsShaders.h)
+layout (std140) uniform FrameData {
+    mat4 perspective;        // Camera perspective projection matrix
+    mat4 view;               // Camera viewing matrix
+    mat4 lightSpace[3];      // Light's perspective * viewing matrix for each shadow cascade (SHADOW_CASCADES of them)
+    vec4 cascadeSplits;      // How far from the camera each shadow cascade reaches
+    vec3 cameraPosition;
+    float seasonBlend;       // Amount to blend with next season
+    vec3 pointLightPosition; // Dance bomb's point light
+    int curSeason;           // Current season, value should be between 0 and 3 inclusive
+    vec3 cameraRight;
+    int danceBomb;           // 1 or 0
+    vec3 cameraUp;
+    int discoLights;         // 1 or 0
+    vec4 lightDir;
+};
 
 void main() {
+    drawOutline = instanceFlags.x;
+    entityAlternateTexture = instanceFlags.y;
+    textureIdx = instanceFlags.z;
+    entitySeasons = instanceFlags.w;
+    worldPosition = model * vec4(vertex, 1);
+
     // Perform vertex transformation
     if (isAnimated) {
         mat4 accumulatorModel = mat4(0);
@@ -39,8 +73,9 @@ void main() {
                 totalPosition = vec4(vertex, 1);
                 break;
             }
-            vec4 localPos = boneTransform[boneidx[i]] * vec4(vertex, 1);
-            accumulatorModel += boneweight[i] * boneTransform[boneidx[i]];
+            mat4 bone = boneTransform(boneidx[i]);
+            vec4 localPos = bone * vec4(vertex, 1);
+            accumulatorModel += boneweight[i] * bone;
             totalPosition += boneweight[i] * localPos;
         }
         if (boneidx[0] == -1) {
@@ -56,7 +91,7 @@ void main() {
         fragNormal = normal;
         fragTexcoord = texcoord;
 
-        lightCoordPosn = lightPerspective * lightView * model * totalPosition;
+        shadowPosition = model * totalPosition;
     } else {
         projectedFragPosition = perspective * view * model * vec4(vertex, 1);
         gl_Position = projectedFragPosition;
@@ -67,6 +102,6 @@ void main() {
         fragNormal = normal; // Transform normal according to model transformation
         fragTexcoord = texcoord;
 
-        lightCoordPosn = lightPerspective * lightView * model * vec4(vertex, 1);
+        shadowPosition = model * vec4(vertex, 1);
     }
 }
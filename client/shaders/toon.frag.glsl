@@ -7,25 +7,30 @@ in vec2 fragTexcoord;
 
 in mat4 finalModel;
 
-in vec4 lightCoordPosn;
+in vec4 shadowPosition;
+in vec4 worldPosition;
 
 layout (location = 0) out vec4 fragColor;
-layout (location = 1) out vec4 fragGNormal;
-layout (location = 2) out int fragGMask;
-
-uniform mat4 perspective;
-uniform mat4 view; // View matrix for converting to canonical coordinates
-uniform mat4 model;
-uniform vec3 cameraPosition;
-
-uniform vec4 lightDir;
-uniform mat4 lightView; // Light's viewing matrix
-uniform mat4 lightPerspective; // Light's perspective matrix
-
-// point light only
-uniform vec3 pointLightPosition;
-uniform int danceBomb;          // 1 or 0
-uniform int discoLights;        // 1 or 0 
+layout (location = 1) out vec2 fragGNormal; // Octahedral encoded, see encodeNormal
+layout (location = 2) out uint fragGMask;
+
+// Camera and lighting state for the whole frame, shared by every shader through one uniform buffer
+// Keep identical in every shader that declares it, it has to match sge::FrameUniforms (GraphicsShaders.h)
+layout (std140) uniform FrameData {
+    mat4 perspective;        // Camera perspective projection matrix
+    mat4 view;               // Camera viewing matrix
+    mat4 lightSpace[3];      // Light's perspective * viewing matrix for each shadow cascade (SHADOW_CASCADES of them)
+    vec4 cascadeSplits;      // How far from the camera each shadow cascade reaches
+    vec3 cameraPosition;
+    float seasonBlend;       // Amount to blend with next season
+    vec3 pointLightPosition; // Dance bomb's point light
+    int curSeason;           // Current season, value should be between 0 and 3 inclusive
+    vec3 cameraRight;
+    int danceBomb;           // 1 or 0
+    vec3 cameraUp;
+    int discoLights;         // 1 or 0
+    vec4 lightDir;
+};
 
 // Whether this material has a diffuse texture
 uniform int hasDiffuseMap;
@@ -39,14 +44,12 @@ uniform sampler2D diffuseTexture3;
 uniform vec3 diffuseColor;
 
 uniform int multipleTextures; // 1 or 0 depending on whether this material has multiple diffuse textures
-uniform int textureIdx; // Diffuse texture currently selected (out of the possible diffuse textures)
+flat in int textureIdx; // Diffuse texture currently selected (out of the possible diffuse textures)
 
 uniform int seasons; // 1 or 0 depending on whether this material is affected by current season
-uniform int curSeason; // Current season, value should be between 0 and 3 inclusive
-uniform float seasonBlend; // Amount to blend with next aseason
 
-uniform int entityAlternateTexture; // 1 or 0 depending on whether the current entity could swap to alternate diffuse textures
-uniform int entitySeasons; // 1 or 0 depending on whether the current entity wants to change color/textures with the seasons
+flat in int entityAlternateTexture; // 1 or 0 depending on whether the current entity could swap to alternate diffuse textures
+flat in int entitySeasons; // 1 or 0 depending on whether the current entity wants to change color/textures with the seasons
 
 uniform int hasSpecularMap;
 uniform sampler2D specularTexture;
@@ -56,9 +59,9 @@ uniform int hasShinyMap;
 uniform vec3 shinyColor;
 uniform sampler2D shinyTexture;
 
-uniform int drawOutline;
+flat in int drawOutline;
 
-uniform sampler2D shadowMap;
+uniform sampler2DArray shadowMap; // One layer per shadow cascade
 
 // // Unused positional light stuff
 // uniform vec4 lightPositions[10]; // Positional light positions
@@ -133,23 +136,44 @@ vec4 computeRim(vec3 lightDirection, vec3 viewDir, vec3 normal, vec4 lightColor,
     return rimDot * pow(dot(normal, lightDirection), 0.1) * SpecularColor;
 }
 
+// Fold a unit normal onto an octahedron and flatten it to 2 values between 0 and 1, so the g-buffer only needs two
+// small channels for it. screen.frag.glsl's decodeNormal undoes it
+vec2 encodeNormal(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 encoded = n.xy;
+    if (n.z < 0) {
+        encoded = (1.0 - abs(n.yx)) * vec2(n.x >= 0 ? 1.0 : -1.0, n.y >= 0 ? 1.0 : -1.0);
+    }
+    return encoded * 0.5 + 0.5;
+}
+
+const int shadow_cascades = 3; // SHADOW_CASCADES in GraphicsConstants.h
+
 float computeShadow(vec3 normal, vec3 lightdir, vec4 position) {
-    vec3 projCoords = position.xyz / position.w;
+    // Use the sharpest cascade that reaches this far from the camera, past the last one there's no shadow
+    float depth = -(view * position).z;
+    int cascade = 0;
+    while (cascade < shadow_cascades && depth > cascadeSplits[cascade]) {
+        cascade++;
+    }
+    if (cascade == shadow_cascades) {
+        return 0.0;
+    }
+    vec4 lightCoordPosn = lightSpace[cascade] * position;
+    vec3 projCoords = lightCoordPosn.xyz / lightCoordPosn.w;
 
     // OpenGL viewing frustum goes from [-1, 1], transform to [0, 1] range for texture coordinates
     projCoords = projCoords * 0.5 + 0.5;
 
-    float closestDepth = texture(shadowMap, projCoords.xy).r;
     float currentDepth = projCoords.z;
     float bias = max(0.01 * (1.0 - dot(normal, lightdir)), 0.002);
-    float shadow = currentDepth - bias > closestDepth ? 1.0 : 0.0;
 
     // PCF filtering to make shadows smoother
     float shadowFactor = 0.0;
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
+    vec2 texelSize = 1.0 / textureSize(shadowMap, 0).xy;
     for (int x = -1; x <= 1; ++x) {
         for (int y = -1; y <= 1; ++y) {
-            float pcfDepth = texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r;
+            float pcfDepth = texture(shadowMap, vec3(projCoords.xy + vec2(x, y) * texelSize, cascade)).r;
             shadowFactor += currentDepth - bias > pcfDepth ? 1.0 : 0.0;
         }
     }
@@ -195,14 +219,14 @@ vec4 computePointLight(vec3 lightPos, vec3 normal, vec3 fragPos, vec3 viewDir, v
 
 void main() {
     vec3 transformedNormal = normalize((transpose(inverse(finalModel)) * vec4(fragNormal, 1)).xyz);
-    vec4 position4 = model * vec4(fragPosition, 1.0f);
+    vec4 position4 = worldPosition;
     vec3 position3 = position4.xyz / position4.w;
     vec3 lightdir = normalize(lightDir).xyz;
     vec4 diffuse = vec4(0.0f, 0.0f, 0.0f, 1.0f);
     vec4 specular = vec4(0.0f, 0.0f, 0.0f, 1.0f);
     vec4 shiny = vec4(0.0f, 0.0f, 0.0f, 1.0f);
     vec3 viewDir = normalize(cameraPosition - position3);
-    float shadow = computeShadow(transformedNormal, lightdir, lightCoordPosn);
+    float shadow = computeShadow(transformedNormal, lightdir, shadowPosition);
 
     if (hasDiffuseMap != 0) {
         if (seasons != 0 && entitySeasons != 0) {
@@ -263,9 +287,9 @@ void main() {
     }
 
     fragColor += (1 - shadow) * clamp(computeSpecular(lightdir, viewDir, transformedNormal, globalLightColor, specular, shiny), 0, 1);
-    fragGNormal.xyz = transformedNormal;
-    fragGNormal.w = dot(viewDir, transformedNormal);
-    fragGMask = drawOutline; // 4th position of fragcolor will denote whether to draw outline
+    // The postprocessor works out dot(viewDir, normal) itself from the camera
+    fragGNormal = encodeNormal(transformedNormal);
+    fragGMask = uint(drawOutline); // Whether to draw outline
     // Uncomment to enable rim lighting
     // fragColor += clamp(computeRim(lightdir, viewDir, transformedNormal, lightColor, specular), 0, 1);
 
@@ -0,0 +1,111 @@
+#include "AssetLoader.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+
+std::unique_ptr<AssetLoader> assetLoader;
+
+AssetLoader::AssetLoader() {
+    int numWorkers = ASSET_LOADER_THREADS;
+    if (numWorkers <= 0) {
+        numWorkers = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+    }
+    startTime = std::chrono::steady_clock::now();
+    for (int i = 0; i < numWorkers; i++) {
+        workers.emplace_back(&AssetLoader::workerLoop, this);
+    }
+    std::printf("loading assets on %d threads\n", numWorkers);
+}
+
+AssetLoader::~AssetLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        // anything not decoded yet isn't wanted anymore
+        decodes.clear();
+    }
+    changed.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void AssetLoader::load(AssetDecode decode) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (unfinished == 0) {
+            startTime = std::chrono::steady_clock::now();
+            loadedCount = 0;
+        }
+        decodes.push_back(std::move(decode));
+        unfinished++;
+    }
+    changed.notify_all();
+}
+
+void AssetLoader::workerLoop() {
+    while (true) {
+        AssetDecode decode;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return stopping || !decodes.empty(); });
+            if (stopping) {
+                return;
+            }
+            decode = std::move(decodes.front());
+            decodes.pop_front();
+        }
+
+        AssetUpload upload = decode();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            uploads.push_back(std::move(upload));
+        }
+        changed.notify_all();
+    }
+}
+
+void AssetLoader::uploadFinished(double budgetMs) {
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() < budgetMs) {
+        AssetUpload upload;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (uploads.empty()) {
+                return;
+            }
+            upload = std::move(uploads.front());
+            uploads.pop_front();
+        }
+
+        // a decode that failed has nothing to upload
+        if (upload) {
+            upload();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        unfinished--;
+        loadedCount++;
+        if (unfinished == 0) {
+            double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+            std::printf("loaded %u assets in %.0fms\n", loadedCount, loadMs);
+        }
+    }
+}
+
+void AssetLoader::finish() {
+    while (!isDone()) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return !uploads.empty(); });
+        }
+        uploadFinished(std::numeric_limits<double>::infinity());
+    }
+}
+
+bool AssetLoader::isDone() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return unfinished == 0;
+}
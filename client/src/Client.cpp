@@ -11,6 +11,7 @@ std::vector<std::shared_ptr<sge::DynamicModelEntityState>> movementEntities;
 std::unique_ptr<sge::ParticleEmitterEntity> emitter;
 double lastX, lastY;    // last cursor position
 bool enableInput = false;
+bool showNetworkOverlay = false;  // F3 toggles the network telemetry overlay
 bool danceTwinkle = false;
 
 int main()
@@ -25,8 +26,8 @@ int main()
     // Load 2d images for UI
     sge::loadUIs();
 
-    // Load 3d models for graphics engine
-    sge::loadModels();
+    // Everything else decodes in the background while the lobby runs
+    assetLoader = std::make_unique<AssetLoader>();
 
     sge::emitters.push_back(std::make_unique<sge::ParticleEmitter>());
 
@@ -39,25 +40,9 @@ int main()
     // Allow the river to switch between multiple alternate textures
     entities.push_back(std::make_shared<sge::ModelEntityState>(WATER , glm::vec3(0.0f)));
     entities[1]->setAlternateTexture(true, 0);
-    sge::defaultProgram.updateSeason(SUMMER_SEASON, 0.5);
-    for (unsigned int i = 0; i < 4; i++) { // Player graphics entities
-        std::shared_ptr<sge::DynamicModelEntityState> playerEntity = std::make_shared<sge::DynamicModelEntityState>(FOX, movementEntities.size());
-
-        entities.push_back(playerEntity);
-        clientGame->playerIndices.push_back(movementEntities.size());
-        movementEntities.push_back(playerEntity);
-    }
-    std::shared_ptr<sge::DynamicModelEntityState> egg = std::make_shared<sge::DynamicModelEntityState>(EGG, movementEntities.size());
-    entities.push_back(egg);
-    movementEntities.push_back(egg);
-    for (unsigned int i = 0; i < NUM_PROJ_TYPES; i++) {
-        for (unsigned int j = 0; j < NUM_EACH_PROJECTILE; j++) {
-            std::shared_ptr<sge::DynamicModelEntityState> projEntity = std::make_shared<sge::DynamicModelEntityState>(SUMMER_BALL, movementEntities.size());
-            entities.push_back(projEntity);
-            clientGame->projIndices.push_back(movementEntities.size());
-            movementEntities.push_back(projEntity);
-        }
-    }
+    sge::frameUniforms.data.curSeason = SUMMER_SEASON;
+    sge::frameUniforms.data.seasonBlend = 0.5;
+    // Player, egg and projectile graphics entities get made in syncMovementEntities once we know how many there are
     clientGame->initializeParticleEmitters();
 
     // I move the setup for glfw to after the lobby screen are done
@@ -75,8 +60,12 @@ int main()
 
 
 
+    // Lobby images and sounds get queued first so they're the first to come in
     sound::initSoundManager();
     ui::initUIManager();
+
+    // Load 3d models for graphics engine, they aren't needed until the game starts
+    sge::loadModels();
     
 
 
@@ -124,6 +113,37 @@ void updateSunPostion(glm::vec3 &sunPos, int t) {
     //todo: change this to travel above the river only?
 }
 
+/**
+ * Make graphics entities for any movement entities the client game has that we don't have yet.
+ * Players show up with their selected character, then the egg, then projectiles as the server makes them
+ */
+void syncMovementEntities() {
+    for (unsigned int i = movementEntities.size(); i < clientGame->positions.size(); i++) {
+        ModelIndex model = SUMMER_BALL;
+        if (clientGame->isPlayer(i)) {
+            int character = clientGame->characterOf(i);
+            model = character != NO_CHARACTER ? (ModelIndex)(character + RABBIT) : FOX;
+        } else if (clientGame->isEgg(i)) {
+            model = EGG;
+        }
+        std::shared_ptr<sge::DynamicModelEntityState> entity = std::make_shared<sge::DynamicModelEntityState>(model, i);
+        entities.push_back(entity);
+        movementEntities.push_back(entity);
+    }
+}
+
+/**
+ * Halve the shadow cascades' resolution, going back up to shadowmap-resolution from setup.json once it's at
+ * SHADOWMAP_MIN_RESOLUTION. Trades shadow sharpness for fill rate while the game's running
+ */
+void cycleShadowResolution() {
+    int resolution = sge::shadowprocessor.getResolution() / 2;
+    if (resolution < SHADOWMAP_MIN_RESOLUTION) {
+        resolution = std::stoi(SetupParser::getValue("shadowmap-resolution"));
+    }
+    sge::shadowprocessor.setResolution(resolution);
+}
+
 /**
  * Main client game loop
  */
@@ -135,8 +155,7 @@ void clientLoop()
     // Update shadow map with current state of entities/poses
     // TODO: Avoid hard coding this
     // If we want dynamic global lighting (i.e. change time of day), change the light vector stuff
-    // Projection matrix for light, use orthographic for directional light, perspective for point light
-    glm::mat4 lightProjection = glm::ortho(-40.0, 40.0, -40.0, 40.0, -40.0, 40.0);
+    // Light's projections are fitted around the camera's view every frame, one per shadow cascade (see fitCascades)
     // Light position, also used as light direction for directional lights
     glm::vec3 lightPos(5, 5, 0);
     // Where light is "pointing" towards
@@ -145,6 +164,9 @@ void clientLoop()
     glm::vec3 lightUp(0, 1, 0);
     // Light viewing matrix
     glm::mat4 lightView;
+    // Where the shadows are cast from, only catches up with lightPos when it's moved far enough to redraw the cached
+    // static shadows
+    glm::vec3 shadowLightPos = lightPos;
 
 
     // This is all spaghetti code, it's week 10, demo's on Friday, don't got time for clean code no more
@@ -153,14 +175,22 @@ void clientLoop()
     long long prevRiverTick = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
     int riverFrame = 0; // Frame of current river animation
 
+    double assetUploadBudgetMs = ASSET_UPLOAD_BUDGET_MS;
+
     // Main loop
     while (!glfwWindowShouldClose(sge::window))
     {
         // Poll for and process events (e.g. keyboard & mouse input callbacks)
         glfwPollEvents();
 
+        // Hand a few finished assets to OpenGL, without holding up the frame for long
+        assetLoader->uploadFinished(assetUploadBudgetMs);
+
         // when the lobby screen are done, transition to the game
         if (ui::isTransitioningToGame) {
+            // the game needs every model, usually they're all in long before anyone's picked a character
+            assetLoader->finish();
+            sge::printMemoryReport();
 
             // TODO: to be safe, remove the key callback for the lobby
             glfwSetKeyCallback(sge::window, NULL);
@@ -180,10 +210,11 @@ void clientLoop()
             sound::soundManager->stopAllLobbyMusic();
 
             // Update player models
-            for (unsigned int i = 0; i < NUM_PLAYER_ENTITIES; i++) {
+            syncMovementEntities();
+            for (unsigned int i = 0; i < clientGame->playerIndices.size(); i++) {
                 unsigned int movementIndex = clientGame->playerIndices[i];
-                if (clientGame->characterUID[i] != NO_CHARACTER) {
-                    movementEntities[movementIndex]->updateModel((ModelIndex)(clientGame->characterUID[i] + RABBIT));
+                if (clientGame->characterOf(i) != NO_CHARACTER) {
+                    movementEntities[movementIndex]->updateModel((ModelIndex)(clientGame->characterOf(i) + RABBIT));
                 }
             }
 
@@ -192,6 +223,8 @@ void clientLoop()
 
 
         if (ui::isInLobby) {
+            // start syncing our clock with the server's now so it's ready when the game starts
+            clientGame->updateClockSync();
             // receive update from server - here we only interest in the lobby selection
             clientGame->network->receiveUpdates();
 
@@ -223,13 +256,17 @@ void clientLoop()
 
         }
         else {
-            // Send these input to server
-            clientGame->sendClientInputToServer();
+            sge::dynamicResolution.beginFrame();
+            // Move our own player locally first, sending each tick's input as it's due
+            clientGame->updateClockSync();
+            clientGame->predictLocalMovement();
 
             // Receive updates from server/update local game state
             clientGame->network->receiveUpdates();
+            clientGame->interpolateEntities();
+            syncMovementEntities();
 
-            for (unsigned int i = 0; i < NUM_MOVEMENT_ENTITIES; i++) {
+            for (unsigned int i = 0; i < movementEntities.size(); i++) {
                 movementEntities[i]->setAnimation(clientGame->animations[i]);
             }
 
@@ -262,7 +299,10 @@ void clientLoop()
             // glm::mat4 lightView = glm::lookAt(lightPos, lightCenter, lightUp);
 
             updateSunPostion(lightPos, i);
-            lightView = glm::lookAt(lightPos, lightCenter, lightUp); // recalculate 
+            if (sge::shadowprocessor.lightMoved(lightPos)) {
+                shadowLightPos = lightPos;
+            }
+            lightView = glm::lookAt(shadowLightPos, lightCenter, lightUp); // recalculate 
 
             if (clientGame->seasonBlend < 0.5) {
                 Season prevSeason = (Season)(clientGame->currentSeason - 1);
@@ -270,48 +310,75 @@ void clientLoop()
                     prevSeason = WINTER_SEASON;
                 }
                 // std::cout << "previous season: " << prevSeason << std::endl;
-                sge::defaultProgram.updateSeason(prevSeason, 0.5 + clientGame->seasonBlend);
+                sge::frameUniforms.data.curSeason = prevSeason;
+                sge::frameUniforms.data.seasonBlend = 0.5 + clientGame->seasonBlend;
             }
             else {
-                sge::defaultProgram.updateSeason(clientGame->currentSeason, clientGame->seasonBlend - 0.5);
+                sge::frameUniforms.data.curSeason = clientGame->currentSeason;
+                sge::frameUniforms.data.seasonBlend = clientGame->seasonBlend - 0.5;
             }
 
             // Give shaders global lighting information
             // This only works with 1 shadow-casting light source at the moment
-            sge::shadowProgram.updatePerspectiveMat(lightProjection);
-            sge::shadowProgram.updateViewMat(lightView);
+            sge::frameUniforms.data.lightDir = glm::vec4(lightPos, 0);
+            sge::cullingStats = sge::CullingStats();
+            sge::renderQueue.beginFrame();
 
-            sge::defaultProgram.updateLightPerspectiveMat(lightProjection);
-            sge::defaultProgram.updateLightViewMat(lightView);
-            sge::defaultProgram.updateLightDir(glm::vec4(lightPos, 0));
-
-            glm::vec3 pointLightPosition = clientGame->positions[4] + glm::vec3(0,2,0); // above the egg
+            glm::vec3 pointLightPosition = clientGame->positions[clientGame->eggIndex()] + glm::vec3(0,2,0); // above the egg
             if (clientGame->danceInAction && i % 30 == 0) {
                 danceTwinkle = ! danceTwinkle;
             }
             else if (!clientGame->danceInAction) {
                 danceTwinkle = false;
             }
-            sge::defaultProgram.updateDanceBombInfo(pointLightPosition, clientGame->eggIsDanceBomb, danceTwinkle);
-
-            sge::shadowProgram.useShader();
-            // If we want multiple shadow maps, we'll need to draw EVERYTHING to each one
-            sge::shadowprocessor.drawToShadowmap();
-            for (unsigned int i = 0; i < entities.size(); i++) {
-                entities[i]->drawShadow();
-            }
-            glEnable(GL_CULL_FACE);
-            glCullFace(GL_BACK);
+            sge::frameUniforms.data.pointLightPosition = pointLightPosition;
+            sge::frameUniforms.data.danceBomb = clientGame->eggIsDanceBomb;
+            sge::frameUniforms.data.discoLights = danceTwinkle;
 
-            sge::defaultProgram.useShader();
             sge::updateCameraToFollowPlayer(clientGame->positions[clientGame->client_id],
                                             clientGame->yaws[clientGame->client_id],
                                             clientGame->pitches[clientGame->client_id],
                                             clientGame->cameraDistances[clientGame->client_id],
                                             clientGame->gameOver
                                             );
+            // Shadow cascades follow the camera, so they're fitted after it's moved
+            sge::shadowprocessor.fitCascades(sge::perspectiveMat, sge::viewMat, lightView);
+            std::copy(std::begin(sge::shadowprocessor.lightSpace), std::end(sge::shadowprocessor.lightSpace),
+                      sge::frameUniforms.data.lightSpace);
+            sge::frameUniforms.data.cascadeSplits = sge::shadowprocessor.cascadeSplits;
+            // Every shader reads the frame's camera and lighting from here on
+            sge::frameUniforms.upload();
+
+            sge::shadowProgram.useShader();
+            // Every cascade gets everything inside it drawn to it
+            for (int cascade = 0; cascade < SHADOW_CASCADES; cascade++) {
+                sge::shadowProgram.updateCascade(cascade);
+                sge::lightFrustum = sge::Frustum(sge::shadowprocessor.lightSpace[cascade]);
+                if (sge::shadowprocessor.needsStaticRedraw(cascade)) {
+                    sge::shadowprocessor.drawToStaticShadowmap(cascade);
+                    for (unsigned int i = 0; i < entities.size(); i++) {
+                        if (entities[i]->hasStaticShadow()) {
+                            entities[i]->drawShadow();
+                        }
+                    }
+                    sge::renderQueue.execute(SHADOW_PASS);
+                }
+                // Starts off as a copy of the static shadows, only things that move get drawn every frame
+                sge::shadowprocessor.drawToShadowmap(cascade);
+                for (unsigned int i = 0; i < entities.size(); i++) {
+                    if (!entities[i]->hasStaticShadow()) {
+                        entities[i]->drawShadow();
+                    }
+                }
+                sge::renderQueue.execute(SHADOW_PASS);
+            }
+            sge::glState.enable(GL_CULL_FACE);
+            sge::glState.cullFace(GL_BACK);
+
+            sge::defaultProgram.useShader();
 
-            // Draw everything to framebuffer (gbuffer)
+            // Draw everything to framebuffer (gbuffer), at whatever resolution holds the frame time budget
+            sge::postprocessor.setRenderScale(sge::dynamicResolution.getScale());
             sge::postprocessor.drawToFramebuffer();
 
             // Uncomment the below to display wireframes
@@ -323,37 +390,38 @@ void clientLoop()
             for (unsigned int i = 0; i < entities.size(); i++) {
                 entities[i]->draw();
             }
+            sge::renderQueue.execute(MAIN_PASS);
 
             // Draw skybox
-            glDepthFunc(GL_LEQUAL);
-            glEnablei(GL_BLEND, 0);
-            glDepthMask(GL_FALSE);
+            sge::glState.depthFunc(GL_LEQUAL);
+            sge::glState.enablei(GL_BLEND, 0);
+            sge::glState.depthMask(GL_FALSE);
             sge::skyboxProgram.drawSkybox();
-            glDisablei(GL_BLEND, 0);
-            glDepthMask(GL_TRUE);
-            glDepthFunc(GL_LESS);
+            sge::glState.disablei(GL_BLEND, 0);
+            sge::glState.depthMask(GL_TRUE);
+            sge::glState.depthFunc(GL_LESS);
 
             // Draw particles
             // Only enable alpha blending for color attachment 0 (the one holding fragment colors)
-            glEnablei(GL_BLEND, 0);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            sge::glState.enablei(GL_BLEND, 0);
+            sge::glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
             sge::particleProgram.useShader();
             for (unsigned int i = 0; i < 4; i++) {
                 clientGame->ambientParticleEmitters[i]->setActive(i==clientGame->currentSeason);
                 clientGame->ambientParticleEmitters[i]->update();
                 clientGame->ambientParticleEmitters[i]->draw();
             }
-            for (unsigned int i = 0; i < NUM_TOTAL_PROJECTILES; i++) {
+            for (unsigned int i = 0; i < clientGame->projIndices.size(); i++) {
                 clientGame->projParticleEmitters[i]->setActive(clientGame->projActive[i]);
                 clientGame->projParticleEmitters[i]->update();
                 clientGame->projParticleEmitters[i]->draw();
             }
-            for (unsigned int i = 0; i < NUM_TOTAL_PROJECTILES; i++) {
+            for (unsigned int i = 0; i < clientGame->projIndices.size(); i++) {
                 clientGame->projExplosionEmitters[i]->setActive(clientGame->projActive[i]);
                 clientGame->projExplosionEmitters[i]->update();
                 clientGame->projExplosionEmitters[i]->draw();
             }
-            glDisablei(GL_BLEND, 0);
+            sge::glState.disablei(GL_BLEND, 0);
 
 
             // Render ephemeral entities (bullet trail, fireballs, etc.)
@@ -365,10 +433,10 @@ void clientLoop()
 
             /*
             // TESTING moving sun: literally a shooting photon to me 
-            glEnable(GL_BLEND); // enable alpha blending for images with transparent background
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            sge::glState.enable(GL_BLEND); // enable alpha blending for images with transparent background
+            sge::glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
             sge::billboardProgram.renderPlayerTag(lightPos- glm::vec3(0,1.3,0), sge::UIs[2]->texture, 5);
-            glDisable(GL_BLEND);
+            sge::glState.disable(GL_BLEND);
             sge::lineShaderProgram.renderBulletTrail(lightPos, lightCenter);
             // TESTING: show xyz axis as bullet trails
             sge::lineShaderProgram.renderBulletTrail(glm::vec3(0), glm::vec3(50,0,0));
@@ -378,7 +446,7 @@ void clientLoop()
         */
 
             // Render framebuffer with postprocessing
-            glDisable(GL_CULL_FACE);
+            sge::glState.disable(GL_CULL_FACE);
             sge::screenProgram.useShader();
             sge::postprocessor.drawToScreen();
 
@@ -387,12 +455,12 @@ void clientLoop()
             clientGame->updateShootingEmo();
             
             // Render UIs
-            sge::renderAllBillboardTags(clientGame->positions, clientGame->client_id, clientGame->eggIsDanceBomb, clientGame->eggHolderId);
+            sge::renderAllBillboardTags(clientGame->positions, clientGame->numPlayers, clientGame->client_id, clientGame->eggIsDanceBomb, clientGame->eggHolderId);
             sge::renderAllUIs(clientGame->currentSeason, clientGame->client_id, clientGame->client_id, clientGame->eggHolderId, clientGame->eggIsDanceBomb,
-                                clientGame->characterUID[clientGame->client_id], clientGame->waitingCD);
+                                clientGame->characterOf(clientGame->client_id), clientGame->waitingCD);
             sge::renderAllTexts(clientGame->healths[clientGame->client_id],
-                                clientGame->scores[0] + clientGame->scores[1],
-                                clientGame->scores[2] + clientGame->scores[3],
+                                clientGame->teamScore(BLUE),
+                                clientGame->teamScore(RED),
                                 clientGame->currentSeason,
                                 enableInput,
                                 clientGame->gameOver,
@@ -401,6 +469,38 @@ void clientLoop()
                                 clientGame->detonationMiliSecs,
                                 clientGame->shouldRenderBombTicks()
                                 );
+            if (showNetworkOverlay) {
+                std::vector<std::string> overlayLines = clientGame->networkOverlayLines();
+                char line[128];
+                std::snprintf(line, sizeof(line), "culled %u of %u mesh draws, %u of %u shadow draws", sge::cullingStats.culled,
+                    sge::cullingStats.culled + sge::cullingStats.drawn, sge::cullingStats.shadowCulled,
+                    sge::cullingStats.shadowCulled + sge::cullingStats.shadowDrawn);
+                overlayLines.push_back(line);
+                const sge::RenderQueueStats &mainStats = sge::renderQueue.stats[MAIN_PASS];
+                std::snprintf(line, sizeof(line), "%u draws of %u meshes, %u material %u entity %u VAO changes", mainStats.draws,
+                    mainStats.instances, mainStats.materialChanges, mainStats.instanceChanges, mainStats.vaoChanges);
+                overlayLines.push_back(line);
+                std::snprintf(line, sizeof(line), "%u bone matrices for %u poses", sge::bonePalette.numBones(),
+                    sge::bonePalette.numPoses());
+                overlayLines.push_back(line);
+                std::snprintf(line, sizeof(line), "%d %dpx shadow cascades (F4 to change), static shadows drawn %u times",
+                    SHADOW_CASCADES, sge::shadowprocessor.getResolution(), sge::shadowprocessor.staticRedraws);
+                overlayLines.push_back(line);
+                std::snprintf(line, sizeof(line), "%dx%d render (%s, F5 to toggle), GPU %.1fms CPU %.1fms of %.1fms",
+                    sge::postprocessor.getRenderWidth(), sge::postprocessor.getRenderHeight(),
+                    sge::dynamicResolution.isEnabled() ? "dynamic" : "fixed", sge::dynamicResolution.gpuMs,
+                    sge::dynamicResolution.cpuMs, sge::dynamicResolution.budgetMs);
+                overlayLines.push_back(line);
+                int gBufferBytes = sge::postprocessor.bytesPerPixel();
+                std::snprintf(line, sizeof(line), "G-buffer %s color %s normals (F6 to change): %d bytes/px, %.1fMB a frame",
+                    sge::postprocessor.getColorFormat().name, sge::postprocessor.getNormalFormat().name, gBufferBytes,
+                    gBufferBytes * sge::postprocessor.getRenderWidth() * sge::postprocessor.getRenderHeight() / 1e6);
+                overlayLines.push_back(line);
+                std::snprintf(line, sizeof(line), "%u GL state calls, %u skipped as no-ops", sge::glState.lastFrameStats.issued,
+                    sge::glState.lastFrameStats.skipped);
+                overlayLines.push_back(line);
+                sge::renderDebugOverlay(overlayLines);
+            }
 
             // dancebomb music
             if (clientGame->shouldPlayBombTicking()) {
@@ -413,8 +513,10 @@ void clientLoop()
                 sound::soundManager->stopDanceSong();
             }
 
+            sge::dynamicResolution.endFrame();
             // Swap buffers
             glfwSwapBuffers(sge::window);
+            sge::glState.endFrame();
 
             i++;
         }
@@ -497,6 +599,18 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
         case GLFW_KEY_UP:
             // move up ui box? todo: for positioning ui entities
             break;
+        case GLFW_KEY_F3:
+            showNetworkOverlay = !showNetworkOverlay;
+            break;
+        case GLFW_KEY_F4:
+            cycleShadowResolution();
+            break;
+        case GLFW_KEY_F5:
+            sge::dynamicResolution.setEnabled(!sge::dynamicResolution.isEnabled());
+            break;
+        case GLFW_KEY_F6:
+            sge::postprocessor.cycleFormats();
+            break;
         default:
             std::cout << "unrecognized key press, gg\n";
             break;
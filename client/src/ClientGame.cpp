@@ -1,27 +1,154 @@
 #include "ClientGame.h"
 
+#include <algorithm>
+#include <cmath>
+
+// Local time in milliseconds, only meaningful relative to other calls
+static double nowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 ClientGame::ClientGame()
 {
     network = std::make_unique<ClientNetwork>(this);
     client_id = 0;
     std::cout << "Initializing client game world...\n";
-    for (int i = 0; i < NUM_MOVEMENT_ENTITIES; i++) {
-        positions[i] = glm::vec3(i*10.0f, 0.0f, -(i%2)*8.0f);
-        yaws[i] = -90.0f;
-        animations[i] = -1; // always means no animation
-    }
-    for (int i = 0; i < NUM_PLAYER_ENTITIES; i++) {
-        cameraDistances[i] = CAMERA_DISTANCE_BEHIND_PLAYER;
-        healths[i] = 100;
-        scores[i] = 0;
+    // Just us until the server says how big the match is
+    resizePlayers(1);
 
-    }
+    // Load the collision map so we can predict our own movement instead of waiting on the server
+    collisionMap = CollisionMap::load((std::string)(PROJECT_PATH) + SetupParser::getValue("collision-map-baked"),
+                                      (std::string)(PROJECT_PATH) + SetupParser::getValue("collision-map"));
+    lastPredictionTime = std::chrono::steady_clock::now();
 
 	// send init packet
 	network->sendInitUpdate();
 }
 
-// This isn't part of the constructor since we need the projIndices to be set already, which happens in Client.cpp
+/**
+ * Reset everything that's sized by the number of players. The players are movement entities 0..numPlayers-1
+ * and the egg comes right after them, projectiles get added as the server makes them
+ */
+void ClientGame::resizePlayers(unsigned int numPlayers) {
+    this->numPlayers = numPlayers;
+    positions.clear();
+    yaws.clear();
+    pitches.clear();
+    animations.clear();
+    resizeMovementEntities(numPlayers + 1);
+
+    playerIndices.clear();
+    for (unsigned int i = 0; i < numPlayers; i++) {
+        playerIndices.push_back(i);
+    }
+    projIndices.clear();
+    projActive.clear();
+    projParticleEmitters.clear();
+    projExplosionEmitters.clear();
+
+    cameraDistances.assign(numPlayers, CAMERA_DISTANCE_BEHIND_PLAYER);
+    healths.assign(numPlayers, 100);
+    scores.assign(numPlayers, 0);
+
+    characterUID.assign(numPlayers, NO_CHARACTER);
+    browsingCharacterUID.assign(numPlayers, NO_CHARACTER);
+    teams.resize(numPlayers);
+    for (unsigned int i = 0; i < numPlayers; i++) {
+        teams[i] = ::teammateOf(i);
+    }
+    joined.assign(numPlayers, false);
+    numJoinedPlayers = 0;
+}
+
+void ClientGame::resizeMovementEntities(unsigned int numEntities) {
+    for (unsigned int i = positions.size(); i < numEntities; i++) {
+        positions.push_back(glm::vec3(i*10.0f, 0.0f, -(i%2)*8.0f));
+        yaws.push_back(-90.0f);
+        pitches.push_back(0.0f);
+        animations.push_back(-1); // always means no animation
+    }
+}
+
+/**
+ * Make the particle emitters for a projectile the first time we see it
+ */
+void ClientGame::addProjectile(const ProjectileSnapshot& projectile) {
+    unsigned int i = projectile.type;
+    unsigned int movementIndex = projectile.movementIndex;
+    std::unique_ptr<sge::ParticleEmitterEntity> particles = std::make_unique<sge::ParticleEmitterEntity>(4.0f,
+                                                        0.5f,
+                                                        0.0f,
+                                                        1000,
+                                                        1000,
+                                                        projColorProbs[i],
+                                                        projStartingColors[i],
+                                                        projEndingColors[i],
+                                                        glm::vec3(0.1f, 0.1f, 0.1f),
+                                                        glm::vec3(-0.5f, -0.5f, -0.5f),
+                                                        1.0f,
+                                                        0.0f,
+                                                        glm::vec3(0.0f, 0.005f, 0.0f),
+                                                        movementIndex,
+                                                        glm::vec3(0.0f, 0.0f, 0.0f));
+    particles->setActive(false);
+    std::unique_ptr<sge::ParticleEmitterEntity> explosion = std::make_unique<sge::ParticleEmitterEntity>(0.0f,
+                                                         0.5f,
+                                                         0.0f,
+                                                         1000,
+                                                         250,
+                                                         projColorProbs[i],
+                                                         projStartingColors[i],
+                                                         projEndingColors[i],
+                                                         glm::vec3(0.1f, 0.1f, 0.1f),
+                                                         glm::vec3(-0.5f, -0.5f, -0.5f),
+                                                         1.0f,
+                                                         0.0f,
+                                                         glm::vec3(0.0f, 0.0f, 0.0f),
+                                                         movementIndex,
+                                                         glm::vec3(0.0f, 0.0f, 0.0f));
+    explosion->setActive(false);
+
+    projIndices.push_back(movementIndex);
+    projActive.push_back(projectile.active);
+    projParticleEmitters.push_back(std::move(particles));
+    projExplosionEmitters.push_back(std::move(explosion));
+}
+
+int ClientGame::characterOf(int player) const {
+    return player >= 0 && player < (int)characterUID.size() ? characterUID[player] : NO_CHARACTER;
+}
+
+int ClientGame::browsingCharacterOf(int player) const {
+    return player >= 0 && player < (int)browsingCharacterUID.size() ? browsingCharacterUID[player] : NO_CHARACTER;
+}
+
+int ClientGame::teammateOf(int player) const {
+    return player >= 0 && player < (int)teams.size() ? teams[player] : ::teammateOf(player);
+}
+
+bool ClientGame::allJoinedPlayersReady() const {
+    if (numJoinedPlayers < (unsigned int)MIN_PLAYERS) {
+        return false;
+    }
+    for (unsigned int i = 0; i < joined.size(); i++) {
+        if (joined[i] && characterOf(i) == NO_CHARACTER) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int ClientGame::teamScore(Teams team) const {
+    int total = 0;
+    for (unsigned int i = 0; i < scores.size(); i++) {
+        if (teamOf(i) == team) {
+            total += scores[i];
+        }
+    }
+    return total;
+}
+
+// Ambient particles for each season. Projectile particles are made in addProjectile once the server tells us about them
 void ClientGame::initializeParticleEmitters() {
     // Spring leaf particles
     ambientParticleEmitters[0]=std::make_unique<sge::DiskParticleEmitterEntity>
@@ -50,69 +177,36 @@ void ClientGame::initializeParticleEmitters() {
             glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f), 1.0f, 0.0f, glm::vec3(0.0f, -0.002f, 0.0f),
             glm::vec3(0.0f, 15.0f, 0.0f), 50.0f);
     ambientParticleEmitters[3]->setActive(true);
-
-    for(unsigned int i = 0; i < NUM_PROJ_TYPES; i++) {
-        for (unsigned int j = 0; j < NUM_EACH_PROJECTILE; j++) {
-            unsigned int movementIndex = projIndices[i * NUM_EACH_PROJECTILE + j];
-            projParticleEmitters[i * NUM_EACH_PROJECTILE + j] = std::make_unique<sge::ParticleEmitterEntity>(4.0f,
-                                                                0.5f,
-                                                                0.0f,
-                                                                1000,
-                                                                1000,
-                                                                projColorProbs[i],
-                                                                projStartingColors[i],
-                                                                projEndingColors[i],
-                                                                glm::vec3(0.1f, 0.1f, 0.1f),
-                                                                glm::vec3(-0.5f, -0.5f, -0.5f),
-                                                                1.0f,
-                                                                0.0f,
-                                                                glm::vec3(0.0f, 0.005f, 0.0f),
-                                                                movementIndex,
-                                                                glm::vec3(0.0f, 0.0f, 0.0f));
-            projParticleEmitters[i * NUM_EACH_PROJECTILE + j]->setActive(false);
-            projExplosionEmitters[i * NUM_EACH_PROJECTILE + j] = std::make_unique<sge::ParticleEmitterEntity>(0.0f,
-                                                                 0.5f,
-                                                                 0.0f,
-                                                                 1000,
-                                                                 250,
-                                                                 projColorProbs[i],
-                                                                 projStartingColors[i],
-                                                                 projEndingColors[i],
-                                                                 glm::vec3(0.1f, 0.1f, 0.1f),
-                                                                 glm::vec3(-0.5f, -0.5f, -0.5f),
-                                                                 1.0f,
-                                                                 0.0f,
-                                                                 glm::vec3(0.0f, 0.0f, 0.0f),
-                                                                 movementIndex,
-                                                                 glm::vec3(0.0f, 0.0f, 0.0f));
-            projExplosionEmitters[i * NUM_EACH_PROJECTILE + j]->setActive(false);
-        }
-    }
 }
 
-void ClientGame::updateAnimations(std::bitset<NUM_STATES> movementEntityStates[]) {
-    for (unsigned int i = 0; i < NUM_PLAYER_ENTITIES; i++) {
+void ClientGame::updateAnimations(const std::vector<MovementEntitySnapshot>& movementEntities) {
+    for (unsigned int i = 0; i < playerIndices.size(); i++) {
         unsigned int movementIndex = playerIndices[i];
-        if (movementEntityStates[movementIndex][MOVING_HORIZONTALLY]) {
+        const std::bitset<NUM_STATES>& states = movementEntities[movementIndex].states;
+        if (states[MOVING_HORIZONTALLY]) {
             animations[movementIndex] = WALKING;
         }
-        else if (!movementEntityStates[movementIndex][ON_GROUND]) {
+        else if (!states[ON_GROUND]) {
             animations[movementIndex] = JUMPING;
         } else {
             animations[movementIndex] = STILL;
         }
         // shooting and abilities animation
-        if (movementEntityStates[movementIndex][IS_SHOOTING]) {
+        if (states[IS_SHOOTING]) {
             animations[movementIndex] = SHOOTING;
         }
-        if (movementEntityStates[movementIndex][IS_DANCING]) {
+        if (states[IS_DANCING]) {
             animations[movementIndex] = DANCING; // todo: use this after all 4 dance animations are ready @Joanne
             // animations[movementIndex] = WALKING;   // moonwalk, for testing only
         }
     }
-    for (unsigned int i = 0; i < NUM_TOTAL_PROJECTILES; i++) {
+    for (unsigned int i = 0; i < projIndices.size(); i++) {
         unsigned int movementIndex = projIndices[i];
-        if (movementEntityStates[movementIndex][EXPLODING]) {
+        // the index came from the server, don't trust it to be in range
+        if (movementIndex >= movementEntities.size()) {
+            continue;
+        }
+        if (movementEntities[movementIndex].states[EXPLODING]) {
             projExplosionEmitters[i]->explode();
         }
     }
@@ -164,14 +258,45 @@ bool ClientGame::shouldStopDanceSong() {
 
 void ClientGame::handleServerActionEvent(ServerToClientPacket& updatePacket) {
     // Handle action update (change position, camera angle, HP, etc.)
-    memcpy(&positions, &updatePacket.positions, sizeof(positions));
-    memcpy(&yaws, &updatePacket.yaws, sizeof(yaws));
-    memcpy(&pitches, &updatePacket.pitches, sizeof(pitches));
-    memcpy(&cameraDistances, &updatePacket.cameraDistances, sizeof(cameraDistances));
-    memcpy(&projActive, &updatePacket.active, sizeof(projActive));
-    // std::printf("received yaws: %f, %f, %f, %f\n", updatePacket.yaws[0], updatePacket.yaws[1], updatePacket.yaws[2], updatePacket.yaws[3]);
-    memcpy(&healths, &updatePacket.healths, sizeof(healths));
-    memcpy(&scores, &updatePacket.scores, sizeof(scores));
+    if (updatePacket.players.size() != numPlayers || client_id < 0 || client_id >= (int)numPlayers) {
+        std::printf("Dropping a snapshot with %zu players, expected %u\n", updatePacket.players.size(), numPlayers);
+        return;
+    }
+    // The server grows its projectile pool when it runs out, so there can be new movement entities
+    resizeMovementEntities(updatePacket.movementEntities.size());
+    for (unsigned int i = projIndices.size(); i < updatePacket.projectiles.size(); i++) {
+        addProjectile(updatePacket.projectiles[i]);
+    }
+
+    // Positions and view angles go through the interpolator instead of straight into positions[]
+    // Both measure time against the one server clock estimate in clockSync
+    clockSync.addTickStamp(updatePacket.serverTick, updatePacket.serverTimeMs);
+    interpolator.addSnapshot(updatePacket.serverTick, updatePacket.movementEntities);
+    if (clockSync.isSynced()) {
+        interpolator.addArrival(updatePacket.serverTick, clockSync.serverTickAt(nowMs()));
+    }
+    PlayerSnapshot& me = updatePacket.players[client_id];
+
+    // Nudge when we send inputs so they keep landing right before the tick that uses them
+    if (nextInputTick != 0) {
+        int lead = me.inputLeadTicks;
+        if (lead < 0) {
+            inputArrivalMarginMs += INPUT_ARRIVAL_MARGIN_LATE_STEP_MS;
+        } else if (lead > 0) {
+            inputArrivalMarginMs -= INPUT_ARRIVAL_MARGIN_EARLY_STEP_MS;
+        } else {
+            inputArrivalMarginMs -= INPUT_ARRIVAL_MARGIN_CREEP_MS;
+        }
+        inputArrivalMarginMs = std::clamp(inputArrivalMarginMs, 0.0, INPUT_ARRIVAL_MARGIN_MAX_MS);
+    }
+    for (unsigned int i = 0; i < numPlayers; i++) {
+        cameraDistances[i] = updatePacket.players[i].cameraDistance;
+        healths[i] = updatePacket.players[i].health;
+        scores[i] = updatePacket.players[i].score;
+    }
+    for (unsigned int i = 0; i < updatePacket.projectiles.size(); i++) {
+        projActive[i] = updatePacket.projectiles[i].active;
+    }
     memcpy(&currentSeason, &updatePacket.currentSeason, sizeof(currentSeason));   
     memcpy(&seasonBlend, &updatePacket.seasonBlend, sizeof(seasonBlend));
     memcpy(&eggIsDanceBomb, &updatePacket.eggIsDanceBomb, sizeof(eggIsDanceBomb));
@@ -180,20 +305,30 @@ void ClientGame::handleServerActionEvent(ServerToClientPacket& updatePacket) {
     memcpy(&detonationMiliSecs, &updatePacket.detonationMiliSecs, sizeof(detonationMiliSecs));
     memcpy(&gameDurationInSeconds, &updatePacket.gameDurationInSeconds, sizeof(gameDurationInSeconds));
     bombIsThrown = updatePacket.bombIsThrown;
-    this->waitingCD = updatePacket.seasonAbilityCD[this->client_id] > 0;
-    // std::printf("updatePacket.seasonAbilityCD[this->client_id] = %d\n", updatePacket.seasonAbilityCD[this->client_id]);
+    this->waitingCD = me.seasonAbilityCD > 0;
+
+    updateAnimations(updatePacket.movementEntities);
 
-    updateAnimations(updatePacket.movementEntityStates);
+    reconcileLocalPlayer(updatePacket);
 
     // network->sendActionUpdate(); // client does not need to notify server of its action. 
 }
 
 
 void ClientGame::handleLobbySelectionPacket(LobbyServerToClientPacket& lobbyPacket) {
-    for (int i = 0; i < NUM_PLAYER_ENTITIES; i++) {
-        characterUID[i] = lobbyPacket.playersCharacter[i];
-        browsingCharacterUID[i] = lobbyPacket.playersBrowsingCharacter[i];
-        teams[i] = lobbyPacket.teams[i];
+    unsigned int numSlots = std::min((unsigned int)lobbyPacket.players.size(), numPlayers);
+    numJoinedPlayers = 0;
+    for (unsigned int i = 0; i < numPlayers; i++) {
+        joined[i] = i < numSlots && lobbyPacket.players[i].joined;
+        if (!joined[i]) {
+            characterUID[i] = NO_CHARACTER;
+            browsingCharacterUID[i] = NO_CHARACTER;
+            continue;
+        }
+        numJoinedPlayers++;
+        characterUID[i] = lobbyPacket.players[i].character;
+        browsingCharacterUID[i] = lobbyPacket.players[i].browsingCharacter;
+        teams[i] = lobbyPacket.players[i].teammate;
         //std::cout << "Player " << i << " browsing " << browsingCharacterUID[i] << ", select " << characterUID[i] << std::endl;
     }
 
@@ -201,19 +336,19 @@ void ClientGame::handleLobbySelectionPacket(LobbyServerToClientPacket& lobbyPack
 
 void ClientGame::handleBulletPacket(BulletPacket& bulletPacket) {
 
-    for (int i = 0; i < bulletPacket.count; i++) {
+    for (const BulletTrail& trail : bulletPacket.bulletTrails) {
         // glm::vec3 gunPosition = bulletPacket.bulletTrail[i].first;
         // glm::vec3 hitPoint = bulletPacket.bulletTrail[i].second;
         // std::printf("received bullet trail gun(%f,%f,%f) -> hit(%f,%f,%f)\n", gunPosition.x, gunPosition.y, gunPosition.z, hitPoint.x, hitPoint.y, hitPoint.z);
         
-        bulletQueue.push_back(BulletToRender(bulletPacket.bulletTrail[i].start, bulletPacket.bulletTrail[i].end, BULLET_FRAMES));
+        bulletQueue.push_back(BulletToRender(trail.start, trail.end, BULLET_FRAMES));
 
         // if my client is one of the shooters, play shooting sound
-        if (client_id == bulletPacket.bulletTrail->shooterId) {
+        if (client_id == trail.shooterId) {
             sound::soundManager->shootingSound();
         
             // if i hit another player
-            if (bulletPacket.bulletTrail->playerHit != -1) {
+            if (trail.playerHit != -1) {
                 shootingEmo = 1;
             }
         }
@@ -258,7 +393,7 @@ void ClientGame::updateBulletQueue() {
     }
 }
 
-void ClientGame::sendClientInputToServer()
+void ClientGame::sendClientInputToServer(unsigned int targetTick)
 {
     ClientToServerPacket packet;
 
@@ -283,12 +418,181 @@ void ClientGame::sendClientInputToServer()
     // Movement angle
     packet.yaw = playerYaw;
     packet.pitch = playerPitch;
+
+    packet.inputSequence = inputSequence;
+    packet.viewTick = (float)lastRenderTick;
+    packet.targetTick = targetTick;
     
 
     // Serialize and send to server
 	network->sendClientToServerPacket(packet);
 }
 
+/**
+ * Rewind our player to the server's authoritative state and replay every input the server hadn't seen yet
+ */
+void ClientGame::reconcileLocalPlayer(ServerToClientPacket& updatePacket) {
+    std::bitset<NUM_STATES>& states = updatePacket.movementEntities[client_id].states;
+    // The server overrides our movement in these cases, there's nothing we can predict
+    predictionEnabled = !(states[IS_LERPING] || states[IS_DANCING] || gameOver || godRequest);
+    if (!predictionEnabled) {
+        pendingInputs.clear();
+        hasPredictedState = false;
+        predictionError = glm::vec3(0);
+        return;
+    }
+
+    glm::vec3 oldPosition = predictedState.position;
+    bool hadPredictedState = hasPredictedState;
+
+    predictedState = updatePacket.players[client_id].movementState;
+    hasPredictedState = true;
+
+    // Drop the inputs the server has already applied
+    unsigned int acknowledged = updatePacket.players[client_id].lastInputSequence;
+    while (!pendingInputs.empty() && pendingInputs.front().sequence <= acknowledged) {
+        pendingInputs.pop_front();
+    }
+
+    // Everything left is still in flight, so apply it on top of the server's state
+    for (PendingInput& pending : pendingInputs) {
+        previousPredictedPosition = predictedState.position;
+        physics::stepPlayer(*collisionMap, predictedState, pending.input, currentSeason);
+    }
+    if (pendingInputs.empty()) {
+        previousPredictedPosition = predictedState.position;
+    }
+
+    // Hide small corrections by blending them away over a few frames, snap on big ones (resets, respawns)
+    if (hadPredictedState) {
+        predictionError += oldPosition - predictedState.position;
+        if (glm::length(predictionError) > 2.0f) {
+            predictionError = glm::vec3(0);
+        }
+    }
+
+    positions[client_id] = predictedState.position + predictionError;
+}
+
+/**
+ * Run our own movement locally at the server's tick rate so it shows up without a round trip.
+ * Called once per frame. Once our clock is synced to the server's, each tick's input is sent
+ * just early enough to reach the server right before that tick runs
+ */
+void ClientGame::predictLocalMovement() {
+    float alpha;
+    if (clockSync.isSynced()) {
+        // The tick an input sent right now will get to the server in time for
+        double now = nowMs();
+        double arrivalTick = clockSync.serverTickAt(now + clockSync.getRoundTripMs() / 2 + inputArrivalMarginMs);
+        unsigned int dueTick = (unsigned int)std::max(0.0, std::floor(arrivalTick)) + 1;
+        if (nextInputTick == 0 || dueTick > nextInputTick + MAX_INPUT_CATCHUP_TICKS || dueTick + MAX_PENDING_INPUTS < nextInputTick) {
+            // First synced frame, or the server's ticks jumped on us (we stalled, new game), start over from here
+            nextInputTick = dueTick;
+        }
+        while (nextInputTick <= dueTick) {
+            stepLocalInput(nextInputTick);
+            nextInputTick++;
+        }
+        // How far we are between the last two ticks we stepped
+        alpha = (float)std::clamp(arrivalTick - (nextInputTick - 2), 0.0, 1.0);
+    } else {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        predictionAccumulatorMs += std::chrono::duration<double, std::milli>(now - lastPredictionTime).count();
+        lastPredictionTime = now;
+
+        while (predictionAccumulatorMs >= SERVER_TICK_MS) {
+            predictionAccumulatorMs -= SERVER_TICK_MS;
+            stepLocalInput(0);
+        }
+        alpha = (float)(predictionAccumulatorMs / SERVER_TICK_MS);
+    }
+
+    if (!predictionEnabled || !hasPredictedState) {
+        return;
+    }
+
+    predictionError *= PREDICTION_ERROR_DECAY;
+
+    // Smooth between the last two predicted ticks so movement doesn't look like it's running at 30fps
+    positions[client_id] = glm::mix(previousPredictedPosition, predictedState.position, alpha) + predictionError;
+    // Camera follows our own aim immediately too
+    yaws[client_id] = playerYaw;
+    pitches[client_id] = playerPitch;
+}
+
+/**
+ * Send one tick's worth of input to the server and apply it to our predicted player
+ */
+void ClientGame::stepLocalInput(unsigned int targetTick) {
+    bool predicting = predictionEnabled && hasPredictedState;
+    if (predicting && pendingInputs.size() >= MAX_PENDING_INPUTS) {
+        // Server hasn't acknowledged anything in a long time, stop sending until it catches up so
+        // every input it does ack is one we can still replay
+        return;
+    }
+    physics::MovementInput input = { requestForward, requestBackward, requestLeftward, requestRightward, requestJump, playerYaw };
+    inputSequence++;
+    sendClientInputToServer(targetTick);
+
+    if (!predicting) {
+        return;
+    }
+    pendingInputs.push_back({ inputSequence, input });
+    previousPredictedPosition = predictedState.position;
+    physics::stepPlayer(*collisionMap, predictedState, input, currentSeason);
+}
+
+void ClientGame::updateClockSync() {
+    double now = nowMs();
+    if (clockSync.shouldSendRequest(now)) {
+        ClockSyncRequest request = clockSync.makeRequest(now);
+        network->sendClockSyncRequest(request);
+    }
+}
+
+void ClientGame::handleClockSyncReply(ClockSyncReply& reply) {
+    clockSync.addReply(reply, nowMs());
+    network->telemetry.setRoundTrip(clockSync.getRoundTripMs(), clockSync.getRoundTripJitterMs());
+}
+
+/**
+ * Text for the network debug overlay: connection telemetry plus how our clock and timing are tracking the server
+ */
+std::vector<std::string> ClientGame::networkOverlayLines() {
+    std::vector<std::string> lines = network->telemetry.summaryLines();
+    char line[128];
+    std::snprintf(line, sizeof(line), "clock offset %.1fms  drift %.1fppm  %s", clockSync.getOffsetMs(), clockSync.getDrift() * 1e6,
+        clockSync.isSynced() ? "synced" : "not synced");
+    lines.push_back(line);
+    std::snprintf(line, sizeof(line), "input margin %.1fms  pending inputs %zu  interp delay %.1fms", inputArrivalMarginMs,
+        pendingInputs.size(), interpolator.getInterpolationDelayMs());
+    lines.push_back(line);
+    return lines;
+}
+
+/**
+ * Set positions/yaws/pitches of every entity we aren't predicting from the snapshot history.
+ * Called once per frame after receiving updates
+ */
+void ClientGame::interpolateEntities() {
+    bool predictingSelf = predictionEnabled && hasPredictedState;
+    // Until the clock is synced just show the newest snapshot
+    double tick = clockSync.isSynced() ? interpolator.renderTick(clockSync.serverTickAt(nowMs())) : interpolator.getNewestTick();
+    lastRenderTick = tick;
+    for (unsigned int i = 0; i < positions.size(); i++) {
+        if (predictingSelf && i == (unsigned int)client_id) {
+            continue;
+        }
+        interpolator.sample(i, tick, positions[i], yaws[i], pitches[i]);
+    }
+
+    // If we're carrying the egg it has to stay on our predicted back, not where the server last saw us
+    if (predictingSelf && eggHolderId == client_id) {
+        positions[eggIndex()] = positions[client_id] - physics::forwardDirection(playerYaw) * EGG_Z_WIDTH;
+    }
+}
+
 void ClientGame::sendLobbySelectionToServer(int browsingCharacterUID, int selectedCharacterUID) {
     LobbyClientToServerPacket packet;
 
@@ -303,6 +607,10 @@ void ClientGame::sendLobbySelectionToServer(int browsingCharacterUID, int select
 void ClientGame::handleIssueIdentifier(IssueIdentifierUpdate issue_identifier_update) {
     client_id = issue_identifier_update.client_id;
     std::cout << "My id is " << client_id << std::endl;
+    resizePlayers(issue_identifier_update.maxPlayers);
+    if (client_id >= (int)numPlayers) {
+        std::cout << "The match only has room for " << numPlayers << " players" << std::endl;
+    }
 }
 
 ClientGame::~ClientGame(void) {
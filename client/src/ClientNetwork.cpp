@@ -16,13 +16,14 @@ void ClientNetwork::sendIncreaseCounterUpdate(IncreaseCounterUpdate& increase_co
 	// create and populate header
     UpdateHeader header;
     header.update_type = INCREASE_COUNTER;
+    header.data_length = sizeof(IncreaseCounterUpdate);
 
 	// serialize header and packet data
     serialize(&header, packet_data);
     serialize(&increase_counter_update, packet_data + sizeof(UpdateHeader));
 
 	// send packet
-    NetworkServices::sendMessage(ConnectSocket, packet_data, packet_size);
+    sendToServer(packet_data, packet_size);
 }
 
 
@@ -34,13 +35,14 @@ void ClientNetwork::sendLobbyClientToServer(LobbyClientToServerPacket& packet) {
 	// create and populate header
 	UpdateHeader header;
 	header.update_type = LOBBY_TO_SERVER;
+	header.data_length = sizeof(LobbyClientToServerPacket);
 
 	// serialize header and packet data
 	serialize(&header, packet_data);
 	serialize(&packet, packet_data + sizeof(UpdateHeader));
 
 	// send packet
-	NetworkServices::sendMessage(ConnectSocket, packet_data, packet_size);
+	sendToServer(packet_data, packet_size);
 }
 
 
@@ -55,13 +57,28 @@ void ClientNetwork::sendClientToServerPacket(ClientToServerPacket& packet) {
 	// create and populate header
     UpdateHeader header;
     header.update_type = CLIENT_TO_SERVER;
+    header.data_length = sizeof(ClientToServerPacket);
 
 	// serialize header and packet data
     serialize(&header, packet_data);
     serialize(&packet, packet_data + sizeof(UpdateHeader));
 
 	// send packet
-    NetworkServices::sendMessage(ConnectSocket, packet_data, packet_size);
+    sendToServer(packet_data, packet_size);
+}
+
+void ClientNetwork::sendClockSyncRequest(ClockSyncRequest& request) {
+    const unsigned int packet_size = sizeof(UpdateHeader) + sizeof(ClockSyncRequest);
+    char packet_data[packet_size];
+
+    UpdateHeader header;
+    header.update_type = CLOCK_SYNC_REQUEST;
+    header.data_length = sizeof(ClockSyncRequest);
+
+    serialize(&header, packet_data);
+    serialize(&request, packet_data + sizeof(UpdateHeader));
+
+    sendToServer(packet_data, packet_size);
 }
 
 void ClientNetwork::sendActionUpdate()
@@ -72,10 +89,11 @@ void ClientNetwork::sendActionUpdate()
 
     UpdateHeader header;
     header.update_type = ACTION_EVENT;
+    header.data_length = 0;
 
     serialize(&header, packet_data);
 
-	NetworkServices::sendMessage(ConnectSocket, packet_data, packet_size);
+	sendToServer(packet_data, packet_size);
 }
 
 void ClientNetwork::sendInitUpdate()
@@ -86,42 +104,102 @@ void ClientNetwork::sendInitUpdate()
 
     UpdateHeader header;
     header.update_type = INIT_CONNECTION;
+    header.data_length = 0;
 
     serialize(&header, packet_data);
 
-	NetworkServices::sendMessage(ConnectSocket, packet_data, packet_size);
+	sendToServer(packet_data, packet_size);
 }
 
 void ClientNetwork::sendReplaceCounterUpdate(ReplaceCounterUpdate& replace_counter_update)
 {
-    const unsigned int packet_size = sizeof(UpdateHeader) + sizeof(IncreaseCounterUpdate);
+    const unsigned int packet_size = sizeof(UpdateHeader) + sizeof(ReplaceCounterUpdate);
     char packet_data[packet_size];
 
     UpdateHeader header;
     header.update_type = REPLACE_COUNTER;
+    header.data_length = sizeof(ReplaceCounterUpdate);
 
     serialize(&header, packet_data);
     serialize(&replace_counter_update, packet_data + sizeof(UpdateHeader));
 
-    NetworkServices::sendMessage(ConnectSocket, packet_data, packet_size);
+    sendToServer(packet_data, packet_size);
+}
+
+void ClientNetwork::sendToServer(char* packet_data, int packet_size) {
+	UpdateHeader header;
+	deserialize(&header, packet_data);
+	telemetry.recordSent(header.update_type, packet_size);
+
+	if (!outgoingData.empty()) {
+		// still behind from an earlier send, this has to wait its turn
+		outgoingData.insert(outgoingData.end(), packet_data, packet_data + packet_size);
+		flushSends();
+		return;
+	}
+
+	int result = NetworkServices::sendMessage(ConnectSocket, packet_data, packet_size);
+	telemetry.recordSendResult(packet_size, result);
+	if (result == SOCKET_ERROR) {
+		if (!NetworkServices::wouldBlock()) {
+			// already counted as a failed send, the connection is gone so don't keep it
+			return;
+		}
+		result = 0;
+	}
+	// keep whatever didn't fit in the socket's buffer for next frame
+	outgoingData.insert(outgoingData.end(), packet_data + result, packet_data + packet_size);
+}
+
+void ClientNetwork::flushSends() {
+	if (outgoingData.empty()) {
+		return;
+	}
+	int result = NetworkServices::sendMessage(ConnectSocket, outgoingData.data(), outgoingData.size());
+	if (result == SOCKET_ERROR) {
+		if (!NetworkServices::wouldBlock()) {
+			// the connection is gone, nothing queued is ever going to arrive
+			std::printf("flushSends failed with error: %d\n", GETSOCKETERRNO());
+			outgoingData.clear();
+		}
+		return;
+	}
+	outgoingData.erase(outgoingData.begin(), outgoingData.begin() + result);
 }
 
 void ClientNetwork::receiveUpdates() {
-	int data_length = receivePackets(network_data);
+	flushSends();
+	telemetry.update(ConnectSocket);
 
-    if (data_length <= 0)
+	// anything left over from last time is the start of an update that hadn't fully arrived yet
+	unsigned int carried = pendingData.size();
+	std::memcpy(network_data, pendingData.data(), carried);
+	int received = receivePackets(network_data + carried, MAX_PACKET_SIZE - carried);
+
+    if (received <= 0)
     {
         //no data recieved
         return;
     }
+	unsigned int data_length = carried + received;
 
     unsigned int i = 0;
-    while (i < data_length)
+    while (data_length - i >= sizeof(UpdateHeader))
     {
         UpdateHeader update_header;
         deserialize(&update_header, &(network_data[i]));
         unsigned int data_loc = i + sizeof(UpdateHeader);
-        unsigned int update_length = update_type_data_lengths.at(update_header.update_type);
+        unsigned int update_length = update_header.data_length;
+		if (update_length > MAX_PACKET_SIZE - sizeof(UpdateHeader)) {
+			std::cout << "Update of " << update_length << " bytes is bigger than the receive buffer" << std::endl;
+			assert(false);
+		}
+		if (data_length - data_loc < update_length) {
+			// the rest of this update is still on its way
+			break;
+		}
+        telemetry.recordReceived(update_header.update_type, sizeof(UpdateHeader) + update_length);
+		PacketReader reader(&(network_data[data_loc]), update_length);
 
         switch (update_header.update_type) {
 
@@ -135,21 +213,30 @@ void ClientNetwork::receiveUpdates() {
 
 		case LOBBY_TO_CLIENT: {
 			LobbyServerToClientPacket lobbyToClientPacket;
-			deserialize(&lobbyToClientPacket, &(network_data[data_loc]));
+			if (!lobbyToClientPacket.read(reader)) {
+				std::cout << "Malformed lobby update" << std::endl;
+				break;
+			}
 			game->handleLobbySelectionPacket(lobbyToClientPacket);
 
 			break;
 		}
         case SERVER_TO_CLIENT:{
 			ServerToClientPacket updatePacket;
-			deserialize(&updatePacket, &(network_data[data_loc]));
+			if (!updatePacket.read(reader)) {
+				std::cout << "Malformed server update" << std::endl;
+				break;
+			}
 
             game->handleServerActionEvent(updatePacket);
             break;
 		}
 		case BULLETS:{
 			BulletPacket bulletPacket;
-			deserialize(&bulletPacket, &(network_data[data_loc]));
+			if (!bulletPacket.read(reader)) {
+				std::cout << "Malformed bullet update" << std::endl;
+				break;
+			}
 			game->handleBulletPacket(bulletPacket);
 			break;
 		}
@@ -159,6 +246,12 @@ void ClientNetwork::receiveUpdates() {
 			game->handleGameEndPacket(gameEndPacket);
 			break;
 		}
+		case CLOCK_SYNC_REPLY:{
+			ClockSyncReply clockSyncReply;
+			deserialize(&clockSyncReply, &(network_data[data_loc]));
+			game->handleClockSyncReply(clockSyncReply);
+			break;
+		}
         default:{
             std::cout << "Error in packet types" << std::endl;
             // This should never happen, so assert false so we find out if it does
@@ -167,6 +260,7 @@ void ClientNetwork::receiveUpdates() {
         }
         i += sizeof(UpdateHeader) + update_length;
     }
+	pendingData.assign(network_data + i, network_data + data_length);
 }
 
 void exitNetworkFailure() {
@@ -174,7 +268,7 @@ void exitNetworkFailure() {
 	std::printf("client running while not connected to server\n");
 }
 
-ClientNetwork::ClientNetwork(ClientGame* _game) {
+ClientNetwork::ClientNetwork(ClientNetworkListener* _game) {
 
 	game=_game;
 
@@ -205,8 +299,8 @@ ClientNetwork::ClientNetwork(ClientGame* _game) {
 	hints.ai_socktype = SOCK_STREAM;
 	hints.ai_protocol = IPPROTO_TCP;  // TCP connection!!!
 
-	//resolve server address and port
-	iResult = getaddrinfo((SetupParser::getValue("server-ip")).c_str(), SetupParser::getValue("server-port").c_str(), &hints, &result);
+	//resolve server address and port (client-connect-port is normally the server port, or netem-proxy-port to go through the proxy)
+	iResult = getaddrinfo((SetupParser::getValue("server-ip")).c_str(), SetupParser::getValue("client-connect-port").c_str(), &hints, &result);
 	std::cout << "Sending to " << SetupParser::getValue("server-ip") << std::endl;
 
 	if (iResult != 0)
@@ -224,7 +318,7 @@ ClientNetwork::ClientNetwork(ClientGame* _game) {
 			ptr->ai_protocol);
 
         if (ISINVALIDSOCKET(ConnectSocket)) {
-			std::printf("socket failed with error: %ld\n", GETSOCKETERRNO());
+			std::printf("socket failed with error: %d\n", GETSOCKETERRNO());
 			WSACLEANUP();
 			exitNetworkFailure();
 		}
@@ -256,13 +350,7 @@ ClientNetwork::ClientNetwork(ClientGame* _game) {
 	}
 
 	// Set the mode of the socket to be nonblocking
-	u_long iMode = 1;
-
-	#if defined(_WIN32)
-	iResult = ioctlsocket(ConnectSocket, FIONBIO, &iMode);
-	#else
-	iResult = fcntl(ConnectSocket, O_NONBLOCK, O_NONBLOCK);
-	#endif
+	iResult = NetworkServices::setNonBlocking(ConnectSocket);
 
 	if (iResult == SOCKET_ERROR)
 	{
@@ -273,14 +361,14 @@ ClientNetwork::ClientNetwork(ClientGame* _game) {
 	}
 
 	//disable nagle
-	char value = 1;
-	setsockopt(ConnectSocket, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+	int value = 1;
+	setsockopt(ConnectSocket, IPPROTO_TCP, TCP_NODELAY, (char*)&value, sizeof(value));
 
 }
 
-int ClientNetwork::receivePackets(char* recvbuf)
+int ClientNetwork::receivePackets(char* recvbuf, int bufSize)
 {
-	iResult = NetworkServices::receiveMessage(ConnectSocket, recvbuf, MAX_PACKET_SIZE);
+	iResult = NetworkServices::receiveMessage(ConnectSocket, recvbuf, bufSize);
 
 	if (iResult == 0)
 	{
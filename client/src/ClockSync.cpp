@@ -0,0 +1,79 @@
+#include "ClockSync.h"
+
+#include <cmath>
+#include <algorithm>
+
+bool ClockSync::shouldSendRequest(double nowMs) const {
+    double interval = samples.size() < CLOCK_SYNC_WINDOW ? CLOCK_SYNC_FAST_INTERVAL_MS : CLOCK_SYNC_INTERVAL_MS;
+    return nowMs - lastRequestMs >= interval;
+}
+
+ClockSyncRequest ClockSync::makeRequest(double nowMs) {
+    lastRequestMs = nowMs;
+    ClockSyncRequest request;
+    request.clientSendMs = nowMs;
+    request.roundTripMs = (float)roundTripMs;
+    request.roundTripJitterMs = (float)roundTripJitterMs;
+    return request;
+}
+
+/**
+ * Standard NTP math on one round trip, then keep the sample with the fastest round trip
+ * out of the last few. A fast round trip can't have been delayed much in either direction,
+ * so its offset is the most trustworthy
+ */
+void ClockSync::addReply(const ClockSyncReply& reply, double nowMs) {
+    double roundTrip = (nowMs - reply.clientSendMs) - (reply.serverSendMs - reply.serverReceiveMs);
+    double offset = ((reply.serverReceiveMs - reply.clientSendMs) + (reply.serverSendMs - nowMs)) / 2;
+    if (roundTrip < 0) {
+        return;
+    }
+
+    if (samples.empty()) {
+        roundTripMs = roundTrip;
+        roundTripJitterMs = 0;
+    } else {
+        roundTripJitterMs += (std::abs(roundTrip - roundTripMs) - roundTripJitterMs) * 0.25;
+        roundTripMs += (roundTrip - roundTripMs) * 0.25;
+    }
+
+    samples.push_back({ nowMs, roundTrip, offset });
+    if (samples.size() > CLOCK_SYNC_WINDOW) {
+        samples.pop_front();
+    }
+
+    const ClockSample& best = *std::min_element(samples.begin(), samples.end(),
+        [](const ClockSample& a, const ClockSample& b) { return a.roundTripMs < b.roundTripMs; });
+    offsetMs = best.offsetMs;
+    offsetLocalMs = best.localMs;
+
+    // Drift is the slope of the offset over a long stretch of time, short stretches are all noise
+    if (!hasDriftReference) {
+        hasDriftReference = true;
+        driftReferenceOffsetMs = offsetMs;
+        driftReferenceLocalMs = offsetLocalMs;
+        return;
+    }
+    double span = offsetLocalMs - driftReferenceLocalMs;
+    if (span >= CLOCK_DRIFT_MIN_SPAN_MS) {
+        double measured = std::clamp((offsetMs - driftReferenceOffsetMs) / span, -CLOCK_MAX_DRIFT, CLOCK_MAX_DRIFT);
+        drift += (measured - drift) * 0.25;
+        driftReferenceOffsetMs = offsetMs;
+        driftReferenceLocalMs = offsetLocalMs;
+    }
+}
+
+void ClockSync::addTickStamp(unsigned int serverTick, double serverTimeMs) {
+    hasTickStamp = true;
+    stampTick = serverTick;
+    stampServerMs = serverTimeMs;
+}
+
+double ClockSync::serverTimeMs(double localMs) const {
+    return localMs + offsetMs + drift * (localMs - offsetLocalMs);
+}
+
+double ClockSync::serverTickAt(double localMs) const {
+    // The server runs its ticks on a fixed schedule, so ticks after the stamped one are exactly SERVER_TICK_MS apart
+    return stampTick + (serverTimeMs(localMs) - stampServerMs) / SERVER_TICK_MS;
+}
@@ -0,0 +1,160 @@
+#include "SnapshotInterpolator.h"
+
+#include <cmath>
+#include <algorithm>
+#include <glm/gtc/quaternion.hpp>
+
+SnapshotInterpolator::SnapshotInterpolator(unsigned int numEntities) {
+    histories.resize(numEntities);
+}
+
+/**
+ * Record every entity's state from a server snapshot. Entities the server added since the last
+ * snapshot (new projectiles) start their history here
+ * @param serverTick Tick the server stamped the snapshot with
+ */
+void SnapshotInterpolator::addSnapshot(unsigned int serverTick, const std::vector<MovementEntitySnapshot>& entities) {
+    // TCP keeps things in order, but the server restarting its tick count would confuse everything
+    if (hasSnapshots && serverTick <= newestTick) {
+        if (newestTick - serverTick < SNAPSHOT_HISTORY_LENGTH) {
+            return;
+        }
+        for (std::deque<EntitySnapshot>& history : histories) {
+            history.clear();
+        }
+        hasArrivals = false;
+    }
+    newestTick = serverTick;
+    hasSnapshots = true;
+
+    if (entities.size() > histories.size()) {
+        histories.resize(entities.size());
+    }
+    for (unsigned int i = 0; i < entities.size(); i++) {
+        histories[i].push_back({ serverTick, entities[i].position, entities[i].yaw, entities[i].pitch });
+        if (histories[i].size() > SNAPSHOT_HISTORY_LENGTH) {
+            histories[i].pop_front();
+        }
+    }
+}
+
+/**
+ * Track how long snapshots take to get here, which decides how far in the past we render
+ * @param arrivalServerTick (fractional) server tick the snapshot for serverTick arrived at
+ */
+void SnapshotInterpolator::addArrival(unsigned int serverTick, double arrivalServerTick) {
+    // Early packets pull the estimate down quickly, late ones only slowly, since late is usually just jitter
+    double sampleDelayMs = (arrivalServerTick - serverTick) * SERVER_TICK_MS;
+    if (!hasArrivals) {
+        arrivalDelayMs = sampleDelayMs;
+        arrivalJitterMs = 0;
+        hasArrivals = true;
+        return;
+    }
+    double error = sampleDelayMs - arrivalDelayMs;
+    arrivalDelayMs += error * (error < 0 ? 0.5 : 0.02);
+    arrivalJitterMs += (std::abs(error) - arrivalJitterMs) * 0.1;
+}
+
+/**
+ * Figure out which (fractional) server tick to render right now. We render one tick plus
+ * a couple of jitter deviations behind the newest snapshot we'd expect to have, so there's
+ * almost always a newer snapshot to blend towards
+ */
+double SnapshotInterpolator::renderTick(double nowServerTick) {
+    double targetDelayMs = std::clamp(SERVER_TICK_MS + 2.0 * arrivalJitterMs, (double)MIN_INTERPOLATION_DELAY_MS, MAX_INTERPOLATION_DELAY_MS);
+    // Ease into the new delay so the rendered time never visibly jumps
+    interpolationDelayMs += (targetDelayMs - interpolationDelayMs) * 0.05;
+
+    return nowServerTick - (arrivalDelayMs + interpolationDelayMs) / SERVER_TICK_MS;
+}
+
+/**
+ * Tangent (units per tick) of the entity's path at history[i], for hermite interpolation
+ */
+glm::vec3 SnapshotInterpolator::tangentAt(const std::deque<EntitySnapshot>& history, size_t i) const {
+    size_t prev = i > 0 ? i - 1 : i;
+    size_t next = i + 1 < history.size() ? i + 1 : i;
+    if (prev == next) {
+        return glm::vec3(0);
+    }
+    glm::vec3 delta = history[next].position - history[prev].position;
+    // A teleport somewhere around here, pretend we were standing still
+    if (glm::length(delta) > SNAPSHOT_TELEPORT_DISTANCE * (next - prev)) {
+        return glm::vec3(0);
+    }
+    return delta / (float)(history[next].serverTick - history[prev].serverTick);
+}
+
+bool SnapshotInterpolator::sample(unsigned int entity, double tick, glm::vec3& position, float& yaw, float& pitch) const {
+    if (entity >= histories.size()) {
+        return false;
+    }
+    const std::deque<EntitySnapshot>& history = histories[entity];
+    if (history.empty()) {
+        return false;
+    }
+
+    const EntitySnapshot& newest = history.back();
+    if (tick >= newest.serverTick) {
+        // Packets are late, keep going in the direction we were going for a little while then stop
+        double aheadTicks = std::min(tick - newest.serverTick, MAX_EXTRAPOLATION_MS / SERVER_TICK_MS);
+        position = newest.position + tangentAt(history, history.size() - 1) * (float)aheadTicks;
+        yaw = newest.yaw;
+        pitch = newest.pitch;
+        return true;
+    }
+
+    if (tick <= history.front().serverTick) {
+        position = history.front().position;
+        yaw = history.front().yaw;
+        pitch = history.front().pitch;
+        return true;
+    }
+
+    // Find the two snapshots around the tick we want
+    size_t b = history.size() - 1;
+    while (b > 0 && history[b - 1].serverTick > tick) {
+        b--;
+    }
+    size_t a = b - 1;
+    const EntitySnapshot& from = history[a];
+    const EntitySnapshot& to = history[b];
+
+    float span = (float)(to.serverTick - from.serverTick);
+    float t = (float)((tick - from.serverTick) / span);
+
+    if (glm::length(to.position - from.position) > SNAPSHOT_TELEPORT_DISTANCE * span) {
+        // Don't draw something flying across the map, just show where it ended up
+        position = to.position;
+        yaw = to.yaw;
+        pitch = to.pitch;
+        return true;
+    }
+
+    // Cubic hermite with tangents scaled to the length of this segment
+    glm::vec3 m0 = tangentAt(history, a) * span;
+    glm::vec3 m1 = tangentAt(history, b) * span;
+    float t2 = t * t;
+    float t3 = t2 * t;
+    position = (2 * t3 - 3 * t2 + 1) * from.position + (t3 - 2 * t2 + t) * m0
+             + (-2 * t3 + 3 * t2) * to.position + (t3 - t2) * m1;
+    yaw = slerpYaw(from.yaw, to.yaw, t);
+    pitch = glm::mix(from.pitch, to.pitch, t);
+    return true;
+}
+
+/**
+ * Spherical interpolation between two headings (in degrees), always going the short way around
+ */
+float slerpYaw(float fromDegrees, float toDegrees, float t) {
+    glm::quat from = glm::angleAxis(glm::radians(fromDegrees), glm::vec3(0, 1, 0));
+    glm::quat to = glm::angleAxis(glm::radians(toDegrees), glm::vec3(0, 1, 0));
+    glm::quat result = glm::slerp(from, to, t);
+    float angle = glm::degrees(glm::angle(result));
+    // angle() is always positive, the axis tells us which way we rotated
+    if (glm::axis(result).y < 0) {
+        angle = -angle;
+    }
+    return angle;
+}
@@ -0,0 +1,86 @@
+#include "sge/BonePalette.h"
+
+#include <algorithm>
+
+sge::BonePalette sge::bonePalette;
+
+/**
+ * PRECONDITION: OpenGL context already created/initialized
+ * Create the palette's buffer and leave its texture bound to BONE_PALETTE_TEXTURE for the rest of the game
+ */
+void sge::BonePalette::initPalette() {
+    // Room for a few characters to start with, it grows if a frame needs more
+    capacity = 8 * MAX_BONES;
+    glGenBuffers(1, &TBO);
+    glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+    glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glGenTextures(1, &texture);
+    glState.activeTexture(GL_TEXTURE0 + BONE_PALETTE_TEXTURE);
+    glState.bindTexture(GL_TEXTURE_BUFFER, texture);
+    // Every bone is 4 texels, one per column of its matrix
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, TBO);
+    glState.activeTexture(GL_TEXTURE0);
+}
+
+/**
+ * Delete the palette's buffer and texture
+ */
+void sge::BonePalette::deletePalette() {
+    glState.deleteTextures(1, &texture);
+    glDeleteBuffers(1, &TBO);
+}
+
+/**
+ * Add a pose to this frame's palette. A pose that's already been added (e.g. by the shadow pass) isn't copied again
+ * @param pose Pose to add, must not change until the frame's drawn
+ * @return Index of the pose's first bone in the palette, for the shader's boneOffset
+ */
+unsigned int sge::BonePalette::add(const ModelPose &pose) {
+    auto existing = offsets.find(&pose);
+    if (existing != offsets.end()) {
+        return existing->second;
+    }
+    unsigned int offset = bones.size();
+    bones.insert(bones.end(), pose.begin(), pose.end());
+    offsets[&pose] = offset;
+    return offset;
+}
+
+/**
+ * Upload the bones added since the last upload. The first upload of a frame gives the buffer fresh storage, so it
+ * never has to wait on last frame's draws that are still reading the old bones
+ */
+void sge::BonePalette::upload() {
+    if (uploaded == bones.size()) {
+        return;
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+    if (bones.size() > capacity || uploaded == 0) {
+        // Storage is replaced either way, so everything added this frame goes in this write
+        if (bones.size() > capacity) {
+            capacity = std::max(capacity * 2, bones.size());
+        }
+        glBufferData(GL_TEXTURE_BUFFER, capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+        uploaded = 0;
+    }
+    glBufferSubData(GL_TEXTURE_BUFFER, uploaded * sizeof(glm::mat4), (bones.size() - uploaded) * sizeof(glm::mat4),
+                    &bones[uploaded]);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    uploaded = bones.size();
+}
+
+void sge::BonePalette::clear() {
+    bones.clear();
+    offsets.clear();
+    uploaded = 0;
+}
+
+unsigned int sge::BonePalette::numPoses() const {
+    return offsets.size();
+}
+
+unsigned int sge::BonePalette::numBones() const {
+    return bones.size();
+}
@@ -0,0 +1,102 @@
+#include "sge/DynamicResolution.h"
+
+#include <algorithm>
+#include <string>
+
+#include "SetupParser.h"
+
+sge::DynamicResolution sge::dynamicResolution;
+
+/**
+ * PRECONDITION: OpenGL context already created/initialized
+ * Create the GPU timer queries and read the frame time budget from setup.json
+ */
+void sge::DynamicResolution::initTimers() {
+    glGenQueries(RENDER_TIMER_QUERIES, queries);
+    budgetMs = std::stod(SetupParser::getValue("target_frame_time_ms"));
+    enabled = std::stoi(SetupParser::getValue("dynamic_resolution")) != 0;
+}
+
+void sge::DynamicResolution::deleteTimers() {
+    if (timing) {
+        glEndQuery(GL_TIME_ELAPSED);
+        timing = false;
+    }
+    glDeleteQueries(RENDER_TIMER_QUERIES, queries);
+}
+
+void sge::DynamicResolution::beginFrame() {
+    cpuStart = std::chrono::steady_clock::now();
+    // The query about to be reused was issued RENDER_TIMER_QUERIES frames ago, it's usually done by now
+    if (pending[nextQuery]) {
+        GLint available = 0;
+        glGetQueryObjectiv(queries[nextQuery], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            // GPU is even further behind than that, skip timing this frame rather than wait on it
+            return;
+        }
+        GLuint64 elapsedNs;
+        glGetQueryObjectui64v(queries[nextQuery], GL_QUERY_RESULT, &elapsedNs);
+        gpuTotalMs += elapsedNs / 1e6;
+        gpuSamples++;
+        pending[nextQuery] = false;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, queries[nextQuery]);
+    timing = true;
+}
+
+void sge::DynamicResolution::endFrame() {
+    if (timing) {
+        glEndQuery(GL_TIME_ELAPSED);
+        pending[nextQuery] = true;
+        nextQuery = (nextQuery + 1) % RENDER_TIMER_QUERIES;
+        timing = false;
+    }
+    // Stops before swapping buffers, so waiting for vsync doesn't count
+    cpuTotalMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
+    frames++;
+    if (frames >= RENDER_SCALE_INTERVAL && gpuSamples > 0) {
+        adjustScale();
+    }
+}
+
+/**
+ * Move the scale a step towards holding the budget, based on the frames since the last adjustment
+ */
+void sge::DynamicResolution::adjustScale() {
+    gpuMs = gpuTotalMs / gpuSamples;
+    cpuMs = cpuTotalMs / frames;
+    frames = 0;
+    gpuSamples = 0;
+    gpuTotalMs = 0;
+    cpuTotalMs = 0;
+    if (!enabled) {
+        return;
+    }
+    if (gpuMs > budgetMs && gpuMs >= cpuMs) {
+        // Fewer pixels only helps if it's the GPU we're waiting on
+        scale = std::max(RENDER_SCALE_MIN, scale - RENDER_SCALE_STEP);
+        return;
+    }
+    // Only go up if the frame would still fit with the extra pixels (assuming the GPU's time goes with the pixel
+    // count, which overestimates it), otherwise it'd just come back down next time
+    float larger = std::min(RENDER_SCALE_MAX, scale + RENDER_SCALE_STEP);
+    if (gpuMs * (larger * larger) / (scale * scale) < budgetMs * RENDER_SCALE_HEADROOM) {
+        scale = larger;
+    }
+}
+
+float sge::DynamicResolution::getScale() const {
+    return scale;
+}
+
+void sge::DynamicResolution::setEnabled(bool enable) {
+    enabled = enable;
+    if (!enabled) {
+        scale = RENDER_SCALE_MAX;
+    }
+}
+
+bool sge::DynamicResolution::isEnabled() const {
+    return enabled;
+}
@@ -1,4 +1,5 @@
 #include "sge/FontLoader.h"
+#include "sge/GLStateCache.h"
 
 namespace sge {
 
@@ -39,7 +40,7 @@ namespace sge {
             // generate texture
             unsigned int texture;
             glGenTextures(1, &texture);
-            glBindTexture(GL_TEXTURE_2D, texture);
+            glState.bindTexture(GL_TEXTURE_2D, texture);
             glTexImage2D(
                 GL_TEXTURE_2D,
                 0,
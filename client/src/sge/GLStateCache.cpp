@@ -0,0 +1,260 @@
+#include "sge/GLStateCache.h"
+
+#include <cstring>
+
+sge::GLStateCache sge::glState;
+
+static uint64_t pairKey(uint32_t a, uint32_t b) {
+    return ((uint64_t)a << 32) | b;
+}
+
+/**
+ * Count a call
+ * @param isChanged Whether the call would change anything
+ * @return isChanged, so callers can write if (changed(...)) glWhatever(...)
+ */
+bool sge::GLStateCache::changed(bool isChanged) {
+    if (isChanged) {
+        stats.issued++;
+    } else {
+        stats.skipped++;
+    }
+    return isChanged;
+}
+
+void sge::GLStateCache::useProgram(GLuint newProgram) {
+    if (changed(newProgram != program)) {
+        glUseProgram(newProgram);
+        program = newProgram;
+    }
+}
+
+void sge::GLStateCache::bindVertexArray(GLuint array) {
+    if (changed(array != vertexArray)) {
+        glBindVertexArray(array);
+        vertexArray = array;
+    }
+}
+
+/**
+ * Unlike the other calls this one always goes through when the unit changes, even if nothing gets bound to it after,
+ * since code that creates textures expects glTexImage2D and friends to land on the active unit's texture
+ */
+void sge::GLStateCache::activeTexture(GLenum unit) {
+    if (changed(unit != textureUnit)) {
+        glActiveTexture(unit);
+        textureUnit = unit;
+    }
+}
+
+void sge::GLStateCache::bindTexture(GLenum target, GLuint texture) {
+    // Without knowing the active unit there's nothing to compare against
+    if (textureUnit == UNKNOWN) {
+        changed(true);
+        glBindTexture(target, texture);
+        return;
+    }
+    auto bound = textures.find(pairKey(textureUnit, target));
+    if (changed(bound == textures.end() || bound->second != texture)) {
+        glBindTexture(target, texture);
+        textures[pairKey(textureUnit, target)] = texture;
+    }
+}
+
+void sge::GLStateCache::setCapability(GLenum cap, bool enabled) {
+    auto current = capabilities.find(cap);
+    bool isChanged = current == capabilities.end() || current->second != enabled;
+    // glEnable/glDisable also sets every index glEnablei/glDisablei set separately
+    for (auto it = indexedCapabilities.begin(); it != indexedCapabilities.end();) {
+        if ((GLenum)(it->first >> 32) == cap) {
+            isChanged = isChanged || it->second != enabled;
+            it = indexedCapabilities.erase(it);
+        } else {
+            it++;
+        }
+    }
+    if (changed(isChanged)) {
+        if (enabled) {
+            glEnable(cap);
+        } else {
+            glDisable(cap);
+        }
+        capabilities[cap] = enabled;
+    }
+}
+
+void sge::GLStateCache::setCapabilityIndexed(GLenum cap, GLuint index, bool enabled) {
+    bool isChanged;
+    auto current = indexedCapabilities.find(pairKey(cap, index));
+    if (current != indexedCapabilities.end()) {
+        isChanged = current->second != enabled;
+    } else {
+        // Set for every index by glEnable/glDisable, or not known at all
+        auto whole = capabilities.find(cap);
+        isChanged = whole == capabilities.end() || whole->second != enabled;
+    }
+    if (changed(isChanged)) {
+        if (enabled) {
+            glEnablei(cap, index);
+        } else {
+            glDisablei(cap, index);
+        }
+        indexedCapabilities[pairKey(cap, index)] = enabled;
+    }
+}
+
+void sge::GLStateCache::enable(GLenum cap) {
+    setCapability(cap, true);
+}
+
+void sge::GLStateCache::disable(GLenum cap) {
+    setCapability(cap, false);
+}
+
+void sge::GLStateCache::enablei(GLenum cap, GLuint index) {
+    setCapabilityIndexed(cap, index, true);
+}
+
+void sge::GLStateCache::disablei(GLenum cap, GLuint index) {
+    setCapabilityIndexed(cap, index, false);
+}
+
+void sge::GLStateCache::blendFunc(GLenum sfactor, GLenum dfactor) {
+    if (changed(sfactor != blendSource || dfactor != blendDestination)) {
+        glBlendFunc(sfactor, dfactor);
+        blendSource = sfactor;
+        blendDestination = dfactor;
+    }
+}
+
+void sge::GLStateCache::depthFunc(GLenum func) {
+    if (changed(func != depthFunction)) {
+        glDepthFunc(func);
+        depthFunction = func;
+    }
+}
+
+void sge::GLStateCache::depthMask(GLboolean flag) {
+    if (changed((int)flag != depthWrites)) {
+        glDepthMask(flag);
+        depthWrites = flag;
+    }
+}
+
+void sge::GLStateCache::cullFace(GLenum mode) {
+    if (changed(mode != culledFace)) {
+        glCullFace(mode);
+        culledFace = mode;
+    }
+}
+
+/**
+ * Whether a uniform's new value is different from the one it already has
+ * @param location Uniform location in the current program
+ * @param value New value
+ * @param size Size of the new value in bytes
+ */
+bool sge::GLStateCache::uniformChanged(GLint location, const void *value, size_t size) {
+    // Can't tell which program the uniform belongs to
+    if (program == UNKNOWN) {
+        return changed(true);
+    }
+    std::vector<unsigned char> &current = uniforms[pairKey(program, location)];
+    if (current.size() == size && std::memcmp(current.data(), value, size) == 0) {
+        return changed(false);
+    }
+    current.assign((const unsigned char *)value, (const unsigned char *)value + size);
+    return changed(true);
+}
+
+// Location -1 means the uniform isn't in the program (usually the compiler optimized it out), OpenGL ignores those
+
+void sge::GLStateCache::uniform1i(GLint location, GLint v0) {
+    if (location != -1 && uniformChanged(location, &v0, sizeof(v0))) {
+        glUniform1i(location, v0);
+    }
+}
+
+void sge::GLStateCache::uniform1f(GLint location, GLfloat v0) {
+    if (location != -1 && uniformChanged(location, &v0, sizeof(v0))) {
+        glUniform1f(location, v0);
+    }
+}
+
+void sge::GLStateCache::uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) {
+    GLfloat value[3] = {v0, v1, v2};
+    if (location != -1 && uniformChanged(location, value, sizeof(value))) {
+        glUniform3f(location, v0, v1, v2);
+    }
+}
+
+void sge::GLStateCache::uniform2fv(GLint location, GLsizei count, const GLfloat *value) {
+    if (location != -1 && uniformChanged(location, value, sizeof(GLfloat) * 2 * count)) {
+        glUniform2fv(location, count, value);
+    }
+}
+
+void sge::GLStateCache::uniform3fv(GLint location, GLsizei count, const GLfloat *value) {
+    if (location != -1 && uniformChanged(location, value, sizeof(GLfloat) * 3 * count)) {
+        glUniform3fv(location, count, value);
+    }
+}
+
+void sge::GLStateCache::uniform4fv(GLint location, GLsizei count, const GLfloat *value) {
+    if (location != -1 && uniformChanged(location, value, sizeof(GLfloat) * 4 * count)) {
+        glUniform4fv(location, count, value);
+    }
+}
+
+void sge::GLStateCache::uniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
+    // sge never transposes, so the values are all the cache has to compare
+    if (location != -1 && uniformChanged(location, value, sizeof(GLfloat) * 9 * count)) {
+        glUniformMatrix3fv(location, count, transpose, value);
+    }
+}
+
+void sge::GLStateCache::uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
+    if (location != -1 && uniformChanged(location, value, sizeof(GLfloat) * 16 * count)) {
+        glUniformMatrix4fv(location, count, transpose, value);
+    }
+}
+
+void sge::GLStateCache::deleteTextures(GLsizei n, const GLuint *deleted) {
+    for (GLsizei i = 0; i < n; i++) {
+        for (auto &binding : textures) {
+            if (binding.second == deleted[i]) {
+                binding.second = 0;
+            }
+        }
+    }
+    glDeleteTextures(n, deleted);
+}
+
+void sge::GLStateCache::deleteVertexArrays(GLsizei n, const GLuint *arrays) {
+    for (GLsizei i = 0; i < n; i++) {
+        if (arrays[i] == vertexArray) {
+            vertexArray = 0;
+        }
+    }
+    glDeleteVertexArrays(n, arrays);
+}
+
+void sge::GLStateCache::invalidate() {
+    program = UNKNOWN;
+    vertexArray = UNKNOWN;
+    textureUnit = UNKNOWN;
+    textures.clear();
+    capabilities.clear();
+    indexedCapabilities.clear();
+    blendSource = UNKNOWN;
+    blendDestination = UNKNOWN;
+    depthFunction = UNKNOWN;
+    depthWrites = -1;
+    culledFace = UNKNOWN;
+    uniforms.clear();
+}
+
+void sge::GLStateCache::endFrame() {
+    lastFrameStats = stats;
+    stats = GLStateStats();
+}
@@ -55,16 +55,23 @@ sge::ModelEntityState::ModelEntityState(size_t modelIndex, glm::vec3 position, f
 
 /**
  * PRECONDITION: models have already been loaded
- * Draws the entity on the screen
+ * Queues the entity to be drawn on the screen, see RenderQueue
  */
 void sge::ModelEntityState::draw() const {
-    // Use default shader to set uniforms
-    defaultProgram.useShader();
-    glUniform1i(defaultProgram.entityAlternateTextures, alternateTextures);
-    glUniform1i(defaultProgram.textureIdx, textureIdx);
-    glUniform1i(defaultProgram.entitySeasons, seasons);
     // TODO: add support for server-side roll? Maybe add pitch too here
-    models[modelIndex]->render(position, yaw, false, drawOutline);
+    models[modelIndex]->submit(MAIN_PASS, position, yaw, drawInstance());
+}
+
+/**
+ * Settings the entity draws its model with, everything but where it is
+ */
+sge::DrawInstance sge::ModelEntityState::drawInstance() const {
+    DrawInstance instance;
+    instance.outline = drawOutline;
+    instance.alternateTextures = alternateTextures;
+    instance.textureIdx = textureIdx;
+    instance.seasons = seasons;
+    return instance;
 }
 
 /**
@@ -74,11 +81,19 @@ void sge::ModelEntityState::update() {}
 
 /**
  * PRECONDITION: models have already been loaded
- * Draws the entity to the shadowmap
+ * Queues the entity to be drawn to the shadowmap
  */
 void sge::ModelEntityState::drawShadow() const {
     if (!castShadow) return;
-    models[modelIndex]->render(position, yaw, true, true);
+    models[modelIndex]->submit(SHADOW_PASS, position, yaw, DrawInstance());
+}
+
+/**
+ * Environment entities don't move, so their shadows are only drawn when the light moves (see ShadowMap)
+ * @return
+ */
+bool sge::ModelEntityState::hasStaticShadow() const {
+    return true;
 }
 
 /**
@@ -143,19 +158,14 @@ sge::DynamicModelEntityState::DynamicModelEntityState(size_t modelIndex, size_t
 }
 
 /**
- * Draw entity to screen
+ * Queue entity to be drawn to screen
  */
 void sge::DynamicModelEntityState::draw() const {
-    glUniform1i(defaultProgram.entityAlternateTextures, alternateTextures);
-    glUniform1i(defaultProgram.textureIdx, textureIdx);
-    glUniform1i(defaultProgram.entitySeasons, seasons);
+    DrawInstance instance = drawInstance();
     if (models[modelIndex]->isAnimated()) {
-        models[modelIndex]->renderPose(clientGame->positions[positionIndex], clientGame->yaws[positionIndex], currPose,
-                                       false, drawOutline);
-    } else {
-        models[modelIndex]->render(clientGame->positions[positionIndex], clientGame->yaws[positionIndex], false,
-                                   drawOutline);
+        instance.pose = &currPose;
     }
+    models[modelIndex]->submit(MAIN_PASS, clientGame->positions[positionIndex], clientGame->yaws[positionIndex], instance);
 }
 
 /**
@@ -199,16 +209,23 @@ void sge::DynamicModelEntityState::setAnimation(unsigned int animationId) {
 }
 /*
  * PRECONDITION: models have already been loaded
- * Draws the entity to the shadowmap
+ * Queues the entity to be drawn to the shadowmap
  */
 void sge::DynamicModelEntityState::drawShadow() const {
     if (!castShadow) return;
+    DrawInstance instance;
     if (models[modelIndex]->isAnimated()) {
-        models[modelIndex]->renderPose(clientGame->positions[positionIndex], clientGame->yaws[positionIndex], currPose,
-                                       true, true);
-    } else {
-        models[modelIndex]->render(clientGame->positions[positionIndex], clientGame->yaws[positionIndex], true, true);
+        instance.pose = &currPose;
     }
+    models[modelIndex]->submit(SHADOW_PASS, clientGame->positions[positionIndex], clientGame->yaws[positionIndex], instance);
+}
+
+/**
+ * Dynamic entities' shadows are drawn every frame
+ * @return
+ */
+bool sge::DynamicModelEntityState::hasStaticShadow() const {
+    return false;
 }
 
 /**
@@ -3,22 +3,22 @@
 //
 
 #include "sge/GraphicsGeometry.h"
+#include "sge/RenderQueue.h"
 
 #define STB_IMAGE_IMPLEMENTATION // Needed for stb_image.h
 
 #include <stb_image.h>
 
-/**
- * Converts an assimp matrix (row-major) to a GLM matrix (column-major)
- * @param mat
- * @return
- */
-static glm::mat4 assimpToGlmMat4(aiMatrix4x4 mat) {
-    return glm::mat4(mat[0][0], mat[1][0], mat[2][0], mat[3][0],
-                     mat[0][1], mat[1][1], mat[2][1], mat[3][1],
-                     mat[0][2], mat[1][2], mat[2][2], mat[3][2],
-                     mat[0][3], mat[1][3], mat[2][3], mat[3][3]);
-}
+#include <cstddef>
+#include <filesystem>
+
+// Not in every platform's GL headers, the values come from EXT_texture_compression_s3tc
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
 
 /**
  * Shitty graphics engine (SGE)
@@ -29,53 +29,44 @@ namespace sge {
     /**
      * PRECONDITION: OpenGL should already be initialized
      * Create a ModelComposite (A 3d object model composed of mesh(es))
-     * @param filename Path to .obj file specifying ModelComposite
+     * The vertices, indices and textures go to OpenGL and the model lets go of them, so the mapped file (or imported
+     * buffer) is freed once the caller's done with it too. Only the animations stay in main memory
+     * @param filename Path to .obj/.glb file specifying ModelComposite
+     * @param data The model, already loaded from that file by ModelData::load (usually on an asset loader thread)
+     * @param retainCpuData Hold on to data so cpuData() can get at it later, for models that need their geometry on the CPU
      */
-    sge::ModelComposite::ModelComposite(const std::string &filename) {
+    sge::ModelComposite::ModelComposite(const std::string &filename, std::shared_ptr<const ModelData> data, bool retainCpuData) {
         modelFilePath = filename;
-        // Load model
-        parentDirectory = std::filesystem::path(filename).remove_filename();
-        Assimp::Importer importer;
-        const aiScene *scene = importer.ReadFile(filename,
-                                                 ASSIMP_IMPORT_FLAGS);
-        if (scene == nullptr) {
-            std::cerr << "Unable to load 3d model from path " << filename << std::endl;
-            exit(EXIT_FAILURE);
-        }
 
-        animated = scene->HasAnimations();
+        animated = data->header.animated;
+        numBones = data->header.numBones;
 
-        // Allocate space for meshes, vertices, normals, etc.
-        meshes.reserve(scene->mNumMeshes);
-        materials.reserve(scene->mNumMaterials);
-
-        // Allocate space for
-        reserveGeometrySpace(scene);
-
-        // Load meshes into ModelComposite data structures
-        for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
-            loadMesh(*scene->mMeshes[i], i);
+        meshes.reserve(data->header.numMeshes);
+        for (unsigned int i = 0; i < data->header.numMeshes; i++) {
+            const BakedMesh &mesh = data->meshes[i];
+            meshes.push_back(Mesh(mesh.numIndices, mesh.baseVertex, mesh.baseIndex, mesh.materialIndex));
         }
 
         if (animated) {
-            // Loading bones handled by loadMesh (loadMesh does not load bone hierarchy)
-
-            for (unsigned int i = 0; i < scene->mNumAnimations; i++) {
-                animations.push_back(loadAnimation(*scene->mAnimations[i]));
-            }
-            animationGlobalInverse = assimpToGlmMat4(scene->mRootNode->mTransformation.Inverse());
-            // A bit of a hack since glb files are rotated 90 degrees
-            animationGlobalInverse = glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(0, 1, 0)) * animationGlobalInverse;
+            bones.offsetMatrices.assign(data->offsetMatrices, data->offsetMatrices + numBones);
+            loadAnimations(*data);
+            animationGlobalInverse = data->header.animationGlobalInverse;
             // Load bone hierarchy
-            bones.root = buildBoneHierarchy(scene->mRootNode);
+            unsigned int nodeIndex = 0;
+            bones.root = buildBoneHierarchy(*data, nodeIndex);
 
             // By default, use tick 0 of animation 0 for when no animation is happening
             animationWhenStill = 0;
             animationTickWhenStill = 0;
         }
-        loadMaterials(scene);
-        initBuffers();
-        importer.FreeScene();
+        loadMaterials(*data);
+        computeBounds(*data);
+        // Vertices and indices go to OpenGL straight from the mapped file, the model doesn't keep a copy
+        initBuffers(*data);
+
+        if (retainCpuData) {
+            retainedData = data;
+        }
     }
 
     /**
@@ -93,349 +84,233 @@ namespace sge {
      * Modelcomposite destructor - Deletes VAO, VBO, etc. from OpenGL context
      */
     sge::ModelComposite::~ModelComposite() {
-        glDeleteVertexArrays(1, &VAO);
+        glState.deleteVertexArrays(1, &VAO);
         glDeleteBuffers(NUM_BUFFERS, buffers);
     }
 
-    /**
-     * Populate ModelComposite data structures with mesh data
-     * @param mesh Mesh to load
-     */
-    void ModelComposite::loadMesh(aiMesh &mesh, int meshIdx) {
-        assert(mesh.mNormals != nullptr);
-        assert(mesh.mVertices != nullptr);
-        // Add vertices, normals, texture coords, etc. to ModelComposite data structures
-        for (unsigned int i = 0; i < mesh.mNumVertices; i++) {
-            const aiVector3D &vertex = mesh.mVertices[i];
-            vertices.push_back(glm::vec3(vertex[0], vertex[1], vertex[2]));
-            const aiVector3D &normal = mesh.mNormals[i];
-            normals.push_back(glm::vec3(normal[0], normal[1], normal[2]));
-            if (mesh.HasTextureCoords(0)) {
-                //  Third coordinate is always 0 (Because Assimp is dumb), we can ignore it
-                const aiVector3D &texcoord = mesh.mTextureCoords[0][i];
-                texcoords.push_back(glm::vec2(texcoord[0], texcoord[1]));
-            } else {
-                texcoords.push_back(glm::vec2(0));
-            }
-        }
-
-        // Load faces/triangles into indices
-        for (unsigned int i = 0; i < mesh.mNumFaces; i++) {
-            const aiFace &face = mesh.mFaces[i];
-            indices.push_back(face.mIndices[0]);
-            indices.push_back(face.mIndices[1]);
-            indices.push_back(face.mIndices[2]);
-        }
-
-        if (animated) {
-            for (unsigned int i = 0; i < mesh.mNumBones; i++) {
-                loadBone(*mesh.mBones[i], meshIdx);
-            }
-        }
-    }
-
-    /**
-     * Load an individual bone (for the first time)
-     * Bone should not be loaded again or spicy things will happen
-     * @param bone
-     */
-    void ModelComposite::loadBone(aiBone &bone, int meshIdx) {
-        std::string boneName = bone.mName.C_Str();
-        if (!boneMap.count(boneName)) {
-            // Don't load the same bone twice
-            boneMap[boneName] = boneMap.size();
-            bones.offsetMatrices.push_back(assimpToGlmMat4(bone.mOffsetMatrix));
-            numBones++;
-        }
-
-        int boneIdx = boneMap[boneName];
-
-        // Load vertex weights
-        for (unsigned int i = 0; i < bone.mNumWeights; i++) {
-            aiVertexWeight &curweight = bone.mWeights[i];
-            bool weightAdded = false;
-            int offset = (meshes[meshIdx].BaseVertex + curweight.mVertexId) * MAX_BONE_INFLUENCE;
-            if (curweight.mWeight == 0) continue;
-            for (unsigned int j = 0; j < MAX_BONE_INFLUENCE; j++) {
-                if (boneVertexWeights.indices[offset + j] < 0) {
-                    // not the entire modelcomposite object (blame assimp)
-                    boneVertexWeights.weights[offset + j] = curweight.mWeight;
-                    boneVertexWeights.indices[offset + j] = boneIdx;
-                    weightAdded = true;
-                    break;
-                }
-            }
-            if (!weightAdded) {
-                std::cout << "Warning: Exceeded maximum number of bones per vertex, ignoring remaining weights" << std::endl;
-            }
-        }
-    }
-
     /**
      * Initialize OpenGL buffers for ModelComposite
+     * @param data Model to upload, its vertices are already interleaved the way the vertex buffer wants them
      */
-    void ModelComposite::initBuffers() {
+    void ModelComposite::initBuffers(const ModelData &data) {
         glGenVertexArrays(1, &VAO);
 
-        glBindVertexArray(VAO);
+        glState.bindVertexArray(VAO);
 
         glGenBuffers(NUM_BUFFERS, buffers);
 
         glBindBuffer(GL_ARRAY_BUFFER, buffers[VERTEX_BUF]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(ModelVertex) * data.header.numVertices, data.vertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(VERTEX_POS);
-        glVertexAttribPointer(VERTEX_POS, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-        glBindBuffer(GL_ARRAY_BUFFER, buffers[NORMAL_BUF]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(normals[0]) * normals.size(), &normals[0], GL_STATIC_DRAW);
+        glVertexAttribPointer(VERTEX_POS, 3, GL_FLOAT, GL_FALSE, sizeof(ModelVertex), (void*)offsetof(ModelVertex, position));
         glEnableVertexAttribArray(NORMAL_POS);
-        glVertexAttribPointer(NORMAL_POS, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-        glBindBuffer(GL_ARRAY_BUFFER, buffers[TEXCOORD_BUF]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(texcoords[0]) * texcoords.size(), &texcoords[0], GL_STATIC_DRAW);
+        glVertexAttribPointer(NORMAL_POS, 3, GL_FLOAT, GL_FALSE, sizeof(ModelVertex), (void*)offsetof(ModelVertex, normal));
         glEnableVertexAttribArray(TEXCOORD_POS);
-        glVertexAttribPointer(TEXCOORD_POS, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+        glVertexAttribPointer(TEXCOORD_POS, 2, GL_FLOAT, GL_FALSE, sizeof(ModelVertex), (void*)offsetof(ModelVertex, texcoord));
 
         // Create VAO stuff for animation-related vertex properties
         if (animated) {
-            glBindBuffer(GL_ARRAY_BUFFER, buffers[BONE_IDX]);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(boneVertexWeights.indices[0]) * boneVertexWeights.indices.size(), &boneVertexWeights.indices[0], GL_STATIC_DRAW);
             glEnableVertexAttribArray(BONEIDX_POS);
-            glVertexAttribIPointer(BONEIDX_POS, MAX_BONE_INFLUENCE, GL_INT,  0, nullptr);
-
-            glBindBuffer(GL_ARRAY_BUFFER, buffers[BONE_WEIGHT]);
-            glBufferData(GL_ARRAY_BUFFER, sizeof(boneVertexWeights.weights[0]) * boneVertexWeights.weights.size(), &boneVertexWeights.weights[0], GL_STATIC_DRAW);
+            glVertexAttribIPointer(BONEIDX_POS, MAX_BONE_INFLUENCE, GL_INT, sizeof(ModelVertex), (void*)offsetof(ModelVertex, boneIds));
             glEnableVertexAttribArray(BONEWEIGHT_POS);
-            glVertexAttribPointer(BONEWEIGHT_POS, MAX_BONE_INFLUENCE, GL_FLOAT, GL_FALSE, 0, nullptr);
+            glVertexAttribPointer(BONEWEIGHT_POS, MAX_BONE_INFLUENCE, GL_FLOAT, GL_FALSE, sizeof(ModelVertex), (void*)offsetof(ModelVertex, boneWeights));
+        }
+
+        // Per-instance model matrix and flags come from the render queue's instance buffer, which points them at
+        // each draw's instances right before drawing (see RenderQueue::pointInstanceAttributes)
+        for (int i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(INSTANCE_MODEL_POS + i);
+            glVertexAttribDivisor(INSTANCE_MODEL_POS + i, 1);
         }
+        glEnableVertexAttribArray(INSTANCE_FLAGS_POS);
+        glVertexAttribDivisor(INSTANCE_FLAGS_POS, 1);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[INDEX_BUF]);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * data.header.numIndices, data.indices, GL_STATIC_DRAW);
+        bufferBytes = sizeof(ModelVertex) * data.header.numVertices + sizeof(uint32_t) * data.header.numIndices;
 
         glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        glState.bindVertexArray(0);
     }
 
     /**
-     * Allocate enough space for all vertices, normals, texture coordinates, etc for ModelComposite
-     * and add individual meshes to "meshes" vector
-     *
-     * This function only exists to avoid having our vectors continually reallocate space
-     * when loading larger models
-     *
-     * PRECONDITION: this->animated has already been set
+     * Work out each mesh's bounding box (and the whole model's) for frustum culling.
+     * Animated models are posed through every animation, so their boxes hold the model wherever the animation moves it
+     * @param data Model to get the vertices from
      */
-    void ModelComposite::reserveGeometrySpace(const aiScene *scene) {
-        assert(scene != nullptr);
-        unsigned int num_vertex = 0;
-        unsigned int num_indices = 0;
-        unsigned int num_bones = 0;
-        for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
-            const aiMesh &mesh = *scene->mMeshes[i];
-            // NumIndices = 3 * NumFaces as each face is a triangle, which consists of 3 vertices. Each index references a specific vertex
-            meshes.push_back(Mesh(mesh.mNumFaces * 3, num_vertex, num_indices, mesh.mMaterialIndex));
-            num_vertex += mesh.mNumVertices;
-            num_indices += meshes.back().NumIndices;
-            num_bones += mesh.mNumBones;
+    void ModelComposite::computeBounds(const ModelData &data) {
+        // A mesh's vertices sit together, starting at its base vertex, and its indices say how far they go
+        std::vector<uint32_t> numMeshVertices(meshes.size(), 0);
+        for (unsigned int i = 0; i < meshes.size(); i++) {
+            for (unsigned int j = 0; j < meshes[i].NumIndices; j++) {
+                numMeshVertices[i] = std::max(numMeshVertices[i], data.indices[meshes[i].BaseIndex + j] + 1);
+            }
         }
-        vertices.reserve(num_vertex);
-        normals.reserve(num_vertex);
-        indices.reserve(num_indices);
-        texcoords.reserve(num_vertex);
 
-        if (animated) {
-            // vector.assign automatically allocates space in the vector
-            // All bone indices initialized to -1 and boneweights initialized to 0 by default in reserveGeometrySpace
-            // Directly initializing stuff here because bone properties may not be loaded in sequential order
-            boneVertexWeights.indices.assign(MAX_BONE_INFLUENCE * num_vertex, -1);
-            boneVertexWeights.weights.assign(MAX_BONE_INFLUENCE * num_vertex, 0);
-            bones.offsetMatrices.reserve(num_bones);
-            numBones = num_bones;
+        auto addPose = [&](const ModelPose *pose) {
+            for (unsigned int i = 0; i < meshes.size(); i++) {
+                for (uint32_t v = meshes[i].BaseVertex; v < meshes[i].BaseVertex + numMeshVertices[i]; v++) {
+                    const ModelVertex &vertex = data.vertices[v];
+                    glm::vec4 position(vertex.position, 1);
+                    // Same skinning as the vertex shader
+                    if (pose != nullptr && vertex.boneIds[0] != -1) {
+                        glm::vec4 skinned(0);
+                        for (int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+                            if (vertex.boneIds[k] >= 0 && vertex.boneIds[k] < (int)pose->size()) {
+                                skinned += vertex.boneWeights[k] * ((*pose)[vertex.boneIds[k]] * position);
+                            }
+                        }
+                        position = skinned;
+                    }
+                    meshes[i].bounds.extend(glm::vec3(position));
+                }
+            }
+        };
+
+        if (!animated) {
+            addPose(nullptr);
         } else {
-            numBones = 0;
+            ModelPose pose = emptyModelPose();
+            animationPose(-1, animationTickWhenStill, pose);
+            addPose(&pose);
+            for (unsigned int a = 0; a < animations.size(); a++) {
+                for (int sample = 0; sample <= ANIMATION_BOUNDS_SAMPLES; sample++) {
+                    animationPose(a, animations[a].duration * sample / ANIMATION_BOUNDS_SAMPLES, pose);
+                    addPose(&pose);
+                }
+            }
+            for (Mesh &mesh : meshes) {
+                if (!mesh.bounds.isEmpty()) {
+                    glm::vec3 padding = (mesh.bounds.max - mesh.bounds.min) * ANIMATION_BOUNDS_PADDING;
+                    mesh.bounds.min -= padding;
+                    mesh.bounds.max += padding;
+                }
+            }
+        }
+
+        for (const Mesh &mesh : meshes) {
+            bounds.extend(mesh.bounds);
         }
     }
 
     /**
-     * Render the model with a static pose
-     * @param modelPosition Model position in world coordinates
-     * @param modelYaw Model yaw in degrees
-     * @param shadow Whether to render to shadowmap
-     * @param outline Whether to render outline for current entity, does nothing if shadow is true
+     * Frustum cull the whole model, if it's culled its meshes all count as culled
+     * @param model Model's transformation matrix
+     * @param pass Pass it's being drawn in, the shadow pass is tested against the light and the main pass against the camera
      */
-    void ModelComposite::render(const glm::vec3 &modelPosition, const float &modelYaw, bool shadow, bool outline) const {
-        if (shadow == true) {
-            shadowProgram.useShader();
-            shadowProgram.setAnimated(false);
-        } else {
-            defaultProgram.useShader();
-            defaultProgram.setAnimated(false);
-            defaultProgram.updateOutline(outline);
+    bool ModelComposite::isVisible(const glm::mat4 &model, RenderPass pass) const {
+        const Frustum &frustum = pass == SHADOW_PASS ? lightFrustum : cameraFrustum;
+        if (frustum.intersects(bounds.transformed(model))) {
+            return true;
         }
-        glBindVertexArray(VAO);
-        glm::mat4 model = glm::translate(glm::mat4(1.0f), modelPosition); // This instance's transformation matrix - specifies instance's rotation, translation, etc.
-        model = glm::rotate(model, glm::radians(modelYaw), glm::vec3(0.0f, -1.0f, 0.0f));
-        // yaw (cursor movement) should rotate our player model AND the camera view, right?
-        if (shadow == true) {
-            shadowProgram.updateModelMat(model);
+        (pass == SHADOW_PASS ? cullingStats.shadowCulled : cullingStats.culled) += meshes.size();
+        return false;
+    }
+
+    bool ModelComposite::isMeshVisible(const Mesh &mesh, const glm::mat4 &model, RenderPass pass) const {
+        // Don't bother testing the only mesh twice
+        bool visible = meshes.size() == 1 || (pass == SHADOW_PASS ? lightFrustum : cameraFrustum).intersects(mesh.bounds.transformed(model));
+        if (pass == SHADOW_PASS) {
+            (visible ? cullingStats.shadowDrawn : cullingStats.shadowCulled)++;
         } else {
-            defaultProgram.updateModelMat(model);
+            (visible ? cullingStats.drawn : cullingStats.culled)++;
         }
-        // Draw each mesh to the screen
-        for (unsigned int i = 0; i < meshes.size(); i++) {
-            if (shadow == false) {
-                const Material &mat = materials[meshes[i].MaterialIndex];
-                mat.setShaderMaterial();
-            }
-            glDrawElementsBaseVertex(GL_TRIANGLES, meshes[i].NumIndices, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * meshes[i].BaseIndex), meshes[i].BaseVertex);
-        }
-        glBindVertexArray(0);
+        return visible;
     }
 
-
     /**
-     * Loads all material properties from a scene into ModelComposite material vector
-     * @param scene Scene to load materials from
+     * Queue the model to be drawn, one draw item per mesh that survives frustum culling.
+     * Nothing is sent to OpenGL until the queue is drawn
+     * @param pass Pass to draw the model in
+     * @param modelPosition Model position in world coordinates
+     * @param modelYaw Model yaw in degrees
+     * @param instance The entity's pose and settings, its model matrix is filled in here
      */
-    void ModelComposite::loadMaterials(const aiScene *scene) {
-        for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
-            const aiMaterial &mat = *scene->mMaterials[i];
-            aiColor4D color(0.f, 0.f, 0.f, 0.0f);
-
-            glm::vec3 diffuse(-1.0f);
-            glm::vec3 specular(0.0f);
-            glm::vec3 shininess(0.0f);
-
-            // We only allow blending between textures, not material colors
-            // because .mtl files don't support many color types
-            if (mat.Get(AI_MATKEY_COLOR_DIFFUSE, color) == AI_SUCCESS) {
-                diffuse.x = color.r;
-                diffuse.y = color.g;
-                diffuse.z = color.b;
-            }
-            if (mat.Get(AI_MATKEY_COLOR_SPECULAR, color) == AI_SUCCESS) {
-                specular.x = color.r;
-                specular.y = color.g;
-                specular.z = color.b;
-            }
-            float shininessTmp;
-            aiReturn ret;
-            ret = mat.Get(AI_MATKEY_SHININESS, shininessTmp);
-            if (ret == AI_SUCCESS) {
-                shininess.x = shininessTmp;
-                shininess.y = shininessTmp; // This is intentional, putting them all to R
-                shininess.z = shininessTmp;
-            }
-
-            int diffuseTexIdx0 = loadTexture(aiTextureType_DIFFUSE, scene, mat);
-            int diffuseTexIdx1 = loadTexture(aiTextureType_HEIGHT, scene, mat);
-            int diffuseTexIdx2 = loadTexture(aiTextureType_EMISSIVE, scene, mat);
-            int diffuseTexIdx3 = loadTexture(aiTextureType_AMBIENT, scene, mat);
-            int specularTexIdx = loadTexture(aiTextureType_SPECULAR, scene, mat);
-            int shinyTexIdx = loadTexture(aiTextureType_SHININESS, scene, mat);
-
-            if (ret != AI_SUCCESS || (shininessTmp == 0 && diffuseTexIdx1 == -1)) {
-                specular.x = 0; // No shininess
-                specular.y = 0;
-                specular.z = 0;
+    void ModelComposite::submit(RenderPass pass, const glm::vec3 &modelPosition, const float &modelYaw, DrawInstance instance) const {
+        instance.model = glm::translate(glm::mat4(1.0f), modelPosition); // This instance's transformation matrix - specifies instance's rotation, translation, etc.
+        // yaw (cursor movement) should rotate our player model AND the camera view, right?
+        instance.model = glm::rotate(instance.model, glm::radians(modelYaw), glm::vec3(0.0f, -1.0f, 0.0f));
+        // The bounds cover every pose, so this doesn't need to look at the pose
+        if (!isVisible(instance.model, pass)) {
+            return;
+        }
+        if (instance.pose != nullptr) {
+            assert(animated);
+        }
+        unsigned int instanceIndex = renderQueue.addInstance(pass, instance);
+        for (const Mesh &mesh : meshes) {
+            if (!isMeshVisible(mesh, instance.model, pass)) {
+                continue;
             }
-
-            materials.push_back(Material(
-                    diffuse,
-                    specular,
-                    shininess,
-                    diffuseTexIdx0,
-                    diffuseTexIdx1,
-                    diffuseTexIdx2,
-                    diffuseTexIdx3,
-                    specularTexIdx,
-                    shinyTexIdx, true));
+            DrawItem item;
+            item.mesh = &mesh;
+            // The shadow pass only draws depth, so leaving the material out lets all of a model's meshes go in one run
+            item.material = pass == SHADOW_PASS ? nullptr : &materials[mesh.MaterialIndex];
+            item.VAO = VAO;
+            item.animated = instance.pose != nullptr;
+            item.instance = instanceIndex;
+            renderQueue.submit(pass, item);
         }
     }
 
+
     /**
-     * Loads a texture into SGE
-     * @param type Type of texture to load e.g. specular, diffuse, etc.
-     * @param scene Assimp scene object we're loading textures from
-     * @param material Material we're loading texture for
-     * @return Index of new texture within global textures vector
+     * Loads all of a model's materials and textures into ModelComposite material vector
+     * @param data Model to load materials from
      */
-    int ModelComposite::loadTexture(aiTextureType type, const aiScene *scene, const aiMaterial &material) {
-        stbi_set_flip_vertically_on_load(false);
-        // Load textures
-        aiString path;
-
-        if (material.GetTexture(type, 0, &path) != AI_SUCCESS) {
-//            std::cout << "uh oh, no diffuse texture\n";
-            return -1;
-        }
-
-        // Build path to texture file
-        std::string textureRelativePath(path.C_Str());
-        std::string textureAbsolutePath = parentDirectory.string() + textureRelativePath;
-
-        int width, height, channels;
-        unsigned char *imgData;
-        // We still need to handle embedded textures since the character models are in .glb file format
-        if (const aiTexture *texture = scene->GetEmbeddedTexture(path.C_Str())) {
-            if (texture->mHeight == 0) { // Compressed image format
-                imgData = stbi_load_from_memory((unsigned char *)texture->pcData, texture->mWidth, &width, &height, &channels, 0);
-            } else {
-                std::cout << "Warning: this case of texture is not properly handled\n";
-                // I didn't add all the logic needed to handle this case, e.g. RGBA not handled, 1-channel images not handled, etc.
-                imgData = reinterpret_cast<unsigned char*>(texture->pcData);
-            }
-        } else {
-            // If assimp failed to load it, load it the classic way
-            imgData = stbi_load(textureAbsolutePath.c_str(), &width, &height, &channels, 0);
+    void ModelComposite::loadMaterials(const ModelData &data) {
+        // Textures go into the global textures vector, so the model's texture indices need translating
+        for (unsigned int i = 0; i < data.header.numTextures; i++) {
+            textureIndices.push_back(uploadTexture(data, data.textures[i]));
         }
+        auto globalTexture = [this](int32_t modelTexture) {
+            return modelTexture < 0 ? -1 : textureIndices[modelTexture];
+        };
 
-        // No image
-        if (imgData == nullptr) {
-            std::cout << "Error in loading the texture image: " << textureAbsolutePath << std::endl;
-            return -1;
+        for (unsigned int i = 0; i < data.header.numMaterials; i++) {
+            const BakedMaterial &mat = data.materials[i];
+            materials.push_back(Material(
+                    mat.diffuse,
+                    mat.specular,
+                    mat.shininess,
+                    globalTexture(mat.diffuseMap[0]),
+                    globalTexture(mat.diffuseMap[1]),
+                    globalTexture(mat.diffuseMap[2]),
+                    globalTexture(mat.diffuseMap[3]),
+                    globalTexture(mat.specularMap),
+                    globalTexture(mat.shinyMap), true));
         }
+    }
 
-        // Texture expects a vector, not an array
-        std::vector<unsigned char> dataVector(imgData, imgData + width * height * channels);
-
-        // Switch to our type of texture enum
-        // To handle alternate textures for each season, we export each texture as alternate texture types
-        // from Blender. It's scuffed but it works (probably)
-        enum TexType sgeType;
-        switch (type) {
-            case aiTextureType_DIFFUSE:
-                sgeType = DIFFUSE_TEXTURE0;
-                break;
-            case aiTextureType_HEIGHT:
-                sgeType = DIFFUSE_TEXTURE1;
-                break;
-            case aiTextureType_EMISSIVE:
-                sgeType = DIFFUSE_TEXTURE2;
-                break;
-            case aiTextureType_AMBIENT:
-                sgeType = DIFFUSE_TEXTURE3;
-                break;
-            case aiTextureType_SPECULAR:
-                sgeType = SPECULAR_TEXTURE;
-                break;
-            case aiTextureType_SHININESS:
-                sgeType = SHININESS_TEXTURE;
-                break;
-            default:
-                sgeType = UNKNOWN_TEXTYPE;
-                break;
-        }
+    /**
+     * Whether the driver can sample S3TC (BC1/BC3) compressed textures. Every desktop GPU can, but it's still an extension
+     */
+    static bool supportsCompressedTextures() {
+        #ifdef __APPLE__
+        return true;
+        #else
+        return GLEW_EXT_texture_compression_s3tc;
+        #endif
+    }
 
-        // Add texture to sge data structures
-        int ret = textures.size();
-        textures.push_back(Texture(width, height, channels, sgeType, dataVector));
+    /**
+     * Loads one of a model's (already decoded) textures into SGE, with its whole mip chain
+     * @param data Model the texture belongs to
+     * @param texture Texture to load
+     * @return Index of new texture within global textures vector
+     */
+    int ModelComposite::uploadTexture(const ModelData &data, const BakedTexture &texture) {
+        const unsigned char *pixels = data.texturePixels + texture.pixelOffset;
+        int width = texture.width;
+        int height = texture.height;
+        int channels = texture.channels;
+        enum TexType sgeType = (enum TexType)texture.type;
 
         // Feed texture to OpenGL
-        glActiveTexture(GL_TEXTURE0 + sgeType);
+        glState.activeTexture(GL_TEXTURE0 + sgeType);
         texID.push_back(0);
         glGenTextures(1, &texID.back());
-        glBindTexture(GL_TEXTURE_2D, texID.back());
+        glState.bindTexture(GL_TEXTURE_2D, texID.back());
         // Handle different number of channels in texture
         int format = GL_RGB;
         if (channels == 1) {
@@ -443,72 +318,83 @@ namespace sge {
         } else if (channels == 4) {
             format = GL_RGBA;
         }
+        bool compressed = texture.format != TEXTURE_RAW;
+        bool uploadCompressed = compressed && supportsCompressedTextures();
+        if (compressed && !uploadCompressed) {
+            std::printf("no S3TC support, decompressing %dx%d texture from %s\n", width, height, modelFilePath.c_str());
+        }
 
         // Initialize texture settings within OpenGL
         glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
         glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
         glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
         glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, dataVector.data());
+        size_t gpuBytes = 0;
+        for (uint32_t level = 0; level < texture.numLevels; level++) {
+            const unsigned char *levelPixels = pixels + textureLevelOffset(texture, level);
+            int levelWidth = textureLevelWidth(texture, level);
+            int levelHeight = textureLevelHeight(texture, level);
+            if (uploadCompressed) {
+                GLenum compressedFormat = texture.format == TEXTURE_BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+                glCompressedTexImage2D(GL_TEXTURE_2D, level, compressedFormat, levelWidth, levelHeight, 0,
+                                       textureLevelSize(texture, level), levelPixels);
+                gpuBytes += textureLevelSize(texture, level);
+            } else if (compressed) {
+                std::vector<unsigned char> decompressed = decompressTextureLevel(texture, level, levelPixels);
+                glTexImage2D(GL_TEXTURE_2D, level, format, levelWidth, levelHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, decompressed.data());
+                gpuBytes += (size_t)levelWidth * levelHeight * channels;
+            } else {
+                glTexImage2D(GL_TEXTURE_2D, level, format, levelWidth, levelHeight, 0, format, GL_UNSIGNED_BYTE, levelPixels);
+                gpuBytes += textureLevelSize(texture, level);
+            }
+        }
+        // Trilinear filtering between the mip levels
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.numLevels - 1);
         glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texture.numLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-        stbi_image_free(imgData);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        return ret;
+        glState.bindTexture(GL_TEXTURE_2D, 0);
+
+        // Add texture to sge data structures, the pixels themselves stay with the model data
+        textures.push_back(Texture(width, height, channels, sgeType, gpuBytes, modelFilePath));
+        return textures.size() - 1;
     }
 
     /**
-     * Load an animation from an assimp scene object and add it to
-     * ModelComposite data structures
-     * @param animation
-     * @return
+     * Load a model's animations into ModelComposite data structures
+     * @param data
      */
-    ModelComposite::Animation ModelComposite::loadAnimation(const aiAnimation &animation) {
-        Animation cur;
-        cur.duration = animation.mDuration;
-        cur.ticksPerSecond = animation.mTicksPerSecond;
-        for (unsigned int i = 0; i < animation.mNumChannels; i++) {
-            std::string nodeName = animation.mChannels[i]->mNodeName.C_Str();
-            // Load missing bones in animation
-            if (!boneMap.count(nodeName)) {
-                boneMap[nodeName] = boneMap.size();
-                bones.offsetMatrices.push_back(glm::mat4(1)); // To maintain invariant that this vector can always be indexed by bone id, tho this matrix (should) never be used
-                numBones++;
+    void ModelComposite::loadAnimations(const ModelData &data) {
+        for (unsigned int i = 0; i < data.header.numAnimations; i++) {
+            const BakedAnimation &baked = data.animations[i];
+            Animation cur;
+            cur.duration = baked.duration;
+            cur.ticksPerSecond = baked.ticksPerSecond;
+            for (unsigned int j = baked.firstChannel; j < baked.firstChannel + baked.numChannels; j++) {
+                const BakedChannel &channel = data.channels[j];
+                cur.channels[channel.boneId] = BonePose(data.boneSamples + channel.firstSample, baked.numSamples, baked.ticksPerSample, channel.boneId);
             }
-            int id = boneMap[nodeName];
-            cur.channels[id] = BonePose(*animation.mChannels[i], id);
+            animations.push_back(cur);
         }
-        return cur;
     }
 
     /**
-     * PRECONDITION: All meshes already loaded (and by extension, all bones directly attached to vertices have been loaded)
-     *
-     * Loads the model's bone hierarchy and load in any missing bones
-     * @param root aiNode to build from
+     * Rebuild the bone hierarchy from its depth-first layout
+     * @param data Model to read bone nodes from
+     * @param nodeIndex Index of the node to start at, left just past its subtree
      * @return Resulting tree translated to ModelComposite::BoneNode's
      */
-    ModelComposite::BoneNode ModelComposite::buildBoneHierarchy(aiNode *root) {
+    ModelComposite::BoneNode ModelComposite::buildBoneHierarchy(const ModelData &data, unsigned int &nodeIndex) {
+        const BakedBoneNode &baked = data.boneNodes[nodeIndex++];
         BoneNode cur;
-        std::string boneName = root->mName.C_Str();
-        // Assimp is dumb and adds a bunch of extra nodes in the hierarchy tree with identity matrix relative transformations :/
-        int boneId = -1;
-        if (boneMap.count(boneName)) {
-            boneId = boneMap[boneName];
-        }
-        cur.relativeTransform = assimpToGlmMat4(root->mTransformation);
-        cur.id = boneId;
-        for (unsigned int i = 0; i < root->mNumChildren; i++) {
-            cur.children.push_back(buildBoneHierarchy(root->mChildren[i]));
-            // Delete unnecessary nodes
-            if (cur.children.back().id == -1 && cur.children.back().children.empty()) {
-                cur.children.pop_back();
-            }
+        cur.relativeTransform = baked.relativeTransform;
+        cur.id = baked.id;
+        for (unsigned int i = 0; i < baked.numChildren; i++) {
+            cur.children.push_back(buildBoneHierarchy(data, nodeIndex));
         }
-
         return cur;
     }
 
@@ -523,18 +409,18 @@ namespace sge {
         if (animationId == -1) {
             animationId = animationWhenStill;
         }
-        Animation anim = animations[animationId];
+        Animation &anim = animations[animationId];
         glm::mat4 accumulator(1);
         // Recursively construct final transformation matrices for each bone
         recursePose(outputModelPose, anim, time, accumulator, bones.root);
     }
 
     /**
-     * Get pose object for model's default/binding pose
+     * Get pose object for model's default/binding pose, with one matrix for each of the model's bones
      * @return
      */
     ModelPose ModelComposite::emptyModelPose() {
-        ModelPose pose(MAX_BONES, glm::mat4(1));
+        ModelPose pose(numBones, glm::mat4(1));
         return pose;
     }
 
@@ -549,7 +435,7 @@ namespace sge {
         if (animationId == -1) {
             return animationTickWhenStill;
         }
-        Animation anim = animations[animationId];
+        Animation &anim = animations[animationId];
         float ticks = milliseconds * anim.ticksPerSecond / 1000;
         // apply animation loop
         if (ticks > anim.duration) {
@@ -558,49 +444,6 @@ namespace sge {
         return ticks;
     }
 
-    /**
-     * Render model with a specified pose
-     * @param modelPosition Entity position in world coordinates
-     * @param modelYaw Model yaw (rotation of model in degrees)
-     * @param pose Pose to draw model in
-     * @param shadow Whether to draw to shadow map
-     * @param outline Whether to draw outline, does nothing if shadow is true
-     */
-    void ModelComposite::renderPose(const glm::vec3 &modelPosition, const float &modelYaw, ModelPose pose, bool shadow,
-                                    bool outline) const {
-        if (shadow) {
-            shadowProgram.useShader();
-            shadowProgram.setAnimated(true);
-        } else {
-            defaultProgram.useShader();
-            defaultProgram.setAnimated(true);
-            defaultProgram.updateOutline(outline);
-        }
-
-        glBindVertexArray(VAO);
-        glm::mat4 model = glm::translate(glm::mat4(1.0f), modelPosition); // This instance's transformation matrix - specifies instance's rotation, translation, etc.
-        model = glm::rotate(model, glm::radians(modelYaw), glm::vec3(0.0f, -1.0f, 0.0f));
-        // yaw (cursor movement) should rotate our player model AND the camera view, right?
-        if (shadow) {
-            shadowProgram.updateModelMat(model);
-            shadowProgram.updateBoneTransforms(pose);
-        } else {
-            defaultProgram.updateModelMat(model);
-            defaultProgram.updateBoneTransforms(pose);
-        }
-
-        // Draw each mesh to the screen
-        for (unsigned int i = 0; i < meshes.size(); i++) {
-            const Material &mat = materials[meshes[i].MaterialIndex];
-            if (shadow == false) {
-                mat.setShaderMaterial();
-            }
-            glDrawElementsBaseVertex(GL_TRIANGLES, meshes[i].NumIndices, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * meshes[i].BaseIndex), meshes[i].BaseVertex);
-//            glBindTexture(GL_TEXTURE_2D, 0);
-        }
-        glBindVertexArray(0);
-    }
-
     /**
      * Recursively evaluate bone poses at a given time
      *
@@ -610,7 +453,7 @@ namespace sge {
      * @param accumulator Accumulator transformation matrix to handle bone hierarchy
      * @param cur Current bone node
      */
-    void ModelComposite::recursePose(ModelPose &out, Animation &anim, float time, glm::mat4 accumulator, ModelComposite::BoneNode cur) {
+    void ModelComposite::recursePose(ModelPose &out, Animation &anim, float time, glm::mat4 accumulator, const ModelComposite::BoneNode &cur) {
         assert(animated == true);
         if (cur.id == -1) {
             accumulator = accumulator * cur.relativeTransform;
@@ -632,119 +475,140 @@ namespace sge {
     }
 
     /**
-     * Create a bonepose object from an Assimp animation channel
-     * @param channel Assimp animation channel
-     * @param id Bone id
+     * Print the model's memory usage, one line for the model and one per texture
+     * @param cpuTotal Main memory the model uses gets added to this
+     * @param gpuTotal GPU memory the model uses gets added to this
      */
-    ModelComposite::BonePose::BonePose(aiNodeAnim &channel, int id) {
-        boneId = id;
-        for (unsigned int i = 0; i < channel.mNumPositionKeys; i++) {
-            aiVectorKey keyframePos = channel.mPositionKeys[i];
-            positions.push_back(glm::vec3(keyframePos.mValue.x, keyframePos.mValue.y, keyframePos.mValue.z));
-            positionTimestamps.push_back(keyframePos.mTime);
+    void ModelComposite::printMemoryReport(size_t &cpuTotal, size_t &gpuTotal) const {
+        size_t animationBytes = bones.offsetMatrices.size() * sizeof(glm::mat4);
+        for (const Animation &animation : animations) {
+            for (const auto &channel : animation.channels) {
+                animationBytes += channel.second.samples.size() * sizeof(BoneSample);
+            }
         }
-        for (unsigned int i = 0; i < channel.mNumRotationKeys; i++) {
-            aiQuatKey keyframeRot = channel.mRotationKeys[i];
-            rotations.push_back(glm::quat(keyframeRot.mValue.w, keyframeRot.mValue.x, keyframeRot.mValue.y, keyframeRot.mValue.z));
-            rotationTimestamps.push_back(keyframeRot.mTime);
+        size_t retainedBytes = retainedData != nullptr ? sizeof(BakedModelHeader) + retainedData->memoryUsage() : 0;
+        size_t textureBytes = 0;
+        for (int i : textureIndices) {
+            textureBytes += textures[i].gpuBytes;
         }
-        for (unsigned int i = 0; i < channel.mNumScalingKeys; i++) {
-            aiVectorKey keyframeSca = channel.mScalingKeys[i];
-            scales.push_back(glm::vec3(keyframeSca.mValue.x, keyframeSca.mValue.y, keyframeSca.mValue.z));
-            scaleTimestamps.push_back(keyframeSca.mTime);
+        std::printf("%-24s cpu %7zu KB (animations %zu KB, retained model data %zu KB), gpu %7zu KB (buffers %zu KB, %zu textures %zu KB)\n",
+            std::filesystem::path(modelFilePath).filename().string().c_str(), (animationBytes + retainedBytes) / 1024,
+            animationBytes / 1024, retainedBytes / 1024, (bufferBytes + textureBytes) / 1024, bufferBytes / 1024,
+            textureIndices.size(), textureBytes / 1024);
+        for (int i : textureIndices) {
+            std::printf("    texture %d: %zux%zu, %zu channels, %zu KB on the gpu\n", i, textures[i].width, textures[i].height,
+                textures[i].channels, textures[i].gpuBytes / 1024);
         }
+        cpuTotal += animationBytes + retainedBytes;
+        gpuTotal += bufferBytes + textureBytes;
     }
 
     /**
-     * Interpolate bone pose at time t
-     * @param time
+     * Create a bonepose object from a channel's evenly spaced samples
+     * @param samples First sample of the channel
+     * @param numSamples Number of samples in the channel
+     * @param sampleInterval Animation ticks between samples
+     * @param id Bone id
+     */
+    ModelComposite::BonePose::BonePose(const BoneSample *samples, unsigned int numSamples, double sampleInterval, int id)
+            : boneId(id), samples(samples, samples + numSamples), sampleInterval(sampleInterval) {}
+
+    /**
+     * Interpolate bone pose at time t between the two samples around it
+     * Returns pose at final sample if time is past the end of the animation
+     * @param time Time to evaluate the pose at (animation ticks)
      * @return Transformation matrix for current bone relative to its parent joint
      */
     glm::mat4 ModelComposite::BonePose::poseAtTime(double time) {
-        glm::mat4 translation = interpolatePosition(time);
-        glm::mat4 rotation = interpolateRotation(time);
-        glm::mat4 scale = interpolateScale(time);
-        return translation * rotation * scale;
+        // Default return when no samples available
+        if (samples.empty()) return glm::mat4(1);
+
+        // Samples are evenly spaced, so no searching for the right ones
+        double samplePosition = std::max(time, 0.0) / sampleInterval;
+        size_t idx = (size_t)samplePosition;
+        glm::vec3 position;
+        glm::quat rotation;
+        glm::vec3 scale;
+        if (idx >= samples.size() - 1) {
+            position = samples.back().position;
+            rotation = samples.back().rotation;
+            scale = samples.back().scale;
+        } else {
+            const BoneSample &sample1 = samples[idx];
+            const BoneSample &sample2 = samples[idx + 1];
+            float scalar = samplePosition - idx;
+            position = glm::mix(sample1.position, sample2.position, scalar);
+            rotation = glm::normalize(glm::slerp(sample1.rotation, sample2.rotation, scalar));
+            scale = glm::mix(sample1.scale, sample2.scale, scalar);
+        }
+        return glm::translate(glm::mat4(1), position) * glm::toMat4(rotation) * glm::scale(glm::mat4(1), scale);
     }
 
     /**
-     * Linearly interpolate between keyframes
-     *
-     * Returns pose at final keyframe if time > final keyframe timestamp
-     * @param time Time to interpolate position at (milliseconds)
-     * @return Bone's transformation matrix at specified time
+     * Mesh constructor
+     * @param NumIndices Number of indices in object - 3 * number of faces
+     * @param BaseVertex Starting index in ModelComposite vertex array of current mesh
+     * @param BaseIndex Starting index in ModelComposite indices array of current mesh
+     * @param MaterialIndex Index in ModelComposite's material array - each mesh has one material
      */
-    glm::mat4 ModelComposite::BonePose::interpolatePosition(double time) {
-        // Default return when no keyframes available
-        if (positions.empty()) return glm::mat4(1);
+    Mesh::Mesh(unsigned int NumIndices, unsigned int BaseVertex,
+               unsigned BaseIndex, unsigned int MaterialIndex) : NumIndices(NumIndices), BaseVertex(BaseVertex), BaseIndex(BaseIndex), MaterialIndex(MaterialIndex) {}
 
-        int idx = std::lower_bound(positionTimestamps.begin(), positionTimestamps.end(), time) - positionTimestamps.begin();
-        if (idx >= positionTimestamps.size() - 1) {
-            return glm::translate(glm::mat4(1), positions.back());
-        }
-        glm::vec3 pos1 = positions[idx];
-        glm::vec3 pos2 = positions[idx + 1];
-        double t1 = positionTimestamps[idx];
-        double t2 = positionTimestamps[idx + 1];
-        float scalar = (time - t1) / (t2 - t1);
-        return glm::translate(glm::mat4(1), glm::mix(pos1, pos2, scalar));
+    void BoundingBox::extend(const glm::vec3 &point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
     }
 
-    /**
-     * Interpolate bone rotation at a given time
-     * Returns final pose if time > last keyframe timestamp
-     * @param time Time to evaluate bone rotation pose (milliseconds)
-     * @return Rotation matrix at specified time
-     */
-    glm::mat4 ModelComposite::BonePose::interpolateRotation(double time) {
-        // Default return when no keyframes available
-        if (rotations.empty()) return glm::mat4(1);
+    void BoundingBox::extend(const BoundingBox &box) {
+        if (!box.isEmpty()) {
+            extend(box.min);
+            extend(box.max);
+        }
+    }
 
-        int idx = std::lower_bound(rotationTimestamps.begin(), rotationTimestamps.end(), time) - rotationTimestamps.begin();
-        if (idx >= rotationTimestamps.size() - 1) {
-            return glm::toMat4(rotations.back());
+    BoundingBox BoundingBox::transformed(const glm::mat4 &transform) const {
+        BoundingBox out;
+        if (isEmpty()) {
+            return out;
+        }
+        for (int i = 0; i < 8; i++) {
+            glm::vec3 corner(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+            out.extend(glm::vec3(transform * glm::vec4(corner, 1)));
         }
-        glm::quat rot1 = rotations[idx];
-        glm::quat rot2 = rotations[idx + 1];
-        double t1 = rotationTimestamps[idx];
-        double t2 = rotationTimestamps[idx + 1];
-        float scalar = (time - t1) / (t2 - t1);
-        glm::quat finalRot = glm::normalize(glm::slerp(rot1, rot2, scalar));
-        return glm::toMat4(finalRot);
+        return out;
     }
 
     /**
-     * Interpolate bone scale at a given timestamp in an animation
-     * Returns final pose if time > last keyframe timestamp
-     * @param time Time to evaluate bone scale pose at (milliseconds)
-     * @return Scaling matrix at specified time
+     * Gribb/Hartmann plane extraction: each plane is the last row of the matrix plus or minus one of the others
+     * @param projectionView Projection matrix times view matrix
      */
-    glm::mat4 ModelComposite::BonePose::interpolateScale(double time) {
-        // Default return if no scale keyframes avaialble
-        if (scales.empty()) return glm::mat4(1);
+    Frustum::Frustum(const glm::mat4 &projectionView) : hasPlanes(true) {
+        glm::mat4 m = glm::transpose(projectionView); // so m[i] is row i
+        planes[0] = m[3] + m[0]; // left
+        planes[1] = m[3] - m[0]; // right
+        planes[2] = m[3] + m[1]; // bottom
+        planes[3] = m[3] - m[1]; // top
+        planes[4] = m[3] + m[2]; // near
+        planes[5] = m[3] - m[2]; // far
+    }
 
-        int idx = std::lower_bound(scaleTimestamps.begin(), scaleTimestamps.end(), time) - scaleTimestamps.begin();
-        if (idx >= scaleTimestamps.size() - 1) {
-            return glm::scale(glm::mat4(1), scales.back());
+    bool Frustum::intersects(const BoundingBox &box) const {
+        if (box.isEmpty()) {
+            return false;
+        }
+        if (!hasPlanes) {
+            return true;
         }
-        glm::vec3 scale1 = scales[idx];
-        glm::vec3 scale2 = scales[idx + 1];
-        double t1 = scaleTimestamps[idx];
-        double t2 = scaleTimestamps[idx + 1];
-        float scalar = (time - t1) / (t2 - t1);
-        return glm::scale(glm::mat4(1), glm::mix(scale1, scale2, scalar));
+        for (const glm::vec4 &plane : planes) {
+            // The corner furthest along the plane's normal, if even that one's behind the plane the whole box is
+            glm::vec3 corner(plane.x >= 0 ? box.max.x : box.min.x, plane.y >= 0 ? box.max.y : box.min.y, plane.z >= 0 ? box.max.z : box.min.z);
+            if (glm::dot(glm::vec3(plane), corner) + plane.w < 0) {
+                return false;
+            }
+        }
+        return true;
     }
 
-    /**
-     * Mesh constructor
-     * @param NumIndices Number of indices in object - 3 * number of faces
-     * @param BaseVertex Starting index in ModelComposite vertex array of current mesh
-     * @param BaseIndex Starting index in ModelComposite indices array of current mesh
-     * @param MaterialIndex Index in ModelComposite's material array - each mesh has one material
-     */
-    Mesh::Mesh(unsigned int NumIndices, unsigned int BaseVertex,
-               unsigned BaseIndex, unsigned int MaterialIndex) : NumIndices(NumIndices), BaseVertex(BaseVertex), BaseIndex(BaseIndex), MaterialIndex(MaterialIndex) {}
-
    /**
     *
     * @param diffuse
@@ -835,50 +699,50 @@ namespace sge {
     void Material::setShaderMaterial() const {
        if (diffuseMap[0] != -1) {
            // Tell shader there is a diffuse map
-           glUniform1i(defaultProgram.hasDiffuseMap, 1);
+           glState.uniform1i(defaultProgram.hasDiffuseMap, 1);
            if (seasons || multipleTextures) {
-               glActiveTexture(GL_TEXTURE0 + DIFFUSE_TEXTURE0);
+               glState.activeTexture(GL_TEXTURE0 + DIFFUSE_TEXTURE0);
                if (diffuseMap[0] > -1)
-                   glBindTexture(GL_TEXTURE_2D, texID[diffuseMap[0]]);
-               glActiveTexture(GL_TEXTURE0 + DIFFUSE_TEXTURE1);
+                   glState.bindTexture(GL_TEXTURE_2D, texID[diffuseMap[0]]);
+               glState.activeTexture(GL_TEXTURE0 + DIFFUSE_TEXTURE1);
                if (diffuseMap[1] > -1)
-                   glBindTexture(GL_TEXTURE_2D, texID[diffuseMap[1]]);
-               glActiveTexture(GL_TEXTURE0 + DIFFUSE_TEXTURE2);
+                   glState.bindTexture(GL_TEXTURE_2D, texID[diffuseMap[1]]);
+               glState.activeTexture(GL_TEXTURE0 + DIFFUSE_TEXTURE2);
                if (diffuseMap[2] > -1)
-                   glBindTexture(GL_TEXTURE_2D, texID[diffuseMap[2]]);
-               glActiveTexture(GL_TEXTURE0 + DIFFUSE_TEXTURE3);
+                   glState.bindTexture(GL_TEXTURE_2D, texID[diffuseMap[2]]);
+               glState.activeTexture(GL_TEXTURE0 + DIFFUSE_TEXTURE3);
                if (diffuseMap[3] > -1)
-                   glBindTexture(GL_TEXTURE_2D, texID[diffuseMap[3]]);
+                   glState.bindTexture(GL_TEXTURE_2D, texID[diffuseMap[3]]);
            } else {
-               glActiveTexture(GL_TEXTURE0 + DIFFUSE_TEXTURE0);
-               glBindTexture(GL_TEXTURE_2D, texID[diffuseMap[0]]);
+               glState.activeTexture(GL_TEXTURE0 + DIFFUSE_TEXTURE0);
+               glState.bindTexture(GL_TEXTURE_2D, texID[diffuseMap[0]]);
            }
        } else {
            // Tell shader there is no diffuse map
-           glUniform1i(defaultProgram.hasDiffuseMap, 0);
-           glUniform3fv(defaultProgram.diffuseColor, 1, &diffuse[0]);
+           glState.uniform1i(defaultProgram.hasDiffuseMap, 0);
+           glState.uniform3fv(defaultProgram.diffuseColor, 1, &diffuse[0]);
        }
 
        // Tell shader if the current material supports multiple textures or seasons
-       glUniform1i(defaultProgram.seasons, seasons);
-       glUniform1i(defaultProgram.alternating, multipleTextures);
+       glState.uniform1i(defaultProgram.seasons, seasons);
+       glState.uniform1i(defaultProgram.alternating, multipleTextures);
 
        if (specularMap != -1) {
-           glUniform1i(defaultProgram.hasSpecularMap, 1);
-           glActiveTexture(GL_TEXTURE0 + SPECULAR_TEXTURE);
-           glBindTexture(GL_TEXTURE_2D, texID[specularMap]);
+           glState.uniform1i(defaultProgram.hasSpecularMap, 1);
+           glState.activeTexture(GL_TEXTURE0 + SPECULAR_TEXTURE);
+           glState.bindTexture(GL_TEXTURE_2D, texID[specularMap]);
        } else {
-           glUniform1i(defaultProgram.hasSpecularMap, 0);
-           glUniform3fv(defaultProgram.specularColor, 1, &specular[0]);
+           glState.uniform1i(defaultProgram.hasSpecularMap, 0);
+           glState.uniform3fv(defaultProgram.specularColor, 1, &specular[0]);
        }
 
        if (shinyMap != -1) {
-           glUniform1i(defaultProgram.hasShinyMap, 1);
-           glActiveTexture(GL_TEXTURE0 + SHININESS_TEXTURE);
-           glBindTexture(GL_TEXTURE_2D, texID[shinyMap]);
+           glState.uniform1i(defaultProgram.hasShinyMap, 1);
+           glState.activeTexture(GL_TEXTURE0 + SHININESS_TEXTURE);
+           glState.bindTexture(GL_TEXTURE_2D, texID[shinyMap]);
        } else {
-           glUniform1i(defaultProgram.hasShinyMap, 0);
-           glUniform3fv(defaultProgram.shinyColor, 1, &shininess[0]);
+           glState.uniform1i(defaultProgram.hasShinyMap, 0);
+           glState.uniform3fv(defaultProgram.shinyColor, 1, &shininess[0]);
        }
     }
 
@@ -887,14 +751,15 @@ namespace sge {
      * @param width Texture image width
      * @param height Texture image height
      * @param channels Number of channels within texture
-     * @param data Image data
+     * @param gpuBytes Size of the texture on the GPU
+     * @param source Model the texture belongs to
      */
-    Texture::Texture(size_t width, size_t height, size_t channels, enum TexType type, std::vector<unsigned char> data)
-            : width(width), height(height), channels(channels), type(type), data(data) {}
+    Texture::Texture(size_t width, size_t height, size_t channels, enum TexType type, size_t gpuBytes, const std::string &source)
+            : width(width), height(height), channels(channels), type(type), gpuBytes(gpuBytes), source(source) {}
 
     /**
      * Updates camera lookat matrix - the lookat matrix transforms vertices from world coordinates to camera coordinates
-     * WARNING: THIS WILL CHANGE THE ACTIVE SHADER PROGRAM
+     * Shaders only see the new camera after the next frameUniforms.upload()
      * @param playerPosition Player position
      * @param yaw Camera yaw
      * @param pitch Camera pitch
@@ -920,24 +785,28 @@ namespace sge {
         // move camera above player for better view (it automatically becomes 'fps' when distanceBehind<0)
         cameraPosition.y += CAMERA_DISTANCE_ABOVE_PLAYER;
 
-        // Send camera position to shaders
         glm::vec3 cameraRight = glm::cross(cameraDirection, glm::vec3(0, 1, 0));
         cameraUp = glm::cross(cameraRight, cameraDirection);
         viewMat = glm::lookAt(cameraPosition, cameraPosition + cameraDirection, cameraUp);
+        cameraFrustum = Frustum(perspectiveMat * viewMat);
 
-        particleProgram.useShader();
-        particleProgram.updateViewMat(viewMat);
-
-        defaultProgram.useShader();
-        defaultProgram.updateCamPos(cameraPosition);
-        defaultProgram.updateViewMat(viewMat);
-
-        skyboxProgram.updateViewMat(viewMat);
-        
-        lineShaderProgram.updateViewMat(viewMat);
+        frameUniforms.data.view = viewMat;
+        frameUniforms.data.cameraPosition = cameraPosition;
+        frameUniforms.data.cameraRight = cameraRight;
+        frameUniforms.data.cameraUp = cameraUp;
+    }
 
-        billboardProgram.updateViewMat(viewMat);
-        billboardProgram.updateCameraOrientation(cameraRight, cameraUp);
+    /**
+     * Print how much main memory and GPU memory every loaded model takes up
+     */
+    void printMemoryReport() {
+        size_t cpuTotal = 0, gpuTotal = 0;
+        for (const std::unique_ptr<ModelComposite> &model : models) {
+            if (model != nullptr) {
+                model->printMemoryReport(cpuTotal, gpuTotal);
+            }
+        }
+        std::printf("models total: cpu %zu KB, gpu %zu KB\n", cpuTotal / 1024, gpuTotal / 1024);
     }
 
     /**
@@ -945,7 +814,7 @@ namespace sge {
      */
     void deleteTextures() {
         if (texID.size() > 0) {
-            glDeleteTextures(texID.size(), &texID[0]);
+            glState.deleteTextures(texID.size(), &texID[0]);
         }
     }
 
@@ -965,7 +834,7 @@ namespace sge {
         glDeleteBuffers(1, &VBO);
         glDeleteBuffers(1, &CBO);
         glDeleteBuffers(1, &TBO);
-        glDeleteVertexArrays(1, &VAO);
+        glState.deleteVertexArrays(1, &VAO);
     }
 
     /**
@@ -978,7 +847,7 @@ namespace sge {
         if (count == 0) return;
         particleProgram.updateParticleSize(state.baseParticleSize);
         // Bind the Vertex Array Object
-        glBindVertexArray(VAO);
+        glState.bindVertexArray(VAO);
 
         // Update the colors buffer
         glBindBuffer(GL_ARRAY_BUFFER, CBO);
@@ -997,7 +866,7 @@ namespace sge {
      */
     void ParticleEmitter::initBuffers() {
         glGenVertexArrays(1, &VAO);
-        glBindVertexArray(VAO);
+        glState.bindVertexArray(VAO);
 
         glGenBuffers(1, &VBO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
@@ -1022,7 +891,7 @@ namespace sge {
             glVertexAttribDivisor(2 + i, 1); // This tells OpenGL this attribute is per-instance
         }
         glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        glState.bindVertexArray(0);
     }
 
     /**
@@ -1030,6 +899,7 @@ namespace sge {
      */
     ModelComposite::BonePose::BonePose() {
         boneId = -1;
+        sampleInterval = 1;
     }
 
     /**
@@ -1052,6 +922,9 @@ namespace sge {
     glm::vec3 cameraUp;
     glm::mat4 perspectiveMat;
     glm::mat4 viewMat;
+    Frustum cameraFrustum;
+    Frustum lightFrustum;
+    CullingStats cullingStats;
 
     // For some reason these only work if they're unique pointers, i don't know why
     // we roll with it
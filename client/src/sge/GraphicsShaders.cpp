@@ -2,6 +2,10 @@
 // Created by benjx on 4/10/2024.
 //
 #include "sge/GraphicsShaders.h"
+#include "sge/BonePalette.h"
+#include "sge/RenderQueue.h"
+
+#include <algorithm>
 
 sge::ScreenShader sge::screenProgram;
 
@@ -14,6 +18,38 @@ sge::SkyboxShader sge::skyboxProgram;
 sge::EntityShader sge::shadowProgram;
 sge::ShadowMap sge::shadowprocessor;
 
+sge::FrameUniformBuffer sge::frameUniforms;
+
+// G-buffer formats setup.json can pick from. Normals are octahedral encoded into two channels
+static const sge::TextureFormat colorFormats[NUM_COLOR_FORMATS] = {
+        {"RGBA8", GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4},
+        {"RGB10_A2", GL_RGB10_A2, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, 4}
+};
+static const sge::TextureFormat normalFormats[NUM_NORMAL_FORMATS] = {
+        {"RG8", GL_RG8, GL_RG, GL_UNSIGNED_BYTE, 2},
+        {"RG16F", GL_RG16F, GL_RG, GL_FLOAT, 4}
+};
+static const sge::TextureFormat maskFormat = {"R8UI", GL_R8UI, GL_RED_INTEGER, GL_UNSIGNED_BYTE, 1};
+static const sge::TextureFormat depthStencilFormat = {"DEPTH24_STENCIL8", GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL,
+                                                      GL_UNSIGNED_INT_24_8, 4};
+
+/**
+ * Look up one of the g-buffer formats by name, exits if it isn't one of them
+ * @param formats Formats to choose from
+ * @param name Name of the format in setup.json
+ * @return Index of the format in formats
+ */
+template<size_t N>
+static int findFormat(const sge::TextureFormat (&formats)[N], const std::string &name) {
+    for (size_t i = 0; i < N; i++) {
+        if (name == formats[i].name) {
+            return i;
+        }
+    }
+    std::cout << "Unknown g-buffer format " << name << "\n";
+    exit(EXIT_FAILURE);
+}
+
 sge::LineShaderProgram sge::lineShaderProgram;
 sge::CrosshairShaderProgram sge::crosshairShaderProgram;
 sge::UIShaderProgram sge::uiShaderProgram;
@@ -25,6 +61,9 @@ sge::BillboardProgram sge::billboardProgram;
  */
 void sge::initShaders()
 {
+    frameUniforms.initBuffer();
+    bonePalette.initPalette();
+    renderQueue.initInstanceBuffer();
     defaultProgram.initShaderProgram(
 		(std::string)(PROJECT_PATH)+SetupParser::getValue("default-vertex-shader"),
 		(std::string)(PROJECT_PATH)+SetupParser::getValue("default-fragment-shader")
@@ -100,6 +139,18 @@ void sge::ShaderProgram::initShaderProgram(const std::string &vertexShaderPath,
         std::cout << "Failed to link shaders\n";
         exit(EXIT_FAILURE);
     }
+    bindUniformBlocks();
+}
+
+/**
+ * Point the program's uniform blocks at their fixed binding points. Blocks the program doesn't declare
+ * (or the compiler optimized out) are skipped
+ */
+void sge::ShaderProgram::bindUniformBlocks() const {
+    GLuint frameData = glGetUniformBlockIndex(program, "FrameData");
+    if (frameData != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, frameData, FRAME_DATA_BINDING);
+    }
 }
 
 /**
@@ -127,7 +178,7 @@ std::string sge::ShaderProgram::readShaderSource(const std::string &filename) {
  * Tells OpenGL context to use this shader program for renderng stuff
  */
 void sge::ShaderProgram::useShader() const {
-    glUseProgram(program);
+    glState.useProgram(program);
 }
 
 /**
@@ -181,50 +232,20 @@ void sge::EntityShader::initShaderProgram(const std::string &vertexShaderPath, c
     ShaderProgram::initShaderProgram(vertexShaderPath, fragmentShaderPath);
     useShader();
     // Initialize uniform variables
-    perspectivePos = glGetUniformLocation(program, "perspective");
-    viewPos = glGetUniformLocation(program, "view");
-    modelPos = glGetUniformLocation(program, "model");
-
     isAnimated = glGetUniformLocation(program, "isAnimated");
-    boneTransformPos = glGetUniformLocation(program, "boneTransform");
-}
-
-/**
- * Give shader updated viewing matrix (Convert from world coord to canonical coords)
- * @param mat
- */
-void sge::EntityShader::updateViewMat(const glm::mat4 &mat) const {
-    useShader();
-    glUniformMatrix4fv(viewPos, 1, GL_FALSE, &mat[0][0]);
+    boneOffsetPos = glGetUniformLocation(program, "boneOffset");
+    cascadePos = glGetUniformLocation(program, "cascade");
+    GLint bonePalettePos = glGetUniformLocation(program, "bonePalette");
+    glState.uniform1i(bonePalettePos, BONE_PALETTE_TEXTURE);
 }
 
 /**
- * Give shader updated model matrix (For transforming objects and stuff)
- * @param mat
+ * Point the shader at the current model's pose in the bone palette
+ * @param offset Index of the pose's first bone, from BonePalette::add
  */
-void sge::EntityShader::updateModelMat(const glm::mat4 &mat) const {
+void sge::EntityShader::updateBoneOffset(unsigned int offset) const {
     useShader();
-    glUniformMatrix4fv(modelPos, 1, GL_FALSE, &mat[0][0]);
-}
-
-
-/**
- * Give shader updated perspective projection matrix
- * @param mat
- */
-void sge::EntityShader::updatePerspectiveMat(const glm::mat4 &mat) const {
-    useShader();
-    glUniformMatrix4fv(perspectivePos, 1, GL_FALSE, &mat[0][0]);
-}
-
-/**
- * Update bone transformation matrices for current model's pose
- * @param transforms
- */
-void sge::EntityShader::updateBoneTransforms(std::vector<glm::mat4> &transforms) {
-    assert(transforms.size() == MAX_BONES);
-    useShader();
-    glUniformMatrix4fv(boneTransformPos, MAX_BONES, GL_FALSE, &transforms[0][0][0]);
+    glState.uniform1i(boneOffsetPos, offset);
 }
 
 /**
@@ -233,81 +254,16 @@ void sge::EntityShader::updateBoneTransforms(std::vector<glm::mat4> &transforms)
  */
 void sge::EntityShader::setAnimated(bool animated) const {
     useShader();
-    glUniform1i(isAnimated, animated);
+    glState.uniform1i(isAnimated, animated);
 }
 
 /**
- * Give shader updated camera postition
- * @param pos
+ * Which shadow cascade's light space to draw into, for the shadow map shader
+ * @param cascade
  */
-void sge::ToonShader::updateCamPos(const glm::vec3 &pos) const {
+void sge::EntityShader::updateCascade(int cascade) const {
     useShader();
-    glUniform3fv(cameraPositionPos, 1, &pos[0]);
-}
-
-/**
- * Update light perspective matrix, this is the perspective matrix used when creating
- * the shadow map. Use orthographic projection for directional light sources and perspective
- * projection for point light sources
- * @param mat
- */
-void sge::ToonShader::updateLightPerspectiveMat(const glm::mat4 &mat) const {
-    useShader();
-    glUniformMatrix4fv(lightPerspectivePos, 1, GL_FALSE, &mat[0][0]);
-}
-
-/**
- * Update light viewing matrix for shadow map. Should transform vertices from world space
- * to the current light source's space
- *
- * NOTE: If we want multiple shadow-casting light sources we'll need to scale this lighting perspective/viewing matrices
- * and the number of shadowmap objects up for the number of shadow-casting light sourcse
- * @param mat
- */
-void sge::ToonShader::updateLightViewMat(const glm::mat4 &mat) const {
-    useShader();
-    glUniformMatrix4fv(lightViewPos, 1, GL_FALSE, &mat[0][0]);
-}
-
-/**
- * Update light direction/position
- * Set homogenous coordinate to 0 for directional light sources
- * @param dir
- */
-void sge::ToonShader::updateLightDir(const glm::vec4 &dir) const {
-    useShader();
-    glUniform4fv(lightDirPos, 1, &dir[0]);
-}
-
-/**
- * Update point light position
- * @param pos
- */
-void sge::ToonShader::updateDanceBombInfo(const glm::vec3 &pos, bool danceBomb, bool discoLights) const {
-    useShader();
-    glUniform3fv(pointLightPositionPos, 1, &pos[0]);
-    glUniform1i(danceBombPos, (int)danceBomb);
-    glUniform1i(discoLightsPos, (int)discoLights);
-}
-
-/**
- * Set whether to draw outline for current object
- * @param outline
- */
-void sge::ToonShader::updateOutline(bool outline) const {
-    useShader();
-    glUniform1i(drawOutline, outline);
-}
-
-/**
- * Set the current season
- * @param season Current season (integer between 0 and 3 inclusive). 0 = spring, 1 = summer, 2 = fall, 3 = winter
- * @param blend Current blend factor with the next season. Should be a float between 0 and 1 inclusive
- */
-void sge::ToonShader::updateSeason(Season _season, float blend) {
-    useShader();
-    glUniform1i(curSeason, _season);
-    glUniform1f(seasonBlend, blend);
+    glState.uniform1i(cascadePos, cascade);
 }
 
 /**
@@ -317,39 +273,34 @@ void sge::ToonShader::updateSeason(Season _season, float blend) {
 void sge::ToonShader::setMaterialUniforms() {
 
     alternating = glGetUniformLocation(program, "multipleTextures");
-    textureIdx = glGetUniformLocation(program, "textureIdx");
     seasons = glGetUniformLocation(program, "seasons");
-    curSeason = glGetUniformLocation(program, "curSeason");
-    seasonBlend = glGetUniformLocation(program, "seasonBlend");
-    entityAlternateTextures = glGetUniformLocation(program, "entityAlternateTexture");
-    entitySeasons = glGetUniformLocation(program, "entitySeasons");
 
     hasDiffuseMap = glGetUniformLocation(program, "hasDiffuseMap");
     diffuseColor = glGetUniformLocation(program, "diffuseColor"); // array of diffuse colors
 
     diffuseTexturePos[0] = glGetUniformLocation(program, "diffuseTexture0");
-    glUniform1i(diffuseTexturePos[0], DIFFUSE_TEXTURE0);
+    glState.uniform1i(diffuseTexturePos[0], DIFFUSE_TEXTURE0);
     diffuseTexturePos[1] = glGetUniformLocation(program, "diffuseTexture1");
-    glUniform1i(diffuseTexturePos[1], DIFFUSE_TEXTURE1);
+    glState.uniform1i(diffuseTexturePos[1], DIFFUSE_TEXTURE1);
     diffuseTexturePos[2] = glGetUniformLocation(program, "diffuseTexture2");
-    glUniform1i(diffuseTexturePos[2], DIFFUSE_TEXTURE2);
+    glState.uniform1i(diffuseTexturePos[2], DIFFUSE_TEXTURE2);
     diffuseTexturePos[3] = glGetUniformLocation(program, "diffuseTexture3");
-    glUniform1i(diffuseTexturePos[3], DIFFUSE_TEXTURE3);
+    glState.uniform1i(diffuseTexturePos[3], DIFFUSE_TEXTURE3);
 
 
     hasSpecularMap = glGetUniformLocation(program, "hasSpecularMap");
     specularTexturePos = glGetUniformLocation(program, "specularTexture");
-    glUniform1i(specularTexturePos, SPECULAR_TEXTURE);
+    glState.uniform1i(specularTexturePos, SPECULAR_TEXTURE);
     specularColor = glGetUniformLocation(program, "specularColor");
 
     hasShinyMap = glGetUniformLocation(program, "hasShinyMap");
     shinyColor = glGetUniformLocation(program, "shinyColor");
     shinyTexturePos = glGetUniformLocation(program, "shinyTexture");
-    glUniform1i(shinyTexturePos, SHININESS_TEXTURE);
+    glState.uniform1i(shinyTexturePos, SHININESS_TEXTURE);
 
-    glActiveTexture(GL_TEXTURE0 + SHADOWMAP_TEXTURE);
+    glState.activeTexture(GL_TEXTURE0 + SHADOWMAP_TEXTURE);
     shadowMapTexturePos = glGetUniformLocation(program, "shadowMap");
-    glUniform1i(shadowMapTexturePos, SHADOWMAP_TEXTURE);
+    glState.uniform1i(shadowMapTexturePos, SHADOWMAP_TEXTURE);
 }
 
 /**
@@ -359,14 +310,6 @@ void sge::ToonShader::setMaterialUniforms() {
  */
 void sge::ToonShader::initShaderProgram(const std::string &vertexShaderPath, const std::string &fragmentShaderPath) {
     EntityShader::initShaderProgram(vertexShaderPath, fragmentShaderPath);
-    cameraPositionPos = glGetUniformLocation(program, "cameraPosition");
-    lightPerspectivePos = glGetUniformLocation(program, "lightPerspective");
-    lightViewPos = glGetUniformLocation(program, "lightView");
-    lightDirPos = glGetUniformLocation(program, "lightDir");
-    drawOutline = glGetUniformLocation(program, "drawOutline");
-    pointLightPositionPos = glGetUniformLocation(program, "pointLightPosition");
-    danceBombPos = glGetUniformLocation(program, "danceBomb");
-    discoLightsPos = glGetUniformLocation(program, "discoLights");
     setMaterialUniforms();
 }
 
@@ -379,21 +322,33 @@ void sge::ScreenShader::initShaderProgram(const std::string &vertexShaderPath, c
     ShaderProgram::initShaderProgram(vertexShaderPath, fragmentShaderPath);
     useShader();
     // Activate texture units and bind textures
-    glActiveTexture(GL_TEXTURE0);
+    glState.activeTexture(GL_TEXTURE0);
     GLint colorTexturePos = glGetUniformLocation(program, "colorTexture");
-    glUniform1i(colorTexturePos, 0);
+    glState.uniform1i(colorTexturePos, 0);
 
-    glActiveTexture(GL_TEXTURE0 + 1);
+    glState.activeTexture(GL_TEXTURE0 + 1);
     GLint normalTexturePos = glGetUniformLocation(program, "normalTexture");
-    glUniform1i(normalTexturePos, 1);
+    glState.uniform1i(normalTexturePos, 1);
 
-    glActiveTexture(GL_TEXTURE0 + 2);
+    glState.activeTexture(GL_TEXTURE0 + 2);
     GLint maskTexturePos = glGetUniformLocation(program, "maskTexture");
-    glUniform1i(maskTexturePos, 2);
+    glState.uniform1i(maskTexturePos, 2);
 
-    glActiveTexture(GL_TEXTURE0 + 3);
+    glState.activeTexture(GL_TEXTURE0 + 3);
     GLint depthTexturePos = glGetUniformLocation(program, "depthTexture");
-    glUniform1i(depthTexturePos, 3);
+    glState.uniform1i(depthTexturePos, 3);
+
+    renderScalePos = glGetUniformLocation(program, "renderScale");
+    updateRenderScale(glm::vec2(1));
+}
+
+/**
+ * How much of the postprocessor's framebuffer the scene was drawn to
+ * @param scale Fraction of the framebuffer's width and height
+ */
+void sge::ScreenShader::updateRenderScale(const glm::vec2 &scale) const {
+    useShader();
+    glState.uniform2fv(renderScalePos, 1, &scale[0]);
 }
 
 void CheckOpenGLError(const char* stmt, const char* fname, int line)
@@ -420,14 +375,12 @@ void sge::SkyboxShader::initShaderProgram(const std::string &vertexShaderPath, c
     ShaderProgram::initShaderProgram(vertexShaderPath, fragmentShaderPath);
     useShader();
 
-    perspective = glGetUniformLocation(program, "perspective");
-    view = glGetUniformLocation(program, "view");
     cubeMap = glGetUniformLocation(program, "cubeMap");
-    glUniform1i(cubeMap, 0);
+    glState.uniform1i(cubeMap, 0);
 
-    glActiveTexture(GL_TEXTURE0);
+    glState.activeTexture(GL_TEXTURE0);
     glGenTextures(1, &cubeTex);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubeTex);
+    glState.bindTexture(GL_TEXTURE_CUBE_MAP, cubeTex);
 
     // Load in textures for each face
     std::string skyboxDir = SetupParser::getValue("skybox-dir");
@@ -457,9 +410,9 @@ void sge::SkyboxShader::initShaderProgram(const std::string &vertexShaderPath, c
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    glState.bindTexture(GL_TEXTURE_CUBE_MAP, 0);
     glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    glState.bindVertexArray(VAO);
 
     float skyboxVertices[] = {
             // positions
@@ -513,25 +466,15 @@ void sge::SkyboxShader::initShaderProgram(const std::string &vertexShaderPath, c
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 }
 
-void sge::SkyboxShader::updatePerspectiveMat(const glm::mat4 &mat) const {
-    useShader();
-    glUniformMatrix4fv(perspective, 1, GL_FALSE, &mat[0][0]);
-}
-
-void sge::SkyboxShader::updateViewMat(const glm::mat4 &mat) const {
-    useShader();
-    glUniformMatrix4fv(view, 1, GL_FALSE, &mat[0][0]);
-}
-
 void sge::SkyboxShader::drawSkybox() {
     useShader();
-    glBindVertexArray(VAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubeTex);
+    glState.bindVertexArray(VAO);
+    glState.activeTexture(GL_TEXTURE0);
+    glState.bindTexture(GL_TEXTURE_2D, 0);
+    glState.bindTexture(GL_TEXTURE_CUBE_MAP, cubeTex);
     glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    glState.bindVertexArray(0);
+    glState.bindTexture(GL_TEXTURE_CUBE_MAP, 0);
 }
 
 /**
@@ -541,24 +484,25 @@ void sge::SkyboxShader::drawSkybox() {
  */
 void sge::Postprocesser::initPostprocessor() {
     screenProgram.useShader();
+    colorFormat = findFormat(colorFormats, SetupParser::getValue("gbuffer_color_format"));
+    normalFormat = findFormat(normalFormats, SetupParser::getValue("gbuffer_normal_format"));
     // Generate g-buffer/framebuffers for postprocessing (e.g. drawing cartoon outlines and bloom)
     glGenFramebuffers(1, &FBO.gBuffer);
     glBindFramebuffer(GL_FRAMEBUFFER, FBO.gBuffer);
 
     // Color/specular color buffer
     glGenTextures(1, &FBO.gColor);
-    glBindTexture(GL_TEXTURE_2D, FBO.gColor);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, sge::windowWidth, sge::windowHeight, 0, GL_RGBA, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glState.bindTexture(GL_TEXTURE_2D, FBO.gColor);
+    // Filtered so a scene drawn at a lower render scale is smoothly stretched back up
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, FBO.gColor, 0);
 
     // Normal color buffer
     glGenTextures(1, &FBO.gNormal);
-    glBindTexture(GL_TEXTURE_2D, FBO.gNormal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, sge::windowWidth, sge::windowHeight, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glState.bindTexture(GL_TEXTURE_2D, FBO.gNormal);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -567,8 +511,7 @@ void sge::Postprocesser::initPostprocessor() {
 
     // Mask to be used for various stuff
     glGenTextures(1, &FBO.gMask);
-    glBindTexture(GL_TEXTURE_2D, FBO.gMask);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32I, sge::windowWidth, sge::windowHeight, 0, GL_RED_INTEGER, GL_INT, nullptr);
+    glState.bindTexture(GL_TEXTURE_2D, FBO.gMask);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -578,14 +521,16 @@ void sge::Postprocesser::initPostprocessor() {
 
     // Depth buffer
     glGenTextures(1, &FBO.gStencilDepth);
-    glBindTexture(GL_TEXTURE_2D, FBO.gStencilDepth);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, sge::windowWidth, sge::windowHeight, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+    glState.bindTexture(GL_TEXTURE_2D, FBO.gStencilDepth);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, FBO.gStencilDepth, 0);
 
+    // Give them all storage in the formats setup.json picked
+    allocateTextures();
+
     if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
 
@@ -598,7 +543,7 @@ void sge::Postprocesser::initPostprocessor() {
     // If you think that's scuffed... blame OpenGL that's a pretty standard technique
     // Initialize the quad
     glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    glState.bindVertexArray(VAO);
     glGenBuffers(1, &VBO);
     GLfloat vertices[] = {
             1.0, -1.0, 1.0, 0.0,
@@ -617,7 +562,7 @@ void sge::Postprocesser::initPostprocessor() {
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
 }
 
 /**
@@ -625,12 +570,12 @@ void sge::Postprocesser::initPostprocessor() {
  * framebuffers
  */
 void sge::Postprocesser::deletePostprocessor() {
-    glDeleteVertexArrays(1, &VAO);
+    glState.deleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
-    glDeleteTextures(1, &FBO.gStencilDepth);
-    glDeleteTextures(1, &FBO.gNormal);
-    glDeleteTextures(1, &FBO.gMask);
-    glDeleteTextures(1, &FBO.gColor);
+    glState.deleteTextures(1, &FBO.gStencilDepth);
+    glState.deleteTextures(1, &FBO.gNormal);
+    glState.deleteTextures(1, &FBO.gMask);
+    glState.deleteTextures(1, &FBO.gColor);
     glDeleteFramebuffers(1, &FBO.gBuffer);
 }
 
@@ -638,11 +583,11 @@ void sge::Postprocesser::deletePostprocessor() {
  * Make future draws draw to the postprocessor's framebuffer
  */
 void sge::Postprocesser::drawToFramebuffer() const {
-    glViewport(0, 0, sge::windowWidth, sge::windowHeight);
+    glViewport(0, 0, getRenderWidth(), getRenderHeight());
     glBindFramebuffer(GL_FRAMEBUFFER, FBO.gBuffer);
     glClearColor(0.678f, 0.847f, 0.902f, 1.0f);  // light blue good sky :)
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_DEPTH_TEST);
+    glState.enable(GL_DEPTH_TEST);
 }
 
 /**
@@ -651,29 +596,55 @@ void sge::Postprocesser::drawToFramebuffer() const {
 void sge::Postprocesser::drawToScreen() const {
     // Unbind to switch to OpenGL's default framebuffer (the default framebuffer is what's actually rendered)
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // Everything from here on (the UI too) is drawn at the window's full resolution
+    glViewport(0, 0, sge::windowWidth, sge::windowHeight);
+    screenProgram.updateRenderScale(glm::vec2((float)getRenderWidth() / sge::windowWidth,
+                                              (float)getRenderHeight() / sge::windowHeight));
     glClearColor(1, 0, 0, 1.0f);  // light blue good sky :)
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glDisable(GL_DEPTH_TEST);
+    glState.disable(GL_DEPTH_TEST);
 
     // Set color normal and depth textures for postprocessor
-    glActiveTexture(GL_TEXTURE0 + 0);
-    glBindTexture(GL_TEXTURE_2D, FBO.gColor);
-//    glBindTexture(GL_TEXTURE_2D, shadowprocessor.FBO.gDepth);
-    glActiveTexture(GL_TEXTURE0 + 1);
-    glBindTexture(GL_TEXTURE_2D, FBO.gNormal);
+    glState.activeTexture(GL_TEXTURE0 + 0);
+    glState.bindTexture(GL_TEXTURE_2D, FBO.gColor);
+//    glState.bindTexture(GL_TEXTURE_2D, shadowprocessor.FBO.gDepth);
+    glState.activeTexture(GL_TEXTURE0 + 1);
+    glState.bindTexture(GL_TEXTURE_2D, FBO.gNormal);
 
-    glActiveTexture(GL_TEXTURE0 + 2);
-    glBindTexture(GL_TEXTURE_2D, FBO.gMask);
+    glState.activeTexture(GL_TEXTURE0 + 2);
+    glState.bindTexture(GL_TEXTURE_2D, FBO.gMask);
 
-    glActiveTexture(GL_TEXTURE0 + 3);
-    glBindTexture(GL_TEXTURE_2D, FBO.gStencilDepth);
+    glState.activeTexture(GL_TEXTURE0 + 3);
+    glState.bindTexture(GL_TEXTURE_2D, FBO.gStencilDepth);
     // Draw quad to screen - shaders will perform postprocessing
-    glBindVertexArray(VAO);
+    glState.bindVertexArray(VAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
+
+    glState.bindTexture(GL_TEXTURE_2D, 0);
+    glState.activeTexture(GL_TEXTURE0);
+}
 
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glActiveTexture(GL_TEXTURE0);
+/**
+ * Draw the scene at a fraction of the window's resolution from the next drawToFramebuffer on
+ * @param scale Fraction of the window's width and height, at most 1
+ */
+void sge::Postprocesser::setRenderScale(float scale) {
+    renderScale = scale;
+}
+
+/**
+ * Width of the part of the framebuffer the scene's drawn to
+ */
+int sge::Postprocesser::getRenderWidth() const {
+    return std::max(1, (int)std::round(sge::windowWidth * renderScale));
+}
+
+/**
+ * Height of the part of the framebuffer the scene's drawn to
+ */
+int sge::Postprocesser::getRenderHeight() const {
+    return std::max(1, (int)std::round(sge::windowHeight * renderScale));
 }
 
 /**
@@ -682,71 +653,268 @@ void sge::Postprocesser::drawToScreen() const {
  */
 void sge::Postprocesser::resizeFBO() const {
     screenProgram.useShader();
-    glBindTexture(GL_TEXTURE_2D, FBO.gColor);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, sge::windowWidth, sge::windowHeight, 0, GL_RGBA, GL_FLOAT, nullptr);
+    allocateTextures();
+}
 
-    glBindTexture(GL_TEXTURE_2D, FBO.gNormal);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, sge::windowWidth, sge::windowHeight, 0, GL_RGBA, GL_FLOAT, nullptr);
+/**
+ * (Re)create the g-buffer's textures at the window's size in their current formats
+ */
+void sge::Postprocesser::allocateTextures() const {
+    const TextureFormat *formats[] = {&colorFormats[colorFormat], &normalFormats[normalFormat], &maskFormat,
+                                      &depthStencilFormat};
+    GLuint textures[] = {FBO.gColor, FBO.gNormal, FBO.gMask, FBO.gStencilDepth};
+    for (int i = 0; i < 4; i++) {
+        glState.bindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, formats[i]->internalFormat, sge::windowWidth, sge::windowHeight, 0,
+                     formats[i]->format, formats[i]->type, nullptr);
+    }
+}
+
+/**
+ * Switch to the next combination of color and normal formats, to compare how they look and perform in game
+ * WARNING: THIS WILL CHANGE THE ACTIVE SHADER PROGRAM
+ */
+void sge::Postprocesser::cycleFormats() {
+    normalFormat = (normalFormat + 1) % NUM_NORMAL_FORMATS;
+    if (normalFormat == 0) {
+        colorFormat = (colorFormat + 1) % NUM_COLOR_FORMATS;
+    }
+    resizeFBO();
+}
+
+const sge::TextureFormat &sge::Postprocesser::getColorFormat() const {
+    return colorFormats[colorFormat];
+}
 
-    glBindTexture(GL_TEXTURE_2D, FBO.gMask);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32I, sge::windowWidth, sge::windowHeight, 0, GL_RED_INTEGER, GL_INT, nullptr);
+const sge::TextureFormat &sge::Postprocesser::getNormalFormat() const {
+    return normalFormats[normalFormat];
+}
 
-    glBindTexture(GL_TEXTURE_2D, FBO.gStencilDepth);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, sge::windowWidth, sge::windowHeight, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, nullptr);
+/**
+ * Bytes the g-buffer takes up for each pixel, across all its attachments
+ */
+int sge::Postprocesser::bytesPerPixel() const {
+    return getColorFormat().bytesPerPixel + getNormalFormat().bytesPerPixel + maskFormat.bytesPerPixel +
+           depthStencilFormat.bytesPerPixel;
 }
 
 /**
  * PRECONDITION: shadow shader program has already been initialized
- * Initialize shadow map framebuffers
+ * Initialize shadow map framebuffers, one per cascade for each of the shadow map and static shadow map's layers
  */
 void sge::ShadowMap::initShadowmap() {
     shadowProgram.useShader();
     shadowMapHeight = std::stoi(SetupParser::getValue("shadowmap-resolution"));
     shadowMapWidth = shadowMapHeight;
-    glGenFramebuffers(1, &FBO.gBuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, FBO.gBuffer);
-    glGenTextures(1, &FBO.gStencilDepth);
-    glBindTexture(GL_TEXTURE_2D, FBO.gStencilDepth);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT,
-                 shadowMapWidth, shadowMapHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    for (GLuint *texture : {&depthTexture, &staticDepthTexture}) {
+        glGenTextures(1, texture);
+        glState.bindTexture(GL_TEXTURE_2D_ARRAY, *texture);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        // Cascades don't tile, anything outside one is lit
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    allocateTextures();
+    glGenFramebuffers(SHADOW_CASCADES, cascadeFBOs);
+    glGenFramebuffers(SHADOW_CASCADES, staticFBOs);
+    for (int i = 0; i < SHADOW_CASCADES; i++) {
+        for (const auto &fb : {std::make_pair(cascadeFBOs[i], depthTexture),
+                               std::make_pair(staticFBOs[i], staticDepthTexture)}) {
+            glBindFramebuffer(GL_FRAMEBUFFER, fb.first);
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, fb.second, 0, i);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+
+            if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+        }
+    }
+}
+
+/**
+ * (Re)create both shadow maps' depth textures at the current resolution. They have to match exactly for the static
+ * shadows to be copied across
+ */
+void sge::ShadowMap::allocateTextures() const {
+    for (GLuint texture : {depthTexture, staticDepthTexture}) {
+        glState.bindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, shadowMapWidth, shadowMapHeight, SHADOW_CASCADES, 0,
+                     GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    }
+}
 
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, FBO.gStencilDepth, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
+/**
+ * Whether the light has moved far enough that the shadows should follow it. They're cast from the light's position
+ * the last time this returned true, so the static shadows don't have to be redrawn every time the light moves a bit
+ * @param lightPos Light position, used as the direction towards the light for directional lights
+ * @return True the first time, or if the light has moved more than STATIC_SHADOW_MAX_ANGLE since the last time
+ */
+bool sge::ShadowMap::lightMoved(const glm::vec3 &lightPos) {
+    glm::vec3 lightDir = glm::normalize(lightPos);
+    if (lightValid && glm::dot(lightDir, shadowLightDir) >= std::cos(glm::radians(STATIC_SHADOW_MAX_ANGLE))) {
+        return false;
+    }
+    shadowLightDir = lightDir;
+    lightValid = true;
+    return true;
+}
 
-    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+/**
+ * Fit each cascade's orthographic projection around its slice of the camera's view, filling in lightSpace and
+ * cascadeSplits.
+ * Each slice is wrapped in a sphere so the projection's size doesn't change as the camera turns, and it only moves in
+ * whole texel steps of 1 / CASCADE_SNAP_STEPS of its width, so shadow edges don't crawl as the camera moves and the
+ * static shadows only get redrawn every few steps the player takes
+ * @param cameraPerspective Camera's perspective projection matrix
+ * @param cameraView Camera's viewing matrix
+ * @param lightView Light's viewing matrix
+ */
+void sge::ShadowMap::fitCascades(const glm::mat4 &cameraPerspective, const glm::mat4 &cameraView,
+                                 const glm::mat4 &lightView) {
+    // Pull the frustum's shape back out of the projection matrix
+    float tanHalfFovY = 1.0f / cameraPerspective[1][1];
+    float tanHalfFovX = tanHalfFovY * cameraPerspective[1][1] / cameraPerspective[0][0];
+    float near = cameraPerspective[3][2] / (cameraPerspective[2][2] - 1.0f);
+    float far = std::min(SHADOW_DISTANCE, cameraPerspective[3][2] / (cameraPerspective[2][2] + 1.0f));
+
+    glm::mat4 cameraToLight = lightView * glm::inverse(cameraView);
+    float sliceNear = near;
+    for (int i = 0; i < SHADOW_CASCADES; i++) {
+        // Mix of even and logarithmic splits, logarithmic keeps the nearest cascade small
+        float t = (float)(i + 1) / SHADOW_CASCADES;
+        float sliceFar = CASCADE_SPLIT_LAMBDA * near * std::pow(far / near, t) +
+                         (1 - CASCADE_SPLIT_LAMBDA) * (near + (far - near) * t);
+
+        glm::vec3 corners[8];
+        glm::vec3 center(0);
+        for (int c = 0; c < 8; c++) {
+            float depth = c & 4 ? sliceFar : sliceNear;
+            corners[c] = glm::vec3((c & 1 ? 1 : -1) * tanHalfFovX * depth, (c & 2 ? 1 : -1) * tanHalfFovY * depth,
+                                   -depth);
+            center += corners[c] / 8.0f;
+        }
+        float radius = 0;
+        for (glm::vec3 &corner : corners) {
+            radius = std::max(radius, glm::length(corner - center));
+        }
+        // Round it up so floating point error can't change the projection's size from frame to frame
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        // Pad the box by a whole step so the sphere still fits after the center's snapped
+        float step = 2 * radius / CASCADE_SNAP_STEPS;
+        float halfWidth = radius + step;
+        float texel = 2 * halfWidth / shadowMapWidth;
+        step = std::max(1.0f, std::round(step / texel)) * texel;
+        glm::vec3 lightCenter = glm::vec3(cameraToLight * glm::vec4(center, 1));
+        lightCenter.x = std::floor(lightCenter.x / step) * step;
+        lightCenter.y = std::floor(lightCenter.y / step) * step;
+
+        glm::mat4 projection = glm::ortho(lightCenter.x - halfWidth, lightCenter.x + halfWidth,
+                                          lightCenter.y - halfWidth, lightCenter.y + halfWidth,
+                                          -SHADOW_DEPTH_RANGE, SHADOW_DEPTH_RANGE);
+        lightSpace[i] = projection * lightView;
+        cascadeSplits[i] = sliceFar;
+        sliceNear = sliceFar;
+    }
+}
+
+/**
+ * Whether a cascade's cached static shadows are out of date
+ * @param cascade Cascade to check
+ * @return True if they've never been drawn at this resolution, or the cascade or light has moved since they were
+ */
+bool sge::ShadowMap::needsStaticRedraw(int cascade) const {
+    return !staticValid[cascade] || staticLightSpace[cascade] != lightSpace[cascade];
 }
 
 /**
- * Future draws will now draw to the shadow map
+ * Future draws will draw to a cascade's static shadows, only static geometry should be drawn until drawToShadowmap
+ * @param cascade Cascade whose static shadows are being drawn
  */
-void sge::ShadowMap::drawToShadowmap() const {
+void sge::ShadowMap::drawToStaticShadowmap(int cascade) {
     glViewport(0, 0, shadowMapWidth, shadowMapHeight);
-    glBindFramebuffer(GL_FRAMEBUFFER, FBO.gBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, staticFBOs[cascade]);
+    glState.depthMask(GL_TRUE);
     glClear(GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_DEPTH_TEST);
+    glState.enable(GL_DEPTH_TEST);
+    staticLightSpace[cascade] = lightSpace[cascade];
+    staticValid[cascade] = true;
+    staticRedraws++;
+}
+
+/**
+ * Future draws will now draw to a cascade of the shadow map, which starts off with its static shadows already in it
+ * @param cascade Cascade to draw to
+ */
+void sge::ShadowMap::drawToShadowmap(int cascade) const {
+    glViewport(0, 0, shadowMapWidth, shadowMapHeight);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, staticFBOs[cascade]);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cascadeFBOs[cascade]);
+    glBlitFramebuffer(0, 0, shadowMapWidth, shadowMapHeight, 0, 0, shadowMapWidth, shadowMapHeight,
+                      GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, cascadeFBOs[cascade]);
+    glState.enable(GL_DEPTH_TEST);
+}
+
+/**
+ * Change each cascade's resolution, the static shadows get redrawn at the new one next frame
+ * @param resolution Width and height in texels
+ */
+void sge::ShadowMap::setResolution(int resolution) {
+    shadowMapWidth = resolution;
+    shadowMapHeight = resolution;
+    allocateTextures();
+    std::fill(std::begin(staticValid), std::end(staticValid), false);
+}
+
+int sge::ShadowMap::getResolution() const {
+    return shadowMapWidth;
 }
 
 /**
  * Delete shadow map framebuffers and textures
  */
 void sge::ShadowMap::deleteShadowmap() {
-    glDeleteFramebuffers(1, &FBO.gBuffer);
-    glDeleteTextures(1, &FBO.gStencilDepth);
+    glDeleteFramebuffers(SHADOW_CASCADES, cascadeFBOs);
+    glDeleteFramebuffers(SHADOW_CASCADES, staticFBOs);
+    glState.deleteTextures(1, &depthTexture);
+    glState.deleteTextures(1, &staticDepthTexture);
 }
 
 /**
  * Give toon shader the updated shadow map
  */
 void sge::ShadowMap::updateShadowmap() const {
-    glActiveTexture(GL_TEXTURE0 + SHADOWMAP_TEXTURE);
-    // We're using stencilDepth as the shadowmap's depth buffer
-    glBindTexture(GL_TEXTURE_2D, FBO.gStencilDepth);
+    glState.activeTexture(GL_TEXTURE0 + SHADOWMAP_TEXTURE);
+    glState.bindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+}
+
+/**
+ * Create the per-frame uniform buffer and bind it to its binding point, where it stays for the rest of the game
+ */
+void sge::FrameUniformBuffer::initBuffer() {
+    glGenBuffers(1, &UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/**
+ * Send this frame's camera and lighting state to every shader in one buffer write
+ */
+void sge::FrameUniformBuffer::upload() const {
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/**
+ * Delete the per-frame uniform buffer
+ */
+void sge::FrameUniformBuffer::deleteBuffer() {
+    glDeleteBuffers(1, &UBO);
 }
 
 /**
@@ -778,38 +946,19 @@ void sge::ParticleShader::initShaderProgram(const std::string &vertexShaderPath,
         std::cout << "Failed to link shaders\n";
         exit(EXIT_FAILURE);
     }
+    bindUniformBlocks();
 
-    perspectivePos = glGetUniformLocation(program, "perspective");
-    viewPos = glGetUniformLocation(program, "view");
     sizePos = glGetUniformLocation(program, "particleSize");
 }
 
 
-/**
- * Update perspective matrix for particle shader, needed to render particles at the correct position on the screen
- * @param mat
- */
-void sge::ParticleShader::updatePerspectiveMat(const glm::mat4 &mat) const {
-    useShader();
-    glUniformMatrix4fv(perspectivePos, 1, GL_FALSE, &mat[0][0]);
-}
-
-/**
- * Update camera view matrix for particle shader, needed to render particles at the correct position on the screen
- * @param mat
- */
-void sge::ParticleShader::updateViewMat(const glm::mat4 &mat) const {
-    useShader();
-    glUniformMatrix4fv(viewPos, 1, GL_FALSE, &mat[0][0]);
-}
-
 /**
  * Update base particle size before any form of transformation
  * @param size
  */
 void sge::ParticleShader::updateParticleSize(const float size) const {
     useShader();
-    glUniform1f(sizePos, size);
+    glState.uniform1f(sizePos, size);
 }
 
 // Ben's stuff above, that's why it's all documented :)
@@ -824,15 +973,13 @@ void sge::LineShaderProgram::initShaderProgram(const std::string &vertexShaderPa
     useShader();
 
     // pointers to uniforms location
-    viewPos = glGetUniformLocation(program, "view");
-    perspectivePos = glGetUniformLocation(program, "perspective");
     red = glGetUniformLocation(program, "red");
     green = glGetUniformLocation(program, "green");
     blue = glGetUniformLocation(program, "blue");
 
     // init VAO
     glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    glState.bindVertexArray(VAO);
 
     // init VBO
     glGenBuffers(1, &VBO);
@@ -849,25 +996,15 @@ void sge::LineShaderProgram::initShaderProgram(const std::string &vertexShaderPa
     glEnableVertexAttribArray(0);   // location 0
 
     // unbind for now (don't cause trouble for other shaders)
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-void sge::LineShaderProgram::updateViewMat(const glm::mat4 &mat) {
-    useShader();
-    glUniformMatrix4fv(viewPos, 1, GL_FALSE, &mat[0][0]);
-}
-
-void sge::LineShaderProgram::updatePerspectiveMat(const glm::mat4 &mat) {
-    useShader();
-    glUniformMatrix4fv(perspectivePos, 1, GL_FALSE, &mat[0][0]);
-}
-
 void sge::LineShaderProgram::renderBulletTrail(const glm::vec3& start, const glm::vec3& end) {
     useShader();
-    glUniform1f(red, 0.5 + 0.5 * std::sin(t));
-    glUniform1f(green, 0.2 + 0.5 * std::sin(t+3.14f));
-    glUniform1f(blue, 0.5 + 0.5 * std::cos(t+3.14f));
+    glState.uniform1f(red, 0.5 + 0.5 * std::sin(t));
+    glState.uniform1f(green, 0.2 + 0.5 * std::sin(t+3.14f));
+    glState.uniform1f(blue, 0.5 + 0.5 * std::cos(t+3.14f));
     t += 0.1f;
 
     // Calculate additional vertices for the prism
@@ -888,7 +1025,7 @@ void sge::LineShaderProgram::renderBulletTrail(const glm::vec3& start, const glm
 
 
     // Bind VAO, VBO, and EBO
-    glBindVertexArray(VAO);
+    glState.bindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
     // Buffer vertices and indices
@@ -897,12 +1034,12 @@ void sge::LineShaderProgram::renderBulletTrail(const glm::vec3& start, const glm
     // Draw the triangular cone
     glDrawElements(GL_TRIANGLES, sizeof(indices)/sizeof(GLint), GL_UNSIGNED_INT, 0);
     // Unbind VAO and VBO
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void sge::LineShaderProgram::deleteLineShader() {
-    glDeleteVertexArrays(1, &VAO);
+    glState.deleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
 }
@@ -919,13 +1056,13 @@ void sge::CrosshairShaderProgram::initShaderProgram(const std::string &vertexSha
     // store uniform location
     float aspectRatio = (float)sge::windowHeight/(float)sge::windowWidth;
     aspectRatioPos = glGetUniformLocation(program, "aspectRatio");
-    glUniform1f(aspectRatioPos, aspectRatio);
+    glState.uniform1f(aspectRatioPos, aspectRatio);
 
     scalePos = glGetUniformLocation(program, "scale");
 
     // init VAO
     glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    glState.bindVertexArray(VAO);
 
     // init VBO
     glGenBuffers(1, &VBO);
@@ -942,13 +1079,13 @@ void sge::CrosshairShaderProgram::initShaderProgram(const std::string &vertexSha
     glEnableVertexAttribArray(0);   // location 0
 
     // unbind for now (don't cause trouble for other shaders)
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 }
 
 void sge::CrosshairShaderProgram::deleteLineUI() {
-    glDeleteVertexArrays(1, &VAO);
+    glState.deleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
 }
@@ -957,14 +1094,14 @@ void sge::CrosshairShaderProgram::drawCrossHair(float emo) {
 
     useShader();
 
-    glUniform1f(scalePos, emo/2.0+0.5);
+    glState.uniform1f(scalePos, emo/2.0+0.5);
 
     // Bind VAO, VBO, and EBO
-    glBindVertexArray(VAO);
+    glState.bindVertexArray(VAO);
 
     glDrawElements(GL_LINES, sizeof(indices)/sizeof(GLint), GL_UNSIGNED_INT, 0);
 
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
 }
 
 
@@ -976,14 +1113,14 @@ void sge::UIShaderProgram::initShaderProgram(const std::string &vertexShaderPath
     // store uniform location
     float aspectRatio = (float)sge::windowHeight/(float)sge::windowWidth;
     aspectRatioPos = glGetUniformLocation(program, "aspectRatio");
-    glUniform1f(aspectRatioPos, aspectRatio);
+    glState.uniform1f(aspectRatioPos, aspectRatio);
 
     transPos = glGetUniformLocation(program, "trans");
     alphaPos = glGetUniformLocation(program, "alpha");
 
     // init VAO
     glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    glState.bindVertexArray(VAO);
 
     // init VBO
     glGenBuffers(1, &VBO);
@@ -1002,7 +1139,7 @@ void sge::UIShaderProgram::initShaderProgram(const std::string &vertexShaderPath
 
 
     // unbind for now (don't cause trouble for other shaders)
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 }
@@ -1013,17 +1150,17 @@ void sge::UIShaderProgram::drawUI(float width, float height, float xOffset, floa
 
 void sge::UIShaderProgram::drawUI(float width, float height, float xOffset, float yOffset, float scale, GLuint texture, float alpha) {
     useShader();
-    glUniform1f(alphaPos, alpha);  // transparency
+    glState.uniform1f(alphaPos, alpha);  // transparency
 
     glm::mat3 trans (
         scale,  0,  xOffset, 
         0,  scale,  yOffset,
         0,  0,      1
     );
-    glUniformMatrix3fv(transPos, 1, GL_TRUE, &trans[0][0]);
+    glState.uniformMatrix3fv(transPos, 1, GL_TRUE, &trans[0][0]);
 
     // Bind VAO, VBO, and EBO
-    glBindVertexArray(VAO);
+    glState.bindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
     // this width and height should be from the loaded image (texture)
@@ -1039,12 +1176,12 @@ void sge::UIShaderProgram::drawUI(float width, float height, float xOffset, floa
     glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(boxVertices), boxVertices);
 
     // Bind texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
+    glState.activeTexture(GL_TEXTURE0);
+    glState.bindTexture(GL_TEXTURE_2D, texture);
 
     glDrawElements(GL_TRIANGLES, sizeof(indices)/sizeof(GLuint), GL_UNSIGNED_INT, 0);
 
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
     
 }
 
@@ -1059,11 +1196,11 @@ void sge::TextShaderProgram::initShaderProgram(const std::string &vertexShaderPa
     projectionPos = glGetUniformLocation(program, "projection");
     // DO NOT CHANGE NUMBERS IN THIS ORTHOGRAPHICS PROJ MATRIX (EVEN IF WE USE A DIFFERENT SCREEN SIZE)
     glm::mat4 projection = glm::ortho(0.0f, 1400.0f, 0.0f, 800.0f, 0.0f, 100.0f);
-    glUniformMatrix4fv(projectionPos, 1, GL_FALSE, &projection[0][0]);
+    glState.uniformMatrix4fv(projectionPos, 1, GL_FALSE, &projection[0][0]);
 
     // init VAO
     glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    glState.bindVertexArray(VAO);
 
     // init VBO
     glGenBuffers(1, &VBO);
@@ -1075,7 +1212,7 @@ void sge::TextShaderProgram::initShaderProgram(const std::string &vertexShaderPa
 
 
     // unbind for now (don't cause trouble for other shaders)
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 }
@@ -1088,9 +1225,9 @@ void sge::TextShaderProgram::renderText(std::string text, float x, float y, floa
     
     useShader();
 
-    glUniform3f(glGetUniformLocation(program, "textColor"), color.x, color.y, color.z);
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(VAO);
+    glState.uniform3f(glGetUniformLocation(program, "textColor"), color.x, color.y, color.z);
+    glState.activeTexture(GL_TEXTURE0);
+    glState.bindVertexArray(VAO);
 
     // iterate through all characters
     std::string::const_iterator c;
@@ -1114,7 +1251,7 @@ void sge::TextShaderProgram::renderText(std::string text, float x, float y, floa
             { xpos + w, ypos + h,   1.0f, 0.0f }           
         };
         // render glyph texture over quad
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
+        glState.bindTexture(GL_TEXTURE_2D, ch.TextureID);
         // update content of VBO memory
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices); 
@@ -1124,8 +1261,8 @@ void sge::TextShaderProgram::renderText(std::string text, float x, float y, floa
         // now advance cursors for next glyph (note that advance is number of 1/64 pixels)
         x += (ch.Advance >> 6) * scale; // bitshift by 6 to get value in pixels (2^6 = 64)
     }
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glState.bindVertexArray(0);
+    glState.bindTexture(GL_TEXTURE_2D, 0);
 }
 
 
@@ -1138,17 +1275,13 @@ void sge::BillboardProgram::initShaderProgram(const std::string &vertexShaderPat
     // pointers to uniforms location
     billboardCenterPos = glGetUniformLocation(program, "billboardCenter");
     billboardDimensionPos = glGetUniformLocation(program, "billboardDimension");
-    CameraRightPos = glGetUniformLocation(program, "CameraRight");
-    CameraUpPos = glGetUniformLocation(program, "CameraUp");
-    viewPos = glGetUniformLocation(program, "view");
-    projectionPos = glGetUniformLocation(program, "projection");
 
     glm::vec2 billboardSize = glm::vec2(0.5f, 0.5f);
-    glUniform2fv(billboardDimensionPos, 1, &billboardSize[0]);
+    glState.uniform2fv(billboardDimensionPos, 1, &billboardSize[0]);
 
     // init VAO
     glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    glState.bindVertexArray(VAO);
 
     // init VBO
     glGenBuffers(1, &VBO);
@@ -1164,27 +1297,11 @@ void sge::BillboardProgram::initShaderProgram(const std::string &vertexShaderPat
     glEnableVertexAttribArray(1);  // location 1
 
     // unbind for now (don't cause trouble for other shaders)
-    glBindVertexArray(0);
+    glState.bindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 }
 
-void sge::BillboardProgram::updateViewMat(const glm::mat4 &mat) {
-    useShader();
-    glUniformMatrix4fv(viewPos, 1, GL_FALSE, &mat[0][0]);
-}
-
-void sge::BillboardProgram::updatePerspectiveMat(const glm::mat4 &mat) {
-    useShader();
-    glUniformMatrix4fv(projectionPos, 1, GL_FALSE, &mat[0][0]);
-}
-
-void sge::BillboardProgram::updateCameraOrientation(const glm::vec3 &cameraRight, const glm::vec3 &cameraUp) {
-    useShader();
-    glUniform3fv(CameraRightPos, 1, &cameraRight[0]);
-    glUniform3fv(CameraUpPos, 1, &cameraUp[0]);
-}
-
 void sge::BillboardProgram::renderPlayerTag(const glm::vec3 &playerPos, GLuint textureID) {
     renderPlayerTag(playerPos, textureID, 1.0f);
 }
@@ -1202,20 +1319,20 @@ void sge::BillboardProgram::renderPlayerTag(const glm::vec3 &playerPos, GLuint t
 
     // pass uniforms to shader
     glm::vec3 billboardPosition = playerPos + glm::vec3(0,1.3,0); // tag distance above player
-    glUniform3fv(billboardCenterPos, 1, &billboardPosition[0]);
+    glState.uniform3fv(billboardCenterPos, 1, &billboardPosition[0]);
 
     // Bind VAO, VBO
-    glBindVertexArray(VAO);
+    glState.bindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
     glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
     // Bind texture
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    glState.activeTexture(GL_TEXTURE0);
+    glState.bindTexture(GL_TEXTURE_2D, textureID);
 
     // Draw the quad
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glState.bindVertexArray(0);
+    glState.bindTexture(GL_TEXTURE_2D, 0);
 }
\ No newline at end of file
@@ -0,0 +1,821 @@
+#include "sge/ModelData.h"
+#include "SetupParser.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <assimp/material.h>
+#include <stb_image.h>
+// Only the cooker compresses textures, keep the encoder private to this file
+#define STB_DXT_STATIC
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <cassert>
+
+/**
+ * Converts an assimp matrix (row-major) to a GLM matrix (column-major)
+ * @param mat
+ * @return
+ */
+static glm::mat4 assimpToGlmMat4(aiMatrix4x4 mat) {
+    return glm::mat4(mat[0][0], mat[1][0], mat[2][0], mat[3][0],
+                     mat[0][1], mat[1][1], mat[2][1], mat[3][1],
+                     mat[0][2], mat[1][2], mat[2][2], mat[3][2],
+                     mat[0][3], mat[1][3], mat[2][3], mat[3][3]);
+}
+
+/**
+ * Index of the keyframe at or before time, so time falls between keys[i] and keys[i + 1]
+ */
+template <typename Key>
+static unsigned int keyframeBefore(const Key *keys, unsigned int numKeys, double time) {
+    const Key *after = std::upper_bound(keys, keys + numKeys, time, [](double t, const Key &key) { return t < key.mTime; });
+    return after == keys ? 0 : (unsigned int)(after - keys) - 1;
+}
+
+/**
+ * Linearly interpolate position or scale keyframes, holds the first/last key outside of them
+ */
+static glm::vec3 sampleVectorKeys(const aiVectorKey *keys, unsigned int numKeys, double time, glm::vec3 noKeys) {
+    if (numKeys == 0) return noKeys;
+    unsigned int i = keyframeBefore(keys, numKeys, time);
+    const aiVector3D &v1 = keys[i].mValue;
+    if (i + 1 >= numKeys || time <= keys[i].mTime) {
+        return glm::vec3(v1.x, v1.y, v1.z);
+    }
+    const aiVector3D &v2 = keys[i + 1].mValue;
+    float scalar = (time - keys[i].mTime) / (keys[i + 1].mTime - keys[i].mTime);
+    return glm::mix(glm::vec3(v1.x, v1.y, v1.z), glm::vec3(v2.x, v2.y, v2.z), scalar);
+}
+
+/**
+ * Spherically interpolate rotation keyframes, holds the first/last key outside of them
+ */
+static glm::quat sampleRotationKeys(const aiQuatKey *keys, unsigned int numKeys, double time) {
+    if (numKeys == 0) return glm::quat(1, 0, 0, 0);
+    unsigned int i = keyframeBefore(keys, numKeys, time);
+    const aiQuaternion &q1 = keys[i].mValue;
+    if (i + 1 >= numKeys || time <= keys[i].mTime) {
+        return glm::quat(q1.w, q1.x, q1.y, q1.z);
+    }
+    const aiQuaternion &q2 = keys[i + 1].mValue;
+    float scalar = (time - keys[i].mTime) / (keys[i + 1].mTime - keys[i].mTime);
+    return glm::normalize(glm::slerp(glm::quat(q1.w, q1.x, q1.y, q1.z), glm::quat(q2.w, q2.x, q2.y, q2.z), scalar));
+}
+
+/**
+ * Everything importModel collects before laying it out like a baked file
+ */
+struct ImportedModel {
+    std::vector<sge::ModelVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<sge::BakedMesh> meshes;
+    std::vector<sge::BakedMaterial> materials;
+    std::vector<sge::BakedTexture> textures;
+    std::vector<unsigned char> texturePixels;
+    std::vector<glm::mat4> offsetMatrices;
+    std::vector<sge::BakedBoneNode> boneNodes;
+    std::vector<sge::BakedAnimation> animations;
+    std::vector<sge::BakedChannel> channels;
+    std::vector<sge::BoneSample> boneSamples;
+    std::unordered_map<std::string, unsigned int> boneMap; // Maps Assimp bone names to bone ids
+    std::filesystem::path parentDirectory; // Directory the model is in, textures are relative to it
+    bool animated;
+    bool compressTextures;
+
+    /**
+     * Bone id for a bone name, giving it the next id (and an offset matrix) the first time it's seen
+     */
+    unsigned int boneId(const std::string &boneName, const glm::mat4 &offsetMatrix) {
+        if (!boneMap.count(boneName)) {
+            // Don't load the same bone twice
+            boneMap[boneName] = boneMap.size();
+            offsetMatrices.push_back(offsetMatrix);
+        }
+        return boneMap[boneName];
+    }
+
+    void loadMesh(const aiMesh &mesh, const sge::BakedMesh &bakedMesh);
+    void loadBone(const aiBone &bone, const sge::BakedMesh &bakedMesh);
+    void loadMaterials(const aiScene *scene);
+    int loadTexture(aiTextureType type, const aiScene *scene, const aiMaterial &material);
+    void addTexture(const unsigned char *pixels, uint32_t width, uint32_t height, uint32_t channels, enum TexType type);
+    void loadAnimation(const aiAnimation &animation);
+    bool flattenBoneHierarchy(const aiNode *node, bool isRoot);
+};
+
+/**
+ * Add a mesh's vertices, faces and (for animated models) vertex weights
+ */
+void ImportedModel::loadMesh(const aiMesh &mesh, const sge::BakedMesh &bakedMesh) {
+    assert(mesh.mNormals != nullptr);
+    assert(mesh.mVertices != nullptr);
+    for (unsigned int i = 0; i < mesh.mNumVertices; i++) {
+        sge::ModelVertex vertex = {};
+        vertex.position = glm::vec3(mesh.mVertices[i][0], mesh.mVertices[i][1], mesh.mVertices[i][2]);
+        vertex.normal = glm::vec3(mesh.mNormals[i][0], mesh.mNormals[i][1], mesh.mNormals[i][2]);
+        if (mesh.HasTextureCoords(0)) {
+            //  Third coordinate is always 0 (Because Assimp is dumb), we can ignore it
+            vertex.texcoord = glm::vec2(mesh.mTextureCoords[0][i][0], mesh.mTextureCoords[0][i][1]);
+        }
+        for (unsigned int j = 0; j < MAX_BONE_INFLUENCE; j++) {
+            vertex.boneIds[j] = -1;
+        }
+        vertices.push_back(vertex);
+    }
+
+    for (unsigned int i = 0; i < mesh.mNumFaces; i++) {
+        const aiFace &face = mesh.mFaces[i];
+        indices.push_back(face.mIndices[0]);
+        indices.push_back(face.mIndices[1]);
+        indices.push_back(face.mIndices[2]);
+    }
+
+    if (animated) {
+        for (unsigned int i = 0; i < mesh.mNumBones; i++) {
+            loadBone(*mesh.mBones[i], bakedMesh);
+        }
+    }
+}
+
+/**
+ * Give a bone an id and add its weights to the vertices it influences
+ */
+void ImportedModel::loadBone(const aiBone &bone, const sge::BakedMesh &bakedMesh) {
+    unsigned int id = boneId(bone.mName.C_Str(), assimpToGlmMat4(bone.mOffsetMatrix));
+
+    for (unsigned int i = 0; i < bone.mNumWeights; i++) {
+        const aiVertexWeight &curweight = bone.mWeights[i];
+        if (curweight.mWeight == 0) continue;
+        // Vertex ids are relative to the mesh, not the entire model (blame assimp)
+        sge::ModelVertex &vertex = vertices[bakedMesh.baseVertex + curweight.mVertexId];
+        bool weightAdded = false;
+        for (unsigned int j = 0; j < MAX_BONE_INFLUENCE; j++) {
+            if (vertex.boneIds[j] < 0) {
+                vertex.boneWeights[j] = curweight.mWeight;
+                vertex.boneIds[j] = id;
+                weightAdded = true;
+                break;
+            }
+        }
+        if (!weightAdded) {
+            std::cout << "Warning: Exceeded maximum number of bones per vertex, ignoring remaining weights" << std::endl;
+        }
+    }
+}
+
+/**
+ * Loads all material properties from a scene, decoding any textures they use
+ * @param scene Scene to load materials from
+ */
+void ImportedModel::loadMaterials(const aiScene *scene) {
+    for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
+        const aiMaterial &mat = *scene->mMaterials[i];
+        aiColor4D color(0.f, 0.f, 0.f, 0.0f);
+
+        sge::BakedMaterial baked;
+        baked.diffuse = glm::vec3(-1.0f);
+        baked.specular = glm::vec3(0.0f);
+        baked.shininess = glm::vec3(0.0f);
+
+        // We only allow blending between textures, not material colors
+        // because .mtl files don't support many color types
+        if (mat.Get(AI_MATKEY_COLOR_DIFFUSE, color) == AI_SUCCESS) {
+            baked.diffuse = glm::vec3(color.r, color.g, color.b);
+        }
+        if (mat.Get(AI_MATKEY_COLOR_SPECULAR, color) == AI_SUCCESS) {
+            baked.specular = glm::vec3(color.r, color.g, color.b);
+        }
+        float shininessTmp;
+        aiReturn ret = mat.Get(AI_MATKEY_SHININESS, shininessTmp);
+        if (ret == AI_SUCCESS) {
+            baked.shininess = glm::vec3(shininessTmp); // This is intentional, putting them all to R
+        }
+
+        baked.diffuseMap[0] = loadTexture(aiTextureType_DIFFUSE, scene, mat);
+        baked.diffuseMap[1] = loadTexture(aiTextureType_HEIGHT, scene, mat);
+        baked.diffuseMap[2] = loadTexture(aiTextureType_EMISSIVE, scene, mat);
+        baked.diffuseMap[3] = loadTexture(aiTextureType_AMBIENT, scene, mat);
+        baked.specularMap = loadTexture(aiTextureType_SPECULAR, scene, mat);
+        baked.shinyMap = loadTexture(aiTextureType_SHININESS, scene, mat);
+
+        if (ret != AI_SUCCESS || (shininessTmp == 0 && baked.diffuseMap[1] == -1)) {
+            baked.specular = glm::vec3(0); // No shininess
+        }
+        materials.push_back(baked);
+    }
+}
+
+/**
+ * Decode a material's texture into the model's texture table
+ * @param type Type of texture to load e.g. specular, diffuse, etc.
+ * @param scene Assimp scene object we're loading textures from
+ * @param material Material we're loading texture for
+ * @return Index of the texture in the model's texture table, -1 if there isn't one
+ */
+int ImportedModel::loadTexture(aiTextureType type, const aiScene *scene, const aiMaterial &material) {
+    aiString path;
+    if (material.GetTexture(type, 0, &path) != AI_SUCCESS) {
+        return -1;
+    }
+
+    // Build path to texture file
+    std::string textureAbsolutePath = parentDirectory.string() + path.C_Str();
+
+    int width, height, channels;
+    unsigned char *imgData;
+    bool fromStb = true;
+    // We still need to handle embedded textures since the character models are in .glb file format
+    if (const aiTexture *texture = scene->GetEmbeddedTexture(path.C_Str())) {
+        if (texture->mHeight == 0) { // Compressed image format
+            imgData = stbi_load_from_memory((unsigned char *)texture->pcData, texture->mWidth, &width, &height, &channels, 0);
+        } else {
+            std::cout << "Warning: this case of texture is not properly handled\n";
+            // Raw texels, Assimp stores these as BGRA
+            imgData = reinterpret_cast<unsigned char*>(texture->pcData);
+            width = texture->mWidth;
+            height = texture->mHeight;
+            channels = 4;
+            fromStb = false;
+        }
+    } else {
+        // If assimp failed to load it, load it the classic way
+        imgData = stbi_load(textureAbsolutePath.c_str(), &width, &height, &channels, 0);
+    }
+
+    // No image
+    if (imgData == nullptr) {
+        std::cout << "Error in loading the texture image: " << textureAbsolutePath << std::endl;
+        return -1;
+    }
+
+    // Switch to our type of texture enum
+    // To handle alternate textures for each season, we export each texture as alternate texture types
+    // from Blender. It's scuffed but it works (probably)
+    enum TexType sgeType;
+    switch (type) {
+        case aiTextureType_DIFFUSE:
+            sgeType = DIFFUSE_TEXTURE0;
+            break;
+        case aiTextureType_HEIGHT:
+            sgeType = DIFFUSE_TEXTURE1;
+            break;
+        case aiTextureType_EMISSIVE:
+            sgeType = DIFFUSE_TEXTURE2;
+            break;
+        case aiTextureType_AMBIENT:
+            sgeType = DIFFUSE_TEXTURE3;
+            break;
+        case aiTextureType_SPECULAR:
+            sgeType = SPECULAR_TEXTURE;
+            break;
+        case aiTextureType_SHININESS:
+            sgeType = SHININESS_TEXTURE;
+            break;
+        default:
+            sgeType = UNKNOWN_TEXTYPE;
+            break;
+    }
+
+    addTexture(imgData, width, height, channels, sgeType);
+    if (fromStb) {
+        stbi_image_free(imgData);
+    }
+    return textures.size() - 1;
+}
+
+/**
+ * Halve an image with a box filter, the last row/column of an odd sized image gets averaged with itself
+ */
+static std::vector<unsigned char> halveImage(const unsigned char *pixels, uint32_t width, uint32_t height, uint32_t channels) {
+    uint32_t halfWidth = std::max(1u, width / 2);
+    uint32_t halfHeight = std::max(1u, height / 2);
+    std::vector<unsigned char> half((size_t)halfWidth * halfHeight * channels);
+    for (uint32_t y = 0; y < halfHeight; y++) {
+        uint32_t y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for (uint32_t x = 0; x < halfWidth; x++) {
+            uint32_t x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            for (uint32_t c = 0; c < channels; c++) {
+                unsigned int sum = pixels[((size_t)y0 * width + x0) * channels + c] + pixels[((size_t)y0 * width + x1) * channels + c]
+                    + pixels[((size_t)y1 * width + x0) * channels + c] + pixels[((size_t)y1 * width + x1) * channels + c];
+                half[((size_t)y * halfWidth + x) * channels + c] = (sum + 2) / 4;
+            }
+        }
+    }
+    return half;
+}
+
+/**
+ * Compress an RGB or RGBA image to BC1 or BC3 blocks. Blocks hanging off the edge repeat the last row/column
+ */
+static void compressImage(const unsigned char *pixels, uint32_t width, uint32_t height, uint32_t channels, bool alpha,
+                          std::vector<unsigned char> &out) {
+    unsigned char block[16 * 4];
+    unsigned char compressed[16];
+    size_t blockBytes = alpha ? 16 : 8;
+    for (uint32_t by = 0; by < height; by += 4) {
+        for (uint32_t bx = 0; bx < width; bx += 4) {
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t x = std::min(bx + i % 4, width - 1);
+                uint32_t y = std::min(by + i / 4, height - 1);
+                const unsigned char *pixel = pixels + ((size_t)y * width + x) * channels;
+                block[i * 4 + 0] = pixel[0];
+                block[i * 4 + 1] = pixel[1];
+                block[i * 4 + 2] = pixel[2];
+                block[i * 4 + 3] = channels == 4 ? pixel[3] : 255;
+            }
+            // It's offline, so take the slower but better fit
+            stb_compress_dxt_block(compressed, block, alpha, STB_DXT_HIGHQUAL);
+            out.insert(out.end(), compressed, compressed + blockBytes);
+        }
+    }
+}
+
+/**
+ * Add a decoded image to the model's texture table with its whole mip chain, compressed if we're cooking
+ */
+void ImportedModel::addTexture(const unsigned char *pixels, uint32_t width, uint32_t height, uint32_t channels, enum TexType type) {
+    sge::BakedTexture baked;
+    baked.width = width;
+    baked.height = height;
+    baked.channels = channels;
+    baked.type = type;
+    baked.pixelOffset = texturePixels.size();
+    baked.format = sge::TEXTURE_RAW;
+    if (compressTextures && (channels == 3 || channels == 4)) {
+        baked.format = channels == 4 ? sge::TEXTURE_BC3 : sge::TEXTURE_BC1;
+    }
+    baked.numLevels = 1;
+    while ((width >> baked.numLevels) > 0 || (height >> baked.numLevels) > 0) {
+        baked.numLevels++;
+    }
+
+    std::vector<unsigned char> level(pixels, pixels + (size_t)width * height * channels);
+    for (uint32_t i = 0; i < baked.numLevels; i++) {
+        uint32_t levelWidth = sge::textureLevelWidth(baked, i);
+        uint32_t levelHeight = sge::textureLevelHeight(baked, i);
+        if (i > 0) {
+            level = halveImage(level.data(), sge::textureLevelWidth(baked, i - 1), sge::textureLevelHeight(baked, i - 1), channels);
+        }
+        if (baked.format == sge::TEXTURE_RAW) {
+            texturePixels.insert(texturePixels.end(), level.begin(), level.end());
+        } else {
+            compressImage(level.data(), levelWidth, levelHeight, channels, baked.format == sge::TEXTURE_BC3, texturePixels);
+        }
+        assert(texturePixels.size() - baked.pixelOffset == sge::textureLevelOffset(baked, i) + sge::textureLevelSize(baked, i));
+        // Keep the next level (and everything after the pixels) 4-byte aligned
+        texturePixels.resize((texturePixels.size() + 3) & ~(size_t)3);
+    }
+    textures.push_back(baked);
+}
+
+/**
+ * Resample an animation's keyframes at ANIMATION_SAMPLE_RATE so every channel has a pose at the same evenly spaced times
+ * @param animation
+ */
+void ImportedModel::loadAnimation(const aiAnimation &animation) {
+    sge::BakedAnimation baked;
+    baked.duration = animation.mDuration;
+    baked.ticksPerSecond = animation.mTicksPerSecond;
+    // Assimp leaves this at 0 when the file doesn't say
+    double ticksPerSample = (animation.mTicksPerSecond > 0 ? animation.mTicksPerSecond : 25.0) / ANIMATION_SAMPLE_RATE;
+    baked.ticksPerSample = ticksPerSample;
+    baked.numSamples = (uint32_t)std::ceil(animation.mDuration / ticksPerSample) + 1;
+    baked.firstChannel = channels.size();
+    baked.numChannels = animation.mNumChannels;
+
+    for (unsigned int i = 0; i < animation.mNumChannels; i++) {
+        const aiNodeAnim &channel = *animation.mChannels[i];
+        // Load missing bones in animation, to maintain invariant that offset matrices can always be indexed by bone id, tho this matrix (should) never be used
+        sge::BakedChannel bakedChannel;
+        bakedChannel.boneId = boneId(channel.mNodeName.C_Str(), glm::mat4(1));
+        bakedChannel.firstSample = boneSamples.size();
+        channels.push_back(bakedChannel);
+
+        for (unsigned int sample = 0; sample < baked.numSamples; sample++) {
+            double time = std::min(sample * ticksPerSample, animation.mDuration);
+            sge::BoneSample pose;
+            pose.position = sampleVectorKeys(channel.mPositionKeys, channel.mNumPositionKeys, time, glm::vec3(0));
+            pose.rotation = sampleRotationKeys(channel.mRotationKeys, channel.mNumRotationKeys, time);
+            pose.scale = sampleVectorKeys(channel.mScalingKeys, channel.mNumScalingKeys, time, glm::vec3(1));
+            boneSamples.push_back(pose);
+        }
+    }
+    animations.push_back(baked);
+}
+
+/**
+ * PRECONDITION: All meshes and animations already loaded so every bone has an id
+ *
+ * Append the bone hierarchy under node in depth-first order
+ * @return Whether the node was kept. Assimp is dumb and adds a bunch of extra nodes in the hierarchy tree with
+ * identity matrix relative transformations, nodes that aren't bones and have no bones under them are dropped
+ */
+bool ImportedModel::flattenBoneHierarchy(const aiNode *node, bool isRoot) {
+    size_t index = boneNodes.size();
+    sge::BakedBoneNode baked;
+    std::string boneName = node->mName.C_Str();
+    baked.id = boneMap.count(boneName) ? boneMap[boneName] : -1;
+    baked.relativeTransform = assimpToGlmMat4(node->mTransformation);
+    baked.numChildren = 0;
+    boneNodes.push_back(baked);
+
+    for (unsigned int i = 0; i < node->mNumChildren; i++) {
+        if (flattenBoneHierarchy(node->mChildren[i], false)) {
+            boneNodes[index].numChildren++;
+        }
+    }
+    if (!isRoot && baked.id == -1 && boneNodes[index].numChildren == 0) {
+        boneNodes.pop_back();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Index just past the subtree of the bone node at index, or UINT32_MAX if the subtree runs off the end or uses a bone that isn't there
+ */
+static uint32_t subtreeEnd(const sge::BakedBoneNode *nodes, uint32_t numNodes, uint32_t numBones, uint32_t index) {
+    if (index >= numNodes || nodes[index].id >= (int32_t)numBones) {
+        return UINT32_MAX;
+    }
+    uint32_t next = index + 1;
+    for (uint32_t i = 0; i < nodes[index].numChildren && next != UINT32_MAX; i++) {
+        next = subtreeEnd(nodes, numNodes, numBones, next);
+    }
+    return next;
+}
+
+namespace sge {
+
+    uint32_t textureLevelWidth(const BakedTexture &texture, uint32_t level) {
+        return std::max(1u, texture.width >> level);
+    }
+
+    uint32_t textureLevelHeight(const BakedTexture &texture, uint32_t level) {
+        return std::max(1u, texture.height >> level);
+    }
+
+    size_t textureLevelSize(const BakedTexture &texture, uint32_t level) {
+        size_t width = textureLevelWidth(texture, level);
+        size_t height = textureLevelHeight(texture, level);
+        if (texture.format == TEXTURE_RAW) {
+            return width * height * texture.channels;
+        }
+        size_t blocks = ((width + 3) / 4) * ((height + 3) / 4);
+        return blocks * (texture.format == TEXTURE_BC1 ? 8 : 16);
+    }
+
+    size_t textureLevelOffset(const BakedTexture &texture, uint32_t level) {
+        size_t offset = 0;
+        for (uint32_t i = 0; i < level; i++) {
+            offset += (textureLevelSize(texture, i) + 3) & ~(size_t)3;
+        }
+        return offset;
+    }
+
+    /**
+     * Unpack a BC1 color block's endpoints and palette into 4 RGBA colors
+     * @param fourColors Always use the 4 color palette (BC3 color blocks do), otherwise c0 <= c1 picks the 3 color + transparent one
+     */
+    static void bcPalette(const unsigned char *block, bool fourColors, unsigned char palette[4][4]) {
+        uint16_t c[2] = { (uint16_t)(block[0] | block[1] << 8), (uint16_t)(block[2] | block[3] << 8) };
+        for (int i = 0; i < 2; i++) {
+            palette[i][0] = ((c[i] >> 11) & 31) * 255 / 31;
+            palette[i][1] = ((c[i] >> 5) & 63) * 255 / 63;
+            palette[i][2] = (c[i] & 31) * 255 / 31;
+            palette[i][3] = 255;
+        }
+        for (int j = 0; j < 4; j++) {
+            if (fourColors || c[0] > c[1]) {
+                palette[2][j] = (2 * palette[0][j] + palette[1][j]) / 3;
+                palette[3][j] = (palette[0][j] + 2 * palette[1][j]) / 3;
+            } else {
+                palette[2][j] = (palette[0][j] + palette[1][j]) / 2;
+                palette[3][j] = 0;
+            }
+        }
+    }
+
+    std::vector<unsigned char> decompressTextureLevel(const BakedTexture &texture, uint32_t level, const unsigned char *blocks) {
+        uint32_t width = textureLevelWidth(texture, level);
+        uint32_t height = textureLevelHeight(texture, level);
+        std::vector<unsigned char> pixels((size_t)width * height * 4);
+        bool alpha = texture.format == TEXTURE_BC3;
+        for (uint32_t by = 0; by < height; by += 4) {
+            for (uint32_t bx = 0; bx < width; bx += 4) {
+                unsigned char alphas[16];
+                if (alpha) {
+                    // 2 endpoints, then a 3 bit index per pixel into the 8 alphas between them
+                    unsigned char a[8] = { blocks[0], blocks[1] };
+                    for (int i = 1; i < 7; i++) {
+                        a[i + 1] = a[0] > a[1] ? ((7 - i) * a[0] + i * a[1]) / 7
+                                   : i < 5 ? ((5 - i) * a[0] + i * a[1]) / 5 : (i == 5 ? 0 : 255);
+                    }
+                    uint64_t bits = 0;
+                    for (int i = 0; i < 6; i++) {
+                        bits |= (uint64_t)blocks[2 + i] << (8 * i);
+                    }
+                    for (int i = 0; i < 16; i++) {
+                        alphas[i] = a[(bits >> (3 * i)) & 7];
+                    }
+                    blocks += 8;
+                }
+                unsigned char palette[4][4];
+                bcPalette(blocks, alpha, palette);
+                uint32_t indices = blocks[4] | blocks[5] << 8 | blocks[6] << 16 | (uint32_t)blocks[7] << 24;
+                blocks += 8;
+
+                for (uint32_t i = 0; i < 16; i++) {
+                    uint32_t x = bx + i % 4, y = by + i / 4;
+                    if (x >= width || y >= height) {
+                        continue;
+                    }
+                    unsigned char *pixel = &pixels[((size_t)y * width + x) * 4];
+                    std::memcpy(pixel, palette[(indices >> (2 * i)) & 3], 4);
+                    if (alpha) {
+                        pixel[3] = alphas[i];
+                    }
+                }
+            }
+        }
+        return pixels;
+    }
+
+    std::unique_ptr<ModelData> ModelData::load(const std::string &sourceFilePath) {
+        auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<ModelData> model = loadBaked(bakedPathFor(sourceFilePath), sourceFilePath);
+        if (model == nullptr) {
+            std::printf("importing %s instead, run model_cooker to make this fast\n", sourceFilePath.c_str());
+            model = importModel(sourceFilePath);
+            if (model == nullptr) {
+                return nullptr;
+            }
+        }
+        double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::printf("%s: %u vertices, %u textures, %u animations, %zu KB %s, loaded in %.1fms\n",
+            std::filesystem::path(sourceFilePath).filename().string().c_str(), model->header.numVertices, model->header.numTextures,
+            model->header.numAnimations, model->memoryUsage() / 1024, model->isMapped() ? "mapped from the baked file" : "imported", loadMs);
+        return model;
+    }
+
+    std::string ModelData::bakedPathFor(const std::string &sourceFilePath) {
+        return std::filesystem::path(sourceFilePath).replace_extension(BAKED_MODEL_EXTENSION).string();
+    }
+
+    std::unique_ptr<ModelData> ModelData::loadBaked(const std::string &bakedFilePath, const std::string &sourceFilePath) {
+        std::unique_ptr<ModelData> model(new ModelData());
+        if (!model->mappedFile.open(bakedFilePath)) {
+            std::printf("no baked model at %s\n", bakedFilePath.c_str());
+            return nullptr;
+        }
+        if (!model->attach(model->mappedFile.data(), model->mappedFile.size(), bakedFilePath)) {
+            return nullptr;
+        }
+        SourceStamp source;
+        if (readSourceStamp(sourceFilePath, source) && source != model->header.source) {
+            std::printf("%s was baked from a different %s, re-cook it\n", bakedFilePath.c_str(), sourceFilePath.c_str());
+            return nullptr;
+        }
+        return model;
+    }
+
+    bool ModelData::attach(const char *data, size_t size, const std::string &name) {
+        if (size < sizeof(BakedModelHeader)) {
+            std::printf("%s is too small to be a baked model\n", name.c_str());
+            return false;
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != BAKED_MODEL_MAGIC || header.version != BAKED_MODEL_VERSION || header.vertexSize != sizeof(ModelVertex)
+            || header.animationSampleRate != ANIMATION_SAMPLE_RATE) {
+            std::printf("%s is from a different version of the game (version %u), re-cook it\n", name.c_str(), header.version);
+            return false;
+        }
+
+        uint64_t expectedSize = (uint64_t)header.numVertices * sizeof(ModelVertex) + (uint64_t)header.numIndices * sizeof(uint32_t)
+            + (uint64_t)header.numMeshes * sizeof(BakedMesh) + (uint64_t)header.numMaterials * sizeof(BakedMaterial)
+            + (uint64_t)header.numTextures * sizeof(BakedTexture) + header.texturePixelBytes
+            + (uint64_t)header.numBones * sizeof(glm::mat4) + (uint64_t)header.numBoneNodes * sizeof(BakedBoneNode)
+            + (uint64_t)header.numAnimations * sizeof(BakedAnimation) + (uint64_t)header.numChannels * sizeof(BakedChannel)
+            + (uint64_t)header.numBoneSamples * sizeof(BoneSample);
+        if (header.payloadSize != expectedSize || size - sizeof(header) != expectedSize) {
+            std::printf("%s is truncated or has extra data (%zu bytes, expected %llu)\n", name.c_str(), size, (unsigned long long)(expectedSize + sizeof(header)));
+            return false;
+        }
+        const char *payload = data + sizeof(header);
+        if (hashBytes(payload, header.payloadSize) != header.checksum) {
+            std::printf("%s is corrupt (checksum mismatch)\n", name.c_str());
+            return false;
+        }
+
+        vertices = (const ModelVertex*)payload;
+        indices = (const uint32_t*)(vertices + header.numVertices);
+        meshes = (const BakedMesh*)(indices + header.numIndices);
+        materials = (const BakedMaterial*)(meshes + header.numMeshes);
+        textures = (const BakedTexture*)(materials + header.numMaterials);
+        texturePixels = (const unsigned char*)(textures + header.numTextures);
+        offsetMatrices = (const glm::mat4*)(texturePixels + header.texturePixelBytes);
+        boneNodes = (const BakedBoneNode*)(offsetMatrices + header.numBones);
+        animations = (const BakedAnimation*)(boneNodes + header.numBoneNodes);
+        channels = (const BakedChannel*)(animations + header.numAnimations);
+        boneSamples = (const BoneSample*)(channels + header.numChannels);
+
+        // The sections are only checked as a whole, make sure nothing inside them points outside
+        for (uint32_t i = 0; i < header.numMeshes; i++) {
+            if ((uint64_t)meshes[i].baseIndex + meshes[i].numIndices > header.numIndices || meshes[i].materialIndex >= header.numMaterials) {
+                std::printf("%s has a mesh outside of the model\n", name.c_str());
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < header.numMaterials; i++) {
+            const BakedMaterial &mat = materials[i];
+            int32_t maps[6] = { mat.diffuseMap[0], mat.diffuseMap[1], mat.diffuseMap[2], mat.diffuseMap[3], mat.specularMap, mat.shinyMap };
+            for (int j = 0; j < 6; j++) {
+                if (maps[j] >= (int32_t)header.numTextures) {
+                    std::printf("%s has a material using a texture that isn't there\n", name.c_str());
+                    return false;
+                }
+            }
+        }
+        for (uint32_t i = 0; i < header.numTextures; i++) {
+            const BakedTexture &texture = textures[i];
+            if (texture.width == 0 || texture.height == 0 || texture.channels == 0 || texture.channels > 4 || texture.format > TEXTURE_BC3
+                || texture.numLevels == 0 || texture.numLevels > 32 || (texture.format != TEXTURE_RAW && texture.channels < 3)) {
+                std::printf("%s has a texture it doesn't know how to load\n", name.c_str());
+                return false;
+            }
+            if ((texture.width >> (texture.numLevels - 1)) == 0 && (texture.height >> (texture.numLevels - 1)) == 0) {
+                std::printf("%s has a texture with more mip levels than it has pixels for\n", name.c_str());
+                return false;
+            }
+            if ((uint64_t)texture.pixelOffset + textureLevelOffset(texture, texture.numLevels) > header.texturePixelBytes) {
+                std::printf("%s has a texture outside of the model\n", name.c_str());
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < header.numAnimations; i++) {
+            if ((uint64_t)animations[i].firstChannel + animations[i].numChannels > header.numChannels) {
+                std::printf("%s has an animation outside of the model\n", name.c_str());
+                return false;
+            }
+            for (uint32_t j = animations[i].firstChannel; j < animations[i].firstChannel + animations[i].numChannels; j++) {
+                if ((uint64_t)channels[j].firstSample + animations[i].numSamples > header.numBoneSamples || channels[j].boneId < 0
+                    || channels[j].boneId >= (int32_t)header.numBones) {
+                    std::printf("%s has an animation outside of the model\n", name.c_str());
+                    return false;
+                }
+            }
+        }
+        if (header.animated && (header.numBoneNodes == 0 || subtreeEnd(boneNodes, header.numBoneNodes, header.numBones, 0) != header.numBoneNodes)) {
+            std::printf("%s has a broken bone hierarchy\n", name.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool ModelData::writeBaked(const std::string &bakedFilePath) const {
+        std::ofstream file(bakedFilePath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::printf("couldn't open %s for writing\n", bakedFilePath.c_str());
+            return false;
+        }
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)vertices, header.payloadSize);
+        return (bool)file;
+    }
+
+    /**
+     * Import a model with Assimp and lay it out exactly like a baked file so both ways of loading end up the same
+     * @param sourceFilePath Path to .obj/.glb file specifying the model
+     */
+    std::unique_ptr<ModelData> ModelData::importModel(const std::string &sourceFilePath, bool compressTextures) {
+        Assimp::Importer importer;
+        const aiScene *scene = importer.ReadFile(sourceFilePath, ASSIMP_IMPORT_FLAGS);
+        if (scene == nullptr) {
+            std::cerr << "Unable to load 3d model from path " << sourceFilePath << std::endl;
+            return nullptr;
+        }
+        // per thread, models are imported on asset loader threads
+        stbi_set_flip_vertically_on_load_thread(false);
+
+        ImportedModel imported;
+        imported.parentDirectory = std::filesystem::path(sourceFilePath).remove_filename();
+        imported.animated = scene->HasAnimations();
+        imported.compressTextures = compressTextures;
+
+        // Work out where each mesh starts first, so vectors don't continually reallocate when loading larger models
+        unsigned int numVertices = 0;
+        unsigned int numIndices = 0;
+        for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+            const aiMesh &mesh = *scene->mMeshes[i];
+            // NumIndices = 3 * NumFaces as each face is a triangle, which consists of 3 vertices. Each index references a specific vertex
+            imported.meshes.push_back({ mesh.mNumFaces * 3, numVertices, numIndices, mesh.mMaterialIndex });
+            numVertices += mesh.mNumVertices;
+            numIndices += mesh.mNumFaces * 3;
+        }
+        imported.vertices.reserve(numVertices);
+        imported.indices.reserve(numIndices);
+
+        for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+            imported.loadMesh(*scene->mMeshes[i], imported.meshes[i]);
+        }
+
+        glm::mat4 animationGlobalInverse(1);
+        if (imported.animated) {
+            // Loading bones handled by loadMesh (loadMesh does not load bone hierarchy)
+            for (unsigned int i = 0; i < scene->mNumAnimations; i++) {
+                imported.loadAnimation(*scene->mAnimations[i]);
+            }
+            animationGlobalInverse = assimpToGlmMat4(scene->mRootNode->mTransformation.Inverse());
+            // A bit of a hack since glb files are rotated 90 degrees
+            animationGlobalInverse = glm::rotate(glm::mat4(1), glm::radians(90.0f), glm::vec3(0, 1, 0)) * animationGlobalInverse;
+            imported.flattenBoneHierarchy(scene->mRootNode, true);
+        }
+        imported.loadMaterials(scene);
+        importer.FreeScene();
+
+        std::unique_ptr<ModelData> model(new ModelData());
+        BakedModelHeader &header = model->header;
+        header.magic = BAKED_MODEL_MAGIC;
+        header.version = BAKED_MODEL_VERSION;
+        // Assimp just read it, so it's there
+        readSourceStamp(sourceFilePath, header.source);
+        header.vertexSize = sizeof(ModelVertex);
+        header.animationSampleRate = ANIMATION_SAMPLE_RATE;
+        header.animated = imported.animated;
+        header.numVertices = imported.vertices.size();
+        header.numIndices = imported.indices.size();
+        header.numMeshes = imported.meshes.size();
+        header.numMaterials = imported.materials.size();
+        header.numTextures = imported.textures.size();
+        header.texturePixelBytes = imported.texturePixels.size();
+        header.numBones = imported.offsetMatrices.size();
+        header.numBoneNodes = imported.boneNodes.size();
+        header.numAnimations = imported.animations.size();
+        header.numChannels = imported.channels.size();
+        header.numBoneSamples = imported.boneSamples.size();
+        header.animationGlobalInverse = animationGlobalInverse;
+
+        std::vector<char> &data = model->importedData;
+        data.resize(sizeof(header));
+        auto append = [&data](const auto &section) {
+            const char *bytes = (const char*)section.data();
+            data.insert(data.end(), bytes, bytes + section.size() * sizeof(section[0]));
+        };
+        append(imported.vertices);
+        append(imported.indices);
+        append(imported.meshes);
+        append(imported.materials);
+        append(imported.textures);
+        append(imported.texturePixels);
+        append(imported.offsetMatrices);
+        append(imported.boneNodes);
+        append(imported.animations);
+        append(imported.channels);
+        append(imported.boneSamples);
+        header.payloadSize = data.size() - sizeof(header);
+        header.checksum = hashBytes(data.data() + sizeof(header), header.payloadSize);
+        std::memcpy(data.data(), &header, sizeof(header));
+
+        bool attached = model->attach(data.data(), data.size(), sourceFilePath);
+        assert(attached);
+        return model;
+    }
+
+    std::vector<std::string> modelSourcePaths() {
+        std::string pathPrefix = (std::string)(PROJECT_PATH) + "/client/models/";
+
+        // NOTE: ENSURE THAT FILEPATHS FOLLOWS THE SAME ORDERING AS MODELINDEX ENUM IN GRAPHICSCONSTANTS.H
+        // Modify ModelIndex enum to add more models
+        std::string filePaths[NUM_MODELS] =
+                {
+                SetupParser::getValue("map-path"),
+                "characters/rabbit-dance.glb",
+                "characters/bear-dance.glb",
+                "characters/fox-dance.glb",
+                "characters/penguin-dance.glb",
+                "egg.obj",
+                "empty_obj.obj",
+                "empty_obj.obj",
+                "empty_obj.obj",
+                "empty_obj.obj",
+                "map/water.obj"
+                };
+        std::vector<std::string> paths;
+        for (unsigned int i = 0; i < NUM_MODELS; i++) {
+            paths.push_back(pathPrefix + filePaths[i]);
+        }
+        return paths;
+    }
+}
@@ -0,0 +1,219 @@
+#include "sge/RenderQueue.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <functional>
+
+sge::RenderQueue sge::renderQueue;
+
+/**
+ * Add an entity's settings to a pass
+ * @param pass Pass the entity's meshes will be drawn in
+ * @param instance Model matrix, pose and entity settings
+ * @return Index for the entity's draw items to refer to it by
+ */
+unsigned int sge::RenderQueue::addInstance(RenderPass pass, const DrawInstance &instance) {
+    instances[pass].push_back(instance);
+    boneOffsets[pass].push_back(instance.pose != nullptr ? bonePalette.add(*instance.pose) : 0);
+    return instances[pass].size() - 1;
+}
+
+/**
+ * Queue a mesh to be drawn
+ * @param pass Pass to draw it in
+ * @param item Mesh, material, VAO and the instance it belongs to (from addInstance on the same pass)
+ */
+void sge::RenderQueue::submit(RenderPass pass, const DrawItem &item) {
+    assert(item.instance < instances[pass].size());
+    items[pass].push_back(item);
+}
+
+/**
+ * Create the buffer every pass's instance data goes in
+ */
+void sge::RenderQueue::initInstanceBuffer() {
+    glGenBuffers(1, &instanceBuffer);
+}
+
+void sge::RenderQueue::deleteInstanceBuffer() {
+    glDeleteBuffers(1, &instanceBuffer);
+}
+
+/**
+ * Order draws so the ones that share state end up next to each other. Static draws go by material first since the map
+ * switches between lots of them, then by mesh so every entity drawing the same mesh ends up in one instanced draw.
+ * Animated draws keep each entity together instead, since each of them only has a few materials
+ */
+static bool drawsBefore(const sge::DrawItem &a, const sge::DrawItem &b) {
+    if (a.animated != b.animated) {
+        return a.animated < b.animated;
+    }
+    if (a.animated && a.instance != b.instance) {
+        return a.instance < b.instance;
+    }
+    if (a.material != b.material) {
+        return std::less<const sge::Material *>()(a.material, b.material);
+    }
+    if (a.VAO != b.VAO) {
+        return a.VAO < b.VAO;
+    }
+    if (a.mesh != b.mesh) {
+        return std::less<const sge::Mesh *>()(a.mesh, b.mesh);
+    }
+    return a.instance < b.instance;
+}
+
+/**
+ * Whether two draws next to each other once sorted can be one instanced draw. Skinned draws never are, each entity
+ * needs its own pose
+ */
+static bool sameBatch(const sge::DrawItem &a, const sge::DrawItem &b) {
+    return !a.animated && !b.animated && a.mesh == b.mesh && a.material == b.material;
+}
+
+/**
+ * The instance data the vertex shaders get for an entity
+ */
+static sge::InstanceData packInstance(const sge::DrawInstance &instance) {
+    sge::InstanceData data;
+    data.model = instance.model;
+    data.flags = glm::ivec4(instance.outline, instance.alternateTextures, instance.textureIdx, instance.seasons);
+    return data;
+}
+
+/**
+ * A run of sorted draw items that goes to OpenGL as one draw call
+ */
+struct DrawBatch {
+    size_t item; // First item in the run
+    unsigned int count; // Number of items (instances) in the run
+    size_t first; // Where the run's instance data starts
+};
+
+/**
+ * PRECONDITION: the pass's framebuffer is bound
+ * Draw everything queued for a pass, only telling OpenGL about state that's different from the draw before
+ * WARNING: THIS WILL CHANGE THE ACTIVE SHADER PROGRAM
+ * @param pass Pass to draw
+ */
+void sge::RenderQueue::execute(RenderPass pass) {
+    std::vector<DrawItem> &passItems = items[pass];
+    std::vector<DrawInstance> &passInstances = instances[pass];
+    RenderQueueStats &passStats = stats[pass];
+    std::sort(passItems.begin(), passItems.end(), drawsBefore);
+    // Poses this pass added that earlier passes didn't
+    bonePalette.upload();
+
+    // Each entity gets its own slot (the same index as in passInstances) for draws of just that entity. Draws of several
+    // entities at once need theirs next to each other, so they get copies after that
+    instanceData.clear();
+    for (const DrawInstance &instance : passInstances) {
+        instanceData.push_back(packInstance(instance));
+    }
+    std::vector<DrawBatch> batches;
+    std::vector<unsigned int> batchInstances, lastCopied;
+    size_t lastCopiedFirst = 0;
+    for (size_t i = 0; i < passItems.size();) {
+        DrawBatch batch = {i, 1, passItems[i].instance};
+        batchInstances.assign(1, passItems[i].instance);
+        while (i + batch.count < passItems.size() && sameBatch(passItems[i], passItems[i + batch.count])) {
+            batchInstances.push_back(passItems[i + batch.count].instance);
+            batch.count++;
+        }
+        if (batch.count > 1) {
+            // A model's meshes are usually all visible for the same entities, so they can share one copy
+            if (batchInstances != lastCopied) {
+                lastCopiedFirst = instanceData.size();
+                for (unsigned int instance : batchInstances) {
+                    instanceData.push_back(instanceData[instance]);
+                }
+                lastCopied = batchInstances;
+            }
+            batch.first = lastCopiedFirst;
+        }
+        batches.push_back(batch);
+        i += batch.count;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instanceData.size() * sizeof(InstanceData), instanceData.data(), GL_STREAM_DRAW);
+
+    EntityShader &program = pass == SHADOW_PASS ? shadowProgram : defaultProgram;
+    program.useShader();
+
+    // Nothing's been set yet, so the first draw sets everything
+    bool first = true;
+    bool animated = false;
+    GLuint VAO = 0;
+    const Material *material = nullptr;
+    size_t pointedAt = 0; // Instance data the VAO's per-instance attributes start at
+    const ModelPose *pose = nullptr;
+
+    for (const DrawBatch &batch : batches) {
+        const DrawItem &item = passItems[batch.item];
+        if (first || item.animated != animated) {
+            program.setAnimated(item.animated);
+            animated = item.animated;
+        }
+        // Attribute pointers belong to the VAO, so a different VAO has to be pointed at the instance data again
+        bool newVAO = first || item.VAO != VAO;
+        if (newVAO) {
+            glState.bindVertexArray(item.VAO);
+            VAO = item.VAO;
+            passStats.vaoChanges++;
+        }
+        if (newVAO || batch.first != pointedAt) {
+            pointInstanceAttributes(batch.first);
+            pointedAt = batch.first;
+            passStats.instanceChanges++;
+        }
+        const ModelPose *itemPose = passInstances[item.instance].pose;
+        if (itemPose != nullptr && itemPose != pose) {
+            program.updateBoneOffset(boneOffsets[pass][item.instance]);
+            pose = itemPose;
+        }
+        if (item.material != nullptr && item.material != material) {
+            item.material->setShaderMaterial();
+            material = item.material;
+            passStats.materialChanges++;
+        }
+        first = false;
+
+        const Mesh &mesh = *item.mesh;
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.NumIndices, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * mesh.BaseIndex),
+                                          batch.count, mesh.BaseVertex);
+        passStats.draws++;
+        passStats.instances += batch.count;
+    }
+    glState.bindVertexArray(0);
+
+    passItems.clear();
+    passInstances.clear();
+    boneOffsets[pass].clear();
+}
+
+/**
+ * PRECONDITION: the VAO to draw with is bound
+ * OpenGL 3.3 can't start an instanced draw partway through the instance attributes, so the attributes start at the
+ * draw's instances instead
+ * @param first Index of the draw's first instance in instanceData
+ */
+void sge::RenderQueue::pointInstanceAttributes(size_t first) {
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    size_t start = first * sizeof(InstanceData);
+    for (int i = 0; i < 4; i++) {
+        glVertexAttribPointer(INSTANCE_MODEL_POS + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void*)(start + offsetof(InstanceData, model) + sizeof(glm::vec4) * i));
+    }
+    glVertexAttribIPointer(INSTANCE_FLAGS_POS, 4, GL_INT, sizeof(InstanceData), (void*)(start + offsetof(InstanceData, flags)));
+}
+
+/**
+ * Start counting draws and state changes from zero and empty the bone palette, once per frame
+ */
+void sge::RenderQueue::beginFrame() {
+    for (RenderQueueStats &passStats : stats) {
+        passStats = RenderQueueStats();
+    }
+    bonePalette.clear();
+}
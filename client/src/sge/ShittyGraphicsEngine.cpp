@@ -3,6 +3,8 @@
 //
 #include "sge/ShittyGraphicsEngine.h"
 
+#include <set>
+
 GLFWwindow *sge::window;
 int sge::windowHeight, sge::windowWidth;
 
@@ -46,9 +48,9 @@ void sge::sgeInit()
     // std::printf("window fucking size %d, %d\n", sge::windowWidth, sge::windowHeight);  // why is it 2x on mac?
 
     glViewport(0, 0, sge::windowWidth, sge::windowHeight);
-    glEnable(GL_DEPTH_TEST);   // Only render stuff closest to camera
-    glEnable(GL_STENCIL_TEST); // TODO: is to allow for rendering outlines around objects later. (e.g. outline around egg or something)
-    glEnable(GL_CULL_FACE);
+    glState.enable(GL_DEPTH_TEST);   // Only render stuff closest to camera
+    glState.enable(GL_STENCIL_TEST); // TODO: is to allow for rendering outlines around objects later. (e.g. outline around egg or something)
+    glState.enable(GL_CULL_FACE);
 
 
     // NOTE: I move all these to separate functions because of the UI
@@ -74,16 +76,8 @@ void sge::secondStageInit() {
 
     // Set default camera perspective projection matrix
     perspectiveMat = glm::perspective(glm::radians(90.0f), (float)sge::windowWidth / (float)sge::windowHeight, 0.5f, 1000.0f);
-    particleProgram.useShader();
-    particleProgram.updatePerspectiveMat(perspectiveMat);
-    defaultProgram.useShader();
-    defaultProgram.updatePerspectiveMat(perspectiveMat);
-    skyboxProgram.useShader();
-    skyboxProgram.updatePerspectiveMat(perspectiveMat);
-    lineShaderProgram.useShader();
-    lineShaderProgram.updatePerspectiveMat(perspectiveMat);
-
-    billboardProgram.updatePerspectiveMat(perspectiveMat);
+    frameUniforms.data.perspective = perspectiveMat;
+    dynamicResolution.initTimers();
 
     generator.seed(std::random_device()()); // Seed random number generator used by particle system
 }
@@ -92,9 +86,15 @@ void sge::secondStageInit() {
  * Gracefully end shitty graphics engine
  */
 void sge::sgeClose() {
+    // stop decoding before anything it would decode into goes away
+    assetLoader.reset();
     models.clear();
     postprocessor.deletePostprocessor();
     shadowprocessor.deleteShadowmap();
+    frameUniforms.deleteBuffer();
+    bonePalette.deletePalette();
+    renderQueue.deleteInstanceBuffer();
+    dynamicResolution.deleteTimers();
     lineShaderProgram.deleteLineShader();
     crosshairShaderProgram.deleteLineUI();
     deleteTextures();
@@ -102,32 +102,36 @@ void sge::sgeClose() {
 }
 
 /**
- * Load models from disk into GraphicsGeometry.h's models vector
+ * Queue the models on the asset loader, each one lands in GraphicsGeometry.h's models vector once
+ * it's been uploaded. Entries are nullptr until then, assetLoader->finish() before drawing any
  */
 void sge::loadModels() {
-    // Avoid potentially needing to copy models to a new underlying vector, modelcomposites are fat, so much memory usage :(
-    models.reserve(NUM_MODELS);
-    std::string pathPrefix = (std::string)(PROJECT_PATH) + "/client/models/";
-    
-    // NOTE: ENSURE THAT FILEPATHS FOLLOWS THE SAME ORDERING AS MODELINDEX ENUM IN GRAPHICSGEOMETRY.H
-    // Modify ModelIndex enum to add more models
-    std::string filePaths[NUM_MODELS] =
-            {
-            SetupParser::getValue("map-path"),
-            "characters/rabbit-dance.glb",
-            "characters/bear-dance.glb",
-            "characters/fox-dance.glb",
-            "characters/penguin-dance.glb",
-            "egg.obj",
-            "empty_obj.obj",
-            "empty_obj.obj",
-            "empty_obj.obj",
-            "empty_obj.obj",
-            "map/water.obj"
-            };
+    models.clear();
+    models.resize(NUM_MODELS);
+
+    // Models that need their vertices or texture pixels on the CPU after they're uploaded (none do yet),
+    // every other model's data is freed as soon as it's on the GPU
+    const std::set<ModelIndex> retainCpuData = {};
+
+    // Modify ModelIndex enum and modelSourcePaths to add more models
+    std::vector<std::string> filePaths = modelSourcePaths();
     for (unsigned int i = 0; i < NUM_MODELS; i++) {
-        models.push_back(std::make_unique<ModelComposite>(pathPrefix + filePaths[i]));
+        std::string filePath = filePaths[i];
+        bool retain = retainCpuData.count((ModelIndex)i) > 0;
+        assetLoader->load([i, filePath, retain]() -> AssetUpload {
+            // shared so the upload can be copied into a std::function
+            std::shared_ptr<ModelData> data = ModelData::load(filePath);
+            if (data == nullptr) {
+                std::cerr << "Unable to load 3d model from path " << filePath << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            return [i, filePath, data, retain]() {
+                models[i] = std::make_unique<ModelComposite>(filePath, data, retain);
+                if (i == BEAR) {
+                    // manually set the bear to use animation 0, tick 500 when not moving
+                    models[BEAR]->setStillAnimation(0, 500);
+                }
+            };
+        });
     }
-    // manually set the bear to use animation 0, tick 500 when not moving
-    models[BEAR]->setStillAnimation(0, 500);
 }
@@ -21,8 +21,8 @@ namespace sge {
 
     void UIEntity::loadImage(const char* path) {
         glGenTextures(1, &texture);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        glState.activeTexture(GL_TEXTURE0);
+        glState.bindTexture(GL_TEXTURE_2D, texture);
 
         // set the texture wrapping/filtering options 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	
@@ -49,7 +49,7 @@ namespace sge {
         glTexImage2D(GL_TEXTURE_2D, 0, format, widthInt, heightInt, 0, format, GL_UNSIGNED_BYTE, data);
         stbi_image_free(data);
 
-        glBindTexture(GL_TEXTURE_2D, 0);
+        glState.bindTexture(GL_TEXTURE_2D, 0);
 
         // store scale-to-screen width and height floats in this object
         scaleWidthAndHeightToScreenCoord(widthInt, heightInt);
@@ -179,8 +179,8 @@ namespace sge {
      * the one for all
     */
     void renderAllUIs(int currentSeason, int my_client_id, int client_id, int eggHolderId, bool eggIsDanceBomb, int abilityType, bool waitingCD) {
-        glEnable(GL_BLEND); // enable alpha blending for images with transparent background
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glState.enable(GL_BLEND); // enable alpha blending for images with transparent background
+        glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
         sge::renderSeasonIcon(currentSeason);
         // sge::renderGiveUp();
@@ -191,14 +191,14 @@ namespace sge {
 
         sge::renderSeasonAbility(abilityType, waitingCD);
 
-        glDisable(GL_BLEND);
+        glState.disable(GL_BLEND);
     }
 
 
     // the one to render all texts, prolly shouldn't be here but im too lazy to create another text entitiy class
     void renderAllTexts(int myHP, int team1score, int team2score, int season, bool inputEnabled, bool gameOver, int winner, double gameDurationInSeconds, int detonationMiliSecs, bool imBombOwner) {
-        glEnable(GL_BLEND); 
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glState.enable(GL_BLEND); 
+        glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
         // x,y offset here are relative to the ortho projection matrix in TextShaderProgram: width (1400) and height (800). 
         // Changes to sge::windowWidth or windowHeight won't affect this part. So DON"T CHANGE NUMBERS HERE.
@@ -276,31 +276,44 @@ namespace sge {
             }
         }
     
-        glDisable(GL_BLEND);
+        glState.disable(GL_BLEND);
     }
 
-    void renderAllBillboardTags(glm::vec3* positions, int client_id, bool eggIsDanceBomb, int eggHolderId) {
+    void renderDebugOverlay(const std::vector<std::string>& lines) {
+        glState.enable(GL_BLEND);
+        glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        // same 1400x800 coordinates as renderAllTexts, starting under the game timer
+        float y = 570.0f;
+        for (const std::string& line : lines) {
+            sge::textShaderProgram.renderText(line, 15.0f, y, 0.45f, glm::vec3(1.0f, 1.0f, 0.6f));
+            y -= 18.0f;
+        }
+        glState.disable(GL_BLEND);
+    }
+
+    void renderAllBillboardTags(const std::vector<glm::vec3>& positions, unsigned int numPlayers, int client_id, bool eggIsDanceBomb, int eggHolderId) {
 
         // render tags above other players
-        glEnable(GL_BLEND); // enable alpha blending for images with transparent background
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        for (int i = 0; i < NUM_PLAYER_ENTITIES; i++) {
+        glState.enable(GL_BLEND); // enable alpha blending for images with transparent background
+        glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        for (int i = 0; i < (int)numPlayers; i++) {
             // todo: render my ability affected?
 
             if (i == client_id) continue;
-            sge::billboardProgram.renderPlayerTag(positions[i], sge::UIs[PLAYER_1 + i]->texture);
+            // only have tags for 4 players, bigger matches reuse them
+            sge::billboardProgram.renderPlayerTag(positions[i], sge::UIs[PLAYER_1 + i % 4]->texture);
         }
         // doesn't render egg/bomb tag above if you're the one holding it (render it in yout UI instead)
         if (eggHolderId != client_id) {
             if (eggIsDanceBomb) {
-                sge::billboardProgram.renderPlayerTag(positions[NUM_PLAYER_ENTITIES] + glm::vec3(0,0.5,0), sge::UIs[DANCE_BOMB_TAG]->texture, 2.2f);
+                sge::billboardProgram.renderPlayerTag(positions[numPlayers] + glm::vec3(0,0.5,0), sge::UIs[DANCE_BOMB_TAG]->texture, 2.2f);
             }
             else {
-                sge::billboardProgram.renderPlayerTag(positions[NUM_PLAYER_ENTITIES], sge::UIs[EGG_TAG]->texture, 1.3f);
+                sge::billboardProgram.renderPlayerTag(positions[numPlayers], sge::UIs[EGG_TAG]->texture, 1.3f);
             }
         }
 
-        glDisable(GL_BLEND);
+        glState.disable(GL_BLEND);
 
     }
 
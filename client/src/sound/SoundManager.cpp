@@ -13,12 +13,10 @@ sound::SoundManager::SoundManager() {
 	
 	// std::cout << "shader value: " << SetupParser::getValue("shader") << std::endl;
 
-	// load BGM sound file into buffer
-	if (!bgm_buffer.loadFromFile(bgm_filepath)) {
-		std::cout << "Cannot load file: " << bgm_filepath << std::endl;
-	}
+	// The files are decoded on the asset loader, each sound just stays silent until its buffer is in
 
-	bgm.setBuffer(bgm_buffer);
+	// load BGM sound file into buffer
+	loadSound(bgm_buffer, bgm, bgm_filepath);
 	// make the BGM loop continuously
 	bgm.setLoop(true);
 	// set the BGM volume to half the original
@@ -26,54 +24,40 @@ sound::SoundManager::SoundManager() {
 
 
 	// load shooting sound
-	if (!shooting_buffer.loadFromFile(shooting_sound_filepath)) {
-		std::cout << "Cannot load file: " << shooting_sound_filepath << std::endl;
-	}
-	shooting_sound.setBuffer(shooting_buffer);
+	loadSound(shooting_buffer, shooting_sound, shooting_sound_filepath);
 	shooting_sound.setVolume(15);
 
 	// load jump sound
-	if (!jump_buffer.loadFromFile(jump_sound_filepath)) {
-		std::cout << "Cannot load file: " << jump_sound_filepath << std::endl;
-	}
-	jump_sound.setBuffer(jump_buffer);
+	loadSound(jump_buffer, jump_sound, jump_sound_filepath);
 	jump_sound.setVolume(50);
 
 	// load explosion sound
-	if (!explosion_buffer.loadFromFile(explosion_sound_filepath)) {
-		std::cout << "Cannot load file: " << explosion_sound_filepath << std::endl;
-	}
-	explosion_sound.setBuffer(explosion_buffer);
+	loadSound(explosion_buffer, explosion_sound, explosion_sound_filepath);
 	explosion_sound.setVolume(30);
 
-	// load character theme songs
+	// load character theme songs, the lobby's been asking for one of these since it opened
 	for (int i = 0; i < 4; i++) {
-		if (!character_themes_buffer[i].loadFromFile(character_themes_filepath[i])) {
-			std::cout << "Cannot load character theme song file: " << character_themes_filepath[i] << std::endl;
-		}
-		character_themes[i].setBuffer(character_themes_buffer[i]);
+		loadSound(character_themes_buffer[i], character_themes[i], character_themes_filepath[i], [this, i]() {
+			if (lobbyTheme == i) {
+				character_themes[i].play();
+			}
+		});
 		character_themes[i].setLoop(true);
 		character_themes[i].setVolume(50);
 	}
 
 	// load dancebomb sound effects
 	for (int i = 0; i < 2; i++) {
-		if (!bomb_tick_buffer[i].loadFromFile(bomb_tick_filepath[i])) {
-			std::cout << "Cannot load file: " << bomb_tick_filepath[i] << std::endl;
-		}
-		bomb_tick[i].setBuffer(bomb_tick_buffer[i]);
+		loadSound(bomb_tick_buffer[i], bomb_tick[i], bomb_tick_filepath[i]);
 		bomb_tick[i].setVolume(100);
 	}
 
 	for (int i = 0; i < DANCE_SONG_NUM; i++) {
-		if (!meme_songs_buffer[i].loadFromFile(meme_song_filepaths[i])) {
-			std::cout << "Cannot load file: " << meme_song_filepaths[i] << std::endl;
-		}
-		meme_songs[i].setBuffer(meme_songs_buffer[i]);
+		loadSound(meme_songs_buffer[i], meme_songs[i], meme_song_filepaths[i]);
 		meme_songs[i].setVolume(100);
 	}
 
-	std::cout << "Successfully load all sound files" << std::endl;
+	std::cout << "Queued all sound files" << std::endl;
 
 	// start BGM music for default selected character
 	playCharacterTheme(0);
@@ -82,6 +66,24 @@ sound::SoundManager::SoundManager() {
 
 }
 
+/**
+ * Decode a sound file on the asset loader, then give it to its sound on the main thread
+ */
+void sound::SoundManager::loadSound(sf::SoundBuffer& buffer, sf::Sound& sound, const std::string& filepath, std::function<void()> onLoaded) {
+	assetLoader->load([&buffer, &sound, filepath, onLoaded]() -> AssetUpload {
+		if (!buffer.loadFromFile(filepath)) {
+			std::cout << "Cannot load file: " << filepath << std::endl;
+			return nullptr;
+		}
+		return [&buffer, &sound, onLoaded]() {
+			sound.setBuffer(buffer);
+			if (onLoaded) {
+				onLoaded();
+			}
+		};
+	});
+}
+
 sound::SoundManager::~SoundManager() {
 	std::cout << "Sound Manager get deleted" << std::endl;
 }
@@ -109,6 +111,7 @@ void sound::SoundManager::playCharacterTheme(int characterSeason) {
 	// there should be no "game bgm" in the character selection stage -- you just hear the character's theme songs
 	//std::printf("playing character theme song %d\n", characterSeason);
 	assert(characterSeason < 4);
+	lobbyTheme = characterSeason;
 	character_themes[characterSeason].play();
 }
 
@@ -116,14 +119,18 @@ void sound::SoundManager::stopCharacterTheme(int characterSeason) {
 	// there should be no "game bgm" in the character selection stage -- you just hear the character's theme songs
 	assert(characterSeason < 4);
 	//std::printf("pausing character theme song %d\n", characterSeason);
+	if (lobbyTheme == characterSeason) {
+		lobbyTheme = -1;
+	}
 	character_themes[characterSeason].stop();
 }
 
 void sound::SoundManager::stopAllLobbyMusic() {
 	// assuming that we have one theme for each character
-	for (int i = 0; i < NUM_PLAYER_ENTITIES; i++) {
+	for (int i = 0; i < 4; i++) {
 		character_themes[i].stop();
 	}
+	lobbyTheme = -1;
 
 	// start bgm theme
 	bgm.play();
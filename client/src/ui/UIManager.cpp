@@ -84,53 +84,63 @@ bool ui::UIManager::isDebounced() {
 	return false;
 }
 
-GLuint ui::UIManager::LoadTextureFromFile(std::string filename) {
-	int width, height;
-	unsigned char* data = stbi_load(filename.c_str(), &width, &height, NULL, 4);
-	if (data == nullptr) {
-		return 0;
-	}
-
-	GLuint image_texture;
-	glGenTextures(1, &image_texture);
-	glBindTexture(GL_TEXTURE_2D, image_texture);
+void ui::UIManager::LoadTextureFromFile(std::string filename, std::function<void(GLuint)> onLoaded) {
+	assetLoader->load([filename, onLoaded]() -> AssetUpload {
+		// decode on the loader thread
+		int width, height;
+		unsigned char* data = stbi_load(filename.c_str(), &width, &height, NULL, 4);
+		if (data == nullptr) {
+			std::cout << "Cannot load image: " << filename << std::endl;
+			return nullptr;
+		}
+		std::shared_ptr<unsigned char> pixels(data, stbi_image_free);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		// then upload on the main thread
+		return [width, height, pixels, onLoaded]() {
+			GLuint image_texture;
+			glGenTextures(1, &image_texture);
+			sge::glState.bindTexture(GL_TEXTURE_2D, image_texture);
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // This is required on WebGL for non power-of-two textures
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); // Same
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.get());
 
-	stbi_image_free(data);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // This is required on WebGL for non power-of-two textures
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); // Same
 
-	return image_texture;
+			onLoaded(image_texture);
+		};
+	});
 }
 
+// Images are queued on the asset loader, their texture IDs stay 0 (drawn as nothing) until they're uploaded
 void ui::UIManager::LoadLobbyImages() {
 	// load characters image
+	textures.assign(characters.size(), 0);
 	for (int i = 0; i < characters.size(); i++) {
-		characters[i].textureID = LoadTextureFromFile((std::string)(PROJECT_PATH)+characters[i].imagePath);
-		textures.push_back(characters[i].textureID);
+		LoadTextureFromFile((std::string)(PROJECT_PATH)+characters[i].imagePath, [this, i](GLuint id) {
+			characters[i].textureID = id;
+			textures[i] = id;
+		});
 	}
 
 	// load start background
-	startBackgroundImageTextureID = LoadTextureFromFile((std::string)(PROJECT_PATH)+SetupParser::getValue("start-background"));
+	LoadTextureFromFile((std::string)(PROJECT_PATH)+SetupParser::getValue("start-background"), [this](GLuint id) { startBackgroundImageTextureID = id; });
 	// load start title
-	startTitleTextureID = LoadTextureFromFile((std::string)(PROJECT_PATH)+SetupParser::getValue("start-text"));
+	LoadTextureFromFile((std::string)(PROJECT_PATH)+SetupParser::getValue("start-text"), [this](GLuint id) { startTitleTextureID = id; });
 	// load start button
-	startButtonImageTextureID = LoadTextureFromFile((std::string)(PROJECT_PATH)+SetupParser::getValue("start-button"));
+	LoadTextureFromFile((std::string)(PROJECT_PATH)+SetupParser::getValue("start-button"), [this](GLuint id) { startButtonImageTextureID = id; });
 
 
 
 	// load lobby background image
-	lobbyBackgroundImageTextureID = LoadTextureFromFile((std::string)(PROJECT_PATH)+SetupParser::getValue("lobby-background"));
+	LoadTextureFromFile((std::string)(PROJECT_PATH)+SetupParser::getValue("lobby-background"), [this](GLuint id) { lobbyBackgroundImageTextureID = id; });
 	// load secret character
-	secretCharacterTextureID = LoadTextureFromFile((std::string)(PROJECT_PATH)+SetupParser::getValue("secret-character"));
+	LoadTextureFromFile((std::string)(PROJECT_PATH)+SetupParser::getValue("secret-character"), [this](GLuint id) { secretCharacterTextureID = id; });
 
 	// load indicators
-	redDownTriTextureID = LoadTextureFromFile((std::string)(PROJECT_PATH)+SetupParser::getValue("arrow-image"));
-	greenMarkTextureID = LoadTextureFromFile((std::string)(PROJECT_PATH)+SetupParser::getValue("greenmark-image"));
+	LoadTextureFromFile((std::string)(PROJECT_PATH)+SetupParser::getValue("arrow-image"), [this](GLuint id) { redDownTriTextureID = id; });
+	LoadTextureFromFile((std::string)(PROJECT_PATH)+SetupParser::getValue("greenmark-image"), [this](GLuint id) { greenMarkTextureID = id; });
 
 }
 
@@ -168,8 +178,8 @@ void ui::UIManager::characterDisplay(int columnIndex, int displayedPlayerID) {
 		ImGui::Image((void*)(intptr_t)textures[selectedIndex], imageSize);
 	}
 	// their teammate
-	else if (actualColumnIndex == clientGame->teams[clientGame->client_id]) {
-		ImGui::Image((void*)(intptr_t)getBrowsingCharacter(clientGame->teams[clientGame->client_id]).textureID, imageSize);
+	else if (actualColumnIndex == clientGame->teammateOf(clientGame->client_id)) {
+		ImGui::Image((void*)(intptr_t)getBrowsingCharacter(clientGame->teammateOf(clientGame->client_id)).textureID, imageSize);
 	}
 	// the other team
 	else {
@@ -207,7 +217,7 @@ void ui::UIManager::characterDisplay(int columnIndex, int displayedPlayerID) {
 	// if this displayedPlayer already made their selection, display the green mark underneath them
 	int distanceToTag = 30; // change this distance to the tagname
 	ImGui::SetCursorPos(ImVec2(columnIndex * columnSize + (columnSize - indicatorSize.x) / 2, yOffset + imageSize.y + textSize.y + distanceToTag));
-	if (clientGame->characterUID[displayedPlayerID] != NO_CHARACTER) {
+	if (clientGame->characterOf(displayedPlayerID) != NO_CHARACTER) {
 		ImGui::Image((void*)(intptr_t)greenMarkTextureID, indicatorSize);
 	}
 	ImGui::Spacing();
@@ -245,7 +255,7 @@ void ui::UIManager::displayLobbyTitle() {
 ui::Character ui::UIManager::getBrowsingCharacter(int playerId) {
 	ui::Character result;
 	for (ui::Character character : ui::uiManager->characters) {
-		if (character.characterUID == clientGame->browsingCharacterUID[playerId]) {
+		if (character.characterUID == clientGame->browsingCharacterOf(playerId)) {
 			result = character;
 		}
 	}
@@ -253,22 +263,16 @@ ui::Character ui::UIManager::getBrowsingCharacter(int playerId) {
 }
 
 bool ui::UIManager::canSelectCharacter() {
-	int teammate = clientGame->teams[clientGame->client_id];
+	int teammate = clientGame->teammateOf(clientGame->client_id);
 	// get teammate selected character
-	int teammateSelectedCharacter = clientGame->characterUID[teammate];
+	int teammateSelectedCharacter = clientGame->characterOf(teammate);
 
 	return browsingCharacterUID != teammateSelectedCharacter;
 }
 
 bool ui::UIManager::areAllPlayersReady() {
-	bool areReady = true;
-	for (int character : clientGame->characterUID) {
-		if (character == NO_CHARACTER) {
-			areReady = false;
-		}
-	}
-
-	return areReady;
+	// only the players who have joined, the match doesn't have to be full
+	return clientGame->allJoinedPlayersReady();
 }
 
 
@@ -476,6 +480,8 @@ void ui::UIManager::lobby() {
 	glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w, clear_color.z * clear_color.w, clear_color.w);
 	glClear(GL_COLOR_BUFFER_BIT);
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+	// ImGui puts back the state it changed, but with its own GL calls
+	sge::glState.invalidate();
 
 	glfwSwapBuffers(sge::window);
 }
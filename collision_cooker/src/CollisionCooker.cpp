@@ -0,0 +1,40 @@
+// collision_cooker.cpp : Bakes the collision map so the server and client can map it into memory instead of importing it.
+//
+// Usage: collision_cooker [source mesh] [baked output]
+// Paths default to "collision-map" and "collision-map-baked" in setup.json. Re-run it whenever the map or
+// COLLISION_MAP_VERSION changes, anything that finds a stale or missing baked file falls back to the slow import.
+// The baked file remembers the source mesh's size and modification time, that's how stale files get noticed
+
+#include "Physics.h"
+#include "SetupParser.h"
+
+#include <chrono>
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    std::string sourcePath = argc > 1 ? argv[1] : (std::string)(PROJECT_PATH) + SetupParser::getValue("collision-map");
+    std::string bakedPath = argc > 2 ? argv[2] : (std::string)(PROJECT_PATH) + SetupParser::getValue("collision-map-baked");
+
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<CollisionMap> map = CollisionMap::importMesh(sourcePath);
+    std::printf("imported %s in %.2fs: %u triangles, %zu KB\n", sourcePath.c_str(), secondsSince(start), map->numTriangles(), map->memoryUsage() / 1024);
+
+    if (!map->writeBaked(bakedPath)) {
+        return 1;
+    }
+
+    // Read it back the way the game will, so a bad write shows up here and not at server start
+    start = std::chrono::steady_clock::now();
+    std::unique_ptr<CollisionMap> baked = CollisionMap::loadBaked(bakedPath, sourcePath);
+    if (baked == nullptr || baked->checksum() != map->checksum()) {
+        std::printf("%s didn't read back correctly\n", bakedPath.c_str());
+        return 1;
+    }
+    std::printf("wrote %s (version %d, checksum %016llx), loads in %.1fms\n", bakedPath.c_str(), COLLISION_MAP_VERSION,
+        (unsigned long long)baked->checksum(), secondsSince(start) * 1000);
+    return 0;
+}
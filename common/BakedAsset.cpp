@@ -0,0 +1,35 @@
+#include "BakedAsset.h"
+
+#include <filesystem>
+#include <cstring>
+
+bool readSourceStamp(const std::string& path, SourceStamp& stamp) {
+    std::error_code error;
+    uint64_t size = std::filesystem::file_size(path, error);
+    if (error) {
+        return false;
+    }
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(path, error);
+    if (error) {
+        return false;
+    }
+    stamp.size = size;
+    stamp.modifiedTime = modified.time_since_epoch().count();
+    return true;
+}
+
+uint64_t hashBytes(const char* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash ^= word;
+        hash *= 1099511628211ull;
+    }
+    for (; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
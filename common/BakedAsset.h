@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Shared by the baked asset formats (collision maps, models). A baked file stores the stamp of the
+// source file it was made from, so editing the source makes the game ignore the stale baked copy
+
+struct SourceStamp {
+    uint64_t size;
+    // last write time, in whatever units the filesystem clock uses
+    int64_t modifiedTime;
+
+    bool operator==(const SourceStamp& other) const { return size == other.size && modifiedTime == other.modifiedTime; }
+    bool operator!=(const SourceStamp& other) const { return !(*this == other); }
+};
+
+// Returns false (and leaves stamp alone) if the file isn't there
+bool readSourceStamp(const std::string& path, SourceStamp& stamp);
+
+// FNV-1a over 8 bytes at a time, plenty to catch a truncated or half-written file. Baked models
+// are hundreds of MB, going a byte at a time would make the hash most of their load time
+uint64_t hashBytes(const char* data, size_t size);
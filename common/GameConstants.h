@@ -32,6 +32,7 @@ enum MovementEntityStateIndex {
     IS_USING_ABILITY = 3,
     EXPLODING = 4,
     IS_DANCING,
+    IS_LERPING,
     NUM_STATES
 };
 
@@ -40,11 +41,21 @@ enum Teams {
     RED = 1
 };
 
-// Number of entities that can move by itself (4 players + 1 egg for now)
-#define NUM_PLAYER_ENTITIES 4
-#define NUM_EACH_PROJECTILE 4
-#define NUM_TOTAL_PROJECTILES NUM_PROJ_TYPES * NUM_EACH_PROJECTILE 
-#define NUM_MOVEMENT_ENTITIES NUM_PLAYER_ENTITIES + NUM_TOTAL_PROJECTILES + 1
+// Number of players a match has room for. Players are the first movement entities, followed by the egg and then the projectiles
+#define MAX_PLAYERS std::stoi(SetupParser::getValue("max_players"))
+// Projectiles of each season made when a match starts, more are made if they all get used up at once
+#define PROJECTILES_PER_PLAYER 1
+
+// Teams are made of pairs of players: 0 and 1 are blue, 2 and 3 are red, 4 and 5 are blue...
+inline Teams teamOf(int player) {
+    return (player / 2) % 2 == 0 ? BLUE : RED;
+}
+inline int teammateOf(int player) {
+    return player ^ 1;
+}
+
+// Length of one server tick. Movement constants below are per tick
+#define SERVER_TICK_MS 33
 
 // Map
 #define HEIGHT_LIMIT 20 // how far above the highest point does the map extend
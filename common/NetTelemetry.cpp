@@ -0,0 +1,151 @@
+#include "NetTelemetry.h"
+
+#include <chrono>
+#include <cstdio>
+#if defined(_WIN32)
+#include <winsock2.h>
+#else
+#include <sys/ioctl.h>
+#include <netinet/tcp.h>
+#endif
+#if defined(__linux__)
+#include <linux/sockios.h>
+#endif
+
+static double telemetryNowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void NetTelemetry::recordSent(unsigned int updateType, int bytes) {
+    if (updateType < NUM_UPDATE_TYPES) {
+        sent[updateType].bytes += bytes;
+        sent[updateType].messages++;
+    }
+    totalBytesSent += bytes;
+}
+
+void NetTelemetry::recordSendResult(int requested, int result) {
+    if (result == SOCKET_ERROR) {
+        failedSends++;
+    } else if (result < requested) {
+        partialSends++;
+    }
+}
+
+void NetTelemetry::recordReceived(unsigned int updateType, int bytes) {
+    if (updateType < NUM_UPDATE_TYPES) {
+        received[updateType].bytes += bytes;
+        received[updateType].messages++;
+    }
+    totalBytesReceived += bytes;
+    lastReceivedMs = telemetryNowMs();
+}
+
+void NetTelemetry::setRoundTrip(double roundTripMs, double jitterMs) {
+    this->roundTripMs = roundTripMs;
+    this->roundTripJitterMs = jitterMs;
+}
+
+void NetTelemetry::update(SOCKET socket) {
+    double now = telemetryNowMs();
+    if (lastSampleMs >= 0 && now - lastSampleMs < TELEMETRY_SAMPLE_INTERVAL_MS) {
+        return;
+    }
+
+    if (lastSampleMs >= 0) {
+        double seconds = (now - lastSampleMs) / 1000.0;
+        sendKbps = (totalBytesSent - bytesSentAtSample) * 8 / 1000.0 / seconds;
+        receiveKbps = (totalBytesReceived - bytesReceivedAtSample) * 8 / 1000.0 / seconds;
+    }
+    lastSampleMs = now;
+    bytesSentAtSample = totalBytesSent;
+    bytesReceivedAtSample = totalBytesReceived;
+
+    // TCP does the resending for us, so ask the kernel how much of it is happening
+#if defined(__linux__)
+    struct tcp_info info;
+    socklen_t infoLength = sizeof(info);
+    if (getsockopt(socket, IPPROTO_TCP, TCP_INFO, &info, &infoLength) == 0) {
+        kernelRoundTripMs = info.tcpi_rtt / 1000.0;
+        kernelRoundTripVarMs = info.tcpi_rttvar / 1000.0;
+        retransmits = info.tcpi_total_retrans;
+        unackedSegments = info.tcpi_unacked;
+    }
+    int outgoing;
+    if (ioctl(socket, SIOCOUTQ, &outgoing) == 0) {
+        sendQueueBytes = outgoing;
+    }
+#endif
+
+#if defined(_WIN32)
+    u_long incoming;
+    if (ioctlsocket(socket, FIONREAD, &incoming) == 0) {
+        receiveQueueBytes = (int)incoming;
+    }
+#else
+    int incoming;
+    if (ioctl(socket, FIONREAD, &incoming) == 0) {
+        receiveQueueBytes = incoming;
+    }
+#endif
+}
+
+double NetTelemetry::lastReceivedAgeMs() const {
+    if (lastReceivedMs < 0) {
+        return -1;
+    }
+    return telemetryNowMs() - lastReceivedMs;
+}
+
+std::vector<std::string> NetTelemetry::summaryLines() const {
+    char line[128];
+    std::vector<std::string> lines;
+
+    std::snprintf(line, sizeof(line), "rtt %.1fms (jitter %.1fms)  tcp rtt %.1fms", roundTripMs, roundTripJitterMs, kernelRoundTripMs);
+    lines.push_back(line);
+    std::snprintf(line, sizeof(line), "up %.1f kbps  down %.1f kbps", sendKbps, receiveKbps);
+    lines.push_back(line);
+    std::snprintf(line, sizeof(line), "retransmits %u  unacked %u  failed/partial sends %u/%u", retransmits, unackedSegments, failedSends, partialSends);
+    lines.push_back(line);
+    std::snprintf(line, sizeof(line), "send queue %dB  recv queue %dB  last recv %.0fms ago", sendQueueBytes, receiveQueueBytes, lastReceivedAgeMs());
+    lines.push_back(line);
+    return lines;
+}
+
+std::string NetTelemetry::report() const {
+    std::string result;
+    for (const std::string& line : summaryLines()) {
+        result += "    " + line + "\n";
+    }
+
+    char line[128];
+    for (unsigned int type = 0; type < NUM_UPDATE_TYPES; type++) {
+        if (sent[type].messages == 0 && received[type].messages == 0) {
+            continue;
+        }
+        std::snprintf(line, sizeof(line), "    %-20s sent %8llu msgs %10llu B   received %8llu msgs %10llu B\n", updateTypeName(type),
+            (unsigned long long)sent[type].messages, (unsigned long long)sent[type].bytes,
+            (unsigned long long)received[type].messages, (unsigned long long)received[type].bytes);
+        result += line;
+    }
+    return result;
+}
+
+const char* updateTypeName(unsigned int updateType) {
+    switch (updateType) {
+    case INIT_CONNECTION:    return "INIT_CONNECTION";
+    case ISSUE_IDENTIFIER:   return "ISSUE_IDENTIFIER";
+    case ACTION_EVENT:       return "ACTION_EVENT";
+    case INCREASE_COUNTER:   return "INCREASE_COUNTER";
+    case REPLACE_COUNTER:    return "REPLACE_COUNTER";
+    case CLIENT_TO_SERVER:   return "CLIENT_TO_SERVER";
+    case SERVER_TO_CLIENT:   return "SERVER_TO_CLIENT";
+    case BULLETS:            return "BULLETS";
+    case LOBBY_TO_CLIENT:    return "LOBBY_TO_CLIENT";
+    case LOBBY_TO_SERVER:    return "LOBBY_TO_SERVER";
+    case GAME_END_DATA:      return "GAME_END_DATA";
+    case CLOCK_SYNC_REQUEST: return "CLOCK_SYNC_REQUEST";
+    case CLOCK_SYNC_REPLY:   return "CLOCK_SYNC_REPLY";
+    default:                 return "UNKNOWN";
+    }
+}
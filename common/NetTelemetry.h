@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "NetworkServices.h"
+#include "NetworkData.h"
+
+// How often the kernel socket stats and bandwidth rates are refreshed
+#define TELEMETRY_SAMPLE_INTERVAL_MS 1000.0
+// How often the server prints every session's telemetry
+#define TELEMETRY_LOG_INTERVAL_MS 5000.0
+
+struct UpdateTypeCounters {
+    uint64_t bytes = 0;
+    uint64_t messages = 0;
+};
+
+/**
+ * Counters for one connection: traffic per update type, round trip, TCP retransmits and queue depths.
+ * The server keeps one per client session, the client keeps one for its connection to the server
+ */
+class NetTelemetry {
+public:
+    void recordSent(unsigned int updateType, int bytes);
+    // Call with what send() returned, counts failed and partial sends
+    void recordSendResult(int requested, int result);
+    void recordReceived(unsigned int updateType, int bytes);
+
+    // Round trip measured by the clock sync exchange
+    void setRoundTrip(double roundTripMs, double jitterMs);
+
+    // Refreshes kernel stats and bandwidth rates, cheap to call every frame/tick
+    void update(SOCKET socket);
+
+    // A few short lines for the HUD
+    std::vector<std::string> summaryLines() const;
+    // Everything, including per update type counters, for the server log
+    std::string report() const;
+
+    // Milliseconds since anything was last received on this connection
+    double lastReceivedAgeMs() const;
+
+private:
+    UpdateTypeCounters sent[NUM_UPDATE_TYPES];
+    UpdateTypeCounters received[NUM_UPDATE_TYPES];
+    uint64_t totalBytesSent = 0;
+    uint64_t totalBytesReceived = 0;
+    unsigned int failedSends = 0;
+    unsigned int partialSends = 0;
+    double lastReceivedMs = -1;
+
+    // from the clock sync exchange
+    double roundTripMs = -1;
+    double roundTripJitterMs = 0;
+
+    // from the kernel (TCP_INFO), only on Linux
+    double kernelRoundTripMs = -1;
+    double kernelRoundTripVarMs = 0;
+    unsigned int retransmits = 0;
+    unsigned int unackedSegments = 0;
+    // bytes written but not yet sent/acked, and bytes received but not yet read by us
+    int sendQueueBytes = -1;
+    int receiveQueueBytes = -1;
+
+    // bandwidth over the last sample interval
+    double lastSampleMs = -1;
+    uint64_t bytesSentAtSample = 0;
+    uint64_t bytesReceivedAtSample = 0;
+    double sendKbps = 0;
+    double receiveKbps = 0;
+};
+
+const char* updateTypeName(unsigned int updateType);
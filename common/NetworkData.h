@@ -2,14 +2,22 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include <bitset>
+#include <cstring>
+#include <type_traits>
 #include <glm/glm.hpp>
 #include "GameConstants.h"
+#include "PlayerMovement.h"
 
 #define MAX_PACKET_SIZE 1000000
 
 #define MAX_CONTENTS_SIZE 128
 
+// variable-length updates know how to write and read themselves with these (see the bottom of this file)
+class PacketWriter;
+class PacketReader;
+
 enum UpdateTypes {
     // sent by a client when it first connects to the server
     INIT_CONNECTION = 0,
@@ -42,6 +50,11 @@ enum UpdateTypes {
 
     GAME_END_DATA = 11, 
 
+    // NTP-style clock sync, the client asks for the server's time and the server answers right away
+    CLOCK_SYNC_REQUEST = 12,
+    CLOCK_SYNC_REPLY = 13,
+
+    NUM_UPDATE_TYPES
 };
 
 struct IncreaseCounterUpdate {
@@ -50,6 +63,8 @@ struct IncreaseCounterUpdate {
 
 struct IssueIdentifierUpdate {
     int client_id;
+    // how many players this match has room for, the client sizes its player lists with this
+    unsigned int maxPlayers;
 };
 
 struct ReportCounterUpdate {
@@ -58,6 +73,21 @@ struct ReportCounterUpdate {
 };
 
 
+// All times are milliseconds on the sender's own steady clock
+struct ClockSyncRequest {
+    double clientSendMs;
+    // the client's latest estimate, so the server's telemetry knows it too
+    float roundTripMs;
+    float roundTripJitterMs;
+};
+
+struct ClockSyncReply {
+    // echoed back so the client can match the reply to its request
+    double clientSendMs;
+    double serverReceiveMs;
+    double serverSendMs;
+};
+
 struct LobbyClientToServerPacket {
     // default to MIN_INT if the player has not selected a character
     int characterUID;
@@ -66,13 +96,24 @@ struct LobbyClientToServerPacket {
     int browsingCharacterUID;
 };
 
+// One joined player's lobby state
+struct LobbyPlayer {
+    // false for a slot whose player left the lobby, the rest of the entry is blank until someone takes it
+    bool joined;
+    // default to MIN_INT if the player has not selected a character
+    int character;
+    // character the player is browsing through and has not selected yet
+    int browsingCharacter;
+    // player id of their teammate
+    int teammate;
+};
+
 struct LobbyServerToClientPacket {
-    // all players with their respective character selection
-    int playersCharacter[NUM_PLAYER_ENTITIES];
-    // all players with their current browsing character
-    int playersBrowsingCharacter[NUM_PLAYER_ENTITIES];
-    // teams setup
-    int teams[NUM_PLAYER_ENTITIES];
+    // every slot handed out so far, indexed by client id
+    std::vector<LobbyPlayer> players;
+
+    void write(PacketWriter& writer) const;
+    bool read(PacketReader& reader);
 };
 
 struct ClientToServerPacket {
@@ -100,21 +141,56 @@ struct ClientToServerPacket {
 
     // Movement angle
     float yaw, pitch;
+
+    // Increases by one every tick of movement the client predicted locally
+    unsigned int inputSequence;
+    // (fractional) server tick the client was rendering other entities at, used to rewind hitboxes when shooting
+    float viewTick;
+    // server tick the client wants this input applied on, the server holds it until then (0 if its clock isn't synced yet)
+    unsigned int targetTick;
 };
 
 /* Below are server-to-client packets... terrible naming, yes...*/
 
+// State of one movement entity. Movement entities are the players (indexed by client id), then the egg,
+// then every projectile the server has made so far
+struct MovementEntitySnapshot {
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+    std::bitset<NUM_STATES> states;
+};
+
+struct PlayerSnapshot {
+    float cameraDistance;
+    int health;
+    int score;
+    unsigned int seasonAbilityCD;
+
+    // for client-side prediction: authoritative movement state of the player and the
+    // latest input sequence number from them that this tick (or an earlier one) simulated
+    physics::PlayerMovementState movementState;
+    unsigned int lastInputSequence;
+    // targetTick of the player's newest input minus the tick that was up next when it arrived. Negative means
+    // the input showed up late, so the client should send earlier
+    int inputLeadTicks;
+};
+
+struct ProjectileSnapshot {
+    // index into the movement entities
+    unsigned int movementIndex;
+    BallProjType type;
+    bool active;
+};
+
 struct ServerToClientPacket {
     // to every client, for all clients
 
-    glm::vec3 positions[NUM_MOVEMENT_ENTITIES];
-    float yaws[NUM_MOVEMENT_ENTITIES];
-    float pitches[NUM_MOVEMENT_ENTITIES];
-    float cameraDistances[NUM_PLAYER_ENTITIES];
-    std::bitset<NUM_STATES> movementEntityStates[NUM_MOVEMENT_ENTITIES];
-    bool active[NUM_TOTAL_PROJECTILES];
-    int healths[NUM_PLAYER_ENTITIES];
-    int scores[NUM_PLAYER_ENTITIES];
+    // server tick this snapshot was taken at, the client interpolates between ticks
+    unsigned int serverTick;
+    // server clock when this tick started, lets the client map its own clock onto server ticks
+    double serverTimeMs;
+
     int currentSeason;
     float seasonBlend;
     bool eggIsDanceBomb;
@@ -123,7 +199,13 @@ struct ServerToClientPacket {
     int eggHolderId;
     int detonationMiliSecs;
     double gameDurationInSeconds;
-    unsigned int seasonAbilityCD[NUM_PLAYER_ENTITIES];
+
+    std::vector<MovementEntitySnapshot> movementEntities;
+    std::vector<PlayerSnapshot> players;
+    std::vector<ProjectileSnapshot> projectiles;
+
+    void write(PacketWriter& writer) const;
+    bool read(PacketReader& reader);
 };
 
 struct BulletTrail {
@@ -134,8 +216,11 @@ struct BulletTrail {
 };
 
 struct BulletPacket {
-    unsigned int count;
-    BulletTrail bulletTrail[NUM_PLAYER_ENTITIES];
+    // bullets fired during the last tick
+    std::vector<BulletTrail> bulletTrails;
+
+    void write(PacketWriter& writer) const;
+    bool read(PacketReader& reader);
 };
 
 struct GameEndPacket {
@@ -143,31 +228,14 @@ struct GameEndPacket {
     Teams winner = BLUE;
 };
 
-struct CharacterPacket {
-    // mapping from user ID to character selection ID
-    int charactersUID[NUM_PLAYER_ENTITIES];
-};
-
 struct ReplaceCounterUpdate {
     int counter_value;
 };
 
 struct UpdateHeader {
     unsigned int update_type;
-};
-
-const std::map<unsigned int, unsigned int> update_type_data_lengths = { 
-    {INIT_CONNECTION,0},
-    {ACTION_EVENT,0},
-    {INCREASE_COUNTER,sizeof(IncreaseCounterUpdate)},
-    {ISSUE_IDENTIFIER,sizeof(IssueIdentifierUpdate)},
-    {REPLACE_COUNTER,sizeof(ReplaceCounterUpdate)},
-    {CLIENT_TO_SERVER,sizeof(ClientToServerPacket)},
-    {SERVER_TO_CLIENT, sizeof(ServerToClientPacket)},
-    {BULLETS,           sizeof(BulletPacket)},
-    {GAME_END_DATA,     sizeof(GameEndPacket)},
-    {LOBBY_TO_SERVER, sizeof(LobbyClientToServerPacket)},
-    {LOBBY_TO_CLIENT, sizeof(LobbyServerToClientPacket)}
+    // number of bytes that follow the header
+    unsigned int data_length;
 };
 
 // copy the information from the struct into data
@@ -179,3 +247,119 @@ template <typename T> void serialize(T* struct_ptr, char* data) {
 template <typename T> void deserialize(T* struct_ptr, char* data) {
     std::memcpy(struct_ptr, data, sizeof(T));
 }
+
+/**
+ * Builds the body of a variable-length update. Plain values are copied as they are, and lists are
+ * written as a count followed by that many elements
+ */
+class PacketWriter {
+public:
+    template <typename T> void write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "only plain structs can be copied onto the wire");
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        data.insert(data.end(), bytes, bytes + sizeof(T));
+    }
+
+    template <typename T> void writeList(const std::vector<T>& list) {
+        static_assert(std::is_trivially_copyable_v<T>, "only plain structs can be copied onto the wire");
+        write((unsigned int)list.size());
+        const char* bytes = reinterpret_cast<const char*>(list.data());
+        data.insert(data.end(), bytes, bytes + list.size() * sizeof(T));
+    }
+
+    std::vector<char> data;
+};
+
+/**
+ * Reads back what a PacketWriter wrote. Running past the end of the data (a corrupt or truncated
+ * update) makes every later read do nothing, so check ok() once at the end
+ */
+class PacketReader {
+public:
+    PacketReader(const char* data, unsigned int length) : data(data), length(length) {}
+
+    template <typename T> void read(T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "only plain structs can be copied off the wire");
+        if (failed || length - offset < sizeof(T)) {
+            failed = true;
+            return;
+        }
+        std::memcpy(&value, data + offset, sizeof(T));
+        offset += sizeof(T);
+    }
+
+    template <typename T> void readList(std::vector<T>& list) {
+        static_assert(std::is_trivially_copyable_v<T>, "only plain structs can be copied off the wire");
+        unsigned int count = 0;
+        read(count);
+        if (failed || (length - offset) / sizeof(T) < count) {
+            failed = true;
+            list.clear();
+            return;
+        }
+        list.resize(count);
+        std::memcpy(list.data(), data + offset, count * sizeof(T));
+        offset += count * sizeof(T);
+    }
+
+    // Everything read fine and nothing was left over
+    bool ok() const { return !failed && offset == length; }
+
+private:
+    const char* data;
+    unsigned int length;
+    unsigned int offset = 0;
+    bool failed = false;
+};
+
+inline void LobbyServerToClientPacket::write(PacketWriter& writer) const {
+    writer.writeList(players);
+}
+
+inline bool LobbyServerToClientPacket::read(PacketReader& reader) {
+    reader.readList(players);
+    return reader.ok();
+}
+
+inline void ServerToClientPacket::write(PacketWriter& writer) const {
+    writer.write(serverTick);
+    writer.write(serverTimeMs);
+    writer.write(currentSeason);
+    writer.write(seasonBlend);
+    writer.write(eggIsDanceBomb);
+    writer.write(bombIsThrown);
+    writer.write(danceInAction);
+    writer.write(eggHolderId);
+    writer.write(detonationMiliSecs);
+    writer.write(gameDurationInSeconds);
+    writer.writeList(movementEntities);
+    writer.writeList(players);
+    writer.writeList(projectiles);
+}
+
+inline bool ServerToClientPacket::read(PacketReader& reader) {
+    reader.read(serverTick);
+    reader.read(serverTimeMs);
+    reader.read(currentSeason);
+    reader.read(seasonBlend);
+    reader.read(eggIsDanceBomb);
+    reader.read(bombIsThrown);
+    reader.read(danceInAction);
+    reader.read(eggHolderId);
+    reader.read(detonationMiliSecs);
+    reader.read(gameDurationInSeconds);
+    reader.readList(movementEntities);
+    reader.readList(players);
+    reader.readList(projectiles);
+    // players come first in the movement entities, then the egg
+    return reader.ok() && movementEntities.size() > players.size();
+}
+
+inline void BulletPacket::write(PacketWriter& writer) const {
+    writer.writeList(bulletTrails);
+}
+
+inline bool BulletPacket::read(PacketReader& reader) {
+    reader.readList(bulletTrails);
+    return reader.ok();
+}
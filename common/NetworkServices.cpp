@@ -9,4 +9,27 @@ int NetworkServices::sendMessage(SOCKET curSocket, char* message, int messageSiz
 int NetworkServices::receiveMessage(SOCKET curSocket, char* buffer, int bufSize)
 {
     return recv(curSocket, buffer, bufSize, 0);
-}
\ No newline at end of file
+}
+
+int NetworkServices::setNonBlocking(SOCKET curSocket)
+{
+#if defined(_WIN32)
+    u_long iMode = 1;
+    return ioctlsocket(curSocket, FIONBIO, &iMode);
+#else
+    int flags = fcntl(curSocket, F_GETFL, 0);
+    if (flags == -1) {
+        return SOCKET_ERROR;
+    }
+    return fcntl(curSocket, F_SETFL, flags | O_NONBLOCK);
+#endif
+}
+
+bool NetworkServices::wouldBlock()
+{
+#if defined(_WIN32)
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
@@ -1,5 +1,5 @@
-#if defined(_WIN32)
 #pragma once
+#if defined(_WIN32)
 #include <winsock2.h>
 #include <windows.h>
 #else
@@ -9,6 +9,7 @@
 #include <arpa/inet.h>
 #include <unistd.h>   // Needed for close()
 #include <netdb.h>    // Needed for getaddrinfo() and freeaddrinfo()
+#include <fcntl.h>    // Needed for fcntl
 #include <errno.h>
 #endif
 
@@ -35,5 +36,9 @@ public:
 
 	static int sendMessage(SOCKET curSocket, char* message, int messageSize);
 	static int receiveMessage(SOCKET curSocket, char* buffer, int bufSize);
+	// returns SOCKET_ERROR on failure
+	static int setNonBlocking(SOCKET curSocket);
+	// true if the last call that returned SOCKET_ERROR on a nonblocking socket only failed because it would have blocked
+	static bool wouldBlock();
 
 };
\ No newline at end of file
@@ -0,0 +1,470 @@
+#include "Physics.h"
+
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <cstring>
+#include <cassert>
+#include <fstream>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#define COLLISION_MAP_IMPORT_FLAGS aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_EmbedTextures | aiProcess_GenNormals | aiProcess_FixInfacingNormals | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType | aiProcess_ValidateDataStructure | aiProcess_FindInstances | aiProcess_OptimizeGraph | aiProcess_OptimizeMeshes
+
+std::shared_ptr<const CollisionMap> CollisionMap::load(const std::string& bakedFilePath, const std::string& sourceFilePath) {
+    // Only keep weak references so a map goes away once nothing is using it
+    static std::mutex cacheMutex;
+    static std::map<std::string, std::weak_ptr<const CollisionMap>> cache;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    std::shared_ptr<const CollisionMap> map = cache[sourceFilePath].lock();
+    if (map == nullptr) {
+        auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<CollisionMap> loaded = loadBaked(bakedFilePath, sourceFilePath);
+        if (loaded == nullptr) {
+            std::printf("importing %s instead, run collision_cooker to make this fast\n", sourceFilePath.c_str());
+            loaded = importMesh(sourceFilePath);
+        }
+        double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::printf("collision map: %u triangles, %zu KB %s, loaded in %.1fms\n", loaded->numTriangles(), loaded->memoryUsage() / 1024,
+            loaded->isMapped() ? "mapped from the baked file" : "imported", loadMs);
+        map = std::move(loaded);
+        cache[sourceFilePath] = map;
+    }
+    return map;
+}
+
+std::unique_ptr<CollisionMap> CollisionMap::loadBaked(const std::string& bakedFilePath, const std::string& sourceFilePath) {
+    std::unique_ptr<CollisionMap> map(new CollisionMap());
+    if (!map->mappedFile.open(bakedFilePath)) {
+        std::printf("no baked collision map at %s\n", bakedFilePath.c_str());
+        return nullptr;
+    }
+    if (!map->attach(map->mappedFile.data(), map->mappedFile.size(), bakedFilePath)) {
+        return nullptr;
+    }
+    SourceStamp source;
+    if (readSourceStamp(sourceFilePath, source) && source != map->header.source) {
+        std::printf("%s was baked from a different %s, re-cook it\n", bakedFilePath.c_str(), sourceFilePath.c_str());
+        return nullptr;
+    }
+    return map;
+}
+
+bool CollisionMap::attach(const char* data, size_t size, const std::string& name) {
+    if (size < sizeof(BakedCollisionMapHeader)) {
+        std::printf("%s is too small to be a collision map\n", name.c_str());
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != COLLISION_MAP_MAGIC || header.version != COLLISION_MAP_VERSION || header.bucketWidth != MAP_BUCKET_WIDTH) {
+        std::printf("%s is from a different version of the game (version %u, %u buckets wide), re-cook it\n", name.c_str(), header.version, header.bucketWidth);
+        return false;
+    }
+
+    uint64_t numBuckets = MAP_BUCKET_WIDTH * MAP_BUCKET_WIDTH;
+    uint64_t expectedSize = (uint64_t)header.numVertices * sizeof(glm::vec3) + (uint64_t)header.numTriangles * 3 * sizeof(uint32_t)
+        + (uint64_t)header.numTriangles * sizeof(glm::vec3) + (numBuckets + 1) * sizeof(uint32_t) + (uint64_t)header.numBucketTriangles * sizeof(uint32_t);
+    if (header.payloadSize != expectedSize || size - sizeof(header) != expectedSize) {
+        std::printf("%s is truncated or has extra data (%zu bytes, expected %llu)\n", name.c_str(), size, (unsigned long long)(expectedSize + sizeof(header)));
+        return false;
+    }
+    const char* payload = data + sizeof(header);
+    if (hashBytes(payload, header.payloadSize) != header.checksum) {
+        std::printf("%s is corrupt (checksum mismatch)\n", name.c_str());
+        return false;
+    }
+
+    mapVertices = (const glm::vec3*)payload;
+    mapTriangles = (const uint32_t*)(mapVertices + header.numVertices);
+    triangleNormals = (const glm::vec3*)(mapTriangles + 3 * header.numTriangles);
+    bucketStarts = (const uint32_t*)(triangleNormals + header.numTriangles);
+    bucketTriangles = bucketStarts + numBuckets + 1;
+    return true;
+}
+
+bool CollisionMap::writeBaked(const std::string& bakedFilePath) const {
+    std::ofstream file(bakedFilePath, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::printf("couldn't open %s for writing\n", bakedFilePath.c_str());
+        return false;
+    }
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)mapVertices, header.payloadSize);
+    return (bool)file;
+}
+
+std::unique_ptr<CollisionMap> CollisionMap::importMesh(const std::string& sourceFilePath) {
+    Assimp::Importer importer;
+
+    const aiScene* scene = importer.ReadFile(sourceFilePath, COLLISION_MAP_IMPORT_FLAGS);
+    if (scene == nullptr) {
+        std::cerr << "Unable to load 3d model from path " << sourceFilePath << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "Loaded environment model\n";
+
+    std::unique_ptr<CollisionMap> map(new CollisionMap());
+    BakedCollisionMapHeader& header = map->header;
+    header.magic = COLLISION_MAP_MAGIC;
+    header.version = COLLISION_MAP_VERSION;
+    header.bucketWidth = MAP_BUCKET_WIDTH;
+    // Assimp just read it, so it's there
+    readSourceStamp(sourceFilePath, header.source);
+
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> triangles;
+
+    unsigned int highestMeshIndex = scene->mNumMeshes;
+
+    // First pass over vertices to find the map bounds, we need them before we can bucket anything
+    for (unsigned int i = 0; i < highestMeshIndex; i++) {
+        aiMesh& mesh = *scene->mMeshes[i];
+        for (unsigned int j = 0; j < mesh.mNumVertices; j++) {
+            const aiVector3D& vertex = mesh.mVertices[j];
+            vertices.push_back(glm::vec3(vertex[0], vertex[1], vertex[2]));
+            if (vertex[0] < header.minX) {
+                header.minX = vertex[0];
+            } else if (vertex[0] > header.maxX) {
+                header.maxX = vertex[0];
+            }
+            if (vertex[1] < header.minY) {
+                header.minY = vertex[1];
+            } else if (vertex[1] > header.maxY) {
+                header.maxY = vertex[1];
+            }
+            if (vertex[2] < header.minZ) {
+                header.minZ = vertex[2];
+            }
+            else if (vertex[2] > header.maxZ) {
+                header.maxZ = vertex[2];
+            }
+        }
+    }
+
+    // Fill the buckets as sets first, then pack them into bucketStarts/bucketTriangles
+    std::vector<std::unordered_set<unsigned int>> buckets(MAP_BUCKET_WIDTH * MAP_BUCKET_WIDTH);
+
+    // Face indices are local to each mesh, so offset them by the number of vertices
+    // added by the meshes before it
+    unsigned int baseVertex = 0;
+    for (unsigned int i = 0; i < highestMeshIndex; i++) {
+        aiMesh& mesh = *scene->mMeshes[i];
+        for (unsigned int j = 0; j < mesh.mNumFaces; j++) {
+            const aiFace& face = mesh.mFaces[j];
+
+            // Add vertex indices to the main triangle vector
+            unsigned int triangleIndex = triangles.size() / 3;
+            triangles.push_back(baseVertex + face.mIndices[0]);
+            triangles.push_back(baseVertex + face.mIndices[1]);
+            triangles.push_back(baseVertex + face.mIndices[2]);
+
+            // A, B, and C are the vertices of this triangle
+            glm::vec3 A = vertices[baseVertex + face.mIndices[0]];
+            glm::vec3 B = vertices[baseVertex + face.mIndices[1]];
+            glm::vec3 C = vertices[baseVertex + face.mIndices[2]];
+
+            std::vector<unsigned int> bucketIndicesA = map->determineBucket(A.x, A.z);
+            std::vector<unsigned int> bucketIndicesB = map->determineBucket(B.x, B.z);
+            std::vector<unsigned int> bucketIndicesC = map->determineBucket(C.x, C.z);
+
+            // We want to put the triangles into every bucket they cover (usually this should just be one bucket)
+            // we do this by putting the triangle into all buckets in the rectangle from the minimum x index to the maximum x index
+            // and from the minimum z index to the maximum z index
+            // this may occasionally lead to putting a triangle into a bucket that it doesn't actually cover,
+            // but we don't care very much (small performance loss),
+            // and it should never lead to a triangle not being in a bucket it should be in
+            unsigned int minXIndex = std::min({bucketIndicesA[0], bucketIndicesB[0], bucketIndicesC[0]});
+            unsigned int maxXIndex = std::max({bucketIndicesA[0], bucketIndicesB[0], bucketIndicesC[0]});
+            unsigned int minZIndex = std::min({bucketIndicesA[1], bucketIndicesB[1], bucketIndicesC[1]});
+            unsigned int maxZIndex = std::max({bucketIndicesA[1], bucketIndicesB[1], bucketIndicesC[1]});
+            for (unsigned int xIndex = minXIndex; xIndex <= maxXIndex; xIndex++) {
+                for (unsigned int zIndex = minZIndex; zIndex <= maxZIndex; zIndex++) {
+                    // we store the buckets in a 1D-style, so convert this to a single index
+                    int bucketIndex = zIndex * MAP_BUCKET_WIDTH + xIndex;
+                    buckets[bucketIndex].insert(triangleIndex);
+                }
+            }
+        }
+        baseVertex += mesh.mNumVertices;
+    }
+
+    // Lay everything out exactly like a baked file so both ways of loading end up the same
+    std::vector<glm::vec3> normals;
+    normals.reserve(triangles.size() / 3);
+    for (size_t i = 0; i < triangles.size(); i += 3) {
+        glm::vec3 A = vertices[triangles[i + 0]];
+        glm::vec3 B = vertices[triangles[i + 1]];
+        glm::vec3 C = vertices[triangles[i + 2]];
+        normals.push_back(glm::normalize(glm::cross((C - A), (B - A))));
+    }
+    std::vector<uint32_t> starts;
+    std::vector<uint32_t> bucketContents;
+    starts.reserve(buckets.size() + 1);
+    for (const std::unordered_set<unsigned int>& bucket : buckets) {
+        starts.push_back(bucketContents.size());
+        bucketContents.insert(bucketContents.end(), bucket.begin(), bucket.end());
+    }
+    starts.push_back(bucketContents.size());
+
+    header.numVertices = vertices.size();
+    header.numTriangles = triangles.size() / 3;
+    header.numBucketTriangles = bucketContents.size();
+    header.payloadSize = vertices.size() * sizeof(glm::vec3) + triangles.size() * sizeof(uint32_t) + normals.size() * sizeof(glm::vec3)
+        + starts.size() * sizeof(uint32_t) + bucketContents.size() * sizeof(uint32_t);
+
+    std::vector<char>& data = map->importedData;
+    data.resize(sizeof(header));
+    auto append = [&data](const void* bytes, size_t size) {
+        data.insert(data.end(), (const char*)bytes, (const char*)bytes + size);
+    };
+    append(vertices.data(), vertices.size() * sizeof(glm::vec3));
+    append(triangles.data(), triangles.size() * sizeof(uint32_t));
+    append(normals.data(), normals.size() * sizeof(glm::vec3));
+    append(starts.data(), starts.size() * sizeof(uint32_t));
+    append(bucketContents.data(), bucketContents.size() * sizeof(uint32_t));
+    header.checksum = hashBytes(data.data() + sizeof(header), header.payloadSize);
+    std::memcpy(data.data(), &header, sizeof(header));
+
+    bool attached = map->attach(data.data(), data.size(), sourceFilePath);
+    assert(attached);
+
+    std::cout << "loaded vertices and triangles\n";
+    return map;
+}
+
+MeshIntersection CollisionMap::intersect(glm::vec3 p0, glm::vec3 p1, float maxT) const {
+    MeshIntersection bestIntersection;
+    bestIntersection.t = INFINITY;
+
+    // Determine which buckets to use for checking intersection
+    glm::vec3 endingPos = p0 + p1 * maxT;
+    std::vector<unsigned int> bucketIndicesStart = determineBucket(p0.x, p0.z);
+    std::vector<unsigned int> bucketIndicesEnd = determineBucket(endingPos.x, endingPos.z);
+    unsigned int minXIndex = std::min(bucketIndicesStart[0], bucketIndicesEnd[0]);
+    unsigned int maxXIndex = std::max(bucketIndicesStart[0], bucketIndicesEnd[0]);
+    unsigned int minZIndex = std::min(bucketIndicesStart[1], bucketIndicesEnd[1]);
+    unsigned int maxZIndex = std::max(bucketIndicesStart[1], bucketIndicesEnd[1]);
+
+    std::unordered_set<unsigned int> mergedBucket;
+    // Bullets have a long ray, so bucketStart and bucketEnd would be far apart, resulting in a large rectangle of buckets
+    // Many of them are unncessary. All we care about are buckets along ray.
+    // nice2have: Bresenham’s line generation algorithm. Fix below nxm.
+    for (unsigned int xIndex = minXIndex; xIndex <= maxXIndex; xIndex++) {
+        for (unsigned int zIndex = minZIndex; zIndex <= maxZIndex; zIndex++) {
+            // we store the buckets in a 1D-style, so convert this to a single index
+            int bucketIndex = zIndex * MAP_BUCKET_WIDTH + xIndex;
+            for (unsigned int i = bucketStarts[bucketIndex]; i < bucketStarts[bucketIndex + 1]; i++) {
+                mergedBucket.insert(bucketTriangles[i]);
+            }
+        }
+    }
+
+    for (unsigned int triangleIndex : mergedBucket) {
+        // get the points and the normals
+        glm::vec3 A = mapVertices[mapTriangles[3 * triangleIndex + 0]];
+        glm::vec3 B = mapVertices[mapTriangles[3 * triangleIndex + 1]];
+        glm::vec3 C = mapVertices[mapTriangles[3 * triangleIndex + 2]];
+        glm::vec3 n = triangleNormals[triangleIndex];
+        float t = (glm::dot(A, n) - glm::dot(p0, n)) / glm::dot(p1, n);
+        if (t > -0.001 && t < bestIntersection.t && t < maxT + 0.001) {
+            glm::vec3 iPos = p0 + t * p1;
+            float area = glm::length(glm::cross(B - A, C - B)) / 2;
+            float alpha = glm::length(glm::cross(B - iPos, C - iPos) / 2.0f) / area;
+            float beta = glm::length(glm::cross(A - iPos, C - iPos) / 2.0f) / area;
+            float gamma = glm::length(glm::cross(B - iPos, A - iPos) / 2.0f) / area;
+            // currently they have slight extra give of 0.01, this is because of floating point
+            // rounding. this can be adjusted
+            if (alpha >= -0.01 && beta >= -0.01 && gamma >= -0.01 && alpha + beta + gamma <= 1.01) {
+                bestIntersection.t = t;
+                bestIntersection.normal = n;
+            }
+        }
+    }
+
+    return bestIntersection;
+}
+
+std::vector<unsigned int> CollisionMap::determineBucket(float x, float z) const {
+    float bucketXDim = (header.maxX - header.minX) / MAP_BUCKET_WIDTH;
+    float bucketZDim = (header.maxZ - header.minZ) / MAP_BUCKET_WIDTH;
+
+    float xIndexFloat = (x - header.minX) / bucketXDim;
+    float zIndexFloat = (z - header.minZ) / bucketZDim;
+
+    // if we're too close to the edge of the map we might just barely end up in a bucket that doesn't exist,
+    // and we can never be completely precise with floats, so make sure we're not very far off the expected range
+    // and then fix it to be in the expected range
+    if (xIndexFloat >= MAP_BUCKET_WIDTH) xIndexFloat = MAP_BUCKET_WIDTH - 1;
+    if (zIndexFloat >= MAP_BUCKET_WIDTH) zIndexFloat = MAP_BUCKET_WIDTH - 1;
+    if (xIndexFloat < 0) xIndexFloat = 0;
+    if (zIndexFloat < 0) zIndexFloat = 0;
+
+    unsigned int xIndex = static_cast<unsigned int>(xIndexFloat);
+    unsigned int zIndex = static_cast<unsigned int>(zIndexFloat);
+
+    return { xIndex, zIndex };
+}
+
+bool CollisionMap::withinMapBounds(glm::vec3 pos) const {
+    return pos.x >= header.minX && pos.x <= header.maxX && pos.y >= header.minY && pos.y <= header.maxY + HEIGHT_LIMIT && pos.z >= header.minZ && pos.z <= header.maxZ;
+}
+
+namespace physics {
+
+    glm::vec3 forwardDirection(float yaw) {
+        glm::vec3 forwardDirection;
+        forwardDirection.x = cos(glm::radians(yaw));
+        forwardDirection.y = 0;
+        forwardDirection.z = sin(glm::radians(yaw));
+        return glm::normalize(forwardDirection);
+    }
+
+    /**
+     * Apply the player's movement requests, friction, gravity and jumping to their velocity
+     */
+    void accelerate(PlayerMovementState& state, const MovementInput& input, int currentSeason) {
+        glm::vec3 forward = forwardDirection(input.yaw);
+        glm::vec3 rightward = glm::cross(forward, glm::vec3(0, 1, 0));
+        glm::vec3 totalDirection = glm::vec3(0);
+        float air_modifier = (state.onGround) ? 1 : AIR_MOVEMENT_MODIFIER;
+
+        if (state.swappedControlsTicksLeft > 0) {
+            forward = -forward;
+            rightward = -rightward;
+            state.swappedControlsTicksLeft--;
+        }
+
+        if (input.forwardRequested)      totalDirection += forward;
+        if (input.backwardRequested)     totalDirection -= forward;
+        if (input.leftRequested)     totalDirection -= rightward;
+        if (input.rightRequested)    totalDirection += rightward;
+
+        if (totalDirection != glm::vec3(0)) totalDirection = glm::normalize(totalDirection);
+
+        float currentSpeed = MOVEMENT_SPEED;
+        if (state.movementSpeedTicksLeft > 0) {
+            currentSpeed = state.alternateMovementSpeed;
+            state.movementSpeedTicksLeft--;
+        }
+
+        state.velocity += totalDirection * currentSpeed * air_modifier;
+
+        if (state.onGround) {
+            state.velocity.x *= GROUND_FRICTION;
+            state.velocity.z *= GROUND_FRICTION;
+        }
+        else {
+            state.velocity.x *= AIR_FRICTION;
+            state.velocity.z *= AIR_FRICTION;
+        }
+        // Update velocity with accelerations (gravity, player jumping, etc.)
+        state.velocity.y -= state.jumpHeld ? GRAVITY : GRAVITY * FASTFALL_INCREASE;
+
+        if (state.jumpHeld && !input.jumpRequested) {
+            state.jumpHeld = false;
+        }
+
+        if (!state.jumpHeld && input.jumpRequested && state.doubleJumpUsed < (currentSeason==SUMMER_SEASON?MAX_JUMPS_ALLOWED+1:MAX_JUMPS_ALLOWED)) {
+            state.doubleJumpUsed++;
+            float jumpMult=(currentSeason==SUMMER_SEASON)?1.25:1; // higher jump height in summer
+            if (state.movementSpeedTicksLeft > 0) {
+                state.velocity.y = jumpMult*JUMP_SPEED/2; // decrease jump when slowed
+            } else state.velocity.y = jumpMult*JUMP_SPEED;     // as god of physics, i endorse = and not += here
+            state.jumpHeld = true;
+        }
+    }
+
+    /**
+     * Winter makes the ground slippery: the longer you stay on the ground the faster you slide
+     */
+    void applyWinterMomentum(glm::vec3& velocity, bool onGround, int& timeOnGround) {
+        if (onGround) {
+            timeOnGround++;
+            float speedMult = 1 + std::min(timeOnGround, 90) * 0.004;
+            velocity.x *= speedMult;
+            velocity.z *= speedMult;
+        } else {
+            timeOnGround = 0;
+            float speedMult = 0.8;
+            velocity.x *= speedMult;
+            velocity.z *= speedMult;
+        }
+    }
+
+    /**
+     * Remove any part of velocity that would move one of the collision points into the map.
+     * Does not move the entity, add the resulting velocity to the position afterwards
+     */
+    void collideWithMap(const CollisionMap& map, glm::vec3 position, glm::vec3& velocity, bool& onGround,
+                        const std::vector<glm::vec3>& collisionPoints, const std::vector<int>& groundPoints) {
+        onGround = false;
+        MeshIntersection inter;
+        int count = 0;
+        do {
+            int pointOfInter = -1;
+            inter.t = INFINITY;
+            for (unsigned int i = 0; i < collisionPoints.size(); i++) {
+                glm::vec3 p0 = position + collisionPoints[i];
+                // the t value that is returned is between 0 and 1; it is looking
+                // for a collision between p0+0*velocity and p0+1*velocity
+                MeshIntersection newInter = map.intersect(p0, velocity, 1);
+                if (newInter.t < inter.t) {
+                    pointOfInter = i;
+                    inter = newInter;
+                }
+            }
+            if(inter.t<1) {
+                bool stationaryOnGround=false;
+                for(unsigned int i=0; i<groundPoints.size(); i++) {
+                    if(groundPoints[i]==pointOfInter) {
+                        onGround=true;
+                        glm::vec3 velHorizontal=glm::vec3(velocity.x, 0, velocity.z);
+                        // if there is very low horizontal velocity, stop the player
+                        if(length(velHorizontal)<0.05) {
+                            stationaryOnGround=true;
+                        }
+                    }
+                }
+                // remove the velocity in the direction of the triangle except a little bit less
+                // so you aren't fully in the wall
+                velocity-=(1-inter.t)*inter.normal*glm::dot(inter.normal, velocity)+0.005f*inter.normal;
+                if(stationaryOnGround) {
+                    velocity=glm::vec3(0);
+                }
+                count++;
+                // we cap it at 100 collisions per second; this is pretty generous
+                if(count==100) break;
+            }
+        } while (inter.t < 1);
+    }
+
+    void stepPlayer(const CollisionMap& map, PlayerMovementState& state, const MovementInput& input, int currentSeason) {
+        accelerate(state, input, currentSeason);
+        if (currentSeason == WINTER_SEASON) {
+            applyWinterMomentum(state.velocity, state.onGround, state.timeOnGround);
+        }
+        collideWithMap(map, state.position, state.velocity, state.onGround, playerCollisionPoints(), playerGroundPoints());
+        state.position += state.velocity;
+        if (state.onGround) {
+            state.doubleJumpUsed = 0;
+        }
+    }
+
+    const std::vector<glm::vec3>& playerCollisionPoints() {
+        static const std::vector<glm::vec3> collisionPoints = {glm::vec3(0, -PLAYER_Y_HEIGHT/2, 0),glm::vec3(0, PLAYER_Y_HEIGHT/2, 0),
+                                                               glm::vec3(-PLAYER_X_WIDTH/2, 0, 0),glm::vec3(PLAYER_X_WIDTH/2, 0, 0),
+                                                               glm::vec3(0, 0, -PLAYER_Z_WIDTH/2),glm::vec3(0, 0, PLAYER_Z_WIDTH/2)};
+        return collisionPoints;
+    }
+
+    const std::vector<int>& playerGroundPoints() {
+        // only the bottom point counts as standing on something
+        static const std::vector<int> groundPoints = {0};
+        return groundPoints;
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <unordered_set>
+#include <glm/glm.hpp>
+#include "GameConstants.h"
+#include "MappedFile.h"
+#include "BakedAsset.h"
+#include "PlayerMovement.h"
+
+// Shared movement and map collision code. The server runs this for every player each tick,
+// the client runs the exact same code for its own player so it can predict its movement
+// instead of waiting a full round trip for the server to tell it where it is
+
+#define MAP_BUCKET_WIDTH 40
+
+// Result of a ray vs map mesh test. t is INFINITY if nothing was hit
+struct MeshIntersection {
+    float t;
+    glm::vec3 normal;
+};
+
+#define COLLISION_MAP_MAGIC 0x50414d43 // "CMAP" in a little-endian file
+// Bump whenever the layout below or how it's built changes, old files then get ignored until re-cooked
+#define COLLISION_MAP_VERSION 3
+
+/**
+ * Start of a baked collision map file (see collision_cooker). After it come, in this order: the vertices,
+ * the triangles (3 vertex indices each), one normal per triangle, bucket starts and bucket triangles.
+ * Everything is written exactly as it sits in memory, so baked files only work on little-endian machines
+ */
+struct BakedCollisionMapHeader {
+    uint32_t magic;
+    uint32_t version;
+    // MAP_BUCKET_WIDTH the buckets were built with
+    uint32_t bucketWidth;
+    uint32_t numVertices;
+    uint32_t numTriangles;
+    uint32_t numBucketTriangles;
+    float minX, maxX, minY, maxY, minZ, maxZ;
+    // bytes after the header, and their FNV-1a hash
+    uint64_t payloadSize;
+    uint64_t checksum;
+    // the mesh this was imported from, when it was imported
+    SourceStamp source;
+};
+static_assert(sizeof(BakedCollisionMapHeader) == 80, "baked collision map header must not have padding");
+
+/**
+ * Triangles of the collision map, bucketed on the xz plane so ray tests only look at nearby triangles.
+ * Never changes after loading, so one copy is shared by everything that collides with the same map
+ * (every match on the server, the client's movement prediction).
+ * The data is always laid out like a baked file. It's either a baked file mapped straight into memory,
+ * or a buffer built the same way from the source mesh
+ */
+class CollisionMap {
+public:
+    // Use the baked map if it's there and up to date, otherwise import the source mesh. If anyone
+    // still holds a copy of this map it's handed back instead of loading it again
+    static std::shared_ptr<const CollisionMap> load(const std::string& bakedFilePath, const std::string& sourceFilePath);
+
+    // Run the source mesh through Assimp and bucket it, exits if the file can't be read
+    static std::unique_ptr<CollisionMap> importMesh(const std::string& sourceFilePath);
+    // Map a baked file into memory, nullptr if it's missing, corrupt, from a different version
+    // or older than the source mesh (a missing source mesh is fine, the baked file is all we have then)
+    static std::unique_ptr<CollisionMap> loadBaked(const std::string& bakedFilePath, const std::string& sourceFilePath);
+    bool writeBaked(const std::string& bakedFilePath) const;
+
+    CollisionMap(const CollisionMap&) = delete;
+    CollisionMap& operator=(const CollisionMap&) = delete;
+
+    MeshIntersection intersect(glm::vec3 p0, glm::vec3 p1, float maxT) const;
+    bool withinMapBounds(glm::vec3 pos) const;
+
+    // Bytes of vertices, triangles, normals and buckets
+    size_t memoryUsage() const { return header.payloadSize; }
+    unsigned int numTriangles() const { return header.numTriangles; }
+    uint64_t checksum() const { return header.checksum; }
+    bool isMapped() const { return mappedFile.data() != nullptr; }
+
+private:
+    CollisionMap() = default;
+
+    // Check the header and point the arrays into the payload that follows it
+    bool attach(const char* data, size_t size, const std::string& name);
+
+    std::vector<unsigned int> determineBucket(float x, float z) const;
+
+    BakedCollisionMapHeader header = {};
+    // whichever one holds the header and payload
+    MappedFile mappedFile;
+    std::vector<char> importedData;
+
+    const glm::vec3* mapVertices = nullptr;
+    // 3 in a row give you a triangle, these are indices into mapVertices
+    const uint32_t* mapTriangles = nullptr;
+    const glm::vec3* triangleNormals = nullptr;
+    // Triangle indices of every bucket (MAP_BUCKET_WIDTH * MAP_BUCKET_WIDTH of them) one after the other
+    // (multiply by 3 to index into mapTriangles). Bucket i is bucketTriangles[bucketStarts[i]] up to bucketTriangles[bucketStarts[i + 1]]
+    const uint32_t* bucketStarts = nullptr;
+    const uint32_t* bucketTriangles = nullptr;
+};
+
+namespace physics {
+
+    glm::vec3 forwardDirection(float yaw);
+
+    void accelerate(PlayerMovementState& state, const MovementInput& input, int currentSeason);
+    void applyWinterMomentum(glm::vec3& velocity, bool onGround, int& timeOnGround);
+    void collideWithMap(const CollisionMap& map, glm::vec3 position, glm::vec3& velocity, bool& onGround,
+                        const std::vector<glm::vec3>& collisionPoints, const std::vector<int>& groundPoints);
+
+    // Runs one whole server tick of movement for a player (acceleration, season effects, map collision)
+    void stepPlayer(const CollisionMap& map, PlayerMovementState& state, const MovementInput& input, int currentSeason);
+
+    const std::vector<glm::vec3>& playerCollisionPoints();
+    const std::vector<int>& playerGroundPoints();
+}
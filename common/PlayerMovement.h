@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// The plain data that goes into and comes out of a player's movement step (see Physics.h).
+// Kept on its own so the network packets can carry it without pulling in the collision code
+
+namespace physics {
+
+    // The part of a player's input that affects movement
+    struct MovementInput {
+        bool forwardRequested;
+        bool backwardRequested;
+        bool leftRequested;
+        bool rightRequested;
+        bool jumpRequested;
+        float yaw;
+    };
+
+    // Everything needed to step a single player forward by one tick.
+    // Plain data so it can also be sent over the network for client-side reconciliation
+    struct PlayerMovementState {
+        glm::vec3 position;
+        glm::vec3 velocity;
+        bool onGround;
+        int timeOnGround;
+        int doubleJumpUsed;
+        bool jumpHeld;
+        // status effects that change how the player moves
+        float alternateMovementSpeed;
+        unsigned int movementSpeedTicksLeft;
+        unsigned int swappedControlsTicksLeft;
+    };
+}
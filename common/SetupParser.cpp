@@ -4,5 +4,6 @@ std::ifstream setup_filepath((std::string)PROJECT_PATH + "/common/setup.json");
 nlohmann::json SetupParser::setup_file_data = nlohmann::json::parse(setup_filepath);
 
 std::string SetupParser::getValue(std::string key) {
-	return setup_file_data[key];
+	// at() never inserts, so this is safe to call from several threads at once
+	return setup_file_data.at(key);
 };
\ No newline at end of file
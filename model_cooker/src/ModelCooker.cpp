@@ -0,0 +1,71 @@
+// model_cooker.cpp : Bakes the client's models so it can map them into memory instead of importing them.
+//
+// Usage: model_cooker [source model...]
+// With no arguments it bakes every model the client loads. Each baked file goes next to its source with the
+// extension swapped for BAKED_MODEL_EXTENSION. Re-run it whenever a model or BAKED_MODEL_VERSION changes,
+// the client falls back to the slow import for anything stale or missing
+
+#include "sge/ModelData.h"
+
+#define STB_IMAGE_IMPLEMENTATION // The client gets this from GraphicsGeometry.cpp
+#include <stb_image.h>
+
+#include <set>
+#include <chrono>
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool cookModel(const std::string& sourcePath)
+{
+    auto start = std::chrono::steady_clock::now();
+    // Compress the textures too, the client keeps them compressed on the GPU
+    std::unique_ptr<sge::ModelData> model = sge::ModelData::importModel(sourcePath, true);
+    if (model == nullptr) {
+        return false;
+    }
+    std::printf("imported %s in %.2fs: %u vertices, %u textures, %u animations, %zu KB\n", sourcePath.c_str(), secondsSince(start),
+        model->header.numVertices, model->header.numTextures, model->header.numAnimations, model->memoryUsage() / 1024);
+
+    std::string bakedPath = sge::ModelData::bakedPathFor(sourcePath);
+    if (!model->writeBaked(bakedPath)) {
+        return false;
+    }
+
+    // Read it back the way the game will, so a bad write shows up here and not at client start
+    start = std::chrono::steady_clock::now();
+    std::unique_ptr<sge::ModelData> baked = sge::ModelData::loadBaked(bakedPath, sourcePath);
+    if (baked == nullptr || baked->header.checksum != model->header.checksum) {
+        std::printf("%s didn't read back correctly\n", bakedPath.c_str());
+        return false;
+    }
+    std::printf("wrote %s (version %d, checksum %016llx), loads in %.1fms\n", bakedPath.c_str(), BAKED_MODEL_VERSION,
+        (unsigned long long)baked->header.checksum, secondsSince(start) * 1000);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> sourcePaths;
+    for (int i = 1; i < argc; i++) {
+        sourcePaths.push_back(argv[i]);
+    }
+    if (sourcePaths.empty()) {
+        sourcePaths = sge::modelSourcePaths();
+    }
+
+    // The same model can be in the list more than once, only bake it once
+    std::set<std::string> cooked;
+    int failures = 0;
+    for (const std::string& sourcePath : sourcePaths) {
+        if (cooked.insert(sourcePath).second && !cookModel(sourcePath)) {
+            failures++;
+        }
+    }
+    if (failures > 0) {
+        std::printf("%d of %zu models failed to bake\n", failures, cooked.size());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>  // Needed for TCP_NODELAY
+#include <arpa/inet.h>
+#include <unistd.h>   // Needed for close()
+#include <netdb.h>    // Needed for getaddrinfo() and freeaddrinfo()
+#include <fcntl.h>    // Needed for fcntl
+#include <poll.h>
+#include <errno.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <random>
+#include "NetworkServices.h"
+#include "NetworkData.h"
+
+// Stop reading from a socket while this many bytes are waiting to go out the other side,
+// so a bandwidth cap backs up into the sender's TCP buffers like a real slow link would
+#define PROXY_MAX_QUEUED_BYTES (1 << 20)
+// Linux never retransmits a lost segment sooner than this
+#define TCP_MIN_RTO_MS 200.0
+// A reordered segment makes TCP wait for the one that got overtaken, on top of the jitter
+#define REORDER_HOLD_MS 10.0
+#define PROXY_STATS_INTERVAL_MS 5000.0
+#define PROXY_RECV_BUFLEN 65536
+
+enum LinkDirection {
+    // client to server
+    UPSTREAM = 0,
+    // server to client
+    DOWNSTREAM = 1,
+    NUM_LINK_DIRECTIONS
+};
+
+// How bad one direction of the network is right now
+struct LinkProfile {
+    double latencyMs = 0;
+    double jitterMs = 0;
+    double lossPercent = 0;
+    double reorderPercent = 0;
+    // 0 means no cap
+    double bandwidthKbps = 0;
+};
+
+// One line of a profile script, already merged with the lines before it
+struct ProfileStep {
+    double startSeconds;
+    LinkProfile profiles[NUM_LINK_DIRECTIONS];
+};
+
+/**
+ * Time-varying link profiles read from a text file, see netem_proxy/profiles/example.txt for the format
+ */
+class ProfileScript {
+public:
+    // Returns false (after printing why) if the file can't be read or has a bad line
+    bool load(const std::string& path);
+
+    // Index of the step in effect after running for elapsedSeconds
+    size_t stepAt(double elapsedSeconds) const;
+    const LinkProfile& profileAt(LinkDirection direction, double elapsedSeconds) const;
+
+    void printStep(size_t step) const;
+
+private:
+    // always has at least one step starting at 0 (no impairment unless the script says so)
+    std::vector<ProfileStep> steps = { ProfileStep{ 0, {} } };
+    // if non-zero, the script starts over after this many seconds
+    double loopSeconds = 0;
+};
+
+/**
+ * One direction of one proxied connection. Cuts the byte stream into game messages (UpdateHeader plus
+ * its struct) and holds each one back according to the current profile before passing it on.
+ *
+ * We're proxying TCP, so loss and reordering can't actually drop or shuffle bytes. They show up the way
+ * TCP shows them to the game: a message that waits for a retransmit (or for an overtaken segment),
+ * and everything behind it stuck waiting too
+ */
+class ImpairedLink {
+public:
+    ImpairedLink(LinkDirection direction, SOCKET from, SOCKET to, unsigned int seed);
+
+    // Read whatever arrived on the from socket. Returns false if it closed or sent garbage
+    bool receive(const LinkProfile& profile, double nowMs);
+    // Write out every message that's due. Returns false if the to socket is broken
+    bool deliver(double nowMs);
+
+    // When the next message is due, or INFINITY if nothing is queued
+    double nextDeliveryMs() const;
+    bool wantsToRead() const { return queuedBytes < PROXY_MAX_QUEUED_BYTES; }
+    bool wantsToWrite() const { return writeOffset > 0; }
+
+    // Print counters since the last call, then reset them
+    void printStats(double intervalMs);
+
+    LinkDirection direction;
+    SOCKET from;
+    SOCKET to;
+
+private:
+    struct DelayedMessage {
+        std::vector<char> data;
+        double deliverAtMs;
+    };
+
+    void schedule(std::vector<char>&& message, unsigned int updateType, const LinkProfile& profile, double nowMs);
+    bool chance(double percent);
+
+    // bytes read but not a whole message yet
+    std::vector<char> partial;
+    std::deque<DelayedMessage> queue;
+    size_t queuedBytes = 0;
+    // how much of queue.front() the to socket already took
+    size_t writeOffset = 0;
+
+    // when the bandwidth cap is done pushing the bytes we've accepted so far
+    double linkFreeAtMs = 0;
+    // delivery time of the newest message, TCP never lets a later one arrive first
+    double lastDeliverAtMs = 0;
+
+    std::mt19937 rng;
+    std::normal_distribution<double> jitterDistribution = std::normal_distribution<double>(0.0, 1.0);
+    std::uniform_real_distribution<double> percentDistribution = std::uniform_real_distribution<double>(0.0, 100.0);
+
+    // stats since the last printStats
+    uint64_t bytes = 0;
+    uint64_t messages = 0;
+    uint64_t bytesPerType[NUM_UPDATE_TYPES] = {};
+    uint64_t messagesPerType[NUM_UPDATE_TYPES] = {};
+    unsigned int losses = 0;
+    unsigned int reorders = 0;
+    double totalDelayMs = 0;
+    double maxDelayMs = 0;
+};
+
+struct ProxyConnection {
+    unsigned int id;
+    SOCKET clientSocket;
+    SOCKET serverSocket;
+    ImpairedLink upstream;
+    ImpairedLink downstream;
+};
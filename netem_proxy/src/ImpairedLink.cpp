@@ -0,0 +1,128 @@
+#include "NetemProxy.h"
+#include "NetTelemetry.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+static const char* directionNames[NUM_LINK_DIRECTIONS] = { "client->server", "server->client" };
+
+ImpairedLink::ImpairedLink(LinkDirection direction, SOCKET from, SOCKET to, unsigned int seed)
+    : direction(direction), from(from), to(to), rng(seed) {
+}
+
+bool ImpairedLink::chance(double percent) {
+    return percent > 0 && percentDistribution(rng) < percent;
+}
+
+bool ImpairedLink::receive(const LinkProfile& profile, double nowMs) {
+    char buffer[PROXY_RECV_BUFLEN];
+    int received = recv(from, buffer, sizeof(buffer), 0);
+    if (received == 0) {
+        return false;
+    }
+    if (received < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    partial.insert(partial.end(), buffer, buffer + received);
+
+    // Pull out every complete message
+    size_t start = 0;
+    while (partial.size() - start >= sizeof(UpdateHeader)) {
+        UpdateHeader header;
+        deserialize(&header, &partial[start]);
+        if (header.update_type >= NUM_UPDATE_TYPES || header.data_length > MAX_PACKET_SIZE) {
+            std::printf("[netem] %s: bad update (type %u, %u bytes), dropping the connection\n", directionNames[direction], header.update_type, header.data_length);
+            return false;
+        }
+        size_t messageSize = sizeof(UpdateHeader) + header.data_length;
+        if (partial.size() - start < messageSize) {
+            break;
+        }
+        schedule(std::vector<char>(partial.begin() + start, partial.begin() + start + messageSize), header.update_type, profile, nowMs);
+        start += messageSize;
+    }
+    partial.erase(partial.begin(), partial.begin() + start);
+    return true;
+}
+
+void ImpairedLink::schedule(std::vector<char>&& message, unsigned int updateType, const LinkProfile& profile, double nowMs) {
+    // Time for the bytes to squeeze through the bandwidth cap (kbps is the same as bits per ms)
+    double sentMs = nowMs;
+    if (profile.bandwidthKbps > 0) {
+        linkFreeAtMs = std::max(linkFreeAtMs, nowMs) + message.size() * 8 / profile.bandwidthKbps;
+        sentMs = linkFreeAtMs;
+    }
+
+    double delayMs = profile.latencyMs;
+    if (profile.jitterMs > 0) {
+        delayMs += jitterDistribution(rng) * profile.jitterMs;
+    }
+    if (chance(profile.lossPercent)) {
+        // the segment has to be resent, which takes at least an RTO
+        delayMs += std::max(TCP_MIN_RTO_MS, 2 * profile.latencyMs);
+        losses++;
+    } else if (chance(profile.reorderPercent)) {
+        delayMs += profile.jitterMs + REORDER_HOLD_MS;
+        reorders++;
+    }
+
+    double deliverAtMs = std::max(sentMs + std::max(delayMs, 0.0), lastDeliverAtMs);
+    lastDeliverAtMs = deliverAtMs;
+
+    bytes += message.size();
+    messages++;
+    bytesPerType[updateType] += message.size();
+    messagesPerType[updateType]++;
+    totalDelayMs += deliverAtMs - nowMs;
+    maxDelayMs = std::max(maxDelayMs, deliverAtMs - nowMs);
+
+    queuedBytes += message.size();
+    queue.push_back({ std::move(message), deliverAtMs });
+}
+
+bool ImpairedLink::deliver(double nowMs) {
+    while (!queue.empty() && queue.front().deliverAtMs <= nowMs) {
+        DelayedMessage& message = queue.front();
+        int sent = send(to, message.data.data() + writeOffset, message.data.size() - writeOffset, MSG_NOSIGNAL);
+        if (sent < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        writeOffset += sent;
+        if (writeOffset < message.data.size()) {
+            // socket is full, wait for POLLOUT
+            return true;
+        }
+        queuedBytes -= message.data.size();
+        writeOffset = 0;
+        queue.pop_front();
+    }
+    return true;
+}
+
+double ImpairedLink::nextDeliveryMs() const {
+    return queue.empty() ? INFINITY : queue.front().deliverAtMs;
+}
+
+void ImpairedLink::printStats(double intervalMs) {
+    double seconds = intervalMs / 1000.0;
+    std::printf("    %s: %.1f kbps, %.1f msgs/s, added delay avg %.1fms max %.1fms, %u losses, %u reorders, %zu bytes queued\n",
+        directionNames[direction], bytes * 8 / 1000.0 / seconds, messages / seconds,
+        messages > 0 ? totalDelayMs / messages : 0.0, maxDelayMs, losses, reorders, queuedBytes);
+    for (unsigned int type = 0; type < NUM_UPDATE_TYPES; type++) {
+        if (messagesPerType[type] == 0) {
+            continue;
+        }
+        std::printf("        %-20s %.1f kbps, %.1f msgs/s, %.0f bytes each\n", updateTypeName(type), bytesPerType[type] * 8 / 1000.0 / seconds,
+            messagesPerType[type] / seconds, (double)bytesPerType[type] / messagesPerType[type]);
+    }
+
+    bytes = 0;
+    messages = 0;
+    std::memset(bytesPerType, 0, sizeof(bytesPerType));
+    std::memset(messagesPerType, 0, sizeof(messagesPerType));
+    losses = 0;
+    reorders = 0;
+    totalDelayMs = 0;
+    maxDelayMs = 0;
+}
@@ -0,0 +1,201 @@
+// netem_proxy.cpp : Sits between the client and the server on one machine and makes the network worse on purpose.
+//
+// Usage: netem_proxy [profile script] [listen port] [server ip] [server port]
+// Ports and ip default to "netem-proxy-port", "server-ip" and "server-port" in setup.json. Point the client at the
+// proxy by setting "client-connect-port" to the proxy's port
+
+#include "NetemProxy.h"
+#include "SetupParser.h"
+
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+
+static double nowMs() {
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool setNonBlocking(SOCKET s) {
+    int flags = fcntl(s, F_GETFL, 0);
+    return flags != -1 && fcntl(s, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+static void setNoDelay(SOCKET s) {
+    int value = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+}
+
+static SOCKET listenOn(const std::string& port) {
+    struct addrinfo hints;
+    struct addrinfo* result = NULL;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    hints.ai_flags = AI_PASSIVE;
+
+    if (getaddrinfo(NULL, port.c_str(), &hints, &result) != 0) {
+        std::printf("getaddrinfo failed for port %s\n", port.c_str());
+        return INVALID_SOCKET;
+    }
+    SOCKET s = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (ISINVALIDSOCKET(s) || bind(s, result->ai_addr, (int)result->ai_addrlen) == SOCKET_ERROR || listen(s, SOMAXCONN) == SOCKET_ERROR) {
+        std::printf("couldn't listen on port %s: %d\n", port.c_str(), GETSOCKETERRNO());
+        freeaddrinfo(result);
+        return INVALID_SOCKET;
+    }
+    freeaddrinfo(result);
+    setNonBlocking(s);
+    return s;
+}
+
+static SOCKET connectTo(const std::string& ip, const std::string& port) {
+    struct addrinfo hints;
+    struct addrinfo* result = NULL;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    if (getaddrinfo(ip.c_str(), port.c_str(), &hints, &result) != 0) {
+        std::printf("getaddrinfo failed for %s:%s\n", ip.c_str(), port.c_str());
+        return INVALID_SOCKET;
+    }
+    SOCKET s = INVALID_SOCKET;
+    for (struct addrinfo* ptr = result; ptr != NULL; ptr = ptr->ai_next) {
+        s = socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
+        if (ISINVALIDSOCKET(s)) {
+            continue;
+        }
+        if (connect(s, ptr->ai_addr, (int)ptr->ai_addrlen) == SOCKET_ERROR) {
+            CLOSESOCKET(s);
+            s = INVALID_SOCKET;
+            continue;
+        }
+        break;
+    }
+    freeaddrinfo(result);
+    return s;
+}
+
+int main(int argc, char** argv)
+{
+    ProfileScript script;
+    if (argc > 1 && !script.load(argv[1])) {
+        return 1;
+    }
+    if (argc <= 1) {
+        std::printf("no profile script given, passing everything through untouched\n");
+    }
+    std::string listenPort = argc > 2 ? argv[2] : SetupParser::getValue("netem-proxy-port");
+    std::string serverIp = argc > 3 ? argv[3] : SetupParser::getValue("server-ip");
+    std::string serverPort = argc > 4 ? argv[4] : SetupParser::getValue("server-port");
+
+    SOCKET listenSocket = listenOn(listenPort);
+    if (ISINVALIDSOCKET(listenSocket)) {
+        return 1;
+    }
+    std::printf("netem_proxy listening on %s, forwarding to %s:%s\n", listenPort.c_str(), serverIp.c_str(), serverPort.c_str());
+
+    std::vector<std::unique_ptr<ProxyConnection>> connections;
+    unsigned int nextConnectionId = 0;
+    size_t currentStep = script.stepAt(0);
+    script.printStep(currentStep);
+    double lastStatsMs = nowMs();
+
+    while (true) {
+        double now = nowMs();
+        double elapsedSeconds = now / 1000.0;
+
+        size_t step = script.stepAt(elapsedSeconds);
+        if (step != currentStep) {
+            currentStep = step;
+            script.printStep(currentStep);
+        }
+
+        // Wait for traffic, or until the next held back message is due
+        std::vector<struct pollfd> fds;
+        fds.push_back({ listenSocket, POLLIN, 0 });
+        double nextDueMs = INFINITY;
+        for (std::unique_ptr<ProxyConnection>& c : connections) {
+            short clientEvents = (c->upstream.wantsToRead() ? POLLIN : 0) | (c->downstream.wantsToWrite() ? POLLOUT : 0);
+            short serverEvents = (c->downstream.wantsToRead() ? POLLIN : 0) | (c->upstream.wantsToWrite() ? POLLOUT : 0);
+            fds.push_back({ c->clientSocket, clientEvents, 0 });
+            fds.push_back({ c->serverSocket, serverEvents, 0 });
+            nextDueMs = std::min({ nextDueMs, c->upstream.nextDeliveryMs(), c->downstream.nextDeliveryMs() });
+        }
+        int timeoutMs = 100;
+        if (nextDueMs != INFINITY) {
+            timeoutMs = (int)std::clamp(std::ceil(nextDueMs - now), 0.0, 100.0);
+        }
+        poll(fds.data(), fds.size(), timeoutMs);
+        now = nowMs();
+        elapsedSeconds = now / 1000.0;
+
+        if (fds[0].revents & POLLIN) {
+            SOCKET clientSocket = accept(listenSocket, NULL, NULL);
+            if (!ISINVALIDSOCKET(clientSocket)) {
+                SOCKET serverSocket = connectTo(serverIp, serverPort);
+                if (ISINVALIDSOCKET(serverSocket)) {
+                    std::printf("couldn't reach the server at %s:%s, dropping the client\n", serverIp.c_str(), serverPort.c_str());
+                    CLOSESOCKET(clientSocket);
+                } else {
+                    setNonBlocking(clientSocket);
+                    setNonBlocking(serverSocket);
+                    setNoDelay(clientSocket);
+                    setNoDelay(serverSocket);
+                    unsigned int id = nextConnectionId++;
+                    connections.push_back(std::unique_ptr<ProxyConnection>(new ProxyConnection{ id, clientSocket, serverSocket,
+                        ImpairedLink(UPSTREAM, clientSocket, serverSocket, id * 2 + 1),
+                        ImpairedLink(DOWNSTREAM, serverSocket, clientSocket, id * 2 + 2) }));
+                    std::printf("connection %u opened\n", id);
+                }
+            }
+        }
+
+        // fds has the listen socket first, then a client and server socket for each connection we had before accepting
+        size_t fdIndex = 1;
+        for (size_t i = 0; i < connections.size(); /* no increment */) {
+            ProxyConnection& c = *connections[i];
+            // a connection accepted this iteration wasn't polled yet
+            short clientRevents = fdIndex < fds.size() ? fds[fdIndex].revents : 0;
+            short serverRevents = fdIndex + 1 < fds.size() ? fds[fdIndex + 1].revents : 0;
+            fdIndex += 2;
+
+            bool ok = true;
+            if (clientRevents & (POLLIN | POLLHUP | POLLERR)) {
+                ok = c.upstream.receive(script.profileAt(UPSTREAM, elapsedSeconds), now) && ok;
+            }
+            if (serverRevents & (POLLIN | POLLHUP | POLLERR)) {
+                ok = c.downstream.receive(script.profileAt(DOWNSTREAM, elapsedSeconds), now) && ok;
+            }
+            ok = c.upstream.deliver(now) && ok;
+            ok = c.downstream.deliver(now) && ok;
+
+            if (!ok) {
+                std::printf("connection %u closed\n", c.id);
+                CLOSESOCKET(c.clientSocket);
+                CLOSESOCKET(c.serverSocket);
+                connections.erase(connections.begin() + i);
+                continue;
+            }
+            i++;
+        }
+
+        if (now - lastStatsMs >= PROXY_STATS_INTERVAL_MS) {
+            for (std::unique_ptr<ProxyConnection>& c : connections) {
+                std::printf("[netem] connection %u\n", c->id);
+                c->upstream.printStats(now - lastStatsMs);
+                c->downstream.printStats(now - lastStatsMs);
+            }
+            lastStatsMs = now;
+        }
+    }
+
+    return 0;
+}
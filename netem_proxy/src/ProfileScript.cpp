@@ -0,0 +1,137 @@
+#include "NetemProxy.h"
+
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+static const char* directionNames[NUM_LINK_DIRECTIONS] = { "up", "down" };
+
+/**
+ * Each line is "<start seconds> <up|down|both> [latency=ms] [jitter=ms] [loss=%] [reorder=%] [bandwidth=kbps]".
+ * Anything a line doesn't mention stays how the previous lines left it. "loop <seconds>" repeats the script,
+ * and # starts a comment
+ */
+bool ProfileScript::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::printf("couldn't open profile script %s\n", path.c_str());
+        return false;
+    }
+
+    struct Line {
+        double startSeconds;
+        bool applies[NUM_LINK_DIRECTIONS];
+        std::vector<std::pair<std::string, double>> settings;
+        int lineNumber;
+    };
+    std::vector<Line> lines;
+
+    std::string text;
+    int lineNumber = 0;
+    while (std::getline(file, text)) {
+        lineNumber++;
+        text = text.substr(0, text.find('#'));
+        std::istringstream words(text);
+        std::string first;
+        if (!(words >> first)) {
+            continue;
+        }
+
+        if (first == "loop") {
+            if (!(words >> loopSeconds) || loopSeconds <= 0) {
+                std::printf("%s:%d: loop needs a positive number of seconds\n", path.c_str(), lineNumber);
+                return false;
+            }
+            continue;
+        }
+
+        Line line = {};
+        line.lineNumber = lineNumber;
+        std::string direction;
+        try {
+            line.startSeconds = std::stod(first);
+        } catch (...) {
+            std::printf("%s:%d: expected a start time in seconds, got \"%s\"\n", path.c_str(), lineNumber, first.c_str());
+            return false;
+        }
+        if (!(words >> direction) || (direction != "up" && direction != "down" && direction != "both")) {
+            std::printf("%s:%d: expected up, down or both after the start time\n", path.c_str(), lineNumber);
+            return false;
+        }
+        line.applies[UPSTREAM] = direction != "down";
+        line.applies[DOWNSTREAM] = direction != "up";
+
+        std::string setting;
+        while (words >> setting) {
+            size_t equals = setting.find('=');
+            std::string key = setting.substr(0, equals);
+            double value;
+            try {
+                value = std::stod(setting.substr(equals + 1));
+            } catch (...) {
+                equals = std::string::npos;
+            }
+            if (equals == std::string::npos || value < 0 ||
+                (key != "latency" && key != "jitter" && key != "loss" && key != "reorder" && key != "bandwidth")) {
+                std::printf("%s:%d: don't understand \"%s\"\n", path.c_str(), lineNumber, setting.c_str());
+                return false;
+            }
+            line.settings.push_back({ key, value });
+        }
+        lines.push_back(line);
+    }
+
+    // Apply the lines in time order, each one on top of everything before it
+    std::stable_sort(lines.begin(), lines.end(), [](const Line& a, const Line& b) { return a.startSeconds < b.startSeconds; });
+    ProfileStep current = { 0, {} };
+    steps.clear();
+    for (const Line& line : lines) {
+        current.startSeconds = line.startSeconds;
+        for (int d = 0; d < NUM_LINK_DIRECTIONS; d++) {
+            if (!line.applies[d]) {
+                continue;
+            }
+            LinkProfile& profile = current.profiles[d];
+            for (const auto& [key, value] : line.settings) {
+                if (key == "latency")        profile.latencyMs = value;
+                else if (key == "jitter")    profile.jitterMs = value;
+                else if (key == "loss")      profile.lossPercent = std::min(value, 100.0);
+                else if (key == "reorder")   profile.reorderPercent = std::min(value, 100.0);
+                else if (key == "bandwidth") profile.bandwidthKbps = value;
+            }
+        }
+        // several lines at the same time just merge into one step
+        if (!steps.empty() && steps.back().startSeconds == current.startSeconds) {
+            steps.back() = current;
+        } else {
+            steps.push_back(current);
+        }
+    }
+    if (steps.empty() || steps.front().startSeconds > 0) {
+        steps.insert(steps.begin(), ProfileStep{ 0, {} });
+    }
+    return true;
+}
+
+size_t ProfileScript::stepAt(double elapsedSeconds) const {
+    double t = loopSeconds > 0 ? std::fmod(elapsedSeconds, loopSeconds) : elapsedSeconds;
+    size_t step = 0;
+    while (step + 1 < steps.size() && steps[step + 1].startSeconds <= t) {
+        step++;
+    }
+    return step;
+}
+
+const LinkProfile& ProfileScript::profileAt(LinkDirection direction, double elapsedSeconds) const {
+    return steps[stepAt(elapsedSeconds)].profiles[direction];
+}
+
+void ProfileScript::printStep(size_t step) const {
+    for (int d = 0; d < NUM_LINK_DIRECTIONS; d++) {
+        const LinkProfile& p = steps[step].profiles[d];
+        std::printf("[netem] %6.1fs %-4s latency %.0fms  jitter %.0fms  loss %.1f%%  reorder %.1f%%  bandwidth %s\n",
+            steps[step].startSeconds, directionNames[d], p.latencyMs, p.jitterMs, p.lossPercent, p.reorderPercent,
+            p.bandwidthKbps > 0 ? (std::to_string((int)p.bandwidthKbps) + "kbps").c_str() : "unlimited");
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ServerGame.h"
+#include "Physics.h"
+#include "SetupParser.h"
+
+// How many threads run match ticks, 0 means one per core
+#define MATCH_WORKER_THREADS std::stoi(SetupParser::getValue("match_worker_threads"))
+
+// A thread that ticks its own set of matches. A match stays on the worker it started on
+struct MatchWorker {
+    unsigned int id;
+    std::thread thread;
+    // guards matches, the manager adds to it and the worker removes finished ones
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ServerGame>> matches;
+};
+
+/**
+ * Runs many independent matches in one process. New connections fill up the newest match that hasn't
+ * started yet, and a new match is made when there isn't one. Every match shares the same collision map
+ */
+class MatchManager
+{
+public:
+    MatchManager();
+    ~MatchManager();
+
+    // Accept connections and hand them out to matches, never returns
+    void run();
+
+private:
+    void openListenSocket();
+    void assignToMatch(SOCKET clientSocket);
+    std::shared_ptr<ServerGame> createMatch();
+    void workerLoop(MatchWorker& worker);
+
+    SOCKET listenSocket = INVALID_SOCKET;
+
+    // read-only assets shared by every match, held here so they stay loaded between matches
+    std::shared_ptr<const CollisionMap> collisionMap;
+
+    std::vector<std::unique_ptr<MatchWorker>> workers;
+
+    // the match new players join, only touched by the accepting thread
+    std::shared_ptr<ServerGame> openMatch;
+    unsigned int nextMatchId = 0;
+};
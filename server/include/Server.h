@@ -4,7 +4,7 @@
 #pragma once
 
 #include <iostream>
-#include "ServerGame.h"
+#include "MatchManager.h"
 #include "SetupParser.h"
 
 #include <chrono>
@@ -8,6 +8,9 @@
 #include "bge/World.h"
 #include "bge/Entity.h"
 #include <set>
+#include <chrono>
+#include <mutex>
+#include <atomic>
 
 // this is to fix the circular dependency
 class ServerNetwork;
@@ -17,32 +20,61 @@ class ServerGame
 
 public:
 
-    ServerGame(void);
+    ServerGame(unsigned int matchId, std::shared_ptr<const CollisionMap> collisionMap);
     ~ServerGame(void);
 
     void update();
+
+    // Called from the accepting thread. Returns false if the match is full, started or finished,
+    // otherwise the socket joins the match at the start of its next tick
+    bool addClient(SOCKET socket);
+    // Called from the match's worker after a tick. True once everyone who joined has left,
+    // after which addClient always fails
+    bool closeIfFinished();
+
+    const unsigned int matchId;
+
     void handleInitConnection(unsigned int client_id);
     void handleClientActionInput(unsigned int client_id, ClientToServerPacket& packet);
 
     void handleClientLobbyInput(unsigned int client_id, LobbyClientToServerPacket& packet);
+    // Called by the network when a client's session is gone for good
+    void handleDisconnect(unsigned int client_id);
+    // receivedMs is serverTimeMs() when the request was read off the socket
+    void handleClockSyncRequest(unsigned int client_id, ClockSyncRequest& request, double receivedMs);
+
+    // Milliseconds since the server started, the clock clients sync against
+    double serverTimeMs();
 
     // Game states of world (e.g. golden egg, season)
     
 
 private:
     // IDs for the clients connecting for table in ServerNetwork 
-    static unsigned int client_id;
+    unsigned int client_id;
+    // IDs below client_id whose client left before the match started
+    std::set<unsigned int> freeClientIds;
 
     // The ServerNetwork object
     std::unique_ptr<ServerNetwork> network;
 
-    // data buffer
-    char network_data[MAX_PACKET_SIZE];
-
     bge::World world;
 
     std::set<unsigned int> readyPlayers;
 
-    bool timeStarted = false;
+    // read by the accepting thread to decide whether anyone else can join
+    std::atomic<bool> timeStarted = false;
+
+    // sockets handed over by addClient that update() hasn't picked up yet
+    std::mutex incomingMutex;
+    std::vector<SOCKET> incomingClients;
+    unsigned int numAddedClients = 0;
+    // whether anyone has ever joined, the match is over once they've all left
+    bool hadClients = false;
+    bool finished = false;
+
+    std::chrono::steady_clock::time_point startTime;
+    // serverTimeMs() at the start of the current tick, stamped on snapshots
+    double tickStartMs = 0;
 
 };
\ No newline at end of file
@@ -16,15 +16,20 @@
 #endif
 
 #include <map>
+#include <set>
+#include <chrono>
 #include <iostream>
 #include "NetworkServices.h"
 #include "NetworkData.h"
+#include "NetTelemetry.h"
 class ServerGame;
 #include "ServerGame.h"
 
 #pragma comment (lib, "Ws2_32.lib")
 
 #define DEFAULT_BUFLEN 512
+// A client that has this much unsent data queued up isn't reading anymore, drop it
+#define MAX_QUEUED_SEND_BYTES (4 * MAX_PACKET_SIZE)
 
 class ServerNetwork
 {
@@ -47,11 +52,7 @@ public:
     
     void sendCharacterSelectionUpdate(LobbyServerToClientPacket& packet);
 
-    // Socket to listen for new connections
-    SOCKET ListenSocket;
-
-    // Socket to give to the clients
-    SOCKET ClientSocket;
+    void sendClockSyncReply(unsigned int client_id, ClockSyncReply& reply);
 
     // for error checking return values
     int iResult;
@@ -59,22 +60,50 @@ public:
     // table to keep track of each client's socket
     std::map<unsigned int, SOCKET> sessions;
 
+    // traffic counters for each client session
+    std::map<unsigned int, NetTelemetry> telemetry;
+
+    // print every session's telemetry every TELEMETRY_LOG_INTERVAL_MS
+    void logTelemetry();
+
     // get all updates from clients
     void receiveFromClients();
+
+    // retry whatever the socket wouldn't take last tick, called once at the start of each tick
+    void flushSends();
     
-    // accept new connections
-    bool acceptNewClient(unsigned int& id);
+    // start talking to a client the match manager accepted
+    void addSession(unsigned int id, SOCKET socket);
 
     // receive incoming data
-    int receiveData(unsigned int client_id, char* recvbuf);
+    int receiveData(unsigned int client_id, char* recvbuf, int bufSize);
 
     // issue client_id to individual client
     void sendToClient(unsigned int client_id, char* packets, int totalSize);
 
     // send data to all clients
     void sendToAll(char* packets, int totalSize);
+    void sendToAll(unsigned int update_type, PacketWriter& writer);
 
 private:
     // data buffer
     char network_data[MAX_PACKET_SIZE];
+    // bytes of each client's last update that hadn't fully arrived yet
+    std::map<unsigned int, std::vector<char>> pendingData;
+    // clients whose socket was closed after a failed send, removed from sessions at the next receive
+    std::set<unsigned int> brokenSessions;
+    // bytes each client's socket hasn't taken yet. Nonblocking sends can stop partway through an
+    // update, the rest has to go out before anything newer or the client reads garbage
+    std::map<unsigned int, std::vector<char>> outgoingData;
+
+    // send now if nothing is waiting ahead of it, otherwise queue it behind what is
+    void sendToSession(unsigned int client_id, char* packets, int totalSize);
+    // send as much of a client's queued bytes as the socket will take
+    void flushSession(unsigned int client_id);
+    // close a client's socket, it's forgotten about at the next receive
+    void breakSession(unsigned int client_id);
+    // drop everything kept for a client whose socket is already closed, except its sessions entry
+    void forgetSession(unsigned int client_id);
+
+    std::chrono::steady_clock::time_point lastTelemetryLog = std::chrono::steady_clock::now();
 };
\ No newline at end of file
@@ -49,6 +49,12 @@ namespace bge {
         }
         bool forwardRequested, backwardRequested, leftRequested, rightRequested, jumpRequested, throwEggRequested, shootRequested, abilityRequested, resetRequested, bombRequested;
         float yaw, pitch;
+        // sequence number of the client input these requests came from, echoed back so the client knows what to replay
+        unsigned int inputSequence = 0;
+        // server tick the client was looking at when it sent these requests, for lag compensated shooting
+        float viewTick = 0;
+        // server tick the client meant these requests for, 0 if it doesn't know the server's clock yet
+        unsigned int targetTick = 0;
         glm::vec3 forwardDirection;
         glm::vec3 rightwardDirection;
     };
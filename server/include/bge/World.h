@@ -5,21 +5,22 @@
 #include "ComponentManager.h"
 #include "GameConstants.h"
 #include "NetworkData.h"
+#include "Physics.h"
 
 #include <time.h> 
 #include <set>
+#include <deque>
 #include <iostream>
 #include <unordered_map>
 #include <typeinfo>
 #include <typeindex>
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
 #include <glm/gtc/matrix_transform.hpp>
 
-#define ASSIMP_IMPORT_FLAGS aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_EmbedTextures | aiProcess_GenNormals | aiProcess_FixInfacingNormals | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType | aiProcess_ValidateDataStructure | aiProcess_FindInstances | aiProcess_OptimizeGraph | aiProcess_OptimizeMeshes
-
-#define MAP_BUCKET_WIDTH 40
+// Lag compensation: how many ticks of hitboxes we remember (~500ms) and how far back a shot is allowed to rewind
+#define HITBOX_HISTORY_TICKS 16
+#define MAX_REWIND_TICKS 6
+// Inputs held per player waiting for their target tick, the oldest is dropped past this
+#define MAX_QUEUED_INPUTS 8
 
 struct rayIntersection {
     float t;
@@ -30,10 +31,22 @@ struct rayIntersection {
 namespace bge {
 
     class System;
+    class MovementSystem;
+    class ProjectileStateSystem;
+    class BoxCollisionSystem;
+
+    // Where every shootable box (every player, then the egg) was at the end of one tick
+    struct HitboxFrame {
+        unsigned int tick;
+        std::vector<glm::vec3> mins;
+        std::vector<glm::vec3> maxs;
+    };
 
     class World {
         public:
-            void init();
+            // Everything is sized for numPlayers players here, players are entities 0 to numPlayers-1.
+            // The collision map is shared with the other matches
+            void init(unsigned int numPlayers, std::shared_ptr<const CollisionMap> collisionMap);
             void resetPlayer(unsigned int playerId);
             void resetEgg(unsigned int playerId);
 
@@ -79,34 +92,49 @@ namespace bge {
 
             void updateAllSystems();
 
-            // This can't be contained within a system since we want to do this as we receive client packets rather than once per tick
+            // Holds a client's input until the tick it was meant for, see applyQueuedInputs
+            void queuePlayerInput(unsigned int player, const ClientToServerPacket& packet);
             void updatePlayerInput(unsigned int player, float pitch, float yaw, bool forwardRequested, bool backwardRequested, bool leftRequested, 
             bool rightRequested, bool jumpRequested, bool throwEggRequested, bool shootRequested, bool abilityRequested, bool resetRequested, bool bombRequested,
-            bool godRequested, bool seasonSpeedup);
+            bool godRequested, bool seasonSpeedup, unsigned int inputSequence, float viewTick, unsigned int targetTick);
             void updatePlayerCharacterSelection(unsigned int player, int browsingCharacterUID, int characterUID);
+            // Someone left the lobby, get the player ready for whoever joins next
+            void freePlayerSlot(unsigned int player);
 
             void fillInGameData(ServerToClientPacket& packet);
             void fillInBulletData(BulletPacket& packet);
             void fillinGameEndData(GameEndPacket& packet);
-            void fillInCharacterSelectionData(LobbyServerToClientPacket& packet);
+            // Only the first numJoined slots have been handed out, the others don't go in the packet.
+            // Slots in freeSlots were left by their player and go out blank
+            void fillInCharacterSelectionData(LobbyServerToClientPacket& packet, unsigned int numJoined, const std::set<unsigned int>& freeSlots);
 
             void printDebug();
             Entity getEgg();
 
             bool withinMapBounds(glm::vec3 pos);
+            physics::PlayerMovementState getPlayerMovementState(Entity player);
 
             rayIntersection intersect(glm::vec3 p0, glm::vec3 p1, float maxT);
-            rayIntersection intersectRayBox(glm::vec3 origin, glm::vec3 direction, float maxT);
+            // ignoreId is an entity the ray can't hit, usually whoever fired it
+            rayIntersection intersectRayBox(glm::vec3 origin, glm::vec3 direction, float maxT, int ignoreId = -1);
+            // Same as intersectRayBox, but against the boxes as they were at the given (fractional) tick
+            rayIntersection intersectRayBoxAtTick(glm::vec3 origin, glm::vec3 direction, float maxT, float tick, int ignoreId = -1);
+            float lagCompensatedTick(float viewTick);
+            // Map triangles used for collision, shared with the client's movement prediction (see common/Physics.h)
+            // and with every other match in the process
+            std::shared_ptr<const CollisionMap> collisionMap;
             // nice to have: intersectRaySphere() to let dome shield block bullets
 
             std::vector<BulletTrail> bulletTrails;
 
             glm::vec3 voidLocation;
 
-            Entity players[NUM_PLAYER_ENTITIES];
+            std::vector<Entity> players;
             unsigned int godPlayer = INT_MIN;
 
             int currentSeason;
+            // Number of ticks the world has been simulated for, stamped on every snapshot
+            unsigned int serverTick = 0;
             bool gameOver;
             Teams winner;
             int seasonCounter;
@@ -117,38 +145,47 @@ namespace bge {
             void startWorldTimer();
 
             // mapping between a player and their character selection
-            int charactersUID[NUM_PLAYER_ENTITIES];
+            std::vector<int> charactersUID;
             // mapping between a player and their current browsing character - server you should not care about this - only client should care
-            int browsingCharactersUID[NUM_PLAYER_ENTITIES];
-            // team setup - for now just put player 0 and 1 on same team, 2 and 3 on same team
+            std::vector<int> browsingCharactersUID;
+            // team setup - pairs of players are on the same team (see teamOf in GameConstants.h)
             std::unordered_map<int,int> teammates;
 
         private:
-            void initMesh();
-            std::vector<unsigned int> determineBucket(float x, float z);
-            std::vector<glm::vec3> mapVertices;
-            // Outer vector holds each bucket (MAP_BUCKET_WDITH * MAP_BUCKET_WIDTH of them)
-            // Within each bucket, the uint32_ts refer to indices into the vertex array
-            // (3 in a row give you a triangle)
-            std::vector<uint32_t> mapTriangles;
-            std::vector<std::unordered_set<unsigned int>>buckets = std::vector<std::unordered_set<unsigned int>>(MAP_BUCKET_WIDTH * MAP_BUCKET_WIDTH, std::unordered_set<unsigned int>());
-            float minMapXValue;
-            float maxMapXValue;
-            float minMapZValue;
-            float maxMapZValue;
-            float minMapYValue;
-            float maxMapYValue;
+            glm::vec3 playerInitPosition(unsigned int playerId);
+            Entity createProjectile(BallProjType projType);
 
             std::vector<std::shared_ptr<System>> systems;
             std::set<Entity> entities;
             int currMaxEntityId;
 
             Entity egg;
-            Entity ballProjectiles[NUM_PROJ_TYPES][NUM_EACH_PROJECTILE];
+            // Every projectile made so far for each season, active or not
+            std::vector<Entity> ballProjectiles[NUM_PROJ_TYPES];
+            // Systems new projectiles have to be registered with
+            std::shared_ptr<MovementSystem> movementSystem;
+            std::shared_ptr<ProjectileStateSystem> projectileStateSystem;
+            std::shared_ptr<BoxCollisionSystem> boxCollisionSystem;
 
             void processGameOver();
-            // Contains the indices between 0 and NUM_MOVEMENT_ENTITIES which correspond to projectiles
+
+            // Hands each player the oldest of their queued inputs that is due this tick. With none due
+            // they keep doing what their last input said, and the acked sequence stays where it was
+            void applyQueuedInputs();
+            std::vector<std::deque<ClientToServerPacket>> queuedInputs;
+            // targetTick of each player's newest input minus the tick that was up next when it arrived
+            std::vector<int> inputLeadTicks;
+
+            void recordHitboxes();
+            // Every player, then the egg. Same order as the boxes in a HitboxFrame
+            size_t numHitboxTargets();
+            Entity hitboxTarget(size_t i);
+            // Ring buffer indexed by tick % HITBOX_HISTORY_TICKS
+            HitboxFrame hitboxHistory[HITBOX_HISTORY_TICKS];
+            // Movement entity index of each projectile, in the order they were made
             std::vector<unsigned int> projIndices;
+            // Season of each projectile, same order as projIndices
+            std::vector<BallProjType> projTypes;
 
             std::vector<glm::vec3> playerInitPositions = { glm::vec3(11,5,17),         // hilltop
                                                         glm::vec3(15.24, 5.4, 10),  // hilltop
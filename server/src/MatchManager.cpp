@@ -0,0 +1,220 @@
+#include "MatchManager.h"
+
+#include <algorithm>
+#include <csignal>
+
+MatchManager::MatchManager()
+{
+    // Load the read-only assets once, every match points at these
+    std::cout << "Loading the collision map...\n";
+    collisionMap = CollisionMap::load((std::string)(PROJECT_PATH) + SetupParser::getValue("collision-map-baked"),
+                                      (std::string)(PROJECT_PATH) + SetupParser::getValue("collision-map"));
+
+    openListenSocket();
+
+    int numWorkers = MATCH_WORKER_THREADS;
+    if (numWorkers <= 0) {
+        numWorkers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::printf("running matches on %d worker threads\n", numWorkers);
+    for (int i = 0; i < numWorkers; i++) {
+        workers.push_back(std::make_unique<MatchWorker>());
+        MatchWorker& worker = *workers.back();
+        worker.id = i;
+        worker.thread = std::thread(&MatchManager::workerLoop, this, std::ref(worker));
+    }
+}
+
+void MatchManager::openListenSocket()
+{
+    #if defined(_WIN32)
+    // create WSADATA object
+    WSADATA wsaData;
+
+    // Initialize Winsock
+    int iResult = WSAStartup(MAKEWORD(2, 2), &wsaData);
+    if (iResult != 0) {
+        std::printf("WSAStartup failed with error: %d\n", iResult);
+        exit(EXIT_FAILURE);
+    }
+    #else
+    int iResult;
+    // a client vanishing mid-send should fail that send, not kill every match in the process
+    signal(SIGPIPE, SIG_IGN);
+    #endif
+
+    // address info for the server to listen to
+    struct addrinfo* result = NULL;
+    struct addrinfo hints;
+
+    // set address information
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;    // TCP connection!!!
+    hints.ai_flags = AI_PASSIVE;
+
+    // Resolve the server address and port
+    iResult = getaddrinfo(NULL, SetupParser::getValue("server-port").c_str(), &hints, &result);
+
+    if (iResult != 0) {
+        std::printf("getaddrinfo failed with error: %d\n", iResult);
+        WSACLEANUP();
+        exit(EXIT_FAILURE);
+    }
+
+    // Create a SOCKET for connecting to server
+    listenSocket = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+
+    if (ISINVALIDSOCKET(listenSocket)) {
+        std::printf("socket failed with error: %d\n", GETSOCKETERRNO());
+        freeaddrinfo(result);
+        WSACLEANUP();
+        exit(EXIT_FAILURE);
+    }
+
+    // Setup the TCP listening socket
+    iResult = bind(listenSocket, result->ai_addr, (int)result->ai_addrlen);
+
+    if (iResult == SOCKET_ERROR) {
+        std::printf("bind failed with error: %d\n", GETSOCKETERRNO());
+        freeaddrinfo(result);
+        CLOSESOCKET(listenSocket);
+        WSACLEANUP();
+        exit(EXIT_FAILURE);
+    }
+
+    // no longer need address information
+    freeaddrinfo(result);
+
+    // start listening for new clients attempting to connect
+    // (this socket stays blocking, run() has nothing else to do while it waits)
+    iResult = listen(listenSocket, SOMAXCONN);
+
+    if (iResult == SOCKET_ERROR) {
+        std::printf("listen failed with error: %d\n", GETSOCKETERRNO());
+        CLOSESOCKET(listenSocket);
+        WSACLEANUP();
+        exit(EXIT_FAILURE);
+    }
+}
+
+void MatchManager::run()
+{
+    while (true) {
+        // get the client address
+        struct sockaddr_in client_addr;
+        socklen_t slen = sizeof(client_addr);
+
+        SOCKET clientSocket = accept(listenSocket, (struct sockaddr*)&client_addr, &slen);
+        if (ISINVALIDSOCKET(clientSocket)) {
+            std::printf("accept failed with error: %d\n", GETSOCKETERRNO());
+            continue;
+        }
+
+        char str[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &client_addr.sin_addr, str, INET_ADDRSTRLEN);
+        std::cout << "Listen from " << str << std::endl;
+
+        // matches read their sockets once per tick and must never block on them
+        NetworkServices::setNonBlocking(clientSocket);
+
+        //disable nagle on the client's socket
+        int value = 1;
+        setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, (char*)&value, sizeof(value));
+
+        assignToMatch(clientSocket);
+    }
+}
+
+/**
+ * Put a new connection in the open match, or in a new match if the open one is full, started or gone
+ */
+void MatchManager::assignToMatch(SOCKET clientSocket)
+{
+    if (openMatch == nullptr || !openMatch->addClient(clientSocket)) {
+        openMatch = createMatch();
+        bool added = openMatch->addClient(clientSocket);
+        assert(added);
+    }
+}
+
+/**
+ * Make a match and pin it to the worker with the fewest matches
+ */
+std::shared_ptr<ServerGame> MatchManager::createMatch()
+{
+    std::shared_ptr<ServerGame> match = std::make_shared<ServerGame>(nextMatchId++, collisionMap);
+
+    MatchWorker* leastBusy = nullptr;
+    size_t fewestMatches = SIZE_MAX;
+    for (std::unique_ptr<MatchWorker>& worker : workers) {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        if (worker->matches.size() < fewestMatches) {
+            fewestMatches = worker->matches.size();
+            leastBusy = worker.get();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(leastBusy->mutex);
+        leastBusy->matches.push_back(match);
+    }
+    std::printf("match %u created on worker %u (%zu other matches there)\n", match->matchId, leastBusy->id, fewestMatches);
+    return match;
+}
+
+/**
+ * Tick every match on this worker on the same fixed schedule the single-match server used
+ */
+void MatchManager::workerLoop(MatchWorker& worker)
+{
+    // declare a 33ms duration
+    std::chrono::milliseconds tickLen{SERVER_TICK_MS};
+    // Ticks start on a fixed schedule rather than "33ms after the last one finished", so clients
+    // that synced their clock to ours can predict exactly when each tick will read their input
+    auto nextTick = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<ServerGame>> matches;
+    while (true)
+    {
+        // don't hold the lock while ticking, the manager needs it to add matches
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            matches = worker.matches;
+        }
+
+        // Do updates
+        for (std::shared_ptr<ServerGame>& match : matches) {
+            match->update();
+        }
+
+        // Everyone left, the match is over
+        for (std::shared_ptr<ServerGame>& match : matches) {
+            if (match->closeIfFinished()) {
+                std::printf("match %u finished on worker %u\n", match->matchId, worker.id);
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                worker.matches.erase(std::find(worker.matches.begin(), worker.matches.end(), match));
+            }
+        }
+        matches.clear();
+
+        // Sleep until the next tick is due
+        nextTick += tickLen;
+        auto now = std::chrono::steady_clock::now();
+        if (nextTick > now) {
+            std::this_thread::sleep_until(nextTick);
+        } else if (now - nextTick > 4 * tickLen) {
+            // not good, we're way behind so don't try to catch up with a burst of ticks
+            nextTick = now;
+        }
+    }
+}
+
+MatchManager::~MatchManager()
+{
+    // workers never stop on their own, the process just exits
+    for (std::unique_ptr<MatchWorker>& worker : workers) {
+        worker->thread.detach();
+    }
+    CLOSESOCKET(listenSocket);
+    WSACLEANUP();
+}
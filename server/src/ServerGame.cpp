@@ -1,37 +1,72 @@
 #include "ServerGame.h"
 
-unsigned int ServerGame::client_id;
-
-ServerGame::ServerGame(void)
+ServerGame::ServerGame(unsigned int matchId, std::shared_ptr<const CollisionMap> collisionMap) : matchId(matchId)
 {
     // id's to assign clients for our table
     client_id = 0;
 
-    // set up the server network to listen
+    startTime = std::chrono::steady_clock::now();
+
+    // set up the server network for this match's clients
     network = std::make_unique<ServerNetwork>(this);
 
     // Initialize game world
-    std::cout << "Initializing server game world...\n";
-    world.init();
+    std::printf("Initializing game world for match %u...\n", matchId);
+    world.init(MAX_PLAYERS, collisionMap);
+}
+
+bool ServerGame::addClient(SOCKET socket)
+{
+    std::lock_guard<std::mutex> lock(incomingMutex);
+    if (finished || timeStarted || numAddedClients >= world.players.size()) {
+        return false;
+    }
+    incomingClients.push_back(socket);
+    numAddedClients++;
+    hadClients = true;
+    return true;
+}
+
+bool ServerGame::closeIfFinished()
+{
+    std::lock_guard<std::mutex> lock(incomingMutex);
+    if (hadClients && incomingClients.empty() && network->sessions.empty()) {
+        finished = true;
+    }
+    return finished;
 }
 
 void ServerGame::update()
 {
+    tickStartMs = serverTimeMs();
+
     // get new clients
-    if (network->acceptNewClient(client_id))
     {
-        std::printf("client %d has been connected to the server\n", client_id);
-
-        client_id++;
+        std::lock_guard<std::mutex> lock(incomingMutex);
+        for (SOCKET socket : incomingClients) {
+            // fill in slots people left in the lobby before handing out new ones
+            unsigned int id;
+            if (!freeClientIds.empty()) {
+                id = *freeClientIds.begin();
+                freeClientIds.erase(freeClientIds.begin());
+            } else {
+                id = client_id++;
+            }
+            network->addSession(id, socket);
+            std::printf("client %d has been connected to match %u\n", id, matchId);
+        }
+        incomingClients.clear();
     }
+    network->flushSends();
     network->receiveFromClients();
+    network->logTelemetry();
 
     // TODO: send to client all players' characters selection
     LobbyServerToClientPacket characterSelectionPacket;
-    world.fillInCharacterSelectionData(characterSelectionPacket);
+    world.fillInCharacterSelectionData(characterSelectionPacket, client_id, freeClientIds);
     network->sendCharacterSelectionUpdate(characterSelectionPacket);
 
-    if (readyPlayers.size() < MIN_PLAYERS) {
+    if ((int)readyPlayers.size() < MIN_PLAYERS) {
         return;
     }
 
@@ -46,11 +81,12 @@ void ServerGame::update()
     // send info to clients (this is called once per tick)
     ServerToClientPacket packet;
     world.fillInGameData(packet);
+    packet.serverTimeMs = tickStartMs;
     network->sendPositionsUpdates(packet);
 
     BulletPacket bulletPacket;
     world.fillInBulletData(bulletPacket);
-    if (bulletPacket.count > 0) {
+    if (!bulletPacket.bulletTrails.empty()) {
         network->sendBulletsUpdate(bulletPacket);
     }
 
@@ -68,17 +104,19 @@ void ServerGame::handleInitConnection(unsigned int client_id) {
     // This is a new client, so tell it what its id is
     IssueIdentifierUpdate update;
     update.client_id = client_id;
+    update.maxPlayers = world.players.size();
     network->sendIssueIdentifierUpdate(update);
+    if (client_id >= world.players.size()) {
+        std::printf("client %d joined but the match only has room for %zu players, ignoring its input\n", client_id, world.players.size());
+    }
 }
 
 
 void ServerGame::handleClientActionInput(unsigned int client_id, ClientToServerPacket& packet)
 {
     // pass information about view direction and movement requests from the client's packet to the world
-    // the systems will use whatever the most recent info was before each game tick
-    world.updatePlayerInput(client_id, packet.pitch, packet.yaw, packet.requestForward, packet.requestBackward, 
-    packet.requestLeftward, packet.requestRightward, packet.requestJump, packet.requestThrowEgg, 
-    packet.requestShoot, packet.requestAbility, packet.requestReset, packet.requestBomb, packet.godRequest, packet.seasonSpeedup);
+    // the world applies one queued input per tick, on the tick the client meant it for
+    world.queuePlayerInput(client_id, packet);
 }
 
 void ServerGame::handleClientLobbyInput(unsigned int client_id, LobbyClientToServerPacket& packet) {
@@ -89,6 +127,33 @@ void ServerGame::handleClientLobbyInput(unsigned int client_id, LobbyClientToSer
     }
 }
 
+void ServerGame::handleDisconnect(unsigned int client_id) {
+    if (timeStarted) {
+        // their player stays in the match, nobody else can join it anyway
+        return;
+    }
+    // Still in the lobby, so someone else can have their slot
+    std::lock_guard<std::mutex> lock(incomingMutex);
+    numAddedClients--;
+    freeClientIds.insert(client_id);
+    readyPlayers.erase(client_id);
+    world.freePlayerSlot(client_id);
+}
+
+void ServerGame::handleClockSyncRequest(unsigned int client_id, ClockSyncRequest& request, double receivedMs) {
+    // We only read the socket once per tick, so receivedMs can be up to a tick after the request
+    // really arrived. The client keeps the fastest round trips, which are the ones that weren't held up
+    ClockSyncReply reply;
+    reply.clientSendMs = request.clientSendMs;
+    reply.serverReceiveMs = receivedMs;
+    // serverSendMs is stamped by the network right before the reply goes out
+    network->sendClockSyncReply(client_id, reply);
+}
+
+double ServerGame::serverTimeMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
 ServerGame::~ServerGame(void) {
 
 }
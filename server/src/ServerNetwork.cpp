@@ -1,30 +1,70 @@
 #include "ServerNetwork.h"
 
+// Size of the body of each update a client is allowed to send, -1 if clients never send it
+static int clientUpdateLength(unsigned int update_type) {
+    switch (update_type) {
+    case INIT_CONNECTION:       return 0;
+    case LOBBY_TO_SERVER:       return sizeof(LobbyClientToServerPacket);
+    case CLIENT_TO_SERVER:      return sizeof(ClientToServerPacket);
+    case CLOCK_SYNC_REQUEST:    return sizeof(ClockSyncRequest);
+    default:                    return -1;
+    }
+}
+
 void ServerNetwork::receiveFromClients()
 {
+    // sends that failed since last time closed their sockets, forget about those clients now
+    for (unsigned int client_id : brokenSessions) {
+        std::printf("dropping client %d after a failed send\n", client_id);
+        forgetSession(client_id);
+        sessions.erase(client_id);
+    }
+    brokenSessions.clear();
+
     // go through all clients
     std::map<unsigned int, SOCKET>::iterator iter;
 
     for (iter = sessions.begin(); iter != sessions.end(); /* no increment*/) {
-        int data_length = receiveData(iter->first, network_data);
+        // anything left over from last time is the start of an update that hadn't fully arrived yet
+        std::vector<char>& pending = pendingData[iter->first];
+        unsigned int carried = pending.size();
+        std::memcpy(network_data, pending.data(), carried);
+        int received = receiveData(iter->first, network_data + carried, MAX_PACKET_SIZE - carried);
 
-        if (data_length == -1) {
+        if (received == -1) {
             // waiting for msg, nonblocking
             iter++;
             continue;
-        } else if (data_length == 0) {
+        } else if (received == 0) {
             // no data recieved, ending session
-            std::cout << "No data received (data_length=" << data_length << "), ending session.\n";
+            std::cout << "No data received (data_length=" << received << "), ending session.\n";
+            forgetSession(iter->first);
             sessions.erase(iter++);  // trick to remove while iterating
             continue;
         }
+        // when these bytes came off the socket, for the clock sync replies
+        double receivedMs = game->serverTimeMs();
+        unsigned int data_length = carried + received;
 
         unsigned int i = 0;
-        while (i < data_length) {
+        bool malformed = false;
+        while (data_length - i >= sizeof(UpdateHeader)) {
             UpdateHeader update_header;
             deserialize(&update_header, &(network_data[i]));
             unsigned int data_loc = i + sizeof(UpdateHeader);
-            unsigned int update_length = update_type_data_lengths.at(update_header.update_type);
+            unsigned int update_length = update_header.data_length;
+            // Checked before waiting for the body, so a bogus length can't make us buffer forever
+            int expected_length = clientUpdateLength(update_header.update_type);
+            if (expected_length < 0 || update_length != (unsigned int)expected_length) {
+                std::printf("client %d sent an update of type %u with %u bytes, ending session\n", iter->first, update_header.update_type, update_length);
+                malformed = true;
+                break;
+            }
+            if (data_length - data_loc < update_length) {
+                // the rest of this update is still on its way
+                break;
+            }
+            telemetry[iter->first].recordReceived(update_header.update_type, sizeof(UpdateHeader) + update_length);
 
             switch (update_header.update_type) {
 
@@ -47,16 +87,29 @@ void ServerNetwork::receiveFromClients()
                 game->handleClientActionInput(iter->first, client_packet);
                 break;
 
-            default:
-                std::cout << "Error in packet types" << std::endl;
-                // This should never happen, so assert false so we find out if it does
-                assert(false);
+            case CLOCK_SYNC_REQUEST:
+                ClockSyncRequest clock_sync_request;
+                deserialize(&clock_sync_request, &(network_data[data_loc]));
+                telemetry[iter->first].setRoundTrip(clock_sync_request.roundTripMs, clock_sync_request.roundTripJitterMs);
+                game->handleClockSyncRequest(iter->first, clock_sync_request, receivedMs);
+                break;
 
+            default:
+                // clientUpdateLength already turned away anything we don't handle here
                 break;
             }
             // Move on to the next update
             i += sizeof(UpdateHeader) + update_length;
         }
+        if (malformed) {
+            // no telling where the next update starts, so the rest of this stream is useless
+            CLOSESOCKET(iter->second);
+            forgetSession(iter->first);
+            sessions.erase(iter++);
+            continue;
+        }
+        pending.assign(network_data + i, network_data + data_length);
+        telemetry[iter->first].update(iter->second);
         iter++;
     }
 }
@@ -69,6 +122,7 @@ void ServerNetwork::sendIssueIdentifierUpdate(IssueIdentifierUpdate& issue_ident
 
     UpdateHeader header;
     header.update_type = ISSUE_IDENTIFIER;
+    header.data_length = sizeof(IssueIdentifierUpdate);
 
     serialize(&header, packet_data);
     serialize(&issue_identifier_update, packet_data + sizeof(UpdateHeader));
@@ -77,36 +131,15 @@ void ServerNetwork::sendIssueIdentifierUpdate(IssueIdentifierUpdate& issue_ident
 }
 
 void ServerNetwork::sendPositionsUpdates(ServerToClientPacket& packet) {
-    /* ServerToClientPacket packet;
-    // idea-todo? just use this^ struct in both ClientGame and ServerGame, and we can just copy the whole thing // i feel the need
-    memcpy(&packet.positions, &game->positions, sizeof(game->positions));
-    memcpy(&packet.velocities, &game->velocities, sizeof(game->velocities));
-    memcpy(&packet.yaws, &game->yaws, sizeof(game->yaws));
-    memcpy(&packet.pitches, &game->pitches, sizeof(game->pitches));*/
-
-    const unsigned int packet_size = sizeof(UpdateHeader) + sizeof(ServerToClientPacket);
-    char packet_data[packet_size];
-
-    UpdateHeader header;
-    header.update_type = SERVER_TO_CLIENT;
-
-    serialize(&header, packet_data);
-    serialize(&packet, packet_data + sizeof(UpdateHeader));
-
-    sendToAll(packet_data, packet_size);
+    PacketWriter writer;
+    packet.write(writer);
+    sendToAll(SERVER_TO_CLIENT, writer);
 }
 
 void ServerNetwork::sendBulletsUpdate(BulletPacket& packet) {
-    const unsigned int packet_size = sizeof(UpdateHeader) + sizeof(BulletPacket);
-    char packet_data[packet_size];
-
-    UpdateHeader header;
-    header.update_type = BULLETS;
-
-    serialize(&header, packet_data);
-    serialize(&packet, packet_data + sizeof(UpdateHeader));
-
-    sendToAll(packet_data, packet_size);
+    PacketWriter writer;
+    packet.write(writer);
+    sendToAll(BULLETS, writer);
 }
 
 void ServerNetwork::sendGameEndData(GameEndPacket& packet) {
@@ -115,6 +148,7 @@ void ServerNetwork::sendGameEndData(GameEndPacket& packet) {
 
     UpdateHeader header;
     header.update_type = GAME_END_DATA;
+    header.data_length = sizeof(GameEndPacket);
 
     serialize(&header, packet_data);
     serialize(&packet, packet_data + sizeof(UpdateHeader));
@@ -123,156 +157,52 @@ void ServerNetwork::sendGameEndData(GameEndPacket& packet) {
 }
 
 void ServerNetwork::sendCharacterSelectionUpdate(LobbyServerToClientPacket& packet) {
-    // TODO:
-    const unsigned int packet_size = sizeof(UpdateHeader) + sizeof(LobbyServerToClientPacket);
+    PacketWriter writer;
+    packet.write(writer);
+    sendToAll(LOBBY_TO_CLIENT, writer);
+}
+
+void ServerNetwork::sendClockSyncReply(unsigned int client_id, ClockSyncReply& reply) {
+    const unsigned int packet_size = sizeof(UpdateHeader) + sizeof(ClockSyncReply);
     char packet_data[packet_size];
 
     UpdateHeader header;
-    header.update_type = LOBBY_TO_CLIENT;
+    header.update_type = CLOCK_SYNC_REPLY;
+    header.data_length = sizeof(ClockSyncReply);
 
+    reply.serverSendMs = game->serverTimeMs();
     serialize(&header, packet_data);
-    serialize(&packet, packet_data + sizeof(UpdateHeader));
+    serialize(&reply, packet_data + sizeof(UpdateHeader));
 
-    sendToAll(packet_data, packet_size);
+    sendToClient(client_id, packet_data, packet_size);
 }
 
 ServerNetwork::ServerNetwork(ServerGame* _game)
 {
     game=_game;
-
-    #if defined(_WIN32)
-    // create WSADATA object
-    WSADATA wsaData;
-
-    // Initialize Winsock
-    iResult = WSAStartup(MAKEWORD(2, 2), &wsaData);
-    if (iResult != 0) {
-        std::printf("WSAStartup failed with error: %d\n", iResult);
-        exit(EXIT_FAILURE);
-    }
-    #endif
-
-    // our sockets for the server
-    ListenSocket = INVALID_SOCKET;
-    ClientSocket = INVALID_SOCKET;
-
-    // address info for the server to listen to
-    struct addrinfo* result = NULL;
-    struct addrinfo hints;
-
-    // set address information
-    std::memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_protocol = IPPROTO_TCP;    // TCP connection!!!
-    hints.ai_flags = AI_PASSIVE;
-
-    // Resolve the server address and port
-    iResult = getaddrinfo(NULL, SetupParser::getValue("server-port").c_str(), &hints, &result);
-
-    if (iResult != 0) {
-        std::printf("getaddrinfo failed with error: %d\n", iResult);
-        WSACLEANUP();
-        exit(EXIT_FAILURE);
-    }
-
-    // Create a SOCKET for connecting to server
-    ListenSocket = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
-
-    if (ISINVALIDSOCKET(ListenSocket)) {
-        std::printf("socket failed with error: %d\n", GETSOCKETERRNO());
-        freeaddrinfo(result);
-        WSACLEANUP();
-        exit(EXIT_FAILURE);
-    }
-
-    // Set the mode of the socket to be nonblocking
-    u_long iMode = 1;
-
-	#if defined(_WIN32)
-    iResult = ioctlsocket(ListenSocket, FIONBIO, &iMode);
-    #else
-    iResult = fcntl(ListenSocket, O_NONBLOCK, O_NONBLOCK);
-    #endif
-
-    if (iResult == SOCKET_ERROR) {
-        std::printf("ioctlsocket failed with error: %d\n", GETSOCKETERRNO());
-        CLOSESOCKET(ListenSocket);
-        WSACLEANUP();
-        exit(EXIT_FAILURE);
-    }
-
-    // Setup the TCP listening socket
-    iResult = bind(ListenSocket, result->ai_addr, (int)result->ai_addrlen);
-
-    if (iResult == SOCKET_ERROR) {
-        std::printf("bind failed with error: %d\n", GETSOCKETERRNO());
-        freeaddrinfo(result);
-        CLOSESOCKET(ListenSocket);
-        WSACLEANUP();
-        exit(EXIT_FAILURE);
-    }
-
-    // no longer need address information
-    freeaddrinfo(result);
-
-    // start listening for new clients attempting to connect
-    iResult = listen(ListenSocket, SOMAXCONN);
-
-    if (iResult == SOCKET_ERROR) {
-        std::printf("listen failed with error: %d\n", GETSOCKETERRNO());
-        CLOSESOCKET(ListenSocket);
-        WSACLEANUP();
-        exit(EXIT_FAILURE);
-    }
 }
 
-// accept new connections
-bool ServerNetwork::acceptNewClient(unsigned int& id)
+// add a connection the match manager accepted and handed to this match
+void ServerNetwork::addSession(unsigned int id, SOCKET socket)
 {
-    // get the client address
-    struct sockaddr_in client_addr;
-    socklen_t slen = sizeof(client_addr);
-
-    // if client waiting, accept the connection and save the socket
-    ClientSocket = accept(ListenSocket, (struct sockaddr*)&client_addr, &slen);
+    // [Reconnection] - what if this socket was recently used by a client in the sessions table, but that client got disconnected for a little while
+    // then reassign that client this socket. 
+    // below: instead of passed in `id`, use the lost client_id (gotta find in sessions / tweak sessions structure)
 
-    if (!ISINVALIDSOCKET(ClientSocket))
-    {
-        // we will get the client IP here - will be used to identify client
-        struct in_addr ipAddr = client_addr.sin_addr;
-        char str[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &ipAddr, str, INET_ADDRSTRLEN);
-        std::string client_ip(str);
-        std::cout << "Listen from " << client_ip << std::endl;
-
-        //disable nagle on the client's socket
-        char value = 1;
-        setsockopt(ClientSocket, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
-
-
-        // [Reconnection] - what if this ClientSocket was recently used by a client in the sessions table, but that client got disconnected for a little while
-        // then reassign that client this ClientSocket. 
-        // below: instead of passed in `id`, use the lost client_id (gotta find in sessions / tweak sessions structure)
-
-        // Instead, we could mark sessions[id] as INVALID_SESSION. And then later, when someone reconnects, just assign him the INVALID_SESSION slot. 
-        // Instead of map, an array is the best for speed (spatial locality). 
-
-        // insert new client into session id table
-        sessions[id] = ClientSocket;
-        return true;
-    }
+    // Instead, we could mark sessions[id] as INVALID_SESSION. And then later, when someone reconnects, just assign him the INVALID_SESSION slot. 
+    // Instead of map, an array is the best for speed (spatial locality). 
 
-    return false;
+    // insert new client into session id table
+    sessions[id] = socket;
 }
 
 // receive incoming data
-int ServerNetwork::receiveData(unsigned int client_id, char* recvbuf)
+int ServerNetwork::receiveData(unsigned int client_id, char* recvbuf, int bufSize)
 {
     if (sessions.count(client_id))
     {
         SOCKET currentSocket = sessions[client_id];
-        iResult = NetworkServices::receiveMessage(currentSocket, recvbuf, MAX_PACKET_SIZE);
+        iResult = NetworkServices::receiveMessage(currentSocket, recvbuf, bufSize);
         /* Possible iResult return values:
             -1: waiting for msg to arrive from the nonblocking socket...
             0 : no data received, so close connection.
@@ -291,18 +221,87 @@ int ServerNetwork::receiveData(unsigned int client_id, char* recvbuf)
     return 0;
 }
 
+void ServerNetwork::forgetSession(unsigned int client_id)
+{
+    game->handleDisconnect(client_id);
+    telemetry.erase(client_id);
+    pendingData.erase(client_id);
+    outgoingData.erase(client_id);
+}
+
+void ServerNetwork::breakSession(unsigned int client_id)
+{
+    CLOSESOCKET(sessions[client_id]);
+    // the socket number can be handed to a new connection in another match, so stop using it
+    brokenSessions.insert(client_id);
+    outgoingData.erase(client_id);
+}
+
+void ServerNetwork::flushSession(unsigned int client_id)
+{
+    std::vector<char>& outgoing = outgoingData[client_id];
+    if (outgoing.empty()) {
+        return;
+    }
+    int iSendResult = NetworkServices::sendMessage(sessions[client_id], outgoing.data(), outgoing.size());
+    if (iSendResult == SOCKET_ERROR) {
+        if (!NetworkServices::wouldBlock()) {
+            std::printf("flushSession failed with error: %d\n", GETSOCKETERRNO());
+            breakSession(client_id);
+        }
+        return;
+    }
+    outgoing.erase(outgoing.begin(), outgoing.begin() + iSendResult);
+}
+
+void ServerNetwork::flushSends()
+{
+    for (auto& [client_id, socket] : sessions) {
+        if (!brokenSessions.count(client_id)) {
+            flushSession(client_id);
+        }
+    }
+}
+
+void ServerNetwork::sendToSession(unsigned int client_id, char* packets, int totalSize)
+{
+    UpdateHeader header;
+    deserialize(&header, packets);
+    telemetry[client_id].recordSent(header.update_type, totalSize);
+
+    std::vector<char>& outgoing = outgoingData[client_id];
+    if (!outgoing.empty()) {
+        // still behind from an earlier send, this has to wait its turn
+        outgoing.insert(outgoing.end(), packets, packets + totalSize);
+        flushSession(client_id);
+    } else {
+        int iSendResult = NetworkServices::sendMessage(sessions[client_id], packets, totalSize);
+        telemetry[client_id].recordSendResult(totalSize, iSendResult);
+        if (iSendResult == SOCKET_ERROR) {
+            if (!NetworkServices::wouldBlock()) {
+                std::printf("sendToSession failed with error: %d\n", GETSOCKETERRNO());
+                breakSession(client_id);
+                return;
+            }
+            iSendResult = 0;
+        }
+        // keep whatever didn't fit in the socket's buffer for next tick
+        outgoing.insert(outgoing.end(), packets + iSendResult, packets + totalSize);
+    }
+
+    if (!brokenSessions.count(client_id) && outgoing.size() > MAX_QUEUED_SEND_BYTES) {
+        std::printf("client %d has %zu bytes it isn't reading, dropping it\n", client_id, outgoing.size());
+        breakSession(client_id);
+    }
+}
+
 // send data to a specific client
 void ServerNetwork::sendToClient(unsigned int client_id, char* packets, int totalSize)
 {
     if (sessions.count(client_id))
     {
-        SOCKET currentSocket = sessions[client_id];
-        int iSendResult = NetworkServices::sendMessage(currentSocket, packets, totalSize);
-
-        if (iSendResult == SOCKET_ERROR)
-        {
-            std::printf("sendToClient failed with error: %d\n", GETSOCKETERRNO());
-            CLOSESOCKET(currentSocket);
+        if (!brokenSessions.count(client_id)) {
+            sendToSession(client_id, packets, totalSize);
         }
     }
     else {
@@ -310,22 +309,43 @@ void ServerNetwork::sendToClient(unsigned int client_id, char* packets, int tota
     }
 }
 
+// send a variable-length update to all clients, the header goes in front of what the writer wrote
+void ServerNetwork::sendToAll(unsigned int update_type, PacketWriter& writer)
+{
+    UpdateHeader header;
+    header.update_type = update_type;
+    header.data_length = writer.data.size();
+
+    std::vector<char> packet_data(sizeof(UpdateHeader) + writer.data.size());
+    serialize(&header, packet_data.data());
+    std::memcpy(packet_data.data() + sizeof(UpdateHeader), writer.data.data(), writer.data.size());
+
+    sendToAll(packet_data.data(), packet_data.size());
+}
+
 // send data to all clients
 void ServerNetwork::sendToAll(char* packets, int totalSize)
 {
-    SOCKET currentSocket;
     std::map<unsigned int, SOCKET>::iterator iter;
-    int iSendResult;
     for (iter = sessions.begin(); iter != sessions.end(); iter++)
     {
-        currentSocket = iter->second;
-        iSendResult = NetworkServices::sendMessage(currentSocket, packets, totalSize);
-
-        if (iSendResult == SOCKET_ERROR)
-        {
-            std::printf("sendToAll failed with error: %d\n", GETSOCKETERRNO());
-            CLOSESOCKET(currentSocket);
+        if (brokenSessions.count(iter->first)) {
+            continue;
         }
+        sendToSession(iter->first, packets, totalSize);
+    }
+}
+
+void ServerNetwork::logTelemetry()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastTelemetryLog < std::chrono::duration<double, std::milli>(TELEMETRY_LOG_INTERVAL_MS)) {
+        return;
+    }
+    lastTelemetryLog = now;
+
+    for (auto& [client_id, counters] : telemetry) {
+        std::printf("[telemetry] match %u client %d\n%s", game->matchId, client_id, counters.report().c_str());
     }
 }
 
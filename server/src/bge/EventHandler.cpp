@@ -54,7 +54,7 @@ namespace bge {
 	}
 
 	void BulletVsPlayerHandler::handleInteraction(Entity shooter, Entity target) {
-		if (target.type != PLAYER) {
+		if (target.type != PLAYER || target.id == shooter.id) {
 			return;
 		}
 
@@ -248,62 +248,19 @@ namespace bge {
                 continue;
             }
 
-            glm::vec3 forwardDirection;
-            forwardDirection.x = cos(glm::radians(req.yaw));
-            forwardDirection.y = 0;
-            forwardDirection.z = sin(glm::radians(req.yaw));
-            forwardDirection = glm::normalize(forwardDirection);
-            req.forwardDirection = forwardDirection;
-
-            glm::vec3 rightwardDirection = glm::cross(forwardDirection, glm::vec3(0, 1, 0));
-            req.rightwardDirection = rightwardDirection;
-            glm::vec3 totalDirection = glm::vec3(0);
-            float air_modifier = (vel.onGround) ? 1 : AIR_MOVEMENT_MODIFIER;
-
-            if (statusEffects.swappedControlsTicksLeft > 0) {
-                forwardDirection = -forwardDirection;
-                rightwardDirection = -rightwardDirection;
-                statusEffects.swappedControlsTicksLeft--;
-            }
-
-            if (req.forwardRequested)      totalDirection += forwardDirection;
-            if (req.backwardRequested)     totalDirection -= forwardDirection;
-            if (req.leftRequested)     totalDirection -= rightwardDirection;
-            if (req.rightRequested)    totalDirection += rightwardDirection;
-
-            if (totalDirection != glm::vec3(0)) totalDirection = glm::normalize(totalDirection);
-
-            float currentSpeed = MOVEMENT_SPEED;
-            if (statusEffects.movementSpeedTicksLeft > 0) {
-                currentSpeed = statusEffects.alternateMovementSpeed;
-                statusEffects.movementSpeedTicksLeft--;
-            }
-
-            vel.velocity += totalDirection * currentSpeed * air_modifier;
-
-            if (vel.onGround) {
-                vel.velocity.x *= GROUND_FRICTION;
-                vel.velocity.z *= GROUND_FRICTION;
-            }
-            else {
-                vel.velocity.x *= AIR_FRICTION;
-                vel.velocity.z *= AIR_FRICTION;
-            }
-            // Update velocity with accelerations (gravity, player jumping, etc.)
-            vel.velocity.y -= jump.jumpHeld ? GRAVITY : GRAVITY * FASTFALL_INCREASE;
-
-            if (jump.jumpHeld && !req.jumpRequested) {
-                jump.jumpHeld = false;
-            }
-
-            if (!jump.jumpHeld && req.jumpRequested && jump.doubleJumpUsed < (world->currentSeason==SUMMER_SEASON?MAX_JUMPS_ALLOWED+1:MAX_JUMPS_ALLOWED)) {
-                jump.doubleJumpUsed++;
-                float jumpMult=(world->currentSeason==SUMMER_SEASON)?1.25:1; // higher jump height in summer
-                if (statusEffects.movementSpeedTicksLeft > 0) {
-                    vel.velocity.y = jumpMult*JUMP_SPEED/2; // decrease jump when slowed
-                } else vel.velocity.y = jumpMult*JUMP_SPEED;     // as god of physics, i endorse = and not += here
-                jump.jumpHeld = true;
-            }
+            req.forwardDirection = physics::forwardDirection(req.yaw);
+            req.rightwardDirection = glm::cross(req.forwardDirection, glm::vec3(0, 1, 0));
+
+            // The acceleration itself lives in common/ so the client can predict its own movement with the same code
+            physics::PlayerMovementState state = world->getPlayerMovementState(e);
+            physics::MovementInput input = { req.forwardRequested, req.backwardRequested, req.leftRequested, req.rightRequested, req.jumpRequested, req.yaw };
+            physics::accelerate(state, input, world->currentSeason);
+
+            vel.velocity = state.velocity;
+            jump.doubleJumpUsed = state.doubleJumpUsed;
+            jump.jumpHeld = state.jumpHeld;
+            statusEffects.movementSpeedTicksLeft = state.movementSpeedTicksLeft;
+            statusEffects.swappedControlsTicksLeft = state.swappedControlsTicksLeft;
         }
     }
 
@@ -333,51 +290,9 @@ namespace bge {
             MeshCollisionComponent& meshCol = meshCollisionCM->lookup(e);
 
             if (meshCol.active) {
-                vel.onGround = false;
-                glm::vec3 rightDir = glm::cross(vel.velocity, glm::vec3(0, 1, 0));
-                glm::vec3 upDir = glm::cross(rightDir, vel.velocity);
-                rayIntersection inter;
-                int count = 0;
-                do {
-                    int pointOfInter = -1;
-                    inter.t = INFINITY;
-                    for (int i = 0; i < meshCol.collisionPoints.size(); i++) {
-                        glm::vec3 p0 = pos.position + meshCol.collisionPoints[i];
-                        // the t value that is returned is between 0 and 1; it is looking
-                        // for a collision between p0+0*vel.velocity and p0+1*vel.velocity
-                        rayIntersection newInter = world->intersect(p0, vel.velocity, 1);
-                        if (newInter.t < inter.t) {
-                            pointOfInter = i;
-                            inter = newInter;
-                        }
-                    }
-                    if(inter.t<1) {
-                        bool stationaryOnGround=false;
-                        for(int i=0; i<meshCol.groundPoints.size(); i++) {
-                            if(meshCol.groundPoints[i]==pointOfInter) {
-                                vel.onGround=true;
-                                glm::vec3 velHorizontal=glm::vec3(vel.velocity.x, 0, vel.velocity.z);
-                                // if there is very low horizontal velocity, stop the player
-                                if(length(velHorizontal)<0.05) {
-                                    stationaryOnGround=true;
-                                }
-                            }
-                        }
-                        // remove the velocity in the direction of the triangle except a little bit less
-                        // so you aren't fully in the wall
-                        vel.velocity-=(1-inter.t)*inter.normal*glm::dot(inter.normal, vel.velocity)+0.005f*inter.normal;
-                        if(stationaryOnGround) {
-                            vel.velocity=glm::vec3(0);
-                        }
-                        count++;
-                        // we cap it at 100 collisions per second; this is pretty generous
-                        if(count==100) break; 
-                    }
-                } while (inter.t < 1);
+                physics::collideWithMap(*world->collisionMap, pos.position, vel.velocity, vel.onGround, meshCol.collisionPoints, meshCol.groundPoints);
             }
 
-            // std::cout<<count<<std::endl;
-
             pos.position += vel.velocity;
 
             if (vel.onGround) {
@@ -472,17 +387,21 @@ namespace bge {
             PositionComponent& playerPos = positionCM->lookup(e);
             CameraComponent& camera = cameraCM->lookup(e);
 
+            // Lag compensation: check against targets where the shooter saw them, not where they are now
+            float rewindTick = world->lagCompensatedTick(req.viewTick);
+
             // tps ideal hit point : from camera's view
             glm::vec3 viewPosition = playerPos.position + req.forwardDirection * PLAYER_Z_WIDTH + glm::vec3(0,1,0) * CAMERA_DISTANCE_ABOVE_PLAYER;  // above & in front of player, in line with user's camera
             rayIntersection mapInter = world->intersect(viewPosition, camera.direction, BULLET_MAX_T);
-            rayIntersection playerInter = world->intersectRayBox(viewPosition, camera.direction, BULLET_MAX_T);
+            // the shooter's own rewound hitbox can be somewhere they aren't anymore, never let them hit it
+            rayIntersection playerInter = world->intersectRayBoxAtTick(viewPosition, camera.direction, BULLET_MAX_T, rewindTick, e.id);
             glm::vec3 idealHitPoint = viewPosition + camera.direction * std::min({mapInter.t, playerInter.t, BULLET_MAX_T});
             
             // shoot another ray from player's gun towards the ideal hit point (matthew's idea)
             // whatever it hits is our real hitPoint. 
             glm::vec3 gunPosition = playerPos.position + req.forwardDirection * PLAYER_Z_WIDTH*1.4f + req.rightwardDirection * PLAYER_Z_WIDTH/2.5f;
             glm::vec3 shootDirection = glm::normalize(idealHitPoint - gunPosition);
-            playerInter = world->intersectRayBox(gunPosition, shootDirection, BULLET_MAX_T);
+            playerInter = world->intersectRayBoxAtTick(gunPosition, shootDirection, BULLET_MAX_T, rewindTick, e.id);
             mapInter = world->intersect(gunPosition, shootDirection, BULLET_MAX_T);
             glm::vec3 hitPoint = gunPosition + shootDirection * std::min({playerInter.t, mapInter.t, BULLET_MAX_T});
 
@@ -731,19 +650,8 @@ namespace bge {
             }
         } else if (world->currentSeason == WINTER_SEASON) {
             for (Entity e : registeredEntities) {
-                MovementRequestComponent& req = movementRequestCM->lookup(e);
                 VelocityComponent& vel = velocityCM->lookup(e);
-                if (vel.onGround) {
-                    vel.timeOnGround++;
-                    float speedMult = 1 + std::min(vel.timeOnGround, 90) * 0.004;
-                    vel.velocity.x *= speedMult;
-                    vel.velocity.z *= speedMult;
-                } else {
-                    vel.timeOnGround = 0;
-                    float speedMult = 0.8;
-                    vel.velocity.x *= speedMult;
-                    vel.velocity.z *= speedMult;
-                }
+                physics::applyWinterMomentum(vel.velocity, vel.onGround, vel.timeOnGround);
             }
         }
 
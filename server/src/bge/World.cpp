@@ -2,11 +2,11 @@
 
 namespace bge {
 
-    void World::init() {
+    void World::init(unsigned int numPlayers, std::shared_ptr<const CollisionMap> collisionMap) {
         // First entity will get index 0
         currMaxEntityId = 0;
 
-        initMesh();
+        this->collisionMap = collisionMap;
 
         // Put objects here to make them disappear
         voidLocation = glm::vec3(0.0f, -100.0f, 0.0f);
@@ -31,35 +31,33 @@ namespace bge {
         lerpingCM = std::make_shared<ComponentManager<LerpingComponent>>();
 
         std::shared_ptr<PlayerAccelerationSystem> playerAccSystem = std::make_shared<PlayerAccelerationSystem>(this, positionCM, velocityCM, movementRequestCM, jumpInfoCM, statusEffectsCM);
-        std::shared_ptr<MovementSystem> movementSystem = std::make_shared<MovementSystem>(this, positionCM, meshCollisionCM, velocityCM);
-        std::shared_ptr<BoxCollisionSystem> boxCollisionSystem = std::make_shared<BoxCollisionSystem>(this, positionCM, eggInfoCM, boxDimensionCM);
+        movementSystem = std::make_shared<MovementSystem>(this, positionCM, meshCollisionCM, velocityCM);
+        boxCollisionSystem = std::make_shared<BoxCollisionSystem>(this, positionCM, eggInfoCM, boxDimensionCM);
         std::shared_ptr<EggMovementSystem> eggMovementSystem = std::make_shared<EggMovementSystem>(this, positionCM, eggInfoCM, movementRequestCM, playerDataCM);
 
         std::shared_ptr<CameraSystem> cameraSystem = std::make_shared<CameraSystem>(this, positionCM, movementRequestCM, cameraCM);
         std::shared_ptr<BulletSystem> bulletSystem = std::make_shared<BulletSystem>(this, positionCM, movementRequestCM, cameraCM, playerDataCM, healthCM, statusEffectsCM);
         std::shared_ptr<SeasonAbilitySystem> seasonAbilitySystem = std::make_shared<SeasonAbilitySystem>(this, movementRequestCM, playerDataCM, seasonAbilityStatusCM, ballProjDataCM, positionCM, velocityCM, cameraCM);
-        std::shared_ptr<ProjectileStateSystem> projectileStateSystem = std::make_shared<ProjectileStateSystem>(this, playerDataCM, statusEffectsCM, ballProjDataCM, positionCM, velocityCM, meshCollisionCM, healthCM);
+        projectileStateSystem = std::make_shared<ProjectileStateSystem>(this, playerDataCM, statusEffectsCM, ballProjDataCM, positionCM, velocityCM, meshCollisionCM, healthCM);
         std::shared_ptr<SeasonEffectSystem> seasonEffectSystem = std::make_shared<SeasonEffectSystem>(this, healthCM, velocityCM, movementRequestCM, jumpInfoCM, seasonAbilityStatusCM);
         std::shared_ptr<LerpingSystem> lerpingSystem = std::make_shared<LerpingSystem>(this);
         std::shared_ptr<DanceBombSystem> dancebombSystem = std::make_shared<DanceBombSystem>(this);        
         std::shared_ptr<GodMovementSystem> godMovementSystem = std::make_shared<GodMovementSystem>(this);
 
         // init players
-        for (int i = 0; i < NUM_PLAYER_ENTITIES; i++) {
+        players.clear();
+        for (unsigned int i = 0; i < numPlayers; i++) {
             Entity newPlayer = createEntity(PLAYER);
-            players[i] = newPlayer;
+            players.push_back(newPlayer);
 
             // Create components
             // PositionComponent pos = PositionComponent(i*10.0f, 10.0f, -(i%2)*8.0f);
-            PositionComponent pos = PositionComponent(playerInitPositions[i]);
+            PositionComponent pos = PositionComponent(playerInitPosition(i));
             addComponent(newPlayer, pos);
             VelocityComponent vel = VelocityComponent(0.0f, 0.0f, 0.0f);
             addComponent(newPlayer, vel);
-            std::vector<glm::vec3> collisionPoints = {glm::vec3(0, -PLAYER_Y_HEIGHT/2, 0),glm::vec3(0, PLAYER_Y_HEIGHT/2, 0),
-                                                      glm::vec3(-PLAYER_X_WIDTH/2, 0, 0),glm::vec3(PLAYER_X_WIDTH/2, 0, 0),
-                                                      glm::vec3(0, 0, -PLAYER_Z_WIDTH/2),glm::vec3(0, 0, PLAYER_Z_WIDTH/2)};
-            std::vector<int> groundPoints = {0};
-            MeshCollisionComponent meshCol = MeshCollisionComponent(collisionPoints, groundPoints, true);
+            // same points the client predicts its own movement with
+            MeshCollisionComponent meshCol = MeshCollisionComponent(physics::playerCollisionPoints(), physics::playerGroundPoints(), true);
             addComponent(newPlayer, meshCol);
             MovementRequestComponent req = MovementRequestComponent(false, false, false, false, false, false, false, false, false, 0, -90, false);
             addComponent(newPlayer, req);
@@ -115,7 +113,7 @@ namespace bge {
         lerpingSystem->registerEntity(egg);
 
         /* 
-            From positionCM's pov, players are at indices 0~3, egg is at 4 in its componentDataStorage vector.
+            From positionCM's pov, players are at indices 0~numPlayers-1, egg is at numPlayers in its componentDataStorage vector.
             Client side rendering follows the same order. 
             So for the same CM, do NOT change the order of addComponent^. (which shouldn't need changing anyways)
 
@@ -124,39 +122,23 @@ namespace bge {
             ^(enums are still numbers under the hood, can't solve vector index inconsistency)
         */
 
-        // Init all ball projectiles (they start out inactive then we'll make them active as we need them)
+        // Init ball projectiles (they start out inactive then we'll make them active as we need them)
         for (unsigned int i = 0; i < NUM_PROJ_TYPES; i++) {
-            for (unsigned int j = 0; j < NUM_EACH_PROJECTILE; j++) {
-                Entity newProj = createEntity(PROJECTILE);
-                ballProjectiles[i][j] = newProj;
-
-                // Position starts below the map where they can't be seen
-                PositionComponent pos = PositionComponent(voidLocation);
-                addComponent(newProj, pos);
-                VelocityComponent vel = VelocityComponent(0.0f, 0.0f, 0.0f);
-                addComponent(newProj, vel);
-                std::vector<glm::vec3> collisionPoints = { glm::vec3(0, -PROJ_Y_HEIGHT / 2, 0),glm::vec3(0, PROJ_Y_HEIGHT / 2, 0),
-                                                          glm::vec3(-PROJ_X_WIDTH / 2, 0, 0),glm::vec3(PROJ_X_WIDTH / 2, 0, 0),
-                                                          glm::vec3(0, 0, -PROJ_Z_WIDTH / 2),glm::vec3(0, 0, PROJ_Z_WIDTH / 2) };
-                // All points are "ground points" since we're using this to determine if we've collided at all
-                std::vector<int> groundPoints = { 0, 1, 2, 3, 4, 5 };
-                MeshCollisionComponent meshCol = MeshCollisionComponent(collisionPoints, groundPoints, false);
-                addComponent(newProj, meshCol);
-                BoxDimensionComponent boxDim = BoxDimensionComponent(PROJ_X_WIDTH, PROJ_Y_HEIGHT, PROJ_Z_WIDTH);
-                addComponent(newProj, boxDim);
-                BallProjDataComponent data = BallProjDataComponent((BallProjType)i);
-                addComponent(newProj, data);
-
-                projIndices.push_back(movementSystem->size());
-                movementSystem->registerEntity(newProj);
-                projectileStateSystem->registerEntity(newProj);
-                boxCollisionSystem->registerEntity(newProj);
+            for (unsigned int j = 0; j < numPlayers * PROJECTILES_PER_PLAYER; j++) {
+                createProjectile((BallProjType)i);
             }
         }
 
         currentSeason = SPRING_SEASON;
         seasonCounter = 0;
 
+        // Nothing recorded yet, make sure no frame looks like it belongs to a real tick
+        for (HitboxFrame& frame : hitboxHistory) {
+            frame.tick = UINT_MAX;
+            frame.mins.resize(numPlayers + 1);
+            frame.maxs.resize(numPlayers + 1);
+        }
+
         // Process player input
         systems.push_back(playerAccSystem);
         // Process position of the player camera
@@ -186,30 +168,40 @@ namespace bge {
         gameOver = false;
 
         // initialize all players' character selection
-        for (int i = 0; i < NUM_PLAYER_ENTITIES; i++) {
-            charactersUID[i] = NO_CHARACTER;
-        }
+        charactersUID.assign(numPlayers, NO_CHARACTER);
 
         // initialize all players' initial browsing character selection
-        for (int i = 0; i < NUM_PLAYER_ENTITIES; i++) {
-            browsingCharactersUID[i] = SPRING_CHARACTER;
-        }
+        browsingCharactersUID.assign(numPlayers, SPRING_CHARACTER);
+
+        // nobody has sent any input yet
+        queuedInputs.assign(numPlayers, std::deque<ClientToServerPacket>());
+        inputLeadTicks.assign(numPlayers, 0);
 
         // initialize all team setup
-        for (int i = 0; i < NUM_PLAYER_ENTITIES; i++) {
-            if (i % 2 == 0) {
-                teammates[i] = i + 1;
-            }
-            else {
-                teammates[i] = i - 1;
-            }
+        for (unsigned int i = 0; i < numPlayers; i++) {
+            teammates[i] = teammateOf(i);
         }
         
     }
 
+    /**
+     * Where a player spawns. There are only a few spawn points, so later players
+     * spread out in a ring around the spawn point they share
+     */
+    glm::vec3 World::playerInitPosition(unsigned int playerId) {
+        unsigned int numSpawns = playerInitPositions.size();
+        glm::vec3 spawn = playerInitPositions[playerId % numSpawns];
+        unsigned int ring = playerId / numSpawns;
+        if (ring == 0) {
+            return spawn;
+        }
+        float angle = ring * 2.4f;  // roughly the golden angle so the ring spots don't line up
+        return spawn + glm::vec3(std::cos(angle), 0.5f, std::sin(angle)) * (float)(1 + (ring - 1) / 6);
+    }
+
     void World::resetPlayer(unsigned int playerId) {
         PositionComponent& pos = positionCM->lookup(players[playerId]);
-        pos.position = playerInitPositions[playerId];
+        pos.position = playerInitPosition(playerId);
         pos.isLerping = false;
 
         VelocityComponent& vel = velocityCM->lookup(players[playerId]);
@@ -245,106 +237,74 @@ namespace bge {
     }
 
     rayIntersection World::intersect(glm::vec3 p0, glm::vec3 p1, float maxT) {
+        MeshIntersection meshIntersection = collisionMap->intersect(p0, p1, maxT);
+
         rayIntersection bestIntersection;
-        bestIntersection.t=INFINITY;
-
-        // Determine which buckets to use for checking intersection
-        glm::vec3 endingPos = p0 + p1 * maxT;
-        std::vector<unsigned int> bucketIndicesStart = determineBucket(p0.x, p0.z);
-        std::vector<unsigned int> bucketIndicesEnd = determineBucket(endingPos.x, endingPos.z);
-        unsigned int minXIndex = std::min(bucketIndicesStart[0], bucketIndicesEnd[0]);
-        unsigned int maxXIndex = std::max(bucketIndicesStart[0], bucketIndicesEnd[0]);
-        unsigned int minZIndex = std::min(bucketIndicesStart[1], bucketIndicesEnd[1]);
-        unsigned int maxZIndex = std::max(bucketIndicesStart[1], bucketIndicesEnd[1]);
-
-        std::unordered_set<unsigned int> mergedBucket;
-        // Bullets have a long ray, so bucketStart and bucketEnd would be far apart, resulting in a large rectangle of buckets 
-        // Many of them are unncessary. All we care about are buckets along ray. 
-        // nice2have: Bresenham’s line generation algorithm. Fix below nxm. 
-        for (unsigned int xIndex = minXIndex; xIndex <= maxXIndex; xIndex++) {
-            for (unsigned int zIndex = minZIndex; zIndex <= maxZIndex; zIndex++) {
-                // we store the buckets in a 1D-style, so convert this to a single index
-                int bucketIndex = zIndex * MAP_BUCKET_WIDTH + xIndex;
-                for (unsigned int triangleIndex : buckets[bucketIndex]) {
-                    mergedBucket.insert(triangleIndex);
+        bestIntersection.t = meshIntersection.t;
+        bestIntersection.normal = meshIntersection.normal;
+        if (meshIntersection.t != INFINITY) {
+            bestIntersection.ent.type = MESH;
+        }
+
+        // check against player boxes here. ()
+
+        return bestIntersection;
+    }
+
+    // Distance along the ray to the box, INFINITY if it misses
+    static float rayBoxDistance(glm::vec3 origin, glm::vec3 direction, glm::vec3 min, glm::vec3 max) {
+        float tFar = INFINITY;
+        float tNear = -tFar;
+
+        // check ray's x direction against the min and max yz-plane, etc. 
+        for (int i = 0; i < 3; i++) {
+            if (std::abs(direction[i]) < 0.0001f) {
+                if (origin[i] < min[i] || origin[i] > max[i]) {
+                    return INFINITY; // no hit, cuz ur out of the plane
                 }
             }
-        }
-        // std::cout << "ray length: " << maxT << "\t Number of buckets used: " << mergedBucket.size() << "\n";
-
-        for (unsigned int triangleIndex : mergedBucket) {
-            // get the points and the normals
-            glm::vec3 A = mapVertices[mapTriangles[3 * triangleIndex + 0]];
-            glm::vec3 B = mapVertices[mapTriangles[3 * triangleIndex + 1]];
-            glm::vec3 C = mapVertices[mapTriangles[3 * triangleIndex + 2]];
-            // get the normal - TODO precompute normals
-            glm::vec3 n = glm::normalize(glm::cross((C - A), (B - A)));
-            float t = (glm::dot(A, n) - glm::dot(p0, n)) / glm::dot(p1, n);
-            if (t > -0.001 && t < bestIntersection.t && t < maxT + 0.001) {
-                glm::vec3 iPos = p0 + t * p1;
-                float area = glm::length(glm::cross(B - A, C - B)) / 2;
-                float alpha = glm::length(glm::cross(B - iPos, C - iPos) / 2.0f) / area;
-                float beta = glm::length(glm::cross(A - iPos, C - iPos) / 2.0f) / area;
-                float gamma = glm::length(glm::cross(B - iPos, A - iPos) / 2.0f) / area;
-                // currently they have slight extra give of 0.01, this is because of floating point
-                // rounding. this can be adjusted
-                if (alpha >= -0.01 && beta >= -0.01 && gamma >= -0.01 && alpha + beta + gamma <= 1.01) {
-                    bestIntersection.t = t;
-                    bestIntersection.normal = n;
-                    bestIntersection.ent.type = MESH;
+            else {
+                // https://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-box-intersection.html
+                float t1 = (min[i] - origin[i]) / direction[i];
+                float t2 = (max[i] - origin[i]) / direction[i];
+                if (t1 > t2) {
+                    std::swap(t1, t2);
+                }
+                tNear = std::max(tNear, t1);
+                tFar = std::min(tFar, t2);
+
+                if (tNear > tFar || tFar < 0.0f) {
+                    return INFINITY;
                 }
             }
         }
+        return tNear;
+    }
 
-        // check against player boxes here. ()
+    size_t World::numHitboxTargets() {
+        return players.size() + 1;
+    }
 
-        return bestIntersection;
+    Entity World::hitboxTarget(size_t i) {
+        return i < players.size() ? players[i] : egg;
     }
 
-    rayIntersection World::intersectRayBox(glm::vec3 origin, glm::vec3 direction, float maxT) {
+    rayIntersection World::intersectRayBox(glm::vec3 origin, glm::vec3 direction, float maxT, int ignoreId) {
 
         rayIntersection bestIntersection;
         bestIntersection.t = INFINITY;
         bestIntersection.ent.id = -1; // no player hit 
 
-        Entity targets[] = {players[0], players[1], players[2], players[3], egg};
-
-        for (Entity target: targets) {
+        for (size_t i = 0; i < numHitboxTargets(); i++) {
+            Entity target = hitboxTarget(i);
+            if (target.id == ignoreId) {
+                continue;
+            }
 
             // target box
             PositionComponent& pos = positionCM->lookup(target);
             BoxDimensionComponent& dim = boxDimensionCM->lookup(target);
-            glm::vec3 min = pos.position - dim.halfDimension;
-            glm::vec3 max = pos.position + dim.halfDimension;
-       
-            // Ray
-            float tFar = INFINITY;
-            float tNear = -tFar;
-
-            // check ray's x direction against the min and max yz-plane, etc. 
-            for (int i = 0; i < 3; i++) {
-                if (std::abs(direction[i]) < 0.0001f) {
-                    if (origin[i] < min[i] || origin[i] > max[i]) {
-                        tNear = INFINITY; // no hit, cuz ur out of the plane
-                        break;
-                    }
-                }
-                else {
-                    // https://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-box-intersection.html
-                    float t1 = (min[i] - origin[i]) / direction[i];
-                    float t2 = (max[i] - origin[i]) / direction[i];
-                    if (t1 > t2) {
-                        std::swap(t1, t2);
-                    }
-                    tNear = std::max(tNear, t1);
-                    tFar = std::min(tFar, t2);
-
-                    if (tNear > tFar || tFar < 0.0f) {
-                        tNear = INFINITY;
-                        break;
-                    }
-                }
-            }
+            float tNear = rayBoxDistance(origin, direction, pos.position - dim.halfDimension, pos.position + dim.halfDimension);
 
             // hits, is it the closest target?
             if (tNear < maxT && tNear < bestIntersection.t) {
@@ -357,119 +317,66 @@ namespace bge {
         return bestIntersection;
     }
 
-    std::vector<unsigned int> World::determineBucket(float x, float z) {
-        float bucketXDim = (maxMapXValue - minMapXValue) / MAP_BUCKET_WIDTH;
-        float bucketZDim = (maxMapZValue - minMapZValue) / MAP_BUCKET_WIDTH;
-
-        float xIndexFloat = (x - minMapXValue) / bucketXDim;
-        float zIndexFloat = (z - minMapZValue) / bucketZDim;
-
-        // if we're too close to the edge of the map we might just barely end up in a bucket that doesn't exist,
-        // and we can never be completely precise with floats, so make sure we're not very far off the expected range
-        // and then fix it to be in the expected range
-        if (xIndexFloat >= MAP_BUCKET_WIDTH) xIndexFloat = MAP_BUCKET_WIDTH - 1;
-        if (zIndexFloat >= MAP_BUCKET_WIDTH) zIndexFloat = MAP_BUCKET_WIDTH - 1;
-        if (xIndexFloat < 0) xIndexFloat = 0;
-        if (zIndexFloat < 0) zIndexFloat = 0;
+    /**
+     * Remember where every shootable box is at the end of this tick
+     */
+    void World::recordHitboxes() {
+        HitboxFrame& frame = hitboxHistory[serverTick % HITBOX_HISTORY_TICKS];
+        frame.tick = serverTick;
+        for (size_t i = 0; i < numHitboxTargets(); i++) {
+            Entity target = hitboxTarget(i);
+            PositionComponent& pos = positionCM->lookup(target);
+            BoxDimensionComponent& dim = boxDimensionCM->lookup(target);
+            frame.mins[i] = pos.position - dim.halfDimension;
+            frame.maxs[i] = pos.position + dim.halfDimension;
+        }
+    }
 
-        unsigned int xIndex = static_cast<unsigned int>(xIndexFloat);
-        unsigned int zIndex = static_cast<unsigned int>(zIndexFloat);
-  
-        return { xIndex, zIndex };
+    /**
+     * Which tick a shot should be checked against: whatever the shooter was looking at,
+     * but never further back than MAX_REWIND_TICKS so high ping players can't shoot into the past forever.
+     * A viewTick of 0 means the shooter hasn't rendered a snapshot yet, so there's nothing to rewind to
+     */
+    float World::lagCompensatedTick(float viewTick) {
+        float newestTick = (float)serverTick;
+        if (viewTick <= 0) {
+            return newestTick;
+        }
+        return std::clamp(viewTick, std::max(0.0f, newestTick - MAX_REWIND_TICKS), newestTick);
     }
 
-    void World::initMesh() {
-        Assimp::Importer importer;
-        std::string mapFilePath = (std::string)(PROJECT_PATH) + SetupParser::getValue("collision-map");
-        
-        const aiScene* scene = importer.ReadFile(mapFilePath,
-            ASSIMP_IMPORT_FLAGS);
-        if (scene == nullptr) {
-            std::cerr << "Unable to load 3d model from path " << mapFilePath << std::endl;
-            exit(EXIT_FAILURE);
+    rayIntersection World::intersectRayBoxAtTick(glm::vec3 origin, glm::vec3 direction, float maxT, float tick, int ignoreId) {
+        unsigned int fromTick = (unsigned int)std::floor(tick);
+        unsigned int toTick = fromTick + 1;
+        const HitboxFrame& from = hitboxHistory[fromTick % HITBOX_HISTORY_TICKS];
+        const HitboxFrame& to = hitboxHistory[toTick % HITBOX_HISTORY_TICKS];
+
+        // Haven't recorded that far back (or it's already been overwritten), use where things are now
+        if (tick >= serverTick || from.tick != fromTick || to.tick != toTick) {
+            return intersectRayBox(origin, direction, maxT, ignoreId);
         }
-        std::cout << "Loaded environment model\n";
-
-        minMapXValue = 0;
-        maxMapXValue = 0;
-        minMapZValue = 0;
-        maxMapZValue = 0;
-        minMapYValue = 0;
-        maxMapYValue = 0;
-
-        unsigned int highestMeshIndex = scene->mNumMeshes;
-
-        // Load meshes into ModelComposite data structures
-        for (unsigned int i = 0; i < highestMeshIndex; i++) {
-            aiMesh& mesh = *scene->mMeshes[i];
-            // load vertices
-            for (unsigned int j = 0; j < mesh.mNumVertices; j++) {
-                const aiVector3D& vertex = mesh.mVertices[j];
-                mapVertices.push_back(glm::vec3(vertex[0], vertex[1], vertex[2]));
-                if (vertex[0] < minMapXValue) {
-                    minMapXValue = vertex[0];
-                } else if (vertex[0] > maxMapXValue) {
-                    maxMapXValue = vertex[0];
-                }
-                if (vertex[1] < minMapYValue) {
-                    minMapYValue = vertex[1];
-                } else if (vertex[1] > maxMapYValue) {
-                    maxMapYValue = vertex[1];
-                }
-                if (vertex[2] < minMapZValue) {
-                    minMapZValue = vertex[2];
-                }
-                else if (vertex[2] > maxMapZValue) {
-                    maxMapZValue = vertex[2];
-                }
+
+        rayIntersection bestIntersection;
+        bestIntersection.t = INFINITY;
+        bestIntersection.ent.id = -1; // no player hit 
+
+        // Client renders between ticks, so blend between the two recorded ticks the same way
+        float alpha = tick - fromTick;
+        for (size_t i = 0; i < numHitboxTargets(); i++) {
+            Entity target = hitboxTarget(i);
+            if (target.id == ignoreId) {
+                continue;
             }
-        }
-        for (unsigned int i = 0; i < highestMeshIndex; i++) {
-            aiMesh& mesh = *scene->mMeshes[i];
-            // load triangles
-            for (unsigned int j = 0; j < mesh.mNumFaces; j++) {
-                const aiFace& face = mesh.mFaces[j];
-
-                // Add vertex indices to the main triangle vector
-                int triangleIndex = mapTriangles.size() / 3;
-                mapTriangles.push_back(face.mIndices[0]);
-                mapTriangles.push_back(face.mIndices[1]);
-                mapTriangles.push_back(face.mIndices[2]);
-
-                // A, B, and C are the vertices of this triangle
-                glm::vec3 A = mapVertices[face.mIndices[0]];
-                glm::vec3 B = mapVertices[face.mIndices[1]];
-                glm::vec3 C = mapVertices[face.mIndices[2]];
-
-                std::vector<unsigned int> bucketIndicesA = determineBucket(A.x, A.z);
-                std::vector<unsigned int> bucketIndicesB = determineBucket(B.x, B.z);
-                std::vector<unsigned int> bucketIndicesC = determineBucket(C.x, C.z);
-
-                // We want to put the triangles into every bucket they cover (usually this should just be one bucket)
-                // we do this by putting the triangle into all buckets in the rectangle from the minimum x index to the maximum x index
-                // and from the minimum z index to the maximum z index
-                // this may occasionally lead to putting a triangle into a bucket that it doesn't actually cover,
-                // but we don't care very much (small performance loss),
-                // and it should never lead to a triangle not being in a bucket it should be in
-                unsigned int minXIndex = std::min({bucketIndicesA[0], bucketIndicesB[0], bucketIndicesC[0]});
-                unsigned int maxXIndex = std::max({bucketIndicesA[0], bucketIndicesB[0], bucketIndicesC[0]});
-                unsigned int minZIndex = std::min({bucketIndicesA[1], bucketIndicesB[1], bucketIndicesC[1]});
-                unsigned int maxZIndex = std::max({bucketIndicesA[1], bucketIndicesB[1], bucketIndicesC[1]});
-                for (unsigned int xIndex = minXIndex; xIndex <= maxXIndex; xIndex++) {
-                    for (unsigned int zIndex = minZIndex; zIndex <= maxZIndex; zIndex++) {
-                        // we store the buckets in a 1D-style, so convert this to a single index
-                        int bucketIndex = zIndex * MAP_BUCKET_WIDTH + xIndex;
-                        // add the triangle to the bucket
-                        /*buckets[bucketIndex].push_back(face.mIndices[0]);
-                        buckets[bucketIndex].push_back(face.mIndices[1]);
-                        buckets[bucketIndex].push_back(face.mIndices[2]);*/
-                        buckets[bucketIndex].insert(triangleIndex);
-                    }
-                }
+            glm::vec3 min = glm::mix(from.mins[i], to.mins[i], alpha);
+            glm::vec3 max = glm::mix(from.maxs[i], to.maxs[i], alpha);
+            float tNear = rayBoxDistance(origin, direction, min, max);
+            if (tNear < maxT && tNear < bestIntersection.t) {
+                bestIntersection.t = tNear;
+                bestIntersection.ent = target;
             }
         }
 
-        std::cout << "loaded vertices and triangles\n";
+        return bestIntersection;
     }
 
     Entity World::createEntity(EntityType type) {
@@ -567,12 +474,15 @@ namespace bge {
     void World::updateAllSystems() {
 
         // double gameDurationInSeconds; // moved to World.h
+        serverTick++;
+        applyQueuedInputs();
 
         if (!gameOver) {
             // this needs to be a reference because the elements in systems are unique_ptrs
             for (auto& s : systems) {
                 s->update();
             }
+            recordHitboxes();
             gameDurationInSeconds = difftime(time(nullptr),worldTimer);
             if (difftime(time(nullptr),lastTimerCheck) > 30) {
                 printf("%f seconds have passed.\n", gameDurationInSeconds);
@@ -591,42 +501,80 @@ namespace bge {
         std::vector<PositionComponent>& positions = positionCM->getAllComponents();
         std::vector<PlayerDataComponent>& playerData = playerDataCM->getAllComponents();
 
-        int teamBlueScore = playerData[0].points + playerData[1].points;
-        int teamRedScore = playerData[2].points + playerData[3].points;
-
-        if (teamBlueScore >= teamRedScore) {
-            // Winner at the foot of the bear
-            positions[0].position = WINNER_1_POS;
-            positions[1].position = WINNER_2_POS;
-
-            // Losers to the side of the bear, clapping?
-            positions[2].position = LOSER_1_POS;
-            positions[3].position = LOSER_2_POS;
-
-            winner = BLUE;
-        } else if (teamRedScore > teamBlueScore) {
-            positions[0].position = LOSER_1_POS;
-            positions[1].position = LOSER_2_POS;
-
-            positions[2].position = WINNER_1_POS;
-            positions[3].position = WINNER_2_POS;
-
-            winner = RED;
+        int teamScores[2] = { 0, 0 };
+        for (unsigned int i = 0; i < players.size(); i++) {
+            teamScores[teamOf(i)] += playerData[i].points;
         }
 
         // What to do in case of tie?
         // Right now, BLUE teams wins.
-
+        winner = teamScores[BLUE] >= teamScores[RED] ? BLUE : RED;
+
+        // Winners at the foot of the bear, losers to the side of the bear, clapping?
+        // Each team's first pair gets the two spots, anyone after them lines up behind
+        unsigned int placed[2] = { 0, 0 };
+        for (unsigned int i = 0; i < players.size(); i++) {
+            Teams team = teamOf(i);
+            unsigned int n = placed[team]++;
+            glm::vec3 spot;
+            if (team == winner) {
+                spot = n % 2 == 0 ? WINNER_1_POS : WINNER_2_POS;
+            } else {
+                spot = n % 2 == 0 ? LOSER_1_POS : LOSER_2_POS;
+            }
+            positions[i].position = spot + GAME_END_CAMERA_DIR * (float)(n / 2);
+        }
     }
 
     void World::printDebug() {
     }
 
+    void World::queuePlayerInput(unsigned int player, const ClientToServerPacket& packet) {
+        if (player >= players.size()) {
+            // a client that joined after the match filled up, it doesn't have a player
+            return;
+        }
+        // serverTick+1 is the next tick to run, anything meant for it got here just in time
+        inputLeadTicks[player] = packet.targetTick == 0 ? 0 : (int)(packet.targetTick - (serverTick + 1));
+
+        std::deque<ClientToServerPacket>& queue = queuedInputs[player];
+        if (queue.size() >= MAX_QUEUED_INPUTS) {
+            queue.pop_front();
+        }
+        queue.push_back(packet);
+    }
+
+    void World::applyQueuedInputs() {
+        for (unsigned int i = 0; i < players.size(); i++) {
+            std::deque<ClientToServerPacket>& queue = queuedInputs[i];
+            if (queue.empty()) {
+                continue;
+            }
+            const ClientToServerPacket& packet = queue.front();
+            // a target this far ahead means the client's clock is off, don't let it stall the player
+            bool due = packet.targetTick == 0 || packet.targetTick <= serverTick || packet.targetTick > serverTick + MAX_QUEUED_INPUTS;
+            if (!due) {
+                continue;
+            }
+            updatePlayerInput(i, packet.pitch, packet.yaw, packet.requestForward, packet.requestBackward,
+            packet.requestLeftward, packet.requestRightward, packet.requestJump, packet.requestThrowEgg,
+            packet.requestShoot, packet.requestAbility, packet.requestReset, packet.requestBomb, packet.godRequest, packet.seasonSpeedup, packet.inputSequence, packet.viewTick, packet.targetTick);
+            queue.pop_front();
+        }
+    }
+
     void World::updatePlayerInput(unsigned int player, float pitch, float yaw, bool forwardRequested, bool backwardRequested, 
     bool leftRequested, bool rightRequested, bool jumpRequested, bool throwEggRequested, bool shootRequested, bool abilityRequested, 
-    bool resetRequested, bool bombRequested, bool godRequested, bool seasonSpeedup) {
+    bool resetRequested, bool bombRequested, bool godRequested, bool seasonSpeedup, unsigned int inputSequence, float viewTick, unsigned int targetTick) {
+        if (player >= players.size()) {
+            // a client that joined after the match filled up, it doesn't have a player
+            return;
+        }
         MovementRequestComponent& req = movementRequestCM->lookup(players[player]);
 
+        req.inputSequence = inputSequence;
+        req.viewTick = viewTick;
+        req.targetTick = targetTick;
         req.pitch = pitch;
         req.yaw = yaw;
         req.forwardRequested = forwardRequested;
@@ -653,25 +601,69 @@ namespace bge {
     }
     
     void World::updatePlayerCharacterSelection(unsigned int player, int browsingCharacterUID, int characterUID) {
+        if (player >= players.size()) {
+            return;
+        }
         charactersUID[player] = characterUID;
         browsingCharactersUID[player] = browsingCharacterUID;
     }
 
+    void World::freePlayerSlot(unsigned int player) {
+        if (player >= players.size()) {
+            return;
+        }
+        charactersUID[player] = NO_CHARACTER;
+        browsingCharactersUID[player] = SPRING_CHARACTER;
+        queuedInputs[player].clear();
+        inputLeadTicks[player] = 0;
+    }
+
     Entity World::getFreshProjectile(BallProjType projType) {
-        int i = 0;
-        while (i < NUM_EACH_PROJECTILE) {
-            Entity ballProjEntity = ballProjectiles[projType][i];
+        for (Entity ballProjEntity : ballProjectiles[projType]) {
             BallProjDataComponent& data = ballProjDataCM->lookup(ballProjEntity);
             if (!data.active) {
                 data.active = true;
                 meshCollisionCM->lookup(ballProjEntity).active = true;
                 return ballProjEntity;
             }
-            i++;
         }
-        // If we reach the end of this function, that means all projectiles are active and we don't have one to give
-        assert(false);
-        return NULL;
+        // All of them are in the air, make another one. It stays in the pool for later
+        Entity ballProjEntity = createProjectile(projType);
+        ballProjDataCM->lookup(ballProjEntity).active = true;
+        meshCollisionCM->lookup(ballProjEntity).active = true;
+        return ballProjEntity;
+    }
+
+    /**
+     * Make an inactive projectile and add it to the end of the movement entities
+     */
+    Entity World::createProjectile(BallProjType projType) {
+        Entity newProj = createEntity(PROJECTILE);
+        ballProjectiles[projType].push_back(newProj);
+
+        // Position starts below the map where they can't be seen
+        PositionComponent pos = PositionComponent(voidLocation);
+        addComponent(newProj, pos);
+        VelocityComponent vel = VelocityComponent(0.0f, 0.0f, 0.0f);
+        addComponent(newProj, vel);
+        std::vector<glm::vec3> collisionPoints = { glm::vec3(0, -PROJ_Y_HEIGHT / 2, 0),glm::vec3(0, PROJ_Y_HEIGHT / 2, 0),
+                                                  glm::vec3(-PROJ_X_WIDTH / 2, 0, 0),glm::vec3(PROJ_X_WIDTH / 2, 0, 0),
+                                                  glm::vec3(0, 0, -PROJ_Z_WIDTH / 2),glm::vec3(0, 0, PROJ_Z_WIDTH / 2) };
+        // All points are "ground points" since we're using this to determine if we've collided at all
+        std::vector<int> groundPoints = { 0, 1, 2, 3, 4, 5 };
+        MeshCollisionComponent meshCol = MeshCollisionComponent(collisionPoints, groundPoints, false);
+        addComponent(newProj, meshCol);
+        BoxDimensionComponent boxDim = BoxDimensionComponent(PROJ_X_WIDTH, PROJ_Y_HEIGHT, PROJ_Z_WIDTH);
+        addComponent(newProj, boxDim);
+        BallProjDataComponent data = BallProjDataComponent(projType);
+        addComponent(newProj, data);
+
+        projIndices.push_back(movementSystem->size());
+        projTypes.push_back(projType);
+        movementSystem->registerEntity(newProj);
+        projectileStateSystem->registerEntity(newProj);
+        boxCollisionSystem->registerEntity(newProj);
+        return newProj;
     }
 
     Entity World::getEgg() {
@@ -679,39 +671,57 @@ namespace bge {
     }
 
     void World::fillInGameData(ServerToClientPacket& packet) {
-        std::vector<PositionComponent> positions = positionCM->getAllComponents();
-        for (int i = 0; i < NUM_MOVEMENT_ENTITIES; i++) {
-            packet.positions[i] = positions[i].position;
-        }
-        std::vector<MovementRequestComponent> requests = movementRequestCM->getAllComponents();
-        for (int i = 0; i < NUM_PLAYER_ENTITIES; i++) {
-            packet.pitches[i] = requests[i].pitch;
-            packet.yaws[i] = requests[i].yaw;
-            packet.movementEntityStates[i][IS_SHOOTING] = requests[i].shootRequested;
-            packet.movementEntityStates[i][IS_USING_ABILITY] = requests[i].abilityRequested;
-        }
-        std::vector<CameraComponent> cameras = cameraCM->getAllComponents();
-        for (int i = 0; i < cameras.size(); i++) {
-            packet.cameraDistances[i] = cameras[i].distanceBehindPlayer;
-        }
-        std::vector<VelocityComponent> velocities = velocityCM->getAllComponents();
-        for (int i = 0; i < velocities.size(); i++) {
-            packet.movementEntityStates[i][ON_GROUND] = velocities[i].onGround;
-            packet.movementEntityStates[i][MOVING_HORIZONTALLY] = velocities[i].velocity.x != 0 || velocities[i].velocity.z != 0;
+        packet.serverTick = serverTick;
+        std::vector<PositionComponent>& positions = positionCM->getAllComponents();
+        std::vector<VelocityComponent>& velocities = velocityCM->getAllComponents();
+        packet.movementEntities.resize(positions.size());
+        for (size_t i = 0; i < positions.size(); i++) {
+            MovementEntitySnapshot& entity = packet.movementEntities[i];
+            entity.position = positions[i].position;
+            // only players have a view direction, but the client interpolates every entity's
+            entity.yaw = 0;
+            entity.pitch = 0;
+            entity.states.reset();
+            entity.states[ON_GROUND] = velocities[i].onGround;
+            entity.states[MOVING_HORIZONTALLY] = velocities[i].velocity.x != 0 || velocities[i].velocity.z != 0;
+            entity.states[IS_DANCING] = positions[i].isBombDancing /*|| requests[i].danceRequested*/ ;
         }
-        for (unsigned int i = 0; i < NUM_PROJ_TYPES; i++) {
-            for (unsigned int j = 0; j < NUM_EACH_PROJECTILE; j++) {
-                BallProjDataComponent& projData = ballProjDataCM->lookup(ballProjectiles[i][j]);
-                packet.active[i * NUM_EACH_PROJECTILE + j] = projData.active;
-                packet.movementEntityStates[projIndices[i * NUM_EACH_PROJECTILE + j]][EXPLODING] = projData.exploded;
-            }
+
+        std::vector<MovementRequestComponent>& requests = movementRequestCM->getAllComponents();
+        std::vector<CameraComponent>& cameras = cameraCM->getAllComponents();
+        std::vector<HealthComponent>& healths = healthCM->getAllComponents();
+        std::vector<PlayerDataComponent>& playerData = playerDataCM->getAllComponents();
+        std::vector<SeasonAbilityStatusComponent>& seasonAbilityStatus = seasonAbilityStatusCM->getAllComponents();
+        packet.players.resize(players.size());
+        for (size_t i = 0; i < players.size(); i++) {
+            MovementEntitySnapshot& entity = packet.movementEntities[i];
+            entity.pitch = requests[i].pitch;
+            entity.yaw = requests[i].yaw;
+            entity.states[IS_SHOOTING] = requests[i].shootRequested;
+            entity.states[IS_USING_ABILITY] = requests[i].abilityRequested;
+            entity.states[IS_LERPING] = positions[i].isLerping;
+
+            PlayerSnapshot& player = packet.players[i];
+            player.cameraDistance = cameras[i].distanceBehindPlayer;
+            player.health = healths[i].healthPoint;
+            player.score = playerData[i].points >> 5; // div 32 to avoid score growing too fast. 
+            player.seasonAbilityCD = seasonAbilityStatus[i].coolDown;
+            // enough for each client to rewind its own player to this tick and replay its newer inputs
+            player.movementState = getPlayerMovementState(players[i]);
+            // only inputs that have actually been simulated are acked
+            player.lastInputSequence = requests[i].inputSequence;
+            // how early this player's input got here, the client tunes its send timing to keep this at 0
+            player.inputLeadTicks = inputLeadTicks[i];
         }
-        std::vector<HealthComponent> healths = healthCM->getAllComponents();
-        std::vector<PlayerDataComponent> playerData = playerDataCM->getAllComponents();
-        for (int i = 0; i < NUM_PLAYER_ENTITIES; i++) {
-            packet.healths[i] = healths[i].healthPoint;
-            packet.scores[i] = playerData[i].points >> 5; // div 32 to avoid score growing too fast. 
+
+        // projectiles are the only entities with BallProjData, in the order they were made
+        std::vector<BallProjDataComponent>& projData = ballProjDataCM->getAllComponents();
+        packet.projectiles.resize(projIndices.size());
+        for (size_t i = 0; i < projIndices.size(); i++) {
+            packet.projectiles[i] = { projIndices[i], projTypes[i], projData[i].active };
+            packet.movementEntities[projIndices[i]].states[EXPLODING] = projData[i].exploded;
         }
+
         packet.currentSeason = currentSeason;
         packet.seasonBlend = ((float)seasonCounter) / SEASON_LENGTH;
         EggInfoComponent& eggInfo = eggInfoCM->lookup(egg);
@@ -719,24 +729,13 @@ namespace bge {
         packet.eggHolderId = eggInfo.holderId;
         packet.bombIsThrown = eggInfo.bombIsThrown;
         packet.danceInAction = eggInfo.danceInAction;
-        for (int i = 0; i < NUM_MOVEMENT_ENTITIES; i++) {
-            packet.movementEntityStates[i][IS_DANCING] = positions[i].isBombDancing /*|| requests[i].danceRequested*/ ;
-        }
-        packet.detonationMiliSecs = eggInfo.detonationTicks * 33;
+        packet.detonationMiliSecs = eggInfo.detonationTicks * SERVER_TICK_MS;
         packet.gameDurationInSeconds = this->gameDurationInSeconds;
-        std::vector<SeasonAbilityStatusComponent> seasonAbilityStatus = seasonAbilityStatusCM->getAllComponents();
-        for (int i = 0; i < NUM_PLAYER_ENTITIES; i++) {
-            packet.seasonAbilityCD[i] = seasonAbilityStatus[i].coolDown;
-            // std::printf("seasonAbilityStatus[%d].coolDown=%d\n", i, seasonAbilityStatus[i].coolDown);
-        }
     }
 
     void World::fillInBulletData(BulletPacket& packet) {
         // tell client about the bullets that spawned during this game tick
-        for (int i = 0; i < bulletTrails.size(); i++) {
-            packet.bulletTrail[i] = bulletTrails[i];
-        }
-        packet.count = bulletTrails.size();
+        packet.bulletTrails = bulletTrails;
         bulletTrails.clear();
     }
 
@@ -745,11 +744,18 @@ namespace bge {
         packet.winner = winner;
     }
 
-    void World::fillInCharacterSelectionData(LobbyServerToClientPacket& packet) {
-        for (int i = 0; i < NUM_PLAYER_ENTITIES; i++) {
-            packet.playersCharacter[i] = charactersUID[i];
-            packet.playersBrowsingCharacter[i] = browsingCharactersUID[i];
-            packet.teams[i] = teammates[i];
+    void World::fillInCharacterSelectionData(LobbyServerToClientPacket& packet, unsigned int numJoined, const std::set<unsigned int>& freeSlots) {
+        packet.players.resize(std::min((size_t)numJoined, players.size()));
+        for (size_t i = 0; i < players.size(); i++) {
+            if (freeSlots.count(i)) {
+                if (i < packet.players.size()) {
+                    packet.players[i] = { false, NO_CHARACTER, NO_CHARACTER, teammates[i] };
+                }
+                continue;
+            }
+            if (i < packet.players.size()) {
+                packet.players[i] = { true, charactersUID[i], browsingCharactersUID[i], teammates[i] };
+            }
 
             playerDataCM->lookup(players[i]).playerType = (PlayerType) browsingCharactersUID[i];
         }
@@ -757,6 +763,25 @@ namespace bge {
 
 
     bool World::withinMapBounds(glm::vec3 pos) {
-        return pos.x >= minMapXValue && pos.x <= maxMapXValue && pos.y >= minMapYValue && pos.y <= maxMapYValue + HEIGHT_LIMIT && pos.z >= minMapZValue && pos.z <= maxMapZValue;
+        return collisionMap->withinMapBounds(pos);
+    }
+
+    physics::PlayerMovementState World::getPlayerMovementState(Entity player) {
+        PositionComponent& pos = positionCM->lookup(player);
+        VelocityComponent& vel = velocityCM->lookup(player);
+        JumpInfoComponent& jump = jumpInfoCM->lookup(player);
+        StatusEffectsComponent& statusEffects = statusEffectsCM->lookup(player);
+
+        physics::PlayerMovementState state;
+        state.position = pos.position;
+        state.velocity = vel.velocity;
+        state.onGround = vel.onGround;
+        state.timeOnGround = vel.timeOnGround;
+        state.doubleJumpUsed = jump.doubleJumpUsed;
+        state.jumpHeld = jump.jumpHeld;
+        state.alternateMovementSpeed = statusEffects.alternateMovementSpeed;
+        state.movementSpeedTicksLeft = statusEffects.movementSpeedTicksLeft;
+        state.swappedControlsTicksLeft = statusEffects.swappedControlsTicksLeft;
+        return state;
     }
 } 
\ No newline at end of file